@@ -256,11 +256,33 @@ bool ActionsSuggestions::ValidateAndInitialize() {
     }
   }
 
+  if (model_->actions_entity_data_schema() != nullptr) {
+    entity_data_schema_ = LoadAndVerifyFlatbuffer<reflection::Schema>(
+        model_->actions_entity_data_schema()->Data(),
+        model_->actions_entity_data_schema()->size());
+    if (entity_data_schema_ == nullptr) {
+      TC3_LOG(ERROR) << "Could not load entity data schema data.";
+      return false;
+    }
+
+    compiled_entity_data_schema_ =
+        CompiledFlatbufferSchema::Create(entity_data_schema_);
+    if (compiled_entity_data_schema_ == nullptr) {
+      TC3_LOG(ERROR) << "Could not compile entity data schema.";
+      return false;
+    }
+  } else {
+    entity_data_schema_ = nullptr;
+  }
+
   if (model_->annotation_actions_spec() != nullptr &&
       model_->annotation_actions_spec()->annotation_mapping() != nullptr) {
     for (const AnnotationActionsSpec_::AnnotationMapping* mapping :
          *model_->annotation_actions_spec()->annotation_mapping()) {
       annotation_entity_types_.insert(mapping->annotation_collection()->str());
+      annotation_mapping_entity_fields_.emplace_back();
+      ResolveEntityFieldPath(mapping->entity_field(),
+                             &annotation_mapping_entity_fields_.back());
     }
   }
 
@@ -270,21 +292,6 @@ bool ActionsSuggestions::ValidateAndInitialize() {
     return false;
   }
 
-  if (model_->actions_entity_data_schema() != nullptr) {
-    entity_data_schema_ = LoadAndVerifyFlatbuffer<reflection::Schema>(
-        model_->actions_entity_data_schema()->Data(),
-        model_->actions_entity_data_schema()->size());
-    if (entity_data_schema_ == nullptr) {
-      TC3_LOG(ERROR) << "Could not load entity data schema data.";
-      return false;
-    }
-
-    entity_data_builder_.reset(
-        new ReflectiveFlatbufferBuilder(entity_data_schema_));
-  } else {
-    entity_data_schema_ = nullptr;
-  }
-
   std::string actions_script;
   if (GetUncompressedString(model_->lua_actions_script(),
                             model_->compressed_lua_actions_script(),
@@ -485,11 +492,42 @@ bool ActionsSuggestions::InitializeRules(
 
     compiled_rules->emplace_back(rule, std::move(compiled_pattern),
                                  std::move(compiled_output_pattern));
+
+    // Resolve the entity data field paths of the capturing groups once, so
+    // that matches can set the fields directly.
+    if (rule->actions() != nullptr) {
+      std::vector<std::vector<FlatbufferWriter::FieldPath>>* entity_fields =
+          &compiled_rules->back().entity_field_paths;
+      entity_fields->resize(rule->actions()->size());
+      for (int i = 0; i < rule->actions()->size(); i++) {
+        const auto* capturing_groups =
+            rule->actions()->Get(i)->capturing_group();
+        if (capturing_groups == nullptr) {
+          continue;
+        }
+        (*entity_fields)[i].resize(capturing_groups->size());
+        for (int j = 0; j < capturing_groups->size(); j++) {
+          ResolveEntityFieldPath(capturing_groups->Get(j)->entity_field(),
+                                 &(*entity_fields)[i][j]);
+        }
+      }
+    }
   }
 
   return true;
 }
 
+void ActionsSuggestions::ResolveEntityFieldPath(
+    const FlatbufferFieldPath* field_path,
+    FlatbufferWriter::FieldPath* resolved) const {
+  if (field_path == nullptr || compiled_entity_data_schema_ == nullptr) {
+    return;
+  }
+  if (!compiled_entity_data_schema_->ResolveFieldPath(field_path, resolved)) {
+    TC3_LOG(ERROR) << "Could not resolve entity data field path.";
+  }
+}
+
 bool ActionsSuggestions::IsLowConfidenceInput(
     const Conversation& conversation, const int num_messages,
     std::vector<int>* post_check_rules) const {
@@ -1038,13 +1076,22 @@ void ActionsSuggestions::SuggestActionsFromAnnotations(
       model_->annotation_actions_spec()->max_history_from_last_person();
   const int last_person = conversation.messages.back().user_id;
 
+  std::unique_ptr<FlatbufferWriter> entity_data_writer;
+  if (compiled_entity_data_schema_ != nullptr) {
+    entity_data_writer.reset(
+        new FlatbufferWriter(compiled_entity_data_schema_.get()));
+  }
+
   int num_messages_last_person = 0;
   int num_messages_any_person = 0;
   bool all_from_last_person = true;
   for (int message_index = conversation.messages.size() - 1; message_index >= 0;
        message_index--) {
     const ConversationMessage& message = conversation.messages[message_index];
-    std::vector<AnnotatedSpan> annotations = message.annotations;
+
+    // Annotations of the message, computed if the message has none.
+    std::vector<AnnotatedSpan> computed_annotations;
+    const std::vector<AnnotatedSpan>* annotations = &message.annotations;
 
     // Update how many messages we have processed from the last person in the
     // conversation and from any person in the conversation.
@@ -1070,13 +1117,14 @@ void ActionsSuggestions::SuggestActionsFromAnnotations(
       }
     }
 
-    if (annotations.empty() && annotator != nullptr) {
-      annotations = annotator->Annotate(message.text,
-                                        AnnotationOptionsForMessage(message));
+    if (annotations->empty() && annotator != nullptr) {
+      computed_annotations = annotator->Annotate(
+          message.text, AnnotationOptionsForMessage(message));
+      annotations = &computed_annotations;
     }
     std::vector<ActionSuggestionAnnotation> action_annotations;
-    action_annotations.reserve(annotations.size());
-    for (const AnnotatedSpan& annotation : annotations) {
+    action_annotations.reserve(annotations->size());
+    for (const AnnotatedSpan& annotation : *annotations) {
       if (annotation.classification.empty()) {
         continue;
       }
@@ -1091,20 +1139,22 @@ void ActionsSuggestions::SuggestActionsFromAnnotations(
               .UTF8Substring(annotation.span.first, annotation.span.second)};
       action_annotation.entity = classification_result;
       action_annotation.name = classification_result.collection;
-      action_annotations.push_back(action_annotation);
+      action_annotations.push_back(std::move(action_annotation));
     }
 
     if (model_->annotation_actions_spec()->deduplicate_annotations()) {
       // Create actions only for deduplicated annotations.
       for (const int annotation_id :
            DeduplicateAnnotations(action_annotations)) {
-        SuggestActionsFromAnnotation(
-            message_index, action_annotations[annotation_id], actions);
+        SuggestActionsFromAnnotation(message_index,
+                                     action_annotations[annotation_id],
+                                     entity_data_writer.get(), actions);
       }
     } else {
       // Create actions for all annotations.
       for (const ActionSuggestionAnnotation& annotation : action_annotations) {
-        SuggestActionsFromAnnotation(message_index, annotation, actions);
+        SuggestActionsFromAnnotation(message_index, annotation,
+                                     entity_data_writer.get(), actions);
       }
     }
   }
@@ -1112,11 +1162,16 @@ void ActionsSuggestions::SuggestActionsFromAnnotations(
 
 void ActionsSuggestions::SuggestActionsFromAnnotation(
     const int message_index, const ActionSuggestionAnnotation& annotation,
+    FlatbufferWriter* entity_data_writer,
     std::vector<ActionSuggestion>* actions) const {
-  for (const AnnotationActionsSpec_::AnnotationMapping* mapping :
-       *model_->annotation_actions_spec()->annotation_mapping()) {
+  const auto* mappings =
+      model_->annotation_actions_spec()->annotation_mapping();
+  for (int mapping_index = 0; mapping_index < mappings->size();
+       mapping_index++) {
+    const AnnotationActionsSpec_::AnnotationMapping* mapping =
+        mappings->Get(mapping_index);
     if (annotation.entity.collection ==
-        mapping->annotation_collection()->str()) {
+        mapping->annotation_collection()->c_str()) {
       if (annotation.entity.score < mapping->min_annotation_score()) {
         continue;
       }
@@ -1127,19 +1182,20 @@ void ActionsSuggestions::SuggestActionsFromAnnotation(
 
       // Set annotation text as (additional) entity data field.
       if (mapping->entity_field() != nullptr) {
-        std::unique_ptr<ReflectiveFlatbuffer> entity_data =
-            entity_data_builder_->NewRoot();
-        TC3_CHECK(entity_data != nullptr);
+        TC3_CHECK(entity_data_writer != nullptr);
+        entity_data_writer->Reset();
 
         // Merge existing static entity data.
         if (!suggestion.serialized_entity_data.empty()) {
-          entity_data->MergeFromSerializedFlatbuffer(
+          entity_data_writer->MergeFromSerializedFlatbuffer(
               StringPiece(suggestion.serialized_entity_data.c_str(),
                           suggestion.serialized_entity_data.size()));
         }
 
-        entity_data->ParseAndSet(mapping->entity_field(), annotation.span.text);
-        suggestion.serialized_entity_data = entity_data->Serialize();
+        entity_data_writer->ParseAndSet(
+            annotation_mapping_entity_fields_[mapping_index],
+            annotation.span.text);
+        entity_data_writer->Serialize(&suggestion.serialized_entity_data);
       }
 
       suggestion.annotations = {annotation};
@@ -1216,40 +1272,51 @@ bool ActionsSuggestions::SuggestActionsFromRules(
   const std::string& message = conversation.messages.back().text;
   const UnicodeText message_unicode(
       UTF8ToUnicodeText(message, /*do_copy=*/false));
+  std::unique_ptr<FlatbufferWriter> entity_data_writer;
+  if (compiled_entity_data_schema_ != nullptr) {
+    entity_data_writer.reset(
+        new FlatbufferWriter(compiled_entity_data_schema_.get()));
+  }
   for (const CompiledRule& rule : rules_) {
     const std::unique_ptr<UniLib::RegexMatcher> matcher =
         rule.pattern->Matcher(message_unicode);
     int status = UniLib::RegexMatcher::kNoError;
     while (matcher->Find(&status) && status == UniLib::RegexMatcher::kNoError) {
-      for (const RulesModel_::Rule_::RuleActionSpec* rule_action :
-           *rule.rule->actions()) {
+      for (int action_index = 0; action_index < rule.rule->actions()->size();
+           action_index++) {
+        const RulesModel_::Rule_::RuleActionSpec* rule_action =
+            rule.rule->actions()->Get(action_index);
         const ActionSuggestionSpec* action = rule_action->action();
         std::vector<ActionSuggestionAnnotation> annotations;
 
         bool sets_entity_data = false;
-        std::unique_ptr<ReflectiveFlatbuffer> entity_data =
-            entity_data_builder_ != nullptr ? entity_data_builder_->NewRoot()
-                                            : nullptr;
+        if (entity_data_writer != nullptr) {
+          entity_data_writer->Reset();
+        }
 
         // Set static entity data.
         if (action != nullptr && action->serialized_entity_data() != nullptr) {
-          TC3_CHECK(entity_data != nullptr);
+          TC3_CHECK(entity_data_writer != nullptr);
           sets_entity_data = true;
-          entity_data->MergeFromSerializedFlatbuffer(
+          entity_data_writer->MergeFromSerializedFlatbuffer(
               StringPiece(action->serialized_entity_data()->c_str(),
                           action->serialized_entity_data()->size()));
         }
 
         // Add entity data from rule capturing groups.
         if (rule_action->capturing_group() != nullptr) {
-          for (const RulesModel_::Rule_::RuleActionSpec_::RuleCapturingGroup*
-                   group : *rule_action->capturing_group()) {
+          for (int group_index = 0;
+               group_index < rule_action->capturing_group()->size();
+               group_index++) {
+            const RulesModel_::Rule_::RuleActionSpec_::RuleCapturingGroup*
+                group = rule_action->capturing_group()->Get(group_index);
             if (group->entity_field() != nullptr) {
-              TC3_CHECK(entity_data != nullptr);
+              TC3_CHECK(entity_data_writer != nullptr);
               sets_entity_data = true;
               if (!SetFieldFromCapturingGroup(
-                      group->group_id(), group->entity_field(), matcher.get(),
-                      entity_data.get())) {
+                      group->group_id(),
+                      rule.entity_field_paths[action_index][group_index],
+                      matcher.get(), entity_data_writer.get())) {
                 TC3_LOG(ERROR)
                     << "Could not set entity data from rule capturing group.";
                 return false;
@@ -1288,7 +1355,7 @@ bool ActionsSuggestions::SuggestActionsFromRules(
           ActionSuggestion suggestion = SuggestionFromSpec(action);
           suggestion.annotations = annotations;
           if (sets_entity_data) {
-            suggestion.serialized_entity_data = entity_data->Serialize();
+            entity_data_writer->Serialize(&suggestion.serialized_entity_data);
           }
           actions->push_back(suggestion);
         }
@@ -1435,6 +1502,15 @@ ActionsSuggestionsResponse ActionsSuggestions::SuggestActions(
   return SuggestActions(conversation, /*annotator=*/nullptr, options);
 }
 
+void ActionsSuggestions::SuggestActionsAsync(
+    const Conversation& conversation, const Annotator* annotator,
+    const ActionSuggestionOptions& options, Executor* executor,
+    std::function<void(ActionsSuggestionsResponse)> callback) const {
+  executor->Schedule([this, conversation, annotator, options, callback]() {
+    callback(SuggestActions(conversation, annotator, options));
+  });
+}
+
 const ActionsModel* ActionsSuggestions::model() const { return model_; }
 const reflection::Schema* ActionsSuggestions::entity_data_schema() const {
   return entity_data_schema_;
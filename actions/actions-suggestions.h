@@ -17,6 +17,7 @@
 #ifndef LIBTEXTCLASSIFIER_ACTIONS_ACTIONS_SUGGESTIONS_H_
 #define LIBTEXTCLASSIFIER_ACTIONS_ACTIONS_SUGGESTIONS_H_
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -31,6 +32,8 @@
 #include "annotator/annotator.h"
 #include "annotator/model-executor.h"
 #include "annotator/types.h"
+#include "utils/executor.h"
+#include "utils/flatbuffers-writer.h"
 #include "utils/flatbuffers.h"
 #include "utils/i18n/locale.h"
 #include "utils/memory/mmap.h"
@@ -105,6 +108,15 @@ class ActionsSuggestions {
       const Conversation& conversation, const Annotator* annotator,
       const ActionSuggestionOptions& options = ActionSuggestionOptions()) const;
 
+  // Asynchronous variant of SuggestActions. The conversation and options are
+  // copied and the suggestion runs as a task on 'executor', which invokes
+  // 'callback' exactly once with the response. This object and 'annotator'
+  // (which can be null) must stay alive until the callback has run.
+  void SuggestActionsAsync(
+      const Conversation& conversation, const Annotator* annotator,
+      const ActionSuggestionOptions& options, Executor* executor,
+      std::function<void(ActionsSuggestionsResponse)> callback) const;
+
   const ActionsModel* model() const;
   const reflection::Schema* entity_data_schema() const;
 
@@ -157,6 +169,11 @@ class ActionsSuggestions {
     const RulesModel_::Rule* rule;
     std::unique_ptr<UniLib::RegexPattern> pattern;
     std::unique_ptr<UniLib::RegexPattern> output_pattern;
+
+    // Entity data field paths of the capturing groups, indexed by action and
+    // capturing group, resolved against the entity data schema.
+    std::vector<std::vector<FlatbufferWriter::FieldPath>> entity_field_paths;
+
     CompiledRule(const RulesModel_::Rule* rule,
                  std::unique_ptr<UniLib::RegexPattern> pattern,
                  std::unique_ptr<UniLib::RegexPattern> output_pattern)
@@ -176,6 +193,11 @@ class ActionsSuggestions {
   bool InitializeRules(ZlibDecompressor* decompressor, const RulesModel* rules,
                        std::vector<CompiledRule>* compiled_rules) const;
 
+  // Resolves an entity data field path against the entity data schema.
+  // Leaves `resolved` empty if the path is not set or could not be resolved.
+  void ResolveEntityFieldPath(const FlatbufferFieldPath* field_path,
+                              FlatbufferWriter::FieldPath* resolved) const;
+
   // Prepare preconditions.
   // Takes values from flag provided data, but falls back to model provided
   // values for parameters that are not explicitly provided.
@@ -215,8 +237,11 @@ class ActionsSuggestions {
       const Conversation& conversation, const ActionSuggestionOptions& options,
       const Annotator* annotator, std::vector<ActionSuggestion>* actions) const;
 
+  // Uses `entity_data_writer` as scratch space for the entity data of the
+  // suggestions.
   void SuggestActionsFromAnnotation(
       const int message_index, const ActionSuggestionAnnotation& annotation,
+      FlatbufferWriter* entity_data_writer,
       std::vector<ActionSuggestion>* actions) const;
 
   // Deduplicates equivalent annotations - annotations that have the same type
@@ -277,9 +302,13 @@ class ActionsSuggestions {
   // Annotation entities used by the model.
   std::unordered_set<std::string> annotation_entity_types_;
 
-  // Builder for creating extra data.
+  // Schema for creating extra data, compiled once at load.
   const reflection::Schema* entity_data_schema_;
-  std::unique_ptr<ReflectiveFlatbufferBuilder> entity_data_builder_;
+  std::unique_ptr<const CompiledFlatbufferSchema> compiled_entity_data_schema_;
+
+  // Resolved entity data fields of the annotation mappings, indexed like the
+  // mappings of the model.
+  std::vector<FlatbufferWriter::FieldPath> annotation_mapping_entity_fields_;
   std::unique_ptr<ActionsSuggestionsRanker> ranker_;
 
   std::string lua_bytecode_;
@@ -25,6 +25,7 @@
 #include "actions/zlib-utils.h"
 #include "annotator/collections.h"
 #include "annotator/types.h"
+#include "utils/executor.h"
 #include "utils/flatbuffers.h"
 #include "utils/flatbuffers_generated.h"
 #include "utils/hash/farmhash.h"
@@ -78,6 +79,24 @@ TEST_F(ActionsSuggestionsTest, SuggestActions) {
   EXPECT_EQ(response.actions.size(), 3 /* share_location + 2 smart replies*/);
 }
 
+TEST_F(ActionsSuggestionsTest, SuggestActionsAsync) {
+  std::unique_ptr<ActionsSuggestions> actions_suggestions = LoadTestModel();
+  InlineExecutor executor;
+  int num_callbacks = 0;
+  ActionsSuggestionsResponse response;
+  actions_suggestions->SuggestActionsAsync(
+      {{{/*user_id=*/1, "Where are you?", /*reference_time_ms_utc=*/0,
+         /*reference_timezone=*/"Europe/Zurich",
+         /*annotations=*/{}, /*locales=*/"en"}}},
+      /*annotator=*/nullptr, ActionSuggestionOptions(), &executor,
+      [&num_callbacks, &response](ActionsSuggestionsResponse result) {
+        ++num_callbacks;
+        response = std::move(result);
+      });
+  EXPECT_EQ(num_callbacks, 1);
+  EXPECT_EQ(response.actions.size(), 3 /* share_location + 2 smart replies*/);
+}
+
 TEST_F(ActionsSuggestionsTest, SuggestNoActionsForUnknownLocale) {
   std::unique_ptr<ActionsSuggestions> actions_suggestions = LoadTestModel();
   const ActionsSuggestionsResponse& response =
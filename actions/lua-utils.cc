@@ -43,7 +43,7 @@ int AnnotationIterator<ClassificationResult>::Item(
     lua_State* state) const {
   // Lookup annotation by collection.
   for (const ClassificationResult& annotation : *annotations) {
-    if (key.Equals(annotation.collection)) {
+    if (key.Equals(annotation.collection.str())) {
       PushAnnotation(annotation, entity_data_schema_, env_);
       return 1;
     }
@@ -88,7 +88,7 @@ void PushAnnotation(const ClassificationResult& classification,
   lua_pushinteger(env->state(),
                   classification.datetime_parse_result.granularity);
   lua_setfield(env->state(), /*idx=*/-2, kGranularityKey);
-  env->PushString(classification.collection);
+  env->PushString(classification.collection.str());
   lua_setfield(env->state(), /*idx=*/-2, kCollectionKey);
   lua_pushnumber(env->state(), classification.score);
   lua_setfield(env->state(), /*idx=*/-2, kScoreKey);
@@ -217,7 +217,7 @@ ClassificationResult ReadClassificationResult(
     } else if (key.Equals(kEntityKey)) {
       auto buffer = ReflectiveFlatbufferBuilder(entity_data_schema).NewRoot();
       env->ReadFlatbuffer(buffer.get());
-      classification.serialized_entity_data = buffer->Serialize();
+      buffer->Serialize(&classification.serialized_entity_data);
     } else {
       TC3_LOG(INFO) << "Unknown classification result field: "
                     << key.ToString();
@@ -295,7 +295,7 @@ ActionSuggestion ReadAction(
       auto buffer =
           ReflectiveFlatbufferBuilder(actions_entity_data_schema).NewRoot();
       env->ReadFlatbuffer(buffer.get());
-      action.serialized_entity_data = buffer->Serialize();
+      buffer->Serialize(&action.serialized_entity_data);
     } else {
       TC3_LOG(INFO) << "Unknown action field: " << key.ToString();
     }
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Per-call heap allocation budgets of the Annotator entry points. The budgets
+// are loose upper bounds, not measurements of the test model: they catch a
+// change that makes a request path allocate per codepoint or multiplies its
+// allocations, but not a few more allocations per call. Measure the test model
+// with tools/benchmark to tighten them.
+// Also checks that serializing the entity data of results reuses the pooled
+// flatbuffer builders and the output buffers instead of allocating.
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "annotator/annotator.h"
+#include "annotator/entity-data_generated.h"
+#include "utils/flatbuffers.h"
+#include "utils/memory/arena.h"
+#include "utils/testing/allocation-counter.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+// Short sentence that triggers the ML model, regular expressions, number and
+// datetime annotators of the test model.
+constexpr char kText[] =
+    "Call me at (800) 123-456 today, at 5pm, or meet me at 350 Third Street "
+    "in 15 minutes.";
+
+// Loose allocation budgets for a single call on kText.
+constexpr int64 kAnnotateAllocationBudget = 8000;
+constexpr int64 kClassifyTextAllocationBudget = 4000;
+constexpr int64 kSuggestSelectionAllocationBudget = 4000;
+
+// Loose budget of the additional Annotate allocations per word of added text,
+// which covers the per-token feature extraction of the ML model and the
+// results.
+constexpr int64 kAnnotateAllocationsPerAddedWord = 40;
+
+// Heap allocations that the arena saves at least for each group of conflicting
+// candidates: the vectors of the chosen and the conflicting candidates and of
+// their scores, and a node of the per-source map and of its index set.
+constexpr int64 kArenaAllocationsSavedPerConflict = 5;
+
+std::string GetModelPath() { return TC3_TEST_DATA_DIR; }
+
+std::string ReadFile(const std::string& file_name) {
+  std::ifstream file_stream(file_name);
+  return std::string(std::istreambuf_iterator<char>(file_stream), {});
+}
+
+// Returns the number of space separated words of 'text'.
+int CountWords(const std::string& text) {
+  int num_words = 0;
+  bool in_word = false;
+  for (const char c : text) {
+    const bool is_space = (c == ' ' || c == '\n');
+    if (!is_space && !in_word) {
+      ++num_words;
+    }
+    in_word = !is_space;
+  }
+  return num_words;
+}
+
+// Returns 'text' repeated 'times' times, on separate lines.
+std::string Repeat(const std::string& text, int times) {
+  std::string result;
+  for (int i = 0; i < times; ++i) {
+    result += text;
+    result += "\n";
+  }
+  return result;
+}
+
+class AnnotatorAllocationsTest : public testing::Test {
+ protected:
+  AnnotatorAllocationsTest() : INIT_UNILIB_FOR_TESTING(unilib_) {}
+
+  void SetUp() override {
+    model_buffer_ = ReadFile(GetModelPath() + "test_model.fb");
+    annotator_ = Annotator::FromUnownedBuffer(model_buffer_.data(),
+                                              model_buffer_.size(), &unilib_);
+    ASSERT_TRUE(annotator_);
+  }
+
+  int64 AnnotateAllocations(const std::string& text) {
+    // Warm up, so that lazily initialized state is not counted.
+    annotator_->Annotate(text);
+    ScopedAllocationCounter counter;
+    annotator_->Annotate(text);
+    return counter.num_allocations();
+  }
+
+  // Returns how many fewer heap allocations Annotate makes on 'text' with an
+  // arena that was warmed up by a previous call.
+  int64 ArenaAllocationSavings(const std::string& text) {
+    const int64 without_arena = AnnotateAllocations(text);
+
+    Arena arena;
+    AnnotationOptions options;
+    options.arena = &arena;
+    annotator_->Annotate(text, options);
+    arena.Reset();
+
+    ScopedAllocationCounter counter;
+    annotator_->Annotate(text, options);
+    return without_arena - counter.num_allocations();
+  }
+
+  UniLib unilib_;
+  std::string model_buffer_;
+  std::unique_ptr<Annotator> annotator_;
+};
+
+TEST_F(AnnotatorAllocationsTest, AnnotateIsWithinBudget) {
+  EXPECT_LE(AnnotateAllocations(kText), kAnnotateAllocationBudget);
+}
+
+TEST_F(AnnotatorAllocationsTest, ClassifyTextIsWithinBudget) {
+  annotator_->ClassifyText(kText, {11, 24});
+  ScopedAllocationCounter counter;
+  annotator_->ClassifyText(kText, {11, 24});
+  EXPECT_LE(counter.num_allocations(), kClassifyTextAllocationBudget);
+}
+
+TEST_F(AnnotatorAllocationsTest, SuggestSelectionIsWithinBudget) {
+  annotator_->SuggestSelection(kText, {12, 15});
+  ScopedAllocationCounter counter;
+  annotator_->SuggestSelection(kText, {12, 15});
+  EXPECT_LE(counter.num_allocations(), kSuggestSelectionAllocationBudget);
+}
+
+TEST_F(AnnotatorAllocationsTest, AnnotateWithArenaAllocatesLess) {
+  // kText has conflicting candidates, e.g. the phone number and the numbers in
+  // it, and every repetition adds its own conflicts.
+  EXPECT_GE(ArenaAllocationSavings(kText), kArenaAllocationsSavedPerConflict);
+  EXPECT_GE(ArenaAllocationSavings(Repeat(kText, 8)),
+            8 * kArenaAllocationsSavedPerConflict);
+}
+
+TEST_F(AnnotatorAllocationsTest, AnnotateWithArenaKeepsResults) {
+  const std::string text = Repeat(kText, 8);
+  const std::vector<AnnotatedSpan> expected = annotator_->Annotate(text);
+
+  Arena arena;
+  AnnotationOptions options;
+  options.arena = &arena;
+  const std::vector<AnnotatedSpan> result = annotator_->Annotate(text, options);
+
+  ASSERT_EQ(result.size(), expected.size());
+  for (int i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i].span, expected[i].span);
+    ASSERT_EQ(result[i].classification.size(),
+              expected[i].classification.size());
+    for (int j = 0; j < result[i].classification.size(); ++j) {
+      EXPECT_EQ(result[i].classification[j].collection,
+                expected[i].classification[j].collection);
+    }
+  }
+}
+
+TEST_F(AnnotatorAllocationsTest, PreparedOptionsAreNotReparsed) {
+  AnnotationOptions options;
+  options.locales = "en-US,de-CH";
+  options.detected_text_language_tags = "en,de";
+  const PreparedOptions prepared_options = annotator_->PrepareOptions(options);
+
+  annotator_->Annotate(kText, options);
+  int64 unprepared_allocations;
+  std::vector<AnnotatedSpan> expected;
+  {
+    ScopedAllocationCounter counter;
+    expected = annotator_->Annotate(kText, options);
+    unprepared_allocations = counter.num_allocations();
+  }
+
+  ScopedAllocationCounter counter;
+  const std::vector<AnnotatedSpan> result =
+      annotator_->Annotate(kText, options, prepared_options);
+  EXPECT_LT(counter.num_allocations(), unprepared_allocations);
+
+  ASSERT_EQ(result.size(), expected.size());
+  for (int i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i].span, expected[i].span);
+  }
+}
+
+TEST_F(AnnotatorAllocationsTest, AnnotateAllocationsPerAddedWord) {
+  // The fixed per-call costs (interpreters, locales, ...) are paid once, so
+  // the allocations of a longer text only grow by the per-word costs.
+  const std::string single_text = Repeat(kText, 1);
+  const std::string repeated_text = Repeat(kText, 8);
+  const int64 single = AnnotateAllocations(single_text);
+  const int64 repeated = AnnotateAllocations(repeated_text);
+  const int added_words = CountWords(repeated_text) - CountWords(single_text);
+  EXPECT_LE(repeated - single, kAnnotateAllocationsPerAddedWord * added_words);
+}
+
+TEST(EntityDataAllocationsTest, PooledBuildersAreReused) {
+  flatbuffers::FlatBufferBuilder* first;
+  {
+    PooledFlatBufferBuilder builder;
+    first = builder.get();
+    builder->Finish(builder->CreateString("test"));
+  }
+  {
+    PooledFlatBufferBuilder builder;
+    EXPECT_EQ(builder.get(), first);
+    EXPECT_EQ(builder->GetSize(), 0);
+
+    // Nested builders are distinct.
+    PooledFlatBufferBuilder nested;
+    EXPECT_NE(nested.get(), first);
+  }
+}
+
+TEST(EntityDataAllocationsTest, LargeBuildersAreNotPooled) {
+  {
+    PooledFlatBufferBuilder builder;
+    builder->Finish(builder->CreateString("test"));
+  }
+  {
+    // A builder of a small message is reused.
+    ScopedAllocationCounter counter;
+    PooledFlatBufferBuilder builder;
+    EXPECT_EQ(counter.num_allocations(), 0);
+    builder->Finish(builder->CreateString(
+        std::string(PooledFlatBufferBuilder::kMaxPooledSize, 'x')));
+  }
+
+  // The builder of the large message was freed, so a new one is allocated.
+  ScopedAllocationCounter counter;
+  PooledFlatBufferBuilder builder;
+  EXPECT_GT(counter.num_allocations(), 0);
+}
+
+TEST(EntityDataAllocationsTest, PackingIntoBufferDoesNotAllocateAfterWarmUp) {
+  EntityDataT entity_data;
+  entity_data.start = 11;
+  entity_data.end = 24;
+  entity_data.type = "phone";
+  entity_data.datetime.reset(new EntityData_::DatetimeT);
+  entity_data.datetime->time_ms_utc = 1554465190000;
+  entity_data.contact.reset(new EntityData_::ContactT);
+  entity_data.contact->name = "John Doe";
+  entity_data.contact->phone_number = "(800) 123-456";
+
+  std::string serialized;
+  PackFlatbuffer<EntityData>(&entity_data, &serialized);
+  const std::string expected = serialized;
+
+  ScopedAllocationCounter counter;
+  for (int i = 0; i < 100; i++) {
+    PackFlatbuffer<EntityData>(&entity_data, &serialized);
+  }
+  EXPECT_EQ(counter.num_allocations(), 0);
+  EXPECT_EQ(serialized, expected);
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
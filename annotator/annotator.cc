@@ -20,6 +20,8 @@
 #include <cctype>
 #include <cmath>
 #include <iterator>
+#include <limits>
+#include <map>
 #include <numeric>
 #include <unordered_map>
 
@@ -36,7 +38,8 @@
 
 namespace libtextclassifier3 {
 
-using SortedIntSet = std::set<int, std::function<bool(int, int)>>;
+using SortedIntSet =
+    std::set<int, std::function<bool(int, int)>, ArenaAllocator<int>>;
 
 const std::string& Annotator::kPhoneCollection =
     *[]() { return new std::string("phone"); }();
@@ -360,6 +363,26 @@ void Annotator::ValidateAndInitialize() {
     }
   }
 
+  if (model_->entity_data_schema()) {
+    entity_data_schema_ = LoadAndVerifyFlatbuffer<reflection::Schema>(
+        model_->entity_data_schema()->Data(),
+        model_->entity_data_schema()->size());
+    if (entity_data_schema_ == nullptr) {
+      TC3_LOG(ERROR) << "Could not load entity data schema data.";
+      return;
+    }
+
+    compiled_entity_data_schema_ =
+        CompiledFlatbufferSchema::Create(entity_data_schema_);
+    if (compiled_entity_data_schema_ == nullptr) {
+      TC3_LOG(ERROR) << "Could not compile entity data schema.";
+      return;
+    }
+  } else {
+    entity_data_schema_ = nullptr;
+    compiled_entity_data_schema_ = nullptr;
+  }
+
   std::unique_ptr<ZlibDecompressor> decompressor = ZlibDecompressor::Instance();
   if (model_->regex_model()) {
     if (!InitializeRegexModel(decompressor.get())) {
@@ -381,19 +404,19 @@ void Annotator::ValidateAndInitialize() {
     if (model_->output_options()->filtered_collections_annotation()) {
       for (const auto collection :
            *model_->output_options()->filtered_collections_annotation()) {
-        filtered_collections_annotation_.insert(collection->str());
+        filtered_collections_annotation_.Insert(collection->str());
       }
     }
     if (model_->output_options()->filtered_collections_classification()) {
       for (const auto collection :
            *model_->output_options()->filtered_collections_classification()) {
-        filtered_collections_classification_.insert(collection->str());
+        filtered_collections_classification_.Insert(collection->str());
       }
     }
     if (model_->output_options()->filtered_collections_selection()) {
       for (const auto collection :
            *model_->output_options()->filtered_collections_selection()) {
-        filtered_collections_selection_.insert(collection->str());
+        filtered_collections_selection_.Insert(collection->str());
       }
     }
   }
@@ -418,22 +441,6 @@ void Annotator::ValidateAndInitialize() {
                               selection_feature_processor_.get()));
   }
 
-  if (model_->entity_data_schema()) {
-    entity_data_schema_ = LoadAndVerifyFlatbuffer<reflection::Schema>(
-        model_->entity_data_schema()->Data(),
-        model_->entity_data_schema()->size());
-    if (entity_data_schema_ == nullptr) {
-      TC3_LOG(ERROR) << "Could not load entity data schema data.";
-      return;
-    }
-
-    entity_data_builder_.reset(
-        new ReflectiveFlatbufferBuilder(entity_data_schema_));
-  } else {
-    entity_data_schema_ = nullptr;
-    entity_data_builder_ = nullptr;
-  }
-
   if (model_->triggering_locales() &&
       !ParseLocales(model_->triggering_locales()->c_str(),
                     &model_triggering_locales_)) {
@@ -457,9 +464,60 @@ void Annotator::ValidateAndInitialize() {
     return;
   }
 
+  InitializePrioritizedClassificationEngines();
+
   initialized_ = true;
 }
 
+void Annotator::InitializePrioritizedClassificationEngines() {
+  const float kUnbounded = std::numeric_limits<float>::infinity();
+  const float kNoResults = -std::numeric_limits<float>::infinity();
+
+  float max_regex_priority_score = kNoResults;
+  for (const int pattern_id : classification_regex_patterns_) {
+    max_regex_priority_score =
+        std::max(max_regex_priority_score,
+                 regex_patterns_[pattern_id].config->priority_score());
+  }
+
+  // ClassifyText fails without a datetime parser, so it has to run then.
+  float max_datetime_priority_score =
+      datetime_parser_ ? kNoResults : kUnbounded;
+  if (model_->datetime_model() != nullptr &&
+      model_->datetime_model()->patterns() != nullptr) {
+    for (const DatetimeModelPattern* pattern :
+         *model_->datetime_model()->patterns()) {
+      max_datetime_priority_score =
+          std::max(max_datetime_priority_score, pattern->priority_score());
+    }
+  }
+
+  // The engines that are added later at runtime can produce any score, and the
+  // ML model's score is a probability.
+  prioritized_classification_engines_ = {
+      {ClassificationEngine::KNOWLEDGE, kUnbounded},
+      {ClassificationEngine::CONTACT, kUnbounded},
+      {ClassificationEngine::INSTALLED_APP, kUnbounded},
+      {ClassificationEngine::REGEX, max_regex_priority_score},
+      {ClassificationEngine::DATETIME, max_datetime_priority_score},
+      {ClassificationEngine::NUMBER,
+       number_annotator_
+           ? model_->number_annotator_options()->priority_score()
+           : kNoResults},
+      {ClassificationEngine::DURATION,
+       duration_annotator_
+           ? model_->duration_annotator_options()->priority_score()
+           : kNoResults},
+      {ClassificationEngine::MODEL, 1.0f},
+  };
+  std::stable_sort(prioritized_classification_engines_.begin(),
+                   prioritized_classification_engines_.end(),
+                   [](const PrioritizedClassificationEngine& a,
+                      const PrioritizedClassificationEngine& b) {
+                     return a.max_priority_score > b.max_priority_score;
+                   });
+}
+
 bool Annotator::InitializeRegexModel(ZlibDecompressor* decompressor) {
   if (!model_->regex_model()->patterns()) {
     return true;
@@ -485,11 +543,36 @@ bool Annotator::InitializeRegexModel(ZlibDecompressor* decompressor) {
       classification_regex_patterns_.push_back(regex_pattern_id);
     }
     if (regex_pattern->enabled_modes() & ModeFlag_SELECTION) {
-      selection_regex_patterns_.push_back(regex_pattern_id);
+      if (regex_pattern->verification_options() != nullptr) {
+        selection_verified_regex_patterns_.push_back(regex_pattern_id);
+      } else {
+        selection_regex_patterns_.push_back(regex_pattern_id);
+      }
     }
+    // Resolve the entity data field paths of the capturing groups once, so
+    // that matches can set the fields directly.
+    std::vector<FlatbufferWriter::FieldPath> entity_field_paths;
+    if (compiled_entity_data_schema_ != nullptr &&
+        regex_pattern->capturing_group() != nullptr) {
+      entity_field_paths.resize(regex_pattern->capturing_group()->size());
+      for (int i = 0; i < regex_pattern->capturing_group()->size(); i++) {
+        const FlatbufferFieldPath* field_path =
+            regex_pattern->capturing_group()->Get(i)->entity_field_path();
+        if (field_path != nullptr &&
+            !compiled_entity_data_schema_->ResolveFieldPath(
+                field_path, &entity_field_paths[i])) {
+          TC3_LOG(ERROR) << "Could not resolve entity data field path of "
+                            "regex pattern "
+                         << regex_pattern_id << ", group " << i;
+        }
+      }
+    }
+
     regex_patterns_.push_back({
         regex_pattern,
         std::move(compiled_pattern),
+        InternedString(regex_pattern->collection_name()->str()),
+        std::move(entity_field_paths),
     });
     ++regex_pattern_id;
   }
@@ -520,6 +603,22 @@ bool Annotator::InitializeContactEngine(const std::string& serialized_config) {
   return true;
 }
 
+bool Annotator::AddContacts(const std::string& serialized_config) {
+  if (contact_engine_ == nullptr) {
+    TC3_LOG(ERROR) << "The contact engine is not initialized.";
+    return false;
+  }
+  return contact_engine_->AddContacts(serialized_config);
+}
+
+bool Annotator::RemoveContact(const std::string& id) {
+  if (contact_engine_ == nullptr) {
+    TC3_LOG(ERROR) << "The contact engine is not initialized.";
+    return false;
+  }
+  return contact_engine_->RemoveContact(id);
+}
+
 bool Annotator::InitializeInstalledAppEngine(
     const std::string& serialized_config) {
   std::unique_ptr<InstalledAppEngine> installed_app_engine(
@@ -532,6 +631,22 @@ bool Annotator::InitializeInstalledAppEngine(
   return true;
 }
 
+bool Annotator::AddInstalledApps(const std::string& serialized_config) {
+  if (installed_app_engine_ == nullptr) {
+    TC3_LOG(ERROR) << "The installed app engine is not initialized.";
+    return false;
+  }
+  return installed_app_engine_->AddApps(serialized_config);
+}
+
+bool Annotator::RemoveInstalledApp(const std::string& package_name) {
+  if (installed_app_engine_ == nullptr) {
+    TC3_LOG(ERROR) << "The installed app engine is not initialized.";
+    return false;
+  }
+  return installed_app_engine_->RemoveApp(package_name);
+}
+
 namespace {
 
 int CountDigits(const std::string& str, CodepointSpan selection_indices) {
@@ -592,29 +707,44 @@ CodepointSpan SnapLeftIfWhitespaceSelection(CodepointSpan span,
 
 bool Annotator::FilteredForAnnotation(const AnnotatedSpan& span) const {
   return !span.classification.empty() &&
-         filtered_collections_annotation_.find(
-             span.classification[0].collection) !=
-             filtered_collections_annotation_.end();
+         filtered_collections_annotation_.Contains(
+             span.classification[0].collection);
 }
 
 bool Annotator::FilteredForClassification(
     const ClassificationResult& classification) const {
-  return filtered_collections_classification_.find(classification.collection) !=
-         filtered_collections_classification_.end();
+  return filtered_collections_classification_.Contains(
+      classification.collection);
 }
 
 bool Annotator::FilteredForSelection(const AnnotatedSpan& span) const {
   return !span.classification.empty() &&
-         filtered_collections_selection_.find(
-             span.classification[0].collection) !=
-             filtered_collections_selection_.end();
+         filtered_collections_selection_.Contains(
+             span.classification[0].collection);
 }
 
 namespace {
+// Collections checked on every candidate, interned once so that the checks
+// compare pointers instead of strings.
+const InternedString& kInternedOtherCollection =
+    *[]() { return new InternedString(Collections::Other()); }();
+const InternedString& kInternedPhoneCollection =
+    *[]() { return new InternedString(Collections::Phone()); }();
+const InternedString& kInternedAddressCollection =
+    *[]() { return new InternedString(Collections::Address()); }();
+const InternedString& kInternedDictionaryCollection =
+    *[]() { return new InternedString(Collections::Dictionary()); }();
+const InternedString& kInternedDateCollection =
+    *[]() { return new InternedString(Collections::Date()); }();
+const InternedString& kInternedDateTimeCollection =
+    *[]() { return new InternedString(Collections::DateTime()); }();
+const InternedString& kInternedDurationCollection =
+    *[]() { return new InternedString(Collections::Duration()); }();
+
 inline bool ClassifiedAsOther(
     const std::vector<ClassificationResult>& classification) {
   return !classification.empty() &&
-         classification[0].collection == Collections::Other();
+         classification[0].collection == kInternedOtherCollection;
 }
 
 float GetPriorityScore(
@@ -625,6 +755,109 @@ float GetPriorityScore(
     return -1.0;
   }
 }
+
+// Helper function that returns the index of the first candidate that
+// transitively does not overlap with the candidate on 'start_index'. If the end
+// of 'candidates' is reached, it returns the index that points right behind the
+// array.
+int FirstNonOverlappingSpanIndex(const std::vector<AnnotatedSpan>& candidates,
+                                 int start_index) {
+  int first_non_overlapping = start_index + 1;
+  CodepointSpan conflicting_span = candidates[start_index].span;
+  while (
+      first_non_overlapping < candidates.size() &&
+      SpansOverlap(conflicting_span, candidates[first_non_overlapping].span)) {
+    // Grow the span to include the current one.
+    conflicting_span.second = std::max(
+        conflicting_span.second, candidates[first_non_overlapping].span.second);
+
+    ++first_non_overlapping;
+  }
+  return first_non_overlapping;
+}
+
+// Number of codepoints per token assumed when turning the max_selection_span of
+// the selection model into a window of codepoints.
+constexpr int kMaxCodepointsPerSelectionToken = 32;
+
+// Keeps only the connected components of overlapping candidates that contain a
+// candidate overlapping both 'span1' and 'span2'. Assumes that the candidates
+// are sorted according to their position in the input.
+void KeepComponentsOverlapping(CodepointSpan span1, CodepointSpan span2,
+                               std::vector<AnnotatedSpan>* candidates) {
+  int num_kept = 0;
+  for (int i = 0; i < candidates->size();) {
+    const int first_non_overlapping =
+        FirstNonOverlappingSpanIndex(*candidates, /*start_index=*/i);
+    const bool keep = std::any_of(
+        candidates->begin() + i, candidates->begin() + first_non_overlapping,
+        [span1, span2](const AnnotatedSpan& candidate) {
+          return SpansOverlap(candidate.span, span1) &&
+                 SpansOverlap(candidate.span, span2);
+        });
+    if (keep) {
+      for (int j = i; j < first_non_overlapping; ++j) {
+        if (num_kept != j) {
+          (*candidates)[num_kept] = std::move((*candidates)[j]);
+        }
+        ++num_kept;
+      }
+    }
+    i = first_non_overlapping;
+  }
+  candidates->erase(candidates->begin() + num_kept, candidates->end());
+}
+
+// Moves the spans of the candidates from 'first_candidate' on by 'offset'.
+void ShiftCandidateSpans(int offset, int first_candidate,
+                         std::vector<AnnotatedSpan>* candidates) {
+  for (int i = first_candidate; i < candidates->size(); ++i) {
+    CodepointSpan& span = (*candidates)[i].span;
+    if (span.first != kInvalidIndex && span.second != kInvalidIndex) {
+      span.first += offset;
+      span.second += offset;
+    }
+  }
+}
+
+// Calls 'chunk' on 'window' of a context with 'context_size' codepoints. The
+// candidates added by 'chunk' must have spans relative to the whole context.
+// A candidate that reaches an inner edge of the window might have been cut
+// off by it, in which case the window is doubled and the candidates are
+// recomputed, until none reaches an inner edge or the window covers the whole
+// context.
+bool ChunkInWindow(
+    CodepointSpan window, int context_size,
+    const std::function<bool(CodepointSpan, std::vector<AnnotatedSpan>*)>&
+        chunk,
+    std::vector<AnnotatedSpan>* candidates) {
+  const int num_candidates = candidates->size();
+  while (true) {
+    if (!chunk(window, candidates)) {
+      return false;
+    }
+    if (window.first == 0 && window.second == context_size) {
+      return true;
+    }
+    const bool reaches_inner_edge = std::any_of(
+        candidates->begin() + num_candidates, candidates->end(),
+        [window, context_size](const AnnotatedSpan& candidate) {
+          const CodepointSpan& span = candidate.span;
+          if (span.first == kInvalidIndex || span.second == kInvalidIndex) {
+            return false;
+          }
+          return (window.first > 0 && span.first <= window.first) ||
+                 (window.second < context_size && span.second >= window.second);
+        });
+    if (!reaches_inner_edge) {
+      return true;
+    }
+    candidates->erase(candidates->begin() + num_candidates, candidates->end());
+    const int growth = std::max(1, (window.second - window.first) / 2);
+    window = {std::max(0, window.first - growth),
+              std::min(context_size, window.second + growth)};
+  }
+}
 }  // namespace
 
 bool Annotator::VerifyRegexMatchCandidate(
@@ -651,9 +884,48 @@ bool Annotator::VerifyRegexMatchCandidate(
   return true;
 }
 
+PreparedOptions Annotator::PrepareOptions(
+    const std::string& locales,
+    const std::string& detected_text_language_tags) const {
+  PreparedOptions prepared_options;
+  if (!ParseLocales(detected_text_language_tags,
+                    &prepared_options.detected_text_language_tags_)) {
+    TC3_LOG(WARNING)
+        << "Failed to parse the detected_text_language_tags in options: "
+        << detected_text_language_tags;
+  }
+  prepared_options.is_model_triggering_locale_supported_ =
+      Locale::IsAnyLocaleSupported(
+          prepared_options.detected_text_language_tags_,
+          model_triggering_locales_,
+          /*default_value=*/true);
+  if (datetime_parser_) {
+    prepared_options.datetime_locales_ =
+        datetime_parser_->PrepareLocales(locales);
+  }
+  return prepared_options;
+}
+
+PreparedOptions Annotator::PrepareOptions(
+    const AnnotationOptions& options) const {
+  PreparedOptions prepared_options =
+      PrepareOptions(options.locales, options.detected_text_language_tags);
+  prepared_options.is_entity_type_enabled_ =
+      EnabledEntityTypes(options.entity_types);
+  return prepared_options;
+}
+
 CodepointSpan Annotator::SuggestSelection(
     const std::string& context, CodepointSpan click_indices,
     const SelectionOptions& options) const {
+  return SuggestSelection(context, click_indices, options,
+                          PrepareOptions(options));
+}
+
+CodepointSpan Annotator::SuggestSelection(
+    const std::string& context, CodepointSpan click_indices,
+    const SelectionOptions& options,
+    const PreparedOptions& prepared_options) const {
   CodepointSpan original_click_indices = click_indices;
   if (!initialized_) {
     TC3_LOG(ERROR) << "Not initialized";
@@ -663,16 +935,9 @@ CodepointSpan Annotator::SuggestSelection(
     return original_click_indices;
   }
 
-  std::vector<Locale> detected_text_language_tags;
-  if (!ParseLocales(options.detected_text_language_tags,
-                    &detected_text_language_tags)) {
-    TC3_LOG(WARNING)
-        << "Failed to parse the detected_text_language_tags in options: "
-        << options.detected_text_language_tags;
-  }
-  if (!Locale::IsAnyLocaleSupported(detected_text_language_tags,
-                                    model_triggering_locales_,
-                                    /*default_value=*/true)) {
+  const std::vector<Locale>& detected_text_language_tags =
+      prepared_options.detected_text_language_tags_;
+  if (!prepared_options.is_model_triggering_locale_supported_) {
     return original_click_indices;
   }
 
@@ -721,17 +986,47 @@ CodepointSpan Annotator::SuggestSelection(
     TC3_LOG(ERROR) << "Model suggest selection failed.";
     return original_click_indices;
   }
-  if (!RegexChunk(context_unicode, selection_regex_patterns_, &candidates,
-                  /*is_serialized_entity_data_enabled=*/false)) {
-    TC3_LOG(ERROR) << "Regex suggest selection failed.";
+
+  // Only candidates that overlap the click can be returned, so the annotators
+  // that do not depend on the tokens only look at the context around it.
+  const CodepointSpan engine_window =
+      SelectionEngineWindow(context_codepoint_size, click_indices);
+  if (!ChunkInWindow(
+          engine_window, context_codepoint_size,
+          [this, &context_unicode, &options, &prepared_options](
+              CodepointSpan window, std::vector<AnnotatedSpan>* candidates) {
+            const UnicodeText window_unicode = UnicodeText::Substring(
+                context_unicode, window.first, window.second,
+                /*do_copy=*/false);
+            const int num_candidates = candidates->size();
+            if (!RegexChunk(window_unicode, selection_regex_patterns_,
+                            ComputeTriggerFeatures(window_unicode), candidates,
+                            /*is_serialized_entity_data_enabled=*/false)) {
+              TC3_LOG(ERROR) << "Regex suggest selection failed.";
+              return false;
+            }
+            if (!DatetimeChunk(
+                    window_unicode,
+                    /*reference_time_ms_utc=*/0, /*reference_timezone=*/"",
+                    prepared_options.datetime_locales_, ModeFlag_SELECTION,
+                    options.annotation_usecase,
+                    /*is_serialized_entity_data_enabled=*/false, candidates)) {
+              TC3_LOG(ERROR) << "Datetime suggest selection failed.";
+              return false;
+            }
+            ShiftCandidateSpans(window.first, num_candidates, candidates);
+            return true;
+          },
+          &candidates)) {
     return original_click_indices;
   }
-  if (!DatetimeChunk(
-          UTF8ToUnicodeText(context, /*do_copy=*/false),
-          /*reference_time_ms_utc=*/0, /*reference_timezone=*/"",
-          options.locales, ModeFlag_SELECTION, options.annotation_usecase,
-          /*is_serialized_entity_data_enabled=*/false, &candidates)) {
-    TC3_LOG(ERROR) << "Datetime suggest selection failed.";
+  // The verifiers of the matches can look at the whole context, so these
+  // patterns don't run on the window.
+  if (!selection_verified_regex_patterns_.empty() &&
+      !RegexChunk(context_unicode, selection_verified_regex_patterns_,
+                  ComputeTriggerFeatures(context_unicode), &candidates,
+                  /*is_serialized_entity_data_enabled=*/false)) {
+    TC3_LOG(ERROR) << "Regex suggest selection failed.";
     return original_click_indices;
   }
   if (knowledge_engine_ != nullptr &&
@@ -749,16 +1044,51 @@ CodepointSpan Annotator::SuggestSelection(
     TC3_LOG(ERROR) << "Installed app suggest selection failed.";
     return original_click_indices;
   }
-  if (number_annotator_ != nullptr &&
-      !number_annotator_->FindAll(context_unicode, options.annotation_usecase,
-                                  &candidates)) {
-    TC3_LOG(ERROR) << "Number annotator failed in suggest selection.";
-    return original_click_indices;
-  }
-  if (duration_annotator_ != nullptr &&
-      !duration_annotator_->FindAll(context_unicode, tokens,
-                                    options.annotation_usecase, &candidates)) {
-    TC3_LOG(ERROR) << "Duration annotator failed in suggest selection.";
+  if (!ChunkInWindow(
+          engine_window, context_codepoint_size,
+          [this, &context_unicode, context_codepoint_size, &options, &tokens](
+              CodepointSpan window, std::vector<AnnotatedSpan>* candidates) {
+            const UnicodeText window_unicode = UnicodeText::Substring(
+                context_unicode, window.first, window.second,
+                /*do_copy=*/false);
+            const int num_candidates = candidates->size();
+            if (number_annotator_ != nullptr &&
+                !number_annotator_->FindAll(window_unicode,
+                                            options.annotation_usecase,
+                                            candidates)) {
+              TC3_LOG(ERROR) << "Number annotator failed in suggest selection.";
+              return false;
+            }
+            ShiftCandidateSpans(window.first, num_candidates, candidates);
+
+            // The duration annotator works on the tokens, which are relative
+            // to the whole context, so it gets those overlapping the window.
+            std::vector<Token> window_tokens;
+            const std::vector<Token>* duration_tokens = &tokens;
+            if (window.first > 0 || window.second < context_codepoint_size) {
+              window_tokens.assign(
+                  std::lower_bound(tokens.begin(), tokens.end(), window.first,
+                                   [](const Token& token, int position) {
+                                     return token.end <= position;
+                                   }),
+                  std::lower_bound(tokens.begin(), tokens.end(), window.second,
+                                   [](const Token& token, int position) {
+                                     return token.start < position;
+                                   }));
+              duration_tokens = &window_tokens;
+            }
+            if (duration_annotator_ != nullptr &&
+                !duration_annotator_->FindAll(context_unicode,
+                                              *duration_tokens,
+                                              options.annotation_usecase,
+                                              candidates)) {
+              TC3_LOG(ERROR)
+                  << "Duration annotator failed in suggest selection.";
+              return false;
+            }
+            return true;
+          },
+          &candidates)) {
     return original_click_indices;
   }
 
@@ -770,10 +1100,17 @@ CodepointSpan Annotator::SuggestSelection(
               return a.span.first < b.span.first;
             });
 
-  std::vector<int> candidate_indices;
+  // Conflicts are resolved within each connected component of overlapping
+  // candidates, so the components that cannot produce the selection need not
+  // be resolved.
+  KeepComponentsOverlapping(click_indices, original_click_indices,
+                            &candidates);
+
+  ArenaVector<int> candidate_indices;
   if (!ResolveConflicts(candidates, context, tokens,
                         detected_text_language_tags, options.annotation_usecase,
-                        &interpreter_manager, &candidate_indices)) {
+                        &interpreter_manager, /*arena=*/nullptr,
+                        &candidate_indices)) {
     TC3_LOG(ERROR) << "Couldn't resolve conflicts.";
     return original_click_indices;
   }
@@ -812,34 +1149,36 @@ CodepointSpan Annotator::SuggestSelection(
   return original_click_indices;
 }
 
-namespace {
-// Helper function that returns the index of the first candidate that
-// transitively does not overlap with the candidate on 'start_index'. If the end
-// of 'candidates' is reached, it returns the index that points right behind the
-// array.
-int FirstNonOverlappingSpanIndex(const std::vector<AnnotatedSpan>& candidates,
-                                 int start_index) {
-  int first_non_overlapping = start_index + 1;
-  CodepointSpan conflicting_span = candidates[start_index].span;
-  while (
-      first_non_overlapping < candidates.size() &&
-      SpansOverlap(conflicting_span, candidates[first_non_overlapping].span)) {
-    // Grow the span to include the current one.
-    conflicting_span.second = std::max(
-        conflicting_span.second, candidates[first_non_overlapping].span.second);
-
-    ++first_non_overlapping;
+CodepointSpan Annotator::SelectionEngineWindow(
+    int context_size, CodepointSpan click_indices) const {
+  int engine_context_size = model_->selection_options() != nullptr
+                                ? model_->selection_options()
+                                      ->engine_context_size()
+                                : -1;
+  if (engine_context_size == 0) {
+    const int max_selection_span =
+        selection_feature_processor_ != nullptr
+            ? selection_feature_processor_->GetOptions()->max_selection_span()
+            : -1;
+    engine_context_size =
+        max_selection_span < 0
+            ? -1
+            : (max_selection_span + 1) * kMaxCodepointsPerSelectionToken;
   }
-  return first_non_overlapping;
+  if (engine_context_size < 0) {
+    return {0, context_size};
+  }
+  return {std::max(0, click_indices.first - engine_context_size),
+          std::min(context_size, click_indices.second + engine_context_size)};
 }
-}  // namespace
 
 bool Annotator::ResolveConflicts(
     const std::vector<AnnotatedSpan>& candidates, const std::string& context,
     const std::vector<Token>& cached_tokens,
     const std::vector<Locale>& detected_text_language_tags,
     AnnotationUsecase annotation_usecase,
-    InterpreterManager* interpreter_manager, std::vector<int>* result) const {
+    InterpreterManager* interpreter_manager, Arena* arena,
+    ArenaVector<int>* result) const {
   result->clear();
   result->reserve(candidates.size());
   for (int i = 0; i < candidates.size();) {
@@ -848,11 +1187,11 @@ bool Annotator::ResolveConflicts(
 
     const bool conflict_found = first_non_overlapping != (i + 1);
     if (conflict_found) {
-      std::vector<int> candidate_indices;
+      ArenaVector<int> candidate_indices{ArenaAllocator<int>(arena)};
       if (!ResolveConflict(context, cached_tokens, candidates,
                            detected_text_language_tags, i,
                            first_non_overlapping, annotation_usecase,
-                           interpreter_manager, &candidate_indices)) {
+                           interpreter_manager, arena, &candidate_indices)) {
         return false;
       }
       result->insert(result->end(), candidate_indices.begin(),
@@ -913,14 +1252,19 @@ bool Annotator::ResolveConflict(
     const std::vector<AnnotatedSpan>& candidates,
     const std::vector<Locale>& detected_text_language_tags, int start_index,
     int end_index, AnnotationUsecase annotation_usecase,
-    InterpreterManager* interpreter_manager,
-    std::vector<int>* chosen_indices) const {
-  std::vector<int> conflicting_indices;
-  std::unordered_map<int, float> scores;
+    InterpreterManager* interpreter_manager, Arena* arena,
+    ArenaVector<int>* chosen_indices) const {
+  ArenaVector<int> conflicting_indices{ArenaAllocator<int>(arena)};
+  conflicting_indices.reserve(end_index - start_index);
+
+  // Priority scores of the conflicting candidates, indexed relative to
+  // 'start_index'. Candidates without a classification score 0.
+  ArenaVector<float> scores(end_index - start_index, 0.0f,
+                            ArenaAllocator<float>(arena));
   for (int i = start_index; i < end_index; ++i) {
     conflicting_indices.push_back(i);
     if (!candidates[i].classification.empty()) {
-      scores[i] = GetPriorityScore(candidates[i].classification);
+      scores[i - start_index] = GetPriorityScore(candidates[i].classification);
       continue;
     }
 
@@ -937,17 +1281,22 @@ bool Annotator::ResolveConflict(
     }
 
     if (!classification.empty()) {
-      scores[i] = GetPriorityScore(classification);
+      scores[i - start_index] = GetPriorityScore(classification);
     }
   }
 
   std::sort(conflicting_indices.begin(), conflicting_indices.end(),
-            [&scores](int i, int j) { return scores[i] > scores[j]; });
+            [&scores, start_index](int i, int j) {
+              return scores[i - start_index] > scores[j - start_index];
+            });
 
   // Here we keep a set of indices that were chosen, per-source, to enable
   // effective computation.
-  std::unordered_map<AnnotatedSpan::Source, SortedIntSet>
-      chosen_indices_for_source_map;
+  typedef std::pair<const AnnotatedSpan::Source, SortedIntSet> SourceSetPair;
+  std::map<AnnotatedSpan::Source, SortedIntSet,
+           std::less<AnnotatedSpan::Source>, ArenaAllocator<SourceSetPair>>
+      chosen_indices_for_source_map{std::less<AnnotatedSpan::Source>(),
+                                    ArenaAllocator<SourceSetPair>(arena)};
 
   // Greedily place the candidates if they don't conflict with the already
   // placed ones.
@@ -980,14 +1329,16 @@ bool Annotator::ResolveConflict(
     // If the set of indices for the current source doesn't exist yet,
     // initialize it.
     if (chosen_indices_for_source_ptr == nullptr) {
-      SortedIntSet new_set([&candidates](int a, int b) {
-        return candidates[a].span.first < candidates[b].span.first;
-      });
-      chosen_indices_for_source_map[candidates[considered_candidate].source] =
-          std::move(new_set);
+      SortedIntSet new_set(
+          [&candidates](int a, int b) {
+            return candidates[a].span.first < candidates[b].span.first;
+          },
+          ArenaAllocator<int>(arena));
       chosen_indices_for_source_ptr =
-          &chosen_indices_for_source_map[candidates[considered_candidate]
-                                             .source];
+          &chosen_indices_for_source_map
+               .emplace(candidates[considered_candidate].source,
+                        std::move(new_set))
+               .first->second;
     }
 
     // Place the candidate to the output and to the per-source conflict set.
@@ -1087,7 +1438,7 @@ bool Annotator::ModelSuggestSelection(
 
   // Produce selection model candidates.
   std::vector<TokenSpan> chunks;
-  if (!ModelChunk(tokens->size(), /*span_of_interest=*/symmetry_context_span,
+  if (!ModelChunk(*tokens, /*span_of_interest=*/symmetry_context_span,
                   interpreter_manager->SelectionInterpreter(), *cached_features,
                   &chunks)) {
     TC3_LOG(ERROR) << "Could not chunk.";
@@ -1105,7 +1456,7 @@ bool Annotator::ModelSuggestSelection(
 
     // Only output non-empty spans.
     if (candidate.span.first != candidate.span.second) {
-      result->push_back(candidate);
+      result->push_back(std::move(candidate));
     }
   }
   return true;
@@ -1153,6 +1504,77 @@ std::vector<Token> CopyCachedTokens(const std::vector<Token>& cached_tokens,
   }
   return tokens;
 }
+
+std::vector<TokenSpan> PickNonOverlappingChunks(
+    const TokenSpan& inference_span,
+    const std::vector<TokenSpan>& chunks_by_score) {
+  // Traverse the candidate chunks from highest-scoring to lowest-scoring. Pick
+  // them greedily as long as they do not overlap with any previously picked
+  // chunks.
+  std::vector<bool> token_used(TokenSpanSize(inference_span));
+  std::vector<TokenSpan> chunks;
+  for (const TokenSpan& chunk : chunks_by_score) {
+    bool feasible = true;
+    for (int i = chunk.first; i < chunk.second; ++i) {
+      if (token_used[i - inference_span.first]) {
+        feasible = false;
+        break;
+      }
+    }
+
+    if (!feasible) {
+      continue;
+    }
+
+    for (int i = chunk.first; i < chunk.second; ++i) {
+      token_used[i - inference_span.first] = true;
+    }
+
+    chunks.push_back(chunk);
+  }
+
+  std::sort(chunks.begin(), chunks.end());
+  return chunks;
+}
+
+bool BatchBoundsSensitiveChunks(
+    const TokenSpan& span_of_interest, const TokenSpan& inference_span,
+    int max_chunk_length, int max_batch_size,
+    const std::vector<bool>& pruned_boundary_tokens,
+    const std::function<void(const TokenSpan&)>& add_single_token_chunk,
+    const std::function<bool(const std::vector<TokenSpan>&)>& score_batch) {
+  std::vector<TokenSpan> candidate_spans;
+  candidate_spans.reserve(max_batch_size);
+  for (int start = inference_span.first; start < span_of_interest.second;
+       ++start) {
+    const int leftmost_end_index = std::max(start, span_of_interest.first) + 1;
+    for (int end = leftmost_end_index;
+         end <= inference_span.second && end - start <= max_chunk_length;
+         ++end) {
+      const TokenSpan candidate_span = {start, end};
+      if (add_single_token_chunk && TokenSpanSize(candidate_span) == 1) {
+        add_single_token_chunk(candidate_span);
+        continue;
+      }
+      if (!pruned_boundary_tokens.empty() &&
+          (pruned_boundary_tokens[start - inference_span.first] ||
+           pruned_boundary_tokens[end - 1 - inference_span.first])) {
+        continue;
+      }
+      candidate_spans.push_back(candidate_span);
+      if (static_cast<int>(candidate_spans.size()) == max_batch_size) {
+        if (!score_batch(candidate_spans)) {
+          return false;
+        }
+        candidate_spans.clear();
+      }
+    }
+  }
+  if (!candidate_spans.empty()) {
+    return score_batch(candidate_spans);
+  }
+  return true;
+}
 }  // namespace internal
 
 TokenSpan Annotator::ClassifyTextUpperBoundNeededTokens() const {
@@ -1235,7 +1657,7 @@ bool Annotator::ModelClassifyText(
   if (model_->classification_options()->max_num_tokens() > 0 &&
       model_->classification_options()->max_num_tokens() <
           selection_num_tokens) {
-    *classification_results = {{Collections::Other(), 1.0}};
+    *classification_results = {{kInternedOtherCollection, 1.0}};
     return true;
   }
 
@@ -1275,7 +1697,7 @@ bool Annotator::ModelClassifyText(
 
   if (!classification_feature_processor_->HasEnoughSupportedCodepoints(
           *tokens, extraction_span)) {
-    *classification_results = {{Collections::Other(), 1.0}};
+    *classification_results = {{kInternedOtherCollection, 1.0}};
     return true;
   }
 
@@ -1318,36 +1740,36 @@ bool Annotator::ModelClassifyText(
       ComputeSoftmax(logits.data(), logits.dim(1));
 
   if (scores.empty()) {
-    *classification_results = {{Collections::Other(), 1.0}};
+    *classification_results = {{kInternedOtherCollection, 1.0}};
     return true;
   }
 
   const int best_score_index =
       std::max_element(scores.begin(), scores.end()) - scores.begin();
-  const std::string top_collection =
+  const InternedString top_collection =
       classification_feature_processor_->LabelToCollection(best_score_index);
 
   // Sanity checks.
-  if (top_collection == Collections::Phone()) {
+  if (top_collection == kInternedPhoneCollection) {
     const int digit_count = CountDigits(context, selection_indices);
     if (digit_count <
             model_->classification_options()->phone_min_num_digits() ||
         digit_count >
             model_->classification_options()->phone_max_num_digits()) {
-      *classification_results = {{Collections::Other(), 1.0}};
+      *classification_results = {{kInternedOtherCollection, 1.0}};
       return true;
     }
-  } else if (top_collection == Collections::Address()) {
+  } else if (top_collection == kInternedAddressCollection) {
     if (selection_num_tokens <
         model_->classification_options()->address_min_num_tokens()) {
-      *classification_results = {{Collections::Other(), 1.0}};
+      *classification_results = {{kInternedOtherCollection, 1.0}};
       return true;
     }
-  } else if (top_collection == Collections::Dictionary()) {
+  } else if (top_collection == kInternedDictionaryCollection) {
     if (!Locale::IsAnyLocaleSupported(detected_text_language_tags,
                                       dictionary_locales_,
                                       /*default_value=*/false)) {
-      *classification_results = {{Collections::Other(), 1.0}};
+      *classification_results = {{kInternedOtherCollection, 1.0}};
       return true;
     }
   }
@@ -1364,10 +1786,19 @@ bool Annotator::RegexClassifyText(
           .UTF8Substring(selection_indices.first, selection_indices.second);
   const UnicodeText selection_text_unicode(
       UTF8ToUnicodeText(selection_text, /*do_copy=*/false));
+  const std::unique_ptr<FlatbufferWriter> entity_data_writer =
+      NewEntityDataWriter();
+  const AnchoredTextFeatures selection_features =
+      ComputeAnchoredTextFeatures(selection_text);
 
   // Check whether any of the regular expressions match.
   for (const int pattern_id : classification_regex_patterns_) {
     const CompiledRegexPattern& regex_pattern = regex_patterns_[pattern_id];
+    if (!SatisfiesAnchoredMatchConstraints(
+            regex_pattern.config->anchored_match_constraints(),
+            selection_features)) {
+      continue;
+    }
     const std::unique_ptr<UniLib::RegexMatcher> matcher =
         regex_pattern.pattern->Matcher(selection_text_unicode);
     int status = UniLib::RegexMatcher::kNoError;
@@ -1384,11 +1815,12 @@ bool Annotator::RegexClassifyText(
                        context, regex_pattern.config->verification_options(),
                        selection_text, matcher.get())) {
       classification_result->push_back(
-          {regex_pattern.config->collection_name()->str(),
+          {regex_pattern.collection_name,
            regex_pattern.config->target_classification_score(),
            regex_pattern.config->priority_score()});
       if (!SerializedEntityDataFromRegexMatch(
-              regex_pattern.config, matcher.get(),
+              regex_pattern.config, regex_pattern.entity_field_paths,
+              matcher.get(), entity_data_writer.get(),
               &classification_result->back().serialized_entity_data)) {
         TC3_LOG(ERROR) << "Could not get entity data.";
         return false;
@@ -1400,37 +1832,48 @@ bool Annotator::RegexClassifyText(
 }
 
 namespace {
-std::string PickCollectionForDatetime(
+// Returns a span with the single classification moved into it, avoiding the
+// copy of an initializer list.
+AnnotatedSpan SingleClassificationSpan(CodepointSpan span,
+                                       ClassificationResult&& classification) {
+  AnnotatedSpan result;
+  result.span = span;
+  result.classification.push_back(std::move(classification));
+  return result;
+}
+
+const InternedString& PickCollectionForDatetime(
     const DatetimeParseResult& datetime_parse_result) {
   switch (datetime_parse_result.granularity) {
     case GRANULARITY_HOUR:
     case GRANULARITY_MINUTE:
     case GRANULARITY_SECOND:
-      return Collections::DateTime();
+      return kInternedDateTimeCollection;
     default:
-      return Collections::Date();
+      return kInternedDateCollection;
   }
 }
 
-std::string CreateDatetimeSerializedEntityData(
-    const DatetimeParseResult& parse_result) {
-  EntityDataT entity_data;
-  entity_data.datetime.reset(new EntityData_::DatetimeT());
-  entity_data.datetime->time_ms_utc = parse_result.time_ms_utc;
-  entity_data.datetime->granularity =
-      static_cast<EntityData_::Datetime_::Granularity>(
-          parse_result.granularity);
-
-  flatbuffers::FlatBufferBuilder builder;
-  FinishEntityDataBuffer(builder, EntityData::Pack(builder, &entity_data));
-  return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
-                     builder.GetSize());
+void CreateDatetimeSerializedEntityData(
+    const DatetimeParseResult& parse_result,
+    std::string* serialized_entity_data) {
+  PooledFlatBufferBuilder builder;
+  FinishEntityDataBuffer(
+      *builder,
+      CreateEntityData(
+          *builder, /*start=*/0, /*end=*/0, /*type=*/0,
+          EntityData_::CreateDatetime(
+              *builder, parse_result.time_ms_utc,
+              static_cast<EntityData_::Datetime_::Granularity>(
+                  parse_result.granularity))));
+  CopyFinishedFlatbuffer(*builder, serialized_entity_data);
 }
 }  // namespace
 
 bool Annotator::DatetimeClassifyText(
     const std::string& context, CodepointSpan selection_indices,
     const ClassificationOptions& options,
+    const DatetimeParser::PreparedLocales& locales,
     std::vector<ClassificationResult>* classification_results) const {
   if (!datetime_parser_) {
     return false;
@@ -1441,11 +1884,11 @@ bool Annotator::DatetimeClassifyText(
           .UTF8Substring(selection_indices.first, selection_indices.second);
 
   std::vector<DatetimeParseResultSpan> datetime_spans;
-  if (!datetime_parser_->Parse(selection_text, options.reference_time_ms_utc,
-                               options.reference_timezone, options.locales,
-                               ModeFlag_CLASSIFICATION,
-                               options.annotation_usecase,
-                               /*anchor_start_end=*/true, &datetime_spans)) {
+  if (!datetime_parser_->Parse(
+          UTF8ToUnicodeText(selection_text, /*do_copy=*/false),
+          options.reference_time_ms_utc, options.reference_timezone, locales,
+          ModeFlag_CLASSIFICATION, options.annotation_usecase,
+          /*anchor_start_end=*/true, &datetime_spans)) {
     TC3_LOG(ERROR) << "Error during parsing datetime.";
     return false;
   }
@@ -1460,8 +1903,9 @@ bool Annotator::DatetimeClassifyText(
             PickCollectionForDatetime(parse_result),
             datetime_span.target_classification_score);
         classification_results->back().datetime_parse_result = parse_result;
-        classification_results->back().serialized_entity_data =
-            CreateDatetimeSerializedEntityData(parse_result);
+        CreateDatetimeSerializedEntityData(
+            parse_result,
+            &classification_results->back().serialized_entity_data);
         classification_results->back().priority_score =
             datetime_span.priority_score;
       }
@@ -1474,6 +1918,14 @@ bool Annotator::DatetimeClassifyText(
 std::vector<ClassificationResult> Annotator::ClassifyText(
     const std::string& context, CodepointSpan selection_indices,
     const ClassificationOptions& options) const {
+  return ClassifyText(context, selection_indices, options,
+                      PrepareOptions(options));
+}
+
+std::vector<ClassificationResult> Annotator::ClassifyText(
+    const std::string& context, CodepointSpan selection_indices,
+    const ClassificationOptions& options,
+    const PreparedOptions& prepared_options) const {
   if (!initialized_) {
     TC3_LOG(ERROR) << "Not initialized";
     return {};
@@ -1483,16 +1935,9 @@ std::vector<ClassificationResult> Annotator::ClassifyText(
     return {};
   }
 
-  std::vector<Locale> detected_text_language_tags;
-  if (!ParseLocales(options.detected_text_language_tags,
-                    &detected_text_language_tags)) {
-    TC3_LOG(WARNING)
-        << "Failed to parse the detected_text_language_tags in options: "
-        << options.detected_text_language_tags;
-  }
-  if (!Locale::IsAnyLocaleSupported(detected_text_language_tags,
-                                    model_triggering_locales_,
-                                    /*default_value=*/true)) {
+  const std::vector<Locale>& detected_text_language_tags =
+      prepared_options.detected_text_language_tags_;
+  if (!prepared_options.is_model_triggering_locale_supported_) {
     return {};
   }
 
@@ -1507,113 +1952,75 @@ std::vector<ClassificationResult> Annotator::ClassifyText(
     return {};
   }
 
-  // We'll accumulate a list of candidates, and pick the best candidate in the
-  // end.
-  std::vector<AnnotatedSpan> candidates;
-
-  // Try the knowledge engine.
-  // TODO(b/126579108): Propagate error status.
-  ClassificationResult knowledge_result;
-  if (knowledge_engine_ && knowledge_engine_->ClassifyText(
-                               context, selection_indices, &knowledge_result)) {
-    candidates.push_back({selection_indices, {knowledge_result}});
-    candidates.back().source = AnnotatedSpan::Source::KNOWLEDGE;
-  }
-
-  // Try the contact engine.
-  // TODO(b/126579108): Propagate error status.
-  ClassificationResult contact_result;
-  if (contact_engine_ && contact_engine_->ClassifyText(
-                             context, selection_indices, &contact_result)) {
-    candidates.push_back({selection_indices, {contact_result}});
-  }
-
-  // Try the installed app engine.
-  // TODO(b/126579108): Propagate error status.
-  ClassificationResult installed_app_result;
-  if (installed_app_engine_ &&
-      installed_app_engine_->ClassifyText(context, selection_indices,
-                                          &installed_app_result)) {
-    candidates.push_back({selection_indices, {installed_app_result}});
-  }
-
-  // Try the regular expression models.
-  std::vector<ClassificationResult> regex_results;
-  if (!RegexClassifyText(context, selection_indices, &regex_results)) {
-    return {};
-  }
-  for (const ClassificationResult& result : regex_results) {
-    candidates.push_back({selection_indices, {result}});
-  }
-
-  // Try the date model.
-  //
-  // DatetimeClassifyText only returns the first result, which can however have
-  // more interpretations. They are inserted in the candidates as a single
-  // AnnotatedSpan, so that they get treated together by the conflict resolution
-  // algorithm.
-  std::vector<ClassificationResult> datetime_results;
-  if (!DatetimeClassifyText(context, selection_indices, options,
-                            &datetime_results)) {
-    return {};
-  }
-  if (!datetime_results.empty()) {
-    candidates.push_back({selection_indices, std::move(datetime_results)});
-    candidates.back().source = AnnotatedSpan::Source::DATETIME;
-  }
-
-  // Try the number annotator.
-  // TODO(b/126579108): Propagate error status.
-  ClassificationResult number_annotator_result;
-  if (number_annotator_ &&
-      number_annotator_->ClassifyText(
-          UTF8ToUnicodeText(context, /*do_copy=*/false), selection_indices,
-          options.annotation_usecase, &number_annotator_result)) {
-    candidates.push_back({selection_indices, {number_annotator_result}});
-  }
-
-  // Try the duration annotator.
-  ClassificationResult duration_annotator_result;
-  if (duration_annotator_ &&
-      duration_annotator_->ClassifyText(
-          UTF8ToUnicodeText(context, /*do_copy=*/false), selection_indices,
-          options.annotation_usecase, &duration_annotator_result)) {
-    candidates.push_back({selection_indices, {duration_annotator_result}});
-    candidates.back().source = AnnotatedSpan::Source::DURATION;
-  }
-
-  // Try the ML model.
-  //
-  // The output of the model is considered as an exclusive 1-of-N choice. That's
-  // why it's inserted as only 1 AnnotatedSpan into candidates, as opposed to 1
-  // span for each candidate, like e.g. the regex model.
   InterpreterManager interpreter_manager(selection_executor_.get(),
                                          classification_executor_.get());
-  std::vector<ClassificationResult> model_results;
   std::vector<Token> tokens;
-  if (!ModelClassifyText(
-          context, /*cached_tokens=*/{}, detected_text_language_tags,
-          selection_indices, &interpreter_manager,
-          /*embedding_cache=*/nullptr, &model_results, &tokens)) {
-    return {};
+
+  // The candidates of each engine. They are concatenated in the order of the
+  // engines, so that the conflict resolution sees the same order however the
+  // engines were run.
+  std::vector<AnnotatedSpan> engine_candidates[kNumClassificationEngines];
+  if (options.enable_early_termination &&
+      options.annotation_usecase == ANNOTATION_USECASE_SMART) {
+    ++num_early_termination_calls_;
+
+    // All candidates conflict, so the one with the highest priority score
+    // wins. Stop when no remaining engine can produce a higher score; with an
+    // equal one it could win the tie.
+    float best_priority_score = -std::numeric_limits<float>::infinity();
+    bool model_ran = false;
+    for (const PrioritizedClassificationEngine& prioritized :
+         prioritized_classification_engines_) {
+      if (best_priority_score > prioritized.max_priority_score) {
+        break;
+      }
+      std::vector<AnnotatedSpan>* candidates =
+          &engine_candidates[static_cast<int>(prioritized.engine)];
+      if (!ClassifyTextWithEngine(prioritized.engine, context,
+                                  selection_indices, options, prepared_options,
+                                  &interpreter_manager, &tokens, candidates)) {
+        return {};
+      }
+      for (const AnnotatedSpan& candidate : *candidates) {
+        best_priority_score = std::max(
+            best_priority_score, GetPriorityScore(candidate.classification));
+      }
+      model_ran |= prioritized.engine == ClassificationEngine::MODEL;
+    }
+    if (!model_ran) {
+      ++num_skipped_model_inferences_;
+    }
+  } else {
+    for (int engine = 0; engine < kNumClassificationEngines; ++engine) {
+      if (!ClassifyTextWithEngine(static_cast<ClassificationEngine>(engine),
+                                  context, selection_indices, options,
+                                  prepared_options, &interpreter_manager,
+                                  &tokens, &engine_candidates[engine])) {
+        return {};
+      }
+    }
   }
-  if (!model_results.empty()) {
-    candidates.push_back({selection_indices, std::move(model_results)});
+
+  std::vector<AnnotatedSpan> candidates;
+  for (std::vector<AnnotatedSpan>& candidates_of_engine : engine_candidates) {
+    std::move(candidates_of_engine.begin(), candidates_of_engine.end(),
+              std::back_inserter(candidates));
   }
 
-  std::vector<int> candidate_indices;
+  ArenaVector<int> candidate_indices;
   if (!ResolveConflicts(candidates, context, tokens,
                         detected_text_language_tags, options.annotation_usecase,
-                        &interpreter_manager, &candidate_indices)) {
+                        &interpreter_manager, /*arena=*/nullptr,
+                        &candidate_indices)) {
     TC3_LOG(ERROR) << "Couldn't resolve conflicts.";
     return {};
   }
 
   std::vector<ClassificationResult> results;
   for (const int i : candidate_indices) {
-    for (const ClassificationResult& result : candidates[i].classification) {
+    for (ClassificationResult& result : candidates[i].classification) {
       if (!FilteredForClassification(result)) {
-        results.push_back(result);
+        results.push_back(std::move(result));
       }
     }
   }
@@ -1625,11 +2032,132 @@ std::vector<ClassificationResult> Annotator::ClassifyText(
             });
 
   if (results.empty()) {
-    results = {{Collections::Other(), 1.0}};
+    results = {{kInternedOtherCollection, 1.0}};
   }
   return results;
 }
 
+bool Annotator::ClassifyTextWithEngine(
+    ClassificationEngine engine, const std::string& context,
+    CodepointSpan selection_indices, const ClassificationOptions& options,
+    const PreparedOptions& prepared_options,
+    InterpreterManager* interpreter_manager, std::vector<Token>* tokens,
+    std::vector<AnnotatedSpan>* candidates) const {
+  switch (engine) {
+    case ClassificationEngine::KNOWLEDGE: {
+      // TODO(b/126579108): Propagate error status.
+      ClassificationResult knowledge_result;
+      if (knowledge_engine_ &&
+          knowledge_engine_->ClassifyText(context, selection_indices,
+                                          &knowledge_result)) {
+        candidates->push_back(SingleClassificationSpan(
+            selection_indices, std::move(knowledge_result)));
+        candidates->back().source = AnnotatedSpan::Source::KNOWLEDGE;
+      }
+      return true;
+    }
+
+    case ClassificationEngine::CONTACT: {
+      // TODO(b/126579108): Propagate error status.
+      ClassificationResult contact_result;
+      if (contact_engine_ && contact_engine_->ClassifyText(
+                                 context, selection_indices, &contact_result)) {
+        candidates->push_back(SingleClassificationSpan(
+            selection_indices, std::move(contact_result)));
+      }
+      return true;
+    }
+
+    case ClassificationEngine::INSTALLED_APP: {
+      // TODO(b/126579108): Propagate error status.
+      ClassificationResult installed_app_result;
+      if (installed_app_engine_ &&
+          installed_app_engine_->ClassifyText(context, selection_indices,
+                                              &installed_app_result)) {
+        candidates->push_back(SingleClassificationSpan(
+            selection_indices, std::move(installed_app_result)));
+      }
+      return true;
+    }
+
+    case ClassificationEngine::REGEX: {
+      std::vector<ClassificationResult> regex_results;
+      if (!RegexClassifyText(context, selection_indices, &regex_results)) {
+        return false;
+      }
+      for (ClassificationResult& result : regex_results) {
+        candidates->push_back(
+            SingleClassificationSpan(selection_indices, std::move(result)));
+      }
+      return true;
+    }
+
+    case ClassificationEngine::DATETIME: {
+      // DatetimeClassifyText only returns the first result, which can however
+      // have more interpretations. They are inserted in the candidates as a
+      // single AnnotatedSpan, so that they get treated together by the
+      // conflict resolution algorithm.
+      std::vector<ClassificationResult> datetime_results;
+      if (!DatetimeClassifyText(context, selection_indices, options,
+                                prepared_options.datetime_locales_,
+                                &datetime_results)) {
+        return false;
+      }
+      if (!datetime_results.empty()) {
+        candidates->push_back(
+            {selection_indices, std::move(datetime_results)});
+        candidates->back().source = AnnotatedSpan::Source::DATETIME;
+      }
+      return true;
+    }
+
+    case ClassificationEngine::NUMBER: {
+      // TODO(b/126579108): Propagate error status.
+      ClassificationResult number_annotator_result;
+      if (number_annotator_ &&
+          number_annotator_->ClassifyText(
+              UTF8ToUnicodeText(context, /*do_copy=*/false), selection_indices,
+              options.annotation_usecase, &number_annotator_result)) {
+        candidates->push_back(SingleClassificationSpan(
+            selection_indices, std::move(number_annotator_result)));
+      }
+      return true;
+    }
+
+    case ClassificationEngine::DURATION: {
+      ClassificationResult duration_annotator_result;
+      if (duration_annotator_ &&
+          duration_annotator_->ClassifyText(
+              UTF8ToUnicodeText(context, /*do_copy=*/false), selection_indices,
+              options.annotation_usecase, &duration_annotator_result)) {
+        candidates->push_back(SingleClassificationSpan(
+            selection_indices, std::move(duration_annotator_result)));
+        candidates->back().source = AnnotatedSpan::Source::DURATION;
+      }
+      return true;
+    }
+
+    case ClassificationEngine::MODEL: {
+      // The output of the model is considered as an exclusive 1-of-N choice.
+      // That's why it's inserted as only 1 AnnotatedSpan into candidates, as
+      // opposed to 1 span for each candidate, like e.g. the regex model.
+      std::vector<ClassificationResult> model_results;
+      if (!ModelClassifyText(context, /*cached_tokens=*/{},
+                             prepared_options.detected_text_language_tags_,
+                             selection_indices, interpreter_manager,
+                             /*embedding_cache=*/nullptr, &model_results,
+                             tokens)) {
+        return false;
+      }
+      if (!model_results.empty()) {
+        candidates->push_back({selection_indices, std::move(model_results)});
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
 bool Annotator::ModelAnnotate(
     const std::string& context,
     const std::vector<Locale>& detected_text_language_tags,
@@ -1648,11 +2176,12 @@ bool Annotator::ModelAnnotate(
 
   const UnicodeText context_unicode = UTF8ToUnicodeText(context,
                                                         /*do_copy=*/false);
-  std::vector<UnicodeTextRange> lines;
+  std::vector<ContextLine> lines;
   if (!selection_feature_processor_->GetOptions()->only_use_line_with_click()) {
-    lines.push_back({context_unicode.begin(), context_unicode.end()});
+    lines.push_back({{context_unicode.begin(), context_unicode.end()},
+                     {0, context_unicode.size_codepoints()}});
   } else {
-    lines = selection_feature_processor_->SplitContext(context_unicode);
+    selection_feature_processor_->SplitContext(context_unicode, &lines);
   }
 
   const float min_annotate_confidence =
@@ -1660,14 +2189,19 @@ bool Annotator::ModelAnnotate(
            ? model_->triggering_options()->min_annotate_confidence()
            : 0.f);
 
-  for (const UnicodeTextRange& line : lines) {
+  // The line and its tokens reuse their storage from line to line.
+  std::string line_str;
+  for (const ContextLine& line : lines) {
     FeatureProcessor::EmbeddingCache embedding_cache;
-    const std::string line_str =
-        UnicodeText::UTF8Substring(line.first, line.second);
+    line_str.assign(line.range.first.utf8_data(),
+                    line.range.second.utf8_data() -
+                        line.range.first.utf8_data());
+    const UnicodeText line_unicode =
+        UTF8ToUnicodeText(line_str, /*do_copy=*/false);
 
-    *tokens = selection_feature_processor_->Tokenize(line_str);
+    selection_feature_processor_->Tokenize(line_unicode, tokens);
     selection_feature_processor_->RetokenizeAndFindClick(
-        line_str, {0, std::distance(line.first, line.second)},
+        line_unicode, {0, line.span.second - line.span.first},
         selection_feature_processor_->GetOptions()->only_use_line_with_click(),
         tokens,
         /*click_pos=*/nullptr);
@@ -1693,18 +2227,18 @@ bool Annotator::ModelAnnotate(
     }
 
     std::vector<TokenSpan> local_chunks;
-    if (!ModelChunk(tokens->size(), /*span_of_interest=*/full_line_span,
+    if (!ModelChunk(*tokens, /*span_of_interest=*/full_line_span,
                     interpreter_manager->SelectionInterpreter(),
                     *cached_features, &local_chunks)) {
       TC3_LOG(ERROR) << "Could not chunk.";
       return false;
     }
 
-    const int offset = std::distance(context_unicode.begin(), line.first);
+    const int offset = line.span.first;
     for (const TokenSpan& chunk : local_chunks) {
       const CodepointSpan codepoint_span =
           selection_feature_processor_->StripBoundaryCodepoints(
-              line_str, TokenSpanToCodepointSpan(*tokens, chunk));
+              line_unicode, TokenSpanToCodepointSpan(*tokens, chunk));
 
       // Skip empty spans.
       if (codepoint_span.first != codepoint_span.second) {
@@ -1742,10 +2276,21 @@ const FeatureProcessor* Annotator::ClassificationFeatureProcessorForTests()
   return classification_feature_processor_.get();
 }
 
+Annotator::ClassifyTextStats Annotator::GetClassifyTextStats() const {
+  ClassifyTextStats stats;
+  stats.num_early_termination_calls = num_early_termination_calls_;
+  stats.num_skipped_model_inferences = num_skipped_model_inferences_;
+  return stats;
+}
+
 const DatetimeParser* Annotator::DatetimeParserForTests() const {
   return datetime_parser_.get();
 }
 
+const NumberAnnotator* Annotator::NumberAnnotatorForTests() const {
+  return number_annotator_.get();
+}
+
 void Annotator::RemoveNotEnabledEntityTypes(
     const EnabledEntityTypes& is_entity_type_enabled,
     std::vector<AnnotatedSpan>* annotated_spans) const {
@@ -1769,154 +2314,310 @@ void Annotator::RemoveNotEnabledEntityTypes(
       annotated_spans->end());
 }
 
-std::vector<AnnotatedSpan> Annotator::Annotate(
-    const std::string& context, const AnnotationOptions& options) const {
-  std::vector<AnnotatedSpan> candidates;
+namespace {
+// Stages of Annotate, in the order in which they are run.
+enum AnnotateStage {
+  ANNOTATE_STAGE_PREPARE = 0,
+  ANNOTATE_STAGE_MODEL,
+  ANNOTATE_STAGE_REGEX,
+  ANNOTATE_STAGE_DATETIME,
+  ANNOTATE_STAGE_ENGINES,
+  ANNOTATE_STAGE_NUMBER_AND_DURATION,
+  ANNOTATE_STAGE_RESOLVE,
+  NUM_ANNOTATE_STAGES
+};
+}  // namespace
 
-  if (!(model_->enabled_modes() & ModeFlag_ANNOTATION)) {
-    return {};
-  }
+struct Annotator::AnnotateState {
+  AnnotateState(const std::string& arg_context,
+                const AnnotationOptions& arg_options,
+                const PreparedOptions* arg_prepared_options,
+                const ModelExecutor* selection_executor,
+                const ModelExecutor* classification_executor)
+      : context(arg_context),
+        options(arg_options),
+        prepared_options(arg_prepared_options),
+        context_unicode(UTF8ToUnicodeText(context, /*do_copy=*/false)),
+        interpreter_manager(selection_executor, classification_executor) {}
 
-  const UnicodeText context_unicode =
-      UTF8ToUnicodeText(context, /*do_copy=*/false);
-  if (!context_unicode.is_valid()) {
-    return {};
-  }
+  const std::string& context;
+  const AnnotationOptions& options;
 
-  std::vector<Locale> detected_text_language_tags;
-  if (!ParseLocales(options.detected_text_language_tags,
-                    &detected_text_language_tags)) {
-    TC3_LOG(WARNING)
-        << "Failed to parse the detected_text_language_tags in options: "
-        << options.detected_text_language_tags;
-  }
-  if (!Locale::IsAnyLocaleSupported(detected_text_language_tags,
-                                    model_triggering_locales_,
-                                    /*default_value=*/true)) {
-    return {};
-  }
+  // The caller's prepared options or, if there are none, the ones prepared by
+  // the first stage into 'owned_prepared_options'.
+  const PreparedOptions* prepared_options;
+  PreparedOptions owned_prepared_options;
 
-  InterpreterManager interpreter_manager(selection_executor_.get(),
-                                         classification_executor_.get());
+  const UnicodeText context_unicode;
 
-  // Annotate with the selection model.
-  std::vector<Token> tokens;
-  if (!ModelAnnotate(context, detected_text_language_tags, &interpreter_manager,
-                     &tokens, &candidates)) {
-    TC3_LOG(ERROR) << "Couldn't run ModelAnnotate.";
-    return {};
-  }
+  // Features of the context, computed by the first stage.
+  TriggerFeatures trigger_features = kAllTriggerFeatures;
 
-  // Annotate with the regular expression models.
-  if (!RegexChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
-                  annotation_regex_patterns_, &candidates,
-                  options.is_serialized_entity_data_enabled)) {
-    TC3_LOG(ERROR) << "Couldn't run RegexChunk.";
-    return {};
-  }
+  InterpreterManager interpreter_manager;
+  std::vector<Token> tokens;
+  std::vector<AnnotatedSpan> candidates;
+  std::vector<AnnotatedSpan> result;
+};
+
+// Owns the arguments of an asynchronous Annotate call, so that they outlive
+// the caller's copies.
+struct Annotator::AsyncAnnotateRequest {
+  AsyncAnnotateRequest(
+      const std::string& arg_context, const AnnotationOptions& arg_options,
+      std::function<void(std::vector<AnnotatedSpan>)> arg_callback,
+      const ModelExecutor* selection_executor,
+      const ModelExecutor* classification_executor)
+      : context(arg_context),
+        options(arg_options),
+        callback(std::move(arg_callback)),
+        state(context, options, /*arg_prepared_options=*/nullptr,
+              selection_executor, classification_executor) {}
+
+  const std::string context;
+  const AnnotationOptions options;
+  std::function<void(std::vector<AnnotatedSpan>)> callback;
+  AnnotateState state;
+};
+
+bool Annotator::RunAnnotateStage(int stage, AnnotateState* state) const {
+  const std::string& context = state->context;
+  const AnnotationOptions& options = state->options;
+  std::vector<AnnotatedSpan>* candidates = &state->candidates;
+
+  switch (stage) {
+    case ANNOTATE_STAGE_PREPARE:
+      if (!(model_->enabled_modes() & ModeFlag_ANNOTATION)) {
+        return false;
+      }
+      if (!state->context_unicode.is_valid()) {
+        return false;
+      }
+      state->trigger_features = ComputeTriggerFeatures(state->context_unicode);
+      if (state->prepared_options == nullptr) {
+        state->owned_prepared_options = PrepareOptions(options);
+        state->prepared_options = &state->owned_prepared_options;
+      }
+      return state->prepared_options->is_model_triggering_locale_supported_;
+
+    case ANNOTATE_STAGE_MODEL:
+      // Annotate with the selection model.
+      if (!ModelAnnotate(context,
+                         state->prepared_options->detected_text_language_tags_,
+                         &state->interpreter_manager, &state->tokens,
+                         candidates)) {
+        TC3_LOG(ERROR) << "Couldn't run ModelAnnotate.";
+        return false;
+      }
+      return true;
 
-  // Annotate with the datetime model.
-  const EnabledEntityTypes is_entity_type_enabled(options.entity_types);
-  if ((is_entity_type_enabled(Collections::Date()) ||
-       is_entity_type_enabled(Collections::DateTime())) &&
-      !DatetimeChunk(UTF8ToUnicodeText(context, /*do_copy=*/false),
-                     options.reference_time_ms_utc, options.reference_timezone,
-                     options.locales, ModeFlag_ANNOTATION,
-                     options.annotation_usecase,
-                     options.is_serialized_entity_data_enabled, &candidates)) {
-    TC3_LOG(ERROR) << "Couldn't run RegexChunk.";
-    return {};
-  }
+    case ANNOTATE_STAGE_REGEX:
+      // Annotate with the regular expression models.
+      if (!RegexChunk(state->context_unicode, annotation_regex_patterns_,
+                      state->trigger_features, candidates,
+                      options.is_serialized_entity_data_enabled)) {
+        TC3_LOG(ERROR) << "Couldn't run RegexChunk.";
+        return false;
+      }
+      return true;
 
-  // Annotate with the knowledge engine.
-  if (knowledge_engine_ && !knowledge_engine_->Chunk(context, &candidates)) {
-    TC3_LOG(ERROR) << "Couldn't run knowledge engine Chunk.";
-    return {};
-  }
+    case ANNOTATE_STAGE_DATETIME: {
+      // Annotate with the datetime model.
+      const EnabledEntityTypes& is_entity_type_enabled =
+          state->prepared_options->is_entity_type_enabled_;
+      if ((is_entity_type_enabled(kInternedDateCollection) ||
+           is_entity_type_enabled(kInternedDateTimeCollection)) &&
+          !DatetimeChunk(state->context_unicode, options.reference_time_ms_utc,
+                         options.reference_timezone,
+                         state->prepared_options->datetime_locales_,
+                         ModeFlag_ANNOTATION, options.annotation_usecase,
+                         options.is_serialized_entity_data_enabled,
+                         candidates)) {
+        TC3_LOG(ERROR) << "Couldn't run RegexChunk.";
+        return false;
+      }
+      return true;
+    }
 
-  // Annotate with the contact engine.
-  if (contact_engine_ &&
-      !contact_engine_->Chunk(context_unicode, tokens, &candidates)) {
-    TC3_LOG(ERROR) << "Couldn't run contact engine Chunk.";
-    return {};
-  }
+    case ANNOTATE_STAGE_ENGINES:
+      // Annotate with the knowledge engine.
+      if (knowledge_engine_ && !knowledge_engine_->Chunk(context, candidates)) {
+        TC3_LOG(ERROR) << "Couldn't run knowledge engine Chunk.";
+        return false;
+      }
 
-  // Annotate with the installed app engine.
-  if (installed_app_engine_ &&
-      !installed_app_engine_->Chunk(context_unicode, tokens, &candidates)) {
-    TC3_LOG(ERROR) << "Couldn't run installed app engine Chunk.";
-    return {};
-  }
+      // Annotate with the contact engine.
+      if (contact_engine_ &&
+          !contact_engine_->Chunk(state->context_unicode, state->tokens,
+                                  candidates)) {
+        TC3_LOG(ERROR) << "Couldn't run contact engine Chunk.";
+        return false;
+      }
 
-  // Annotate with the number annotator.
-  if (number_annotator_ != nullptr &&
-      !number_annotator_->FindAll(context_unicode, options.annotation_usecase,
-                                  &candidates)) {
-    TC3_LOG(ERROR) << "Couldn't run number annotator FindAll.";
-    return {};
-  }
+      // Annotate with the installed app engine.
+      if (installed_app_engine_ &&
+          !installed_app_engine_->Chunk(state->context_unicode, state->tokens,
+                                        candidates)) {
+        TC3_LOG(ERROR) << "Couldn't run installed app engine Chunk.";
+        return false;
+      }
+      return true;
 
-  // Annotate with the duration annotator.
-  if (is_entity_type_enabled(Collections::Duration()) &&
-      duration_annotator_ != nullptr &&
-      !duration_annotator_->FindAll(context_unicode, tokens,
-                                    options.annotation_usecase, &candidates)) {
-    TC3_LOG(ERROR) << "Couldn't run duration annotator FindAll.";
-    return {};
-  }
+    case ANNOTATE_STAGE_NUMBER_AND_DURATION:
+      // Annotate with the number annotator.
+      if (number_annotator_ != nullptr &&
+          ShouldTrigger(number_annotator_->trigger_features(),
+                        state->trigger_features) &&
+          !number_annotator_->FindAll(state->context_unicode,
+                                      options.annotation_usecase, candidates)) {
+        TC3_LOG(ERROR) << "Couldn't run number annotator FindAll.";
+        return false;
+      }
 
-  // Sort candidates according to their position in the input, so that the next
-  // code can assume that any connected component of overlapping spans forms a
-  // contiguous block.
-  std::sort(candidates.begin(), candidates.end(),
-            [](const AnnotatedSpan& a, const AnnotatedSpan& b) {
-              return a.span.first < b.span.first;
-            });
+      // Annotate with the duration annotator.
+      if (state->prepared_options->is_entity_type_enabled_(
+              kInternedDurationCollection) &&
+          duration_annotator_ != nullptr &&
+          ShouldTrigger(duration_annotator_->trigger_features(),
+                        state->trigger_features) &&
+          !duration_annotator_->FindAll(state->context_unicode, state->tokens,
+                                        options.annotation_usecase,
+                                        candidates)) {
+        TC3_LOG(ERROR) << "Couldn't run duration annotator FindAll.";
+        return false;
+      }
+      return true;
 
-  std::vector<int> candidate_indices;
-  if (!ResolveConflicts(candidates, context, tokens,
-                        detected_text_language_tags, options.annotation_usecase,
-                        &interpreter_manager, &candidate_indices)) {
-    TC3_LOG(ERROR) << "Couldn't resolve conflicts.";
-    return {};
-  }
+    case ANNOTATE_STAGE_RESOLVE: {
+      // Sort candidates according to their position in the input, so that the
+      // next code can assume that any connected component of overlapping spans
+      // forms a contiguous block.
+      std::sort(candidates->begin(), candidates->end(),
+                [](const AnnotatedSpan& a, const AnnotatedSpan& b) {
+                  return a.span.first < b.span.first;
+                });
+
+      ArenaVector<int> candidate_indices{ArenaAllocator<int>(options.arena)};
+      if (!ResolveConflicts(
+              *candidates, context, state->tokens,
+              state->prepared_options->detected_text_language_tags_,
+              options.annotation_usecase, &state->interpreter_manager,
+              options.arena, &candidate_indices)) {
+        TC3_LOG(ERROR) << "Couldn't resolve conflicts.";
+        return false;
+      }
 
-  std::vector<AnnotatedSpan> result;
-  result.reserve(candidate_indices.size());
-  AnnotatedSpan aggregated_span;
-  for (const int i : candidate_indices) {
-    if (candidates[i].span != aggregated_span.span) {
+      std::vector<AnnotatedSpan>& result = state->result;
+      result.reserve(candidate_indices.size());
+      AnnotatedSpan aggregated_span;
+      for (const int i : candidate_indices) {
+        if ((*candidates)[i].span != aggregated_span.span) {
+          if (!aggregated_span.classification.empty()) {
+            result.push_back(std::move(aggregated_span));
+          }
+          aggregated_span =
+              AnnotatedSpan((*candidates)[i].span, /*arg_classification=*/{});
+        }
+        if ((*candidates)[i].classification.empty() ||
+            ClassifiedAsOther((*candidates)[i].classification) ||
+            FilteredForAnnotation((*candidates)[i])) {
+          continue;
+        }
+        for (ClassificationResult& classification :
+             (*candidates)[i].classification) {
+          aggregated_span.classification.push_back(std::move(classification));
+        }
+      }
       if (!aggregated_span.classification.empty()) {
         result.push_back(std::move(aggregated_span));
       }
-      aggregated_span =
-          AnnotatedSpan(candidates[i].span, /*arg_classification=*/{});
-    }
-    if (candidates[i].classification.empty() ||
-        ClassifiedAsOther(candidates[i].classification) ||
-        FilteredForAnnotation(candidates[i])) {
-      continue;
-    }
-    for (ClassificationResult& classification : candidates[i].classification) {
-      aggregated_span.classification.push_back(std::move(classification));
+
+      // We generate all candidates and remove them later (with the exception
+      // of date/time/duration entities) because there are complex
+      // interdependencies between the entity types. E.g., the TLD of an email
+      // can be interpreted as a URL, but most likely a user of the API does not
+      // want such annotations if "url" is enabled and "email" is not.
+      RemoveNotEnabledEntityTypes(
+          state->prepared_options->is_entity_type_enabled_, &result);
+
+      for (AnnotatedSpan& annotated_span : result) {
+        SortClassificationResults(&annotated_span.classification);
+      }
+      return true;
     }
+
+    default:
+      TC3_LOG(ERROR) << "Unknown annotate stage: " << stage;
+      return false;
   }
-  if (!aggregated_span.classification.empty()) {
-    result.push_back(std::move(aggregated_span));
+}
+
+std::vector<AnnotatedSpan> Annotator::Annotate(
+    const std::string& context, const AnnotationOptions& options) const {
+  AnnotateState state(context, options, /*arg_prepared_options=*/nullptr,
+                      selection_executor_.get(),
+                      classification_executor_.get());
+  for (int stage = 0; stage < NUM_ANNOTATE_STAGES; ++stage) {
+    if (!RunAnnotateStage(stage, &state)) {
+      break;
+    }
   }
+  return std::move(state.result);
+}
 
-  // We generate all candidates and remove them later (with the exception of
-  // date/time/duration entities) because there are complex interdependencies
-  // between the entity types. E.g., the TLD of an email can be interpreted as a
-  // URL, but most likely a user of the API does not want such annotations if
-  // "url" is enabled and "email" is not.
-  RemoveNotEnabledEntityTypes(is_entity_type_enabled, &result);
+std::vector<AnnotatedSpan> Annotator::Annotate(
+    const std::string& context, const AnnotationOptions& options,
+    const PreparedOptions& prepared_options) const {
+  AnnotateState state(context, options, &prepared_options,
+                      selection_executor_.get(),
+                      classification_executor_.get());
+  for (int stage = 0; stage < NUM_ANNOTATE_STAGES; ++stage) {
+    if (!RunAnnotateStage(stage, &state)) {
+      break;
+    }
+  }
+  return std::move(state.result);
+}
+
+void Annotator::ScheduleAnnotateStage(
+    std::shared_ptr<AsyncAnnotateRequest> request, int stage,
+    Executor* executor) const {
+  executor->Schedule([this, request, stage, executor]() {
+    if (RunAnnotateStage(stage, &request->state) &&
+        stage + 1 < NUM_ANNOTATE_STAGES) {
+      ScheduleAnnotateStage(request, stage + 1, executor);
+      return;
+    }
+    request->callback(std::move(request->state.result));
+  });
+}
 
-  for (AnnotatedSpan& annotated_span : result) {
-    SortClassificationResults(&annotated_span.classification);
-  }
+void Annotator::AnnotateAsync(
+    const std::string& context, const AnnotationOptions& options,
+    Executor* executor,
+    std::function<void(std::vector<AnnotatedSpan>)> callback) const {
+  ScheduleAnnotateStage(
+      std::make_shared<AsyncAnnotateRequest>(
+          context, options, std::move(callback), selection_executor_.get(),
+          classification_executor_.get()),
+      ANNOTATE_STAGE_PREPARE, executor);
+}
 
-  return result;
+void Annotator::SuggestSelectionAsync(
+    const std::string& context, CodepointSpan click_indices,
+    const SelectionOptions& options, Executor* executor,
+    std::function<void(CodepointSpan)> callback) const {
+  executor->Schedule([this, context, click_indices, options, callback]() {
+    callback(SuggestSelection(context, click_indices, options));
+  });
+}
+
+void Annotator::ClassifyTextAsync(
+    const std::string& context, CodepointSpan selection_indices,
+    const ClassificationOptions& options, Executor* executor,
+    std::function<void(std::vector<ClassificationResult>)> callback) const {
+  executor->Schedule([this, context, selection_indices, options, callback]() {
+    callback(ClassifyText(context, selection_indices, options));
+  });
 }
 
 CodepointSpan Annotator::ComputeSelectionBoundaries(
@@ -1975,24 +2676,29 @@ bool Annotator::HasEntityData(const RegexModel_::Pattern* pattern) const {
   return false;
 }
 
+std::unique_ptr<FlatbufferWriter> Annotator::NewEntityDataWriter() const {
+  if (compiled_entity_data_schema_ == nullptr) {
+    return nullptr;
+  }
+  return std::unique_ptr<FlatbufferWriter>(
+      new FlatbufferWriter(compiled_entity_data_schema_.get()));
+}
+
 bool Annotator::SerializedEntityDataFromRegexMatch(
-    const RegexModel_::Pattern* pattern, UniLib::RegexMatcher* matcher,
+    const RegexModel_::Pattern* pattern,
+    const std::vector<FlatbufferWriter::FieldPath>& entity_field_paths,
+    UniLib::RegexMatcher* matcher, FlatbufferWriter* entity_data_writer,
     std::string* serialized_entity_data) const {
   if (!HasEntityData(pattern)) {
     serialized_entity_data->clear();
     return true;
   }
-  TC3_CHECK(entity_data_builder_ != nullptr);
-
-  std::unique_ptr<ReflectiveFlatbuffer> entity_data =
-      entity_data_builder_->NewRoot();
-
-  TC3_CHECK(entity_data != nullptr);
+  TC3_CHECK(entity_data_writer != nullptr);
+  entity_data_writer->Reset();
 
   // Set static entity data.
   if (pattern->serialized_entity_data() != nullptr) {
-    TC3_CHECK(entity_data != nullptr);
-    entity_data->MergeFromSerializedFlatbuffer(
+    entity_data_writer->MergeFromSerializedFlatbuffer(
         StringPiece(pattern->serialized_entity_data()->c_str(),
                     pattern->serialized_entity_data()->size()));
   }
@@ -2001,14 +2707,17 @@ bool Annotator::SerializedEntityDataFromRegexMatch(
   if (pattern->capturing_group() != nullptr) {
     const int num_groups = pattern->capturing_group()->size();
     for (int i = 0; i < num_groups; i++) {
-      const FlatbufferFieldPath* field_path =
-          pattern->capturing_group()->Get(i)->entity_field_path();
-      if (field_path == nullptr) {
+      if (pattern->capturing_group()->Get(i)->entity_field_path() == nullptr) {
         continue;
       }
-      TC3_CHECK(entity_data != nullptr);
-      if (!SetFieldFromCapturingGroup(/*group_id=*/i, field_path, matcher,
-                                      entity_data.get())) {
+      if (i >= static_cast<int>(entity_field_paths.size())) {
+        TC3_LOG(ERROR) << "No resolved entity data field path for rule "
+                          "capturing group "
+                       << i;
+        return false;
+      }
+      if (!SetFieldFromCapturingGroup(/*group_id=*/i, entity_field_paths[i],
+                                      matcher, entity_data_writer)) {
         TC3_LOG(ERROR)
             << "Could not set entity data from rule capturing group.";
         return false;
@@ -2016,16 +2725,23 @@ bool Annotator::SerializedEntityDataFromRegexMatch(
     }
   }
 
-  *serialized_entity_data = entity_data->Serialize();
+  entity_data_writer->Serialize(serialized_entity_data);
   return true;
 }
 
 bool Annotator::RegexChunk(const UnicodeText& context_unicode,
                            const std::vector<int>& rules,
+                           TriggerFeatures trigger_features,
                            std::vector<AnnotatedSpan>* result,
                            bool is_serialized_entity_data_enabled) const {
+  const std::unique_ptr<FlatbufferWriter> entity_data_writer =
+      is_serialized_entity_data_enabled ? NewEntityDataWriter() : nullptr;
   for (int pattern_id : rules) {
     const CompiledRegexPattern& regex_pattern = regex_patterns_[pattern_id];
+    if (!ShouldTrigger(regex_pattern.config->trigger_features(),
+                       trigger_features)) {
+      continue;
+    }
     const auto matcher = regex_pattern.pattern->Matcher(context_unicode);
     if (!matcher) {
       TC3_LOG(ERROR) << "Could not get regex matcher for pattern: "
@@ -2047,7 +2763,9 @@ bool Annotator::RegexChunk(const UnicodeText& context_unicode,
       std::string serialized_entity_data;
       if (is_serialized_entity_data_enabled) {
         if (!SerializedEntityDataFromRegexMatch(
-                regex_pattern.config, matcher.get(), &serialized_entity_data)) {
+                regex_pattern.config, regex_pattern.entity_field_paths,
+                matcher.get(), entity_data_writer.get(),
+                &serialized_entity_data)) {
           TC3_LOG(ERROR) << "Could not get entity data.";
           return false;
         }
@@ -2061,21 +2779,23 @@ bool Annotator::RegexChunk(const UnicodeText& context_unicode,
           ComputeSelectionBoundaries(matcher.get(), regex_pattern.config);
 
       result->back().classification = {
-          {regex_pattern.config->collection_name()->str(),
+          {regex_pattern.collection_name,
            regex_pattern.config->target_classification_score(),
            regex_pattern.config->priority_score()}};
 
       result->back().classification[0].serialized_entity_data =
-          serialized_entity_data;
+          std::move(serialized_entity_data);
     }
   }
   return true;
 }
 
-bool Annotator::ModelChunk(int num_tokens, const TokenSpan& span_of_interest,
+bool Annotator::ModelChunk(const std::vector<Token>& tokens,
+                           const TokenSpan& span_of_interest,
                            tflite::Interpreter* selection_interpreter,
                            const CachedFeatures& cached_features,
                            std::vector<TokenSpan>* chunks) const {
+  const int num_tokens = tokens.size();
   const int max_selection_span =
       selection_feature_processor_->GetOptions()->max_selection_span();
   // The inference span is the span of interest expanded to include
@@ -2093,7 +2813,7 @@ bool Annotator::ModelChunk(int num_tokens, const TokenSpan& span_of_interest,
           ->bounds_sensitive_features()
           ->enabled()) {
     if (!ModelBoundsSensitiveScoreChunks(
-            num_tokens, span_of_interest, inference_span, cached_features,
+            tokens, span_of_interest, inference_span, cached_features,
             selection_interpreter, &scored_chunks)) {
       return false;
     }
@@ -2109,35 +2829,12 @@ bool Annotator::ModelChunk(int num_tokens, const TokenSpan& span_of_interest,
               return lhs.score < rhs.score;
             });
 
-  // Traverse the candidate chunks from highest-scoring to lowest-scoring. Pick
-  // them greedily as long as they do not overlap with any previously picked
-  // chunks.
-  std::vector<bool> token_used(TokenSpanSize(inference_span));
-  chunks->clear();
+  std::vector<TokenSpan> chunks_by_score;
+  chunks_by_score.reserve(scored_chunks.size());
   for (const ScoredChunk& scored_chunk : scored_chunks) {
-    bool feasible = true;
-    for (int i = scored_chunk.token_span.first;
-         i < scored_chunk.token_span.second; ++i) {
-      if (token_used[i - inference_span.first]) {
-        feasible = false;
-        break;
-      }
-    }
-
-    if (!feasible) {
-      continue;
-    }
-
-    for (int i = scored_chunk.token_span.first;
-         i < scored_chunk.token_span.second; ++i) {
-      token_used[i - inference_span.first] = true;
-    }
-
-    chunks->push_back(scored_chunk.token_span);
+    chunks_by_score.push_back(scored_chunk.token_span);
   }
-
-  std::sort(chunks->begin(), chunks->end());
-
+  *chunks = internal::PickNonOverlappingChunks(inference_span, chunks_by_score);
   return true;
 }
 
@@ -2228,7 +2925,7 @@ bool Annotator::ModelClickContextScoreChunks(
 }
 
 bool Annotator::ModelBoundsSensitiveScoreChunks(
-    int num_tokens, const TokenSpan& span_of_interest,
+    const std::vector<Token>& tokens, const TokenSpan& span_of_interest,
     const TokenSpan& inference_span, const CachedFeatures& cached_features,
     tflite::Interpreter* selection_interpreter,
     std::vector<ScoredChunk>* scored_chunks) const {
@@ -2238,87 +2935,95 @@ bool Annotator::ModelBoundsSensitiveScoreChunks(
                                        ->selection_reduced_output_space()
                                    ? max_selection_span + 1
                                    : 2 * max_selection_span + 1;
+  const FeatureProcessorOptions_::BoundsSensitiveFeatures*
+      bounds_sensitive_features =
+          selection_feature_processor_->GetOptions()
+              ->bounds_sensitive_features();
   const bool score_single_token_spans_as_zero =
-      selection_feature_processor_->GetOptions()
-          ->bounds_sensitive_features()
-          ->score_single_token_spans_as_zero();
+      bounds_sensitive_features->score_single_token_spans_as_zero();
+
+  // Tokens of the inference span that no scored chunk may start or end with.
+  std::vector<bool> pruned_boundary_tokens;
+  if (bounds_sensitive_features->prune_spans_with_ignored_boundary_tokens()) {
+    pruned_boundary_tokens.resize(TokenSpanSize(inference_span));
+    for (int i = inference_span.first; i < inference_span.second; ++i) {
+      pruned_boundary_tokens[i - inference_span.first] =
+          selection_feature_processor_->IsIgnoredSpanBoundaryToken(tokens[i]);
+    }
+  }
 
   scored_chunks->clear();
   if (score_single_token_spans_as_zero) {
     scored_chunks->reserve(TokenSpanSize(span_of_interest));
   }
 
-  // Prepare all chunk candidates into one batch:
+  // Generate the chunk candidates and score them batch by batch:
   //   - Are contained in the inference span
   //   - Have a non-empty intersection with the span of interest
   //   - Are at least one token long
   //   - Are not longer than the maximum chunk length
-  std::vector<TokenSpan> candidate_spans;
-  for (int start = inference_span.first; start < span_of_interest.second;
-       ++start) {
-    const int leftmost_end_index = std::max(start, span_of_interest.first) + 1;
-    for (int end = leftmost_end_index;
-         end <= inference_span.second && end - start <= max_chunk_length;
-         ++end) {
-      const TokenSpan candidate_span = {start, end};
-      if (score_single_token_spans_as_zero &&
-          TokenSpanSize(candidate_span) == 1) {
-        // Do not include the single token span in the batch, add a zero score
-        // for it directly to the output.
-        scored_chunks->push_back(ScoredChunk{candidate_span, 0.0f});
-      } else {
-        candidate_spans.push_back(candidate_span);
-      }
-    }
-  }
-
+  // Single token spans are not batched but get a zero score directly, if the
+  // options ask for it.
   const int max_batch_size = model_->selection_options()->batch_size();
+  std::vector<float> features;
+  features.reserve(max_batch_size * cached_features.OutputFeaturesSize());
+  std::function<void(const TokenSpan&)> add_single_token_chunk;
+  if (score_single_token_spans_as_zero) {
+    add_single_token_chunk = [scored_chunks](const TokenSpan& candidate_span) {
+      scored_chunks->push_back(ScoredChunk{candidate_span, 0.0f});
+    };
+  }
+  return internal::BatchBoundsSensitiveChunks(
+      span_of_interest, inference_span, max_chunk_length, max_batch_size,
+      pruned_boundary_tokens, add_single_token_chunk,
+      [this, &cached_features, selection_interpreter, &features,
+       scored_chunks](const std::vector<TokenSpan>& candidate_spans) {
+        return ModelBoundsSensitiveScoreBatch(candidate_spans, cached_features,
+                                              selection_interpreter, &features,
+                                              scored_chunks);
+      });
+}
 
-  std::vector<float> all_features;
-  scored_chunks->reserve(scored_chunks->size() + candidate_spans.size());
-  for (int batch_start = 0; batch_start < candidate_spans.size();
-       batch_start += max_batch_size) {
-    const int batch_end = std::min(batch_start + max_batch_size,
-                                   static_cast<int>(candidate_spans.size()));
-
-    // Prepare features for the whole batch.
-    all_features.clear();
-    all_features.reserve(max_batch_size * cached_features.OutputFeaturesSize());
-    for (int i = batch_start; i < batch_end; ++i) {
-      cached_features.AppendBoundsSensitiveFeaturesForSpan(candidate_spans[i],
-                                                           &all_features);
-    }
-
-    // Run batched inference.
-    const int batch_size = batch_end - batch_start;
-    const int features_size = cached_features.OutputFeaturesSize();
-    TensorView<float> logits = selection_executor_->ComputeLogits(
-        TensorView<float>(all_features.data(), {batch_size, features_size}),
-        selection_interpreter);
-    if (!logits.is_valid()) {
-      TC3_LOG(ERROR) << "Couldn't compute logits.";
-      return false;
-    }
-    if (logits.dims() != 2 || logits.dim(0) != batch_size ||
-        logits.dim(1) != 1) {
-      TC3_LOG(ERROR) << "Mismatching output.";
-      return false;
-    }
-
-    // Save results.
-    for (int i = batch_start; i < batch_end; ++i) {
-      scored_chunks->push_back(
-          ScoredChunk{candidate_spans[i], logits.data()[i - batch_start]});
-    }
+bool Annotator::ModelBoundsSensitiveScoreBatch(
+    const std::vector<TokenSpan>& candidate_spans,
+    const CachedFeatures& cached_features,
+    tflite::Interpreter* selection_interpreter, std::vector<float>* features,
+    std::vector<ScoredChunk>* scored_chunks) const {
+  // Prepare features for the whole batch.
+  features->clear();
+  for (const TokenSpan& candidate_span : candidate_spans) {
+    cached_features.AppendBoundsSensitiveFeaturesForSpan(candidate_span,
+                                                         features);
+  }
+
+  // Run batched inference.
+  const int batch_size = candidate_spans.size();
+  const int features_size = cached_features.OutputFeaturesSize();
+  TensorView<float> logits = selection_executor_->ComputeLogits(
+      TensorView<float>(features->data(), {batch_size, features_size}),
+      selection_interpreter);
+  if (!logits.is_valid()) {
+    TC3_LOG(ERROR) << "Couldn't compute logits.";
+    return false;
+  }
+  if (logits.dims() != 2 || logits.dim(0) != batch_size ||
+      logits.dim(1) != 1) {
+    TC3_LOG(ERROR) << "Mismatching output.";
+    return false;
   }
 
+  // Save results.
+  for (int i = 0; i < batch_size; ++i) {
+    scored_chunks->push_back(ScoredChunk{candidate_spans[i], logits.data()[i]});
+  }
   return true;
 }
 
 bool Annotator::DatetimeChunk(const UnicodeText& context_unicode,
                               int64 reference_time_ms_utc,
                               const std::string& reference_timezone,
-                              const std::string& locales, ModeFlag mode,
+                              const DatetimeParser::PreparedLocales& locales,
+                              ModeFlag mode,
                               AnnotationUsecase annotation_usecase,
                               bool is_serialized_entity_data_enabled,
                               std::vector<AnnotatedSpan>* result) const {
@@ -2343,8 +3048,9 @@ bool Annotator::DatetimeChunk(const UnicodeText& context_unicode,
           datetime_span.priority_score);
       annotated_span.classification.back().datetime_parse_result = parse_result;
       if (is_serialized_entity_data_enabled) {
-        annotated_span.classification.back().serialized_entity_data =
-            CreateDatetimeSerializedEntityData(parse_result);
+        CreateDatetimeSerializedEntityData(
+            parse_result,
+            &annotated_span.classification.back().serialized_entity_data);
       }
     }
     annotated_span.source = AnnotatedSpan::Source::DATETIME;
@@ -19,6 +19,8 @@
 #ifndef LIBTEXTCLASSIFIER_ANNOTATOR_ANNOTATOR_H_
 #define LIBTEXTCLASSIFIER_ANNOTATOR_ANNOTATOR_H_
 
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <set>
 #include <string>
@@ -35,11 +37,16 @@
 #include "annotator/model_generated.h"
 #include "annotator/number/number.h"
 #include "annotator/strip-unpaired-brackets.h"
+#include "annotator/trigger-features.h"
 #include "annotator/types.h"
 #include "annotator/zlib-utils.h"
+#include "utils/executor.h"
+#include "utils/flatbuffers-writer.h"
 #include "utils/flatbuffers.h"
 #include "utils/i18n/locale.h"
+#include "utils/memory/arena.h"
 #include "utils/memory/mmap.h"
+#include "utils/strings/interned-string.h"
 #include "utils/utf8/unilib.h"
 #include "utils/zlib/zlib.h"
 
@@ -89,13 +96,20 @@ struct ClassificationOptions {
   // Tailors the output annotations according to the specified use-case.
   AnnotationUsecase annotation_usecase = ANNOTATION_USECASE_SMART;
 
+  // If true, the engines run in the order of the highest priority score they
+  // can produce, and stop once a result is found that none of the remaining
+  // engines could outrank. The result is the same. Only applies to the SMART
+  // use-case, in which the candidates of all engines conflict.
+  bool enable_early_termination = false;
+
   bool operator==(const ClassificationOptions& other) const {
     return this->reference_time_ms_utc == other.reference_time_ms_utc &&
            this->reference_timezone == other.reference_timezone &&
            this->locales == other.locales &&
            this->detected_text_language_tags ==
                other.detected_text_language_tags &&
-           this->annotation_usecase == other.annotation_usecase;
+           this->annotation_usecase == other.annotation_usecase &&
+           this->enable_early_termination == other.enable_early_termination;
   }
 };
 
@@ -124,6 +138,12 @@ struct AnnotationOptions {
   // Tailors the output annotations according to the specified use-case.
   AnnotationUsecase annotation_usecase = ANNOTATION_USECASE_SMART;
 
+  // Optional arena from which the temporaries of the call are allocated. Lets
+  // callers that reset one arena per request avoid most of the malloc/free
+  // traffic of the conflict resolution. Not owned, must outlive the call and
+  // must not be used from other threads during it. Not part of operator==.
+  Arena* arena = nullptr;
+
   bool operator==(const AnnotationOptions& other) const {
     return this->reference_time_ms_utc == other.reference_time_ms_utc &&
            this->reference_timezone == other.reference_timezone &&
@@ -164,20 +184,61 @@ class InterpreterManager {
 };
 
 // Stores entity types enabled for annotation, and provides operator() for
-// checking whether a given entity type is enabled.
+// checking whether a given entity type is enabled. An empty set of entity types
+// enables all of them.
+// The entity types come from requests, so they are only looked up among the
+// interned strings instead of permanently growing the pool. Types that are not
+// interned yet, e.g. the collection of an engine that hasn't produced a result
+// in this process, are kept as strings and compared by value.
 class EnabledEntityTypes {
  public:
+  EnabledEntityTypes() {}
   explicit EnabledEntityTypes(
       const std::unordered_set<std::string>& entity_types)
-      : entity_types_(entity_types) {}
+      : all_enabled_(entity_types.empty()) {
+    for (const std::string& entity_type : entity_types) {
+      InternedString interned;
+      if (FindInterned(entity_type, &interned)) {
+        entity_types_.Insert(interned);
+      } else {
+        uninterned_entity_types_.insert(entity_type);
+      }
+    }
+  }
 
-  bool operator()(const std::string& entity_type) const {
-    return entity_types_.empty() ||
-           entity_types_.find(entity_type) != entity_types_.cend();
+  bool operator()(const InternedString& entity_type) const {
+    return all_enabled_ || entity_types_.Contains(entity_type) ||
+           (!uninterned_entity_types_.empty() &&
+            uninterned_entity_types_.count(entity_type.str()) > 0);
   }
 
  private:
-  const std::unordered_set<std::string>& entity_types_;
+  bool all_enabled_ = true;
+  InternedStringSet entity_types_;
+  std::unordered_set<std::string> uninterned_entity_types_;
+};
+
+// Request options that do not change from call to call, resolved for one
+// Annotator by Annotator::PrepareOptions(): the detected text language tags
+// are parsed and checked against the triggering locales of the model, the
+// locales are expanded to the locale ids of the datetime model and the entity
+// types are compiled to a bitmask. Callers that reuse a few option sets across
+// many calls can prepare them once, instead of having every call re-parse
+// them.
+// NOTE: Only valid for the Annotator that prepared it.
+class PreparedOptions {
+ public:
+  const std::vector<Locale>& detected_text_language_tags() const {
+    return detected_text_language_tags_;
+  }
+
+ private:
+  friend class Annotator;
+
+  std::vector<Locale> detected_text_language_tags_;
+  bool is_model_triggering_locale_supported_ = true;
+  DatetimeParser::PreparedLocales datetime_locales_;
+  EnabledEntityTypes is_entity_type_enabled_;
 };
 
 // A text processing model that provides text classification, annotation,
@@ -223,9 +284,26 @@ class Annotator {
   // Initializes the contact engine with the given config.
   bool InitializeContactEngine(const std::string& serialized_config);
 
+  // Adds the contacts from a serialized ContactEngineConfig to the contact
+  // engine, which must be initialized. Safe to call concurrently with
+  // annotation calls.
+  bool AddContacts(const std::string& serialized_config);
+
+  // Removes the contact with the given id from the contact engine.
+  bool RemoveContact(const std::string& id);
+
   // Initializes the installed app engine with the given config.
   bool InitializeInstalledAppEngine(const std::string& serialized_config);
 
+  // Adds the apps from a serialized InstalledAppEngineConfig to the installed
+  // app engine, which must be initialized. Safe to call concurrently with
+  // annotation calls.
+  bool AddInstalledApps(const std::string& serialized_config);
+
+  // Removes the app with the given package name from the installed app
+  // engine.
+  bool RemoveInstalledApp(const std::string& package_name);
+
   // Runs inference for given a context and current selection (i.e. index
   // of the first and one past last selected characters (utf8 codepoint
   // offsets)). Returns the indices (utf8 codepoint offsets) of the selection
@@ -250,11 +328,75 @@ class Annotator {
       const std::string& context,
       const AnnotationOptions& options = AnnotationOptions()) const;
 
+  // Prepares the locales and detected_text_language_tags of request options
+  // for reuse across calls.
+  PreparedOptions PrepareOptions(
+      const std::string& locales,
+      const std::string& detected_text_language_tags) const;
+
+  template <typename Options>
+  PreparedOptions PrepareOptions(const Options& options) const {
+    return PrepareOptions(options.locales, options.detected_text_language_tags);
+  }
+
+  // Also prepares the entity types.
+  PreparedOptions PrepareOptions(const AnnotationOptions& options) const;
+
+  // Variants of the methods above that take options prepared by
+  // PrepareOptions(). The locales, detected_text_language_tags and
+  // entity_types of 'options' are ignored in favor of 'prepared_options'.
+  CodepointSpan SuggestSelection(
+      const std::string& context, CodepointSpan click_indices,
+      const SelectionOptions& options,
+      const PreparedOptions& prepared_options) const;
+
+  std::vector<ClassificationResult> ClassifyText(
+      const std::string& context, CodepointSpan selection_indices,
+      const ClassificationOptions& options,
+      const PreparedOptions& prepared_options) const;
+
+  std::vector<AnnotatedSpan> Annotate(
+      const std::string& context, const AnnotationOptions& options,
+      const PreparedOptions& prepared_options) const;
+
+  // Asynchronous variants of the methods above. The work is scheduled on
+  // 'executor' and 'callback' is invoked exactly once, from one of the
+  // executor's tasks, with the same result the blocking method would return.
+  // The arguments are copied, so they need not outlive the call, but the
+  // Annotator must stay alive until the callback has run.
+  void SuggestSelectionAsync(const std::string& context,
+                             CodepointSpan click_indices,
+                             const SelectionOptions& options,
+                             Executor* executor,
+                             std::function<void(CodepointSpan)> callback) const;
+
+  void ClassifyTextAsync(
+      const std::string& context, CodepointSpan selection_indices,
+      const ClassificationOptions& options, Executor* executor,
+      std::function<void(std::vector<ClassificationResult>)> callback) const;
+
+  // Annotation is split into stages (ML model, regular expressions, datetime,
+  // engines, ...), each of which is scheduled as a separate task, so that a
+  // small pool of workers can interleave many concurrent requests.
+  void AnnotateAsync(
+      const std::string& context, const AnnotationOptions& options,
+      Executor* executor,
+      std::function<void(std::vector<AnnotatedSpan>)> callback) const;
+
   // Looks up a knowledge entity by its id. If successful, populates the
   // serialized knowledge result and returns true.
   bool LookUpKnowledgeEntity(const std::string& id,
                              std::string* serialized_knowledge_result) const;
 
+  // Counters of the ClassifyText calls with early termination.
+  struct ClassifyTextStats {
+    int64 num_early_termination_calls = 0;
+
+    // Calls that returned without running the ML model.
+    int64 num_skipped_model_inferences = 0;
+  };
+  ClassifyTextStats GetClassifyTextStats() const;
+
   const Model* model() const;
   const reflection::Schema* entity_data_schema() const;
 
@@ -265,6 +407,9 @@ class Annotator {
   // Exposes the date time parser for tests and evaluations.
   const DatetimeParser* DatetimeParserForTests() const;
 
+  // Exposes the number annotator for tests and evaluations.
+  const NumberAnnotator* NumberAnnotatorForTests() const;
+
   static const std::string& kPhoneCollection;
   static const std::string& kAddressCollection;
   static const std::string& kDateCollection;
@@ -298,7 +443,8 @@ class Annotator {
   bool InitializeRegexModel(ZlibDecompressor* decompressor);
 
   // Resolves conflicts in the list of candidates by removing some overlapping
-  // ones. Returns indices of the surviving ones.
+  // ones. Returns indices of the surviving ones. Temporaries are allocated from
+  // 'arena' if it is not null.
   // NOTE: Assumes that the candidates are sorted according to their position in
   // the span.
   bool ResolveConflicts(const std::vector<AnnotatedSpan>& candidates,
@@ -306,20 +452,27 @@ class Annotator {
                         const std::vector<Token>& cached_tokens,
                         const std::vector<Locale>& detected_text_language_tags,
                         AnnotationUsecase annotation_usecase,
-                        InterpreterManager* interpreter_manager,
-                        std::vector<int>* result) const;
+                        InterpreterManager* interpreter_manager, Arena* arena,
+                        ArenaVector<int>* result) const;
 
   // Resolves one conflict between candidates on indices 'start_index'
   // (inclusive) and 'end_index' (exclusive). Assigns the winning candidate
   // indices to 'chosen_indices'. Returns false if a problem arises.
+  // Temporaries are allocated from 'arena' if it is not null.
   bool ResolveConflict(const std::string& context,
                        const std::vector<Token>& cached_tokens,
                        const std::vector<AnnotatedSpan>& candidates,
                        const std::vector<Locale>& detected_text_language_tags,
                        int start_index, int end_index,
                        AnnotationUsecase annotation_usecase,
-                       InterpreterManager* interpreter_manager,
-                       std::vector<int>* chosen_indices) const;
+                       InterpreterManager* interpreter_manager, Arena* arena,
+                       ArenaVector<int>* chosen_indices) const;
+
+  // Returns the span of a context of 'context_size' codepoints that the
+  // annotators not driven by the ML model look at in SuggestSelection. See
+  // SelectionModelOptions.engine_context_size.
+  CodepointSpan SelectionEngineWindow(int context_size,
+                                      CodepointSpan click_indices) const;
 
   // Gets selection candidates from the ML model.
   // Provides the tokens produced during tokenization of the context string for
@@ -373,6 +526,7 @@ class Annotator {
   bool DatetimeClassifyText(
       const std::string& context, CodepointSpan selection_indices,
       const ClassificationOptions& options,
+      const DatetimeParser::PreparedLocales& locales,
       std::vector<ClassificationResult>* classification_results) const;
 
   // Chunks given input text with the selection model and classifies the spans
@@ -390,13 +544,14 @@ class Annotator {
   // Groups the tokens into chunks. A chunk is a token span that should be the
   // suggested selection when any of its contained tokens is clicked. The chunks
   // are non-overlapping and are sorted by their position in the context string.
-  // "num_tokens" is the total number of tokens available (as this method does
-  // not need the actual vector of tokens).
+  // "tokens" are the tokens of the context that the features were extracted
+  // from.
   // "span_of_interest" is a span of all the tokens that could be clicked.
   // The resulting chunks all have to overlap with it and they cover this span
   // completely. The first and last chunk might extend beyond it.
   // The chunks vector is cleared before filling.
-  bool ModelChunk(int num_tokens, const TokenSpan& span_of_interest,
+  bool ModelChunk(const std::vector<Token>& tokens,
+                  const TokenSpan& span_of_interest,
                   tflite::Interpreter* selection_interpreter,
                   const CachedFeatures& cached_features,
                   std::vector<TokenSpan>* chunks) const;
@@ -411,17 +566,30 @@ class Annotator {
       std::vector<ScoredChunk>* scored_chunks) const;
 
   // A helper method for ModelChunk(). It generates scored chunk candidates for
-  // a bounds-sensitive model.
+  // a bounds-sensitive model. The candidates are generated and scored in
+  // batches of the model's batch size, so that only one batch of features is
+  // held at a time.
   // NOTE: The returned chunks can (and most likely do) overlap.
   bool ModelBoundsSensitiveScoreChunks(
-      int num_tokens, const TokenSpan& span_of_interest,
+      const std::vector<Token>& tokens, const TokenSpan& span_of_interest,
       const TokenSpan& inference_span, const CachedFeatures& cached_features,
       tflite::Interpreter* selection_interpreter,
       std::vector<ScoredChunk>* scored_chunks) const;
 
-  // Produces chunks isolated by a set of regular expressions.
+  // Scores a batch of chunk candidates with the bounds-sensitive model and
+  // appends them to 'scored_chunks'. 'features' is a reusable buffer.
+  bool ModelBoundsSensitiveScoreBatch(
+      const std::vector<TokenSpan>& candidate_spans,
+      const CachedFeatures& cached_features,
+      tflite::Interpreter* selection_interpreter, std::vector<float>* features,
+      std::vector<ScoredChunk>* scored_chunks) const;
+
+  // Produces chunks isolated by a set of regular expressions. Skips the rules
+  // whose trigger features are absent from 'trigger_features', the features
+  // of the context.
   bool RegexChunk(const UnicodeText& context_unicode,
                   const std::vector<int>& rules,
+                  TriggerFeatures trigger_features,
                   std::vector<AnnotatedSpan>* result,
                   bool is_serialized_entity_data_enabled) const;
 
@@ -429,7 +597,8 @@ class Annotator {
   bool DatetimeChunk(const UnicodeText& context_unicode,
                      int64 reference_time_ms_utc,
                      const std::string& reference_timezone,
-                     const std::string& locales, ModeFlag mode,
+                     const DatetimeParser::PreparedLocales& locales,
+                     ModeFlag mode,
                      AnnotationUsecase annotation_usecase,
                      bool is_serialized_entity_data_enabled,
                      std::vector<AnnotatedSpan>* result) const;
@@ -448,9 +617,17 @@ class Annotator {
   // Returns whether a regex pattern provides entity data from a match.
   bool HasEntityData(const RegexModel_::Pattern* pattern) const;
 
-  // Constructs and serializes entity data from regex matches.
+  // Creates a writer for entity data, or nullptr if the model has no entity
+  // data schema. Meant to be reused for all the matches of a call.
+  std::unique_ptr<FlatbufferWriter> NewEntityDataWriter() const;
+
+  // Constructs and serializes entity data from regex matches, using
+  // `entity_data_writer` as scratch space. `entity_field_paths` are the
+  // resolved field paths of the capturing groups of the pattern.
   bool SerializedEntityDataFromRegexMatch(
-      const RegexModel_::Pattern* pattern, UniLib::RegexMatcher* matcher,
+      const RegexModel_::Pattern* pattern,
+      const std::vector<FlatbufferWriter::FieldPath>& entity_field_paths,
+      UniLib::RegexMatcher* matcher, FlatbufferWriter* entity_data_writer,
       std::string* serialized_entity_data) const;
 
   // Verifies a regex match and returns true if verification was successful.
@@ -474,8 +651,64 @@ class Annotator {
   struct CompiledRegexPattern {
     const RegexModel_::Pattern* config;
     std::unique_ptr<UniLib::RegexPattern> pattern;
+
+    // Collection of the results, interned at load time.
+    InternedString collection_name;
+
+    // Entity data field paths of the capturing groups, resolved against the
+    // entity data schema. Empty if a group sets no entity data.
+    std::vector<FlatbufferWriter::FieldPath> entity_field_paths;
   };
 
+  // Engines that ClassifyText runs on the selection, in the order in which
+  // their candidates are resolved.
+  enum class ClassificationEngine {
+    KNOWLEDGE = 0,
+    CONTACT,
+    INSTALLED_APP,
+    REGEX,
+    DATETIME,
+    NUMBER,
+    DURATION,
+    MODEL,
+  };
+  static constexpr int kNumClassificationEngines = 8;
+
+  struct PrioritizedClassificationEngine {
+    ClassificationEngine engine;
+
+    // Upper bound of the priority scores of the results of the engine.
+    float max_priority_score;
+  };
+
+  // Orders the ClassifyText engines by the highest priority score they can
+  // produce.
+  void InitializePrioritizedClassificationEngines();
+
+  // Runs 'engine' on the selection and adds its results to 'candidates'.
+  // Returns false on error.
+  bool ClassifyTextWithEngine(ClassificationEngine engine,
+                              const std::string& context,
+                              CodepointSpan selection_indices,
+                              const ClassificationOptions& options,
+                              const PreparedOptions& prepared_options,
+                              InterpreterManager* interpreter_manager,
+                              std::vector<Token>* tokens,
+                              std::vector<AnnotatedSpan>* candidates) const;
+
+  // Intermediate state of an Annotate call that is passed between its stages.
+  struct AnnotateState;
+  struct AsyncAnnotateRequest;
+
+  // Runs stage 'stage' of Annotate. Returns whether the remaining stages should
+  // run; if not, 'state->result' holds the final result.
+  bool RunAnnotateStage(int stage, AnnotateState* state) const;
+
+  // Schedules stage 'stage' of an asynchronous Annotate call on 'executor'.
+  // Each stage schedules the next one when it finishes.
+  void ScheduleAnnotateStage(std::shared_ptr<AsyncAnnotateRequest> request,
+                             int stage, Executor* executor) const;
+
   // Removes annotations the entity type of which is not in the set of enabled
   // entity types.
   void RemoveNotEnabledEntityTypes(
@@ -487,9 +720,9 @@ class Annotator {
   bool enabled_for_annotation_ = false;
   bool enabled_for_classification_ = false;
   bool enabled_for_selection_ = false;
-  std::unordered_set<std::string> filtered_collections_annotation_;
-  std::unordered_set<std::string> filtered_collections_classification_;
-  std::unordered_set<std::string> filtered_collections_selection_;
+  InternedStringSet filtered_collections_annotation_;
+  InternedStringSet filtered_collections_classification_;
+  InternedStringSet filtered_collections_selection_;
 
   std::vector<CompiledRegexPattern> regex_patterns_;
 
@@ -497,20 +730,25 @@ class Annotator {
   std::vector<int> annotation_regex_patterns_, classification_regex_patterns_,
       selection_regex_patterns_;
 
+  // Indices into regex_patterns_ of the selection patterns with verification
+  // options, which SuggestSelection runs on the whole context instead of the
+  // engine window.
+  std::vector<int> selection_verified_regex_patterns_;
+
   std::unique_ptr<UniLib> owned_unilib_;
   const UniLib* unilib_;
   std::unique_ptr<CalendarLib> owned_calendarlib_;
   const CalendarLib* calendarlib_;
 
   std::unique_ptr<const KnowledgeEngine> knowledge_engine_;
-  std::unique_ptr<const ContactEngine> contact_engine_;
-  std::unique_ptr<const InstalledAppEngine> installed_app_engine_;
+  std::unique_ptr<ContactEngine> contact_engine_;
+  std::unique_ptr<InstalledAppEngine> installed_app_engine_;
   std::unique_ptr<const NumberAnnotator> number_annotator_;
   std::unique_ptr<const DurationAnnotator> duration_annotator_;
 
-  // Builder for creating extra data.
+  // Schema for creating extra data, compiled once at load.
   const reflection::Schema* entity_data_schema_;
-  std::unique_ptr<ReflectiveFlatbufferBuilder> entity_data_builder_;
+  std::unique_ptr<const CompiledFlatbufferSchema> compiled_entity_data_schema_;
 
   // Locales for which the entire model triggers.
   std::vector<Locale> model_triggering_locales_;
@@ -520,6 +758,13 @@ class Annotator {
 
   // Locales that the dictionary classification support.
   std::vector<Locale> dictionary_locales_;
+
+  // All ClassifyText engines, by descending max_priority_score.
+  std::vector<PrioritizedClassificationEngine>
+      prioritized_classification_engines_;
+
+  mutable std::atomic<int64> num_early_termination_calls_{0};
+  mutable std::atomic<int64> num_skipped_model_inferences_{0};
 };
 
 namespace internal {
@@ -537,6 +782,29 @@ CodepointSpan SnapLeftIfWhitespaceSelection(CodepointSpan span,
 std::vector<Token> CopyCachedTokens(const std::vector<Token>& cached_tokens,
                                     CodepointSpan selection_indices,
                                     TokenSpan tokens_around_selection_to_copy);
+
+// Picks the chunks, which are ordered from the highest to the lowest score,
+// greedily as long as they don't overlap an already picked one, and returns
+// them ordered by position. The chunks must be in 'inference_span'.
+std::vector<TokenSpan> PickNonOverlappingChunks(
+    const TokenSpan& inference_span,
+    const std::vector<TokenSpan>& chunks_by_score);
+
+// Generates the chunks scored by the bounds-sensitive selection model: those
+// in 'inference_span' that overlap 'span_of_interest' and are at most
+// 'max_chunk_length' tokens long, ordered by start and then end. Passes them
+// to 'score_batch' in batches of up to 'max_batch_size' chunks.
+// If 'add_single_token_chunk' is set, the single token chunks are passed to it
+// instead of being scored. Other chunks that start or end with a token flagged
+// in 'pruned_boundary_tokens', which is indexed from the start of the
+// inference span, are skipped; an empty vector prunes nothing.
+// Returns false if 'score_batch' fails.
+bool BatchBoundsSensitiveChunks(
+    const TokenSpan& span_of_interest, const TokenSpan& inference_span,
+    int max_chunk_length, int max_batch_size,
+    const std::vector<bool>& pruned_boundary_tokens,
+    const std::function<void(const TokenSpan&)>& add_single_token_chunk,
+    const std::function<bool(const std::vector<TokenSpan>&)>& score_batch);
 }  // namespace internal
 
 // Interprets the buffer as a Model flatbuffer and returns it for reading.
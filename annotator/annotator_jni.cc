@@ -133,7 +133,7 @@ jobject ClassificationResultWithIntentsToJObject(
 
   jbyteArray serialized_knowledge_result = nullptr;
   const std::string& serialized_knowledge_result_string =
-      classification_result.serialized_knowledge_result;
+      classification_result.serialized_knowledge_result();
   if (!serialized_knowledge_result_string.empty()) {
     serialized_knowledge_result =
         env->NewByteArray(serialized_knowledge_result_string.size());
@@ -144,49 +144,42 @@ jobject ClassificationResultWithIntentsToJObject(
   }
 
   jstring contact_name = nullptr;
-  if (!classification_result.contact_name.empty()) {
-    contact_name =
-        env->NewStringUTF(classification_result.contact_name.c_str());
-  }
-
   jstring contact_given_name = nullptr;
-  if (!classification_result.contact_given_name.empty()) {
-    contact_given_name =
-        env->NewStringUTF(classification_result.contact_given_name.c_str());
-  }
-
   jstring contact_nickname = nullptr;
-  if (!classification_result.contact_nickname.empty()) {
-    contact_nickname =
-        env->NewStringUTF(classification_result.contact_nickname.c_str());
-  }
-
   jstring contact_email_address = nullptr;
-  if (!classification_result.contact_email_address.empty()) {
-    contact_email_address =
-        env->NewStringUTF(classification_result.contact_email_address.c_str());
-  }
-
   jstring contact_phone_number = nullptr;
-  if (!classification_result.contact_phone_number.empty()) {
-    contact_phone_number =
-        env->NewStringUTF(classification_result.contact_phone_number.c_str());
-  }
-
   jstring contact_id = nullptr;
-  if (!classification_result.contact_id.empty()) {
-    contact_id = env->NewStringUTF(classification_result.contact_id.c_str());
+  if (const ContactResultData* contact = classification_result.contact()) {
+    if (!contact->name.empty()) {
+      contact_name = env->NewStringUTF(contact->name.c_str());
+    }
+    if (!contact->given_name.empty()) {
+      contact_given_name = env->NewStringUTF(contact->given_name.c_str());
+    }
+    if (!contact->nickname.empty()) {
+      contact_nickname = env->NewStringUTF(contact->nickname.c_str());
+    }
+    if (!contact->email_address.empty()) {
+      contact_email_address =
+          env->NewStringUTF(contact->email_address.c_str());
+    }
+    if (!contact->phone_number.empty()) {
+      contact_phone_number = env->NewStringUTF(contact->phone_number.c_str());
+    }
+    if (!contact->id.empty()) {
+      contact_id = env->NewStringUTF(contact->id.c_str());
+    }
   }
 
   jstring app_name = nullptr;
-  if (!classification_result.app_name.empty()) {
-    app_name = env->NewStringUTF(classification_result.app_name.c_str());
-  }
-
   jstring app_package_name = nullptr;
-  if (!classification_result.app_package_name.empty()) {
-    app_package_name =
-        env->NewStringUTF(classification_result.app_package_name.c_str());
+  if (const AppResultData* app = classification_result.app()) {
+    if (!app->name.empty()) {
+      app_name = env->NewStringUTF(app->name.c_str());
+    }
+    if (!app->package_name.empty()) {
+      app_package_name = env->NewStringUTF(app->package_name.c_str());
+    }
   }
 
   jobject extras = nullptr;
@@ -0,0 +1,445 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/annotator.h"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "annotator/model_generated.h"
+#include "utils/executor.h"
+#include "utils/testing/annotator.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+constexpr char kText[] =
+    "Call me at (800) 123-456 today, at 5pm, or meet me at 350 Third Street "
+    "in 15 minutes.";
+
+std::string GetModelPath() { return TC3_TEST_DATA_DIR; }
+
+std::string ReadFile(const std::string& file_name) {
+  std::ifstream file_stream(file_name);
+  return std::string(std::istreambuf_iterator<char>(file_stream), {});
+}
+
+// Returns 'text' repeated 'times' times, on separate lines.
+std::string Repeat(const std::string& text, int times) {
+  std::string result;
+  for (int i = 0; i < times; ++i) {
+    result += text;
+    result += "\n";
+  }
+  return result;
+}
+
+// Adds a regex pattern for 'enabled_modes', whose first capturing group is
+// selected, to the model. Its priority score is above the ML model's, so it
+// wins over the other candidates.
+RegexModel_::PatternT* AddRegexPattern(ModelT* model,
+                                       const std::string& collection_name,
+                                       const std::string& pattern,
+                                       ModeFlag enabled_modes) {
+  model->regex_model->patterns.emplace_back(new RegexModel_::PatternT);
+  RegexModel_::PatternT* result = model->regex_model->patterns.back().get();
+  result->collection_name = collection_name;
+  result->pattern = pattern;
+  result->enabled_modes = enabled_modes;
+  result->priority_score = 2.0;
+  return result;
+}
+
+// Sets the number of codepoints around the click that the regex, datetime,
+// number and duration annotators look at in SuggestSelection.
+void SetEngineContextSize(ModelT* model, int engine_context_size) {
+  if (model->selection_options == nullptr) {
+    model->selection_options.reset(new SelectionModelOptionsT);
+  }
+  model->selection_options->engine_context_size = engine_context_size;
+}
+
+// Returns the batches of chunks that BatchBoundsSensitiveChunks scores for a
+// click on tokens [4, 6) of a ten token input.
+std::vector<std::vector<TokenSpan>> BoundsSensitiveChunkBatches(
+    int max_batch_size, const std::vector<bool>& pruned_boundary_tokens,
+    const std::function<void(const TokenSpan&)>& add_single_token_chunk =
+        nullptr) {
+  std::vector<std::vector<TokenSpan>> batches;
+  EXPECT_TRUE(internal::BatchBoundsSensitiveChunks(
+      /*span_of_interest=*/{4, 6}, /*inference_span=*/{1, 9},
+      /*max_chunk_length=*/4, max_batch_size, pruned_boundary_tokens,
+      add_single_token_chunk,
+      [&batches](const std::vector<TokenSpan>& batch) {
+        batches.push_back(batch);
+        return true;
+      }));
+  return batches;
+}
+
+std::vector<TokenSpan> Flatten(
+    const std::vector<std::vector<TokenSpan>>& batches) {
+  std::vector<TokenSpan> result;
+  for (const std::vector<TokenSpan>& batch : batches) {
+    result.insert(result.end(), batch.begin(), batch.end());
+  }
+  return result;
+}
+
+// Executor that queues the tasks until they are run explicitly, so that the
+// stages of a request run after the call that scheduled them has returned.
+class QueueingExecutor : public Executor {
+ public:
+  void Schedule(std::function<void()> task) override {
+    tasks_.push_back(std::move(task));
+  }
+
+  // Runs the queued tasks, including the ones they schedule, and returns how
+  // many were run.
+  int RunAll() {
+    int num_tasks = 0;
+    while (!tasks_.empty()) {
+      std::function<void()> task = std::move(tasks_.front());
+      tasks_.pop_front();
+      task();
+      ++num_tasks;
+    }
+    return num_tasks;
+  }
+
+ private:
+  std::deque<std::function<void()>> tasks_;
+};
+
+void ExpectSameAnnotations(const std::vector<AnnotatedSpan>& result,
+                           const std::vector<AnnotatedSpan>& expected) {
+  ASSERT_EQ(result.size(), expected.size());
+  for (int i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i].span, expected[i].span);
+    ASSERT_EQ(result[i].classification.size(),
+              expected[i].classification.size());
+    for (int j = 0; j < result[i].classification.size(); ++j) {
+      EXPECT_EQ(result[i].classification[j].collection,
+                expected[i].classification[j].collection);
+      EXPECT_FLOAT_EQ(result[i].classification[j].score,
+                      expected[i].classification[j].score);
+    }
+  }
+}
+
+TEST(BatchBoundsSensitiveChunksTest, FlushesPartialLastBatch) {
+  const std::vector<std::vector<TokenSpan>> unbatched =
+      BoundsSensitiveChunkBatches(/*max_batch_size=*/100,
+                                  /*pruned_boundary_tokens=*/{});
+  ASSERT_EQ(unbatched.size(), 1);
+  ASSERT_EQ(unbatched[0].size(), 14);
+
+  const std::vector<std::vector<TokenSpan>> batches =
+      BoundsSensitiveChunkBatches(/*max_batch_size=*/3,
+                                  /*pruned_boundary_tokens=*/{});
+  ASSERT_EQ(batches.size(), 5);
+  for (int i = 0; i + 1 < batches.size(); ++i) {
+    EXPECT_EQ(batches[i].size(), 3);
+  }
+  EXPECT_EQ(batches.back().size(), 2);
+  EXPECT_EQ(Flatten(batches), unbatched[0]);
+}
+
+TEST(BatchBoundsSensitiveChunksTest, PrunesChunksWithIgnoredBoundaryTokens) {
+  const std::vector<TokenSpan> unpruned =
+      Flatten(BoundsSensitiveChunkBatches(/*max_batch_size=*/3,
+                                          /*pruned_boundary_tokens=*/{}));
+  // Tokens 3 and 6 of the inference span [1, 9) are ignored.
+  const std::vector<bool> pruned_boundary_tokens = {
+      false, false, true, false, false, true, false, false};
+  std::vector<TokenSpan> expected;
+  for (const TokenSpan& span : unpruned) {
+    if (span.first != 3 && span.second - 1 != 6) {
+      expected.push_back(span);
+    }
+  }
+  ASSERT_LT(expected.size(), unpruned.size());
+
+  EXPECT_EQ(Flatten(BoundsSensitiveChunkBatches(/*max_batch_size=*/3,
+                                                pruned_boundary_tokens)),
+            expected);
+}
+
+TEST(BatchBoundsSensitiveChunksTest, PassesSingleTokenChunksSeparately) {
+  const std::vector<TokenSpan> all_chunks =
+      Flatten(BoundsSensitiveChunkBatches(/*max_batch_size=*/3,
+                                          /*pruned_boundary_tokens=*/{}));
+  std::vector<TokenSpan> expected;
+  for (const TokenSpan& span : all_chunks) {
+    if (TokenSpanSize(span) > 1) {
+      expected.push_back(span);
+    }
+  }
+
+  std::vector<TokenSpan> single_token_chunks;
+  EXPECT_EQ(Flatten(BoundsSensitiveChunkBatches(
+                /*max_batch_size=*/3, /*pruned_boundary_tokens=*/{},
+                [&single_token_chunks](const TokenSpan& span) {
+                  single_token_chunks.push_back(span);
+                })),
+            expected);
+  EXPECT_EQ(single_token_chunks,
+            std::vector<TokenSpan>({TokenSpan(4, 5), TokenSpan(5, 6)}));
+}
+
+// Returns the chunks that bounds-sensitive selection picks in "( foo bar .",
+// with scores that favor the chunks with the parentheses and the period.
+std::vector<TokenSpan> PickedChunks(bool prune_punctuation) {
+  const TokenSpan span = {0, 4};
+  const std::map<TokenSpan, float> scores = {
+      {{0, 3}, 0.9f}, {{1, 3}, 0.8f}, {{3, 4}, 0.7f}, {{0, 2}, 0.6f}};
+  std::vector<std::pair<float, TokenSpan>> scored_chunks;
+  EXPECT_TRUE(internal::BatchBoundsSensitiveChunks(
+      /*span_of_interest=*/span, /*inference_span=*/span,
+      /*max_chunk_length=*/4, /*max_batch_size=*/2,
+      prune_punctuation ? std::vector<bool>{true, false, false, true}
+                        : std::vector<bool>(),
+      /*add_single_token_chunk=*/nullptr,
+      [&scores, &scored_chunks](const std::vector<TokenSpan>& batch) {
+        for (const TokenSpan& chunk : batch) {
+          const auto it = scores.find(chunk);
+          scored_chunks.push_back(
+              {it != scores.end() ? it->second : 0.1f, chunk});
+        }
+        return true;
+      }));
+  std::stable_sort(scored_chunks.begin(), scored_chunks.end(),
+                   [](const std::pair<float, TokenSpan>& a,
+                      const std::pair<float, TokenSpan>& b) {
+                     return a.first > b.first;
+                   });
+  std::vector<TokenSpan> chunks_by_score;
+  for (const auto& scored_chunk : scored_chunks) {
+    chunks_by_score.push_back(scored_chunk.second);
+  }
+  return internal::PickNonOverlappingChunks(span, chunks_by_score);
+}
+
+TEST(BatchBoundsSensitiveChunksTest, PruningChangesPickedChunks) {
+  // Without pruning, "( foo bar" and "." win.
+  EXPECT_EQ(PickedChunks(/*prune_punctuation=*/false),
+            std::vector<TokenSpan>({TokenSpan(0, 3), TokenSpan(3, 4)}));
+
+  // With pruning, "foo bar" is picked instead, and the lone period can't form
+  // a chunk.
+  EXPECT_EQ(PickedChunks(/*prune_punctuation=*/true),
+            std::vector<TokenSpan>({TokenSpan(1, 3)}));
+}
+
+TEST(EnabledEntityTypesTest, MatchesTypesInternedLater) {
+  const EnabledEntityTypes is_entity_type_enabled(
+      {"enabled-type-interned-later"});
+  EXPECT_TRUE(is_entity_type_enabled(
+      InternedString("enabled-type-interned-later")));
+  EXPECT_FALSE(is_entity_type_enabled(InternedString("other-type")));
+}
+
+class AnnotatorTest : public testing::Test {
+ protected:
+  AnnotatorTest() : INIT_UNILIB_FOR_TESTING(unilib_) {}
+
+  void SetUp() override {
+    // Loads the unmodified model. Individual tests can call LoadModel to make
+    // changes.
+    LoadModel([](ModelT* model) {});
+  }
+
+  template <typename Fn>
+  void LoadModel(Fn model_visitor_fn) {
+    model_buffer_ = ModifyAnnotatorModel(
+        ReadFile(GetModelPath() + "test_model.fb"), model_visitor_fn);
+    annotator_ = Annotator::FromUnownedBuffer(model_buffer_.data(),
+                                              model_buffer_.size(), &unilib_);
+    ASSERT_TRUE(annotator_);
+  }
+
+  UniLib unilib_;
+  std::string model_buffer_;
+  std::unique_ptr<Annotator> annotator_;
+};
+
+TEST_F(AnnotatorTest, AnnotateAsyncOnInlineExecutor) {
+  const std::vector<AnnotatedSpan> expected = annotator_->Annotate(kText);
+  ASSERT_FALSE(expected.empty());
+
+  InlineExecutor executor;
+  int num_callbacks = 0;
+  std::vector<AnnotatedSpan> result;
+  annotator_->AnnotateAsync(
+      kText, AnnotationOptions(), &executor,
+      [&num_callbacks, &result](std::vector<AnnotatedSpan> annotations) {
+        ++num_callbacks;
+        result = std::move(annotations);
+      });
+  EXPECT_EQ(num_callbacks, 1);
+  ExpectSameAnnotations(result, expected);
+}
+
+TEST_F(AnnotatorTest, AnnotateAsyncOnQueueingExecutor) {
+  const std::vector<AnnotatedSpan> expected = annotator_->Annotate(kText);
+  ASSERT_FALSE(expected.empty());
+
+  QueueingExecutor executor;
+  int num_callbacks = 0;
+  std::vector<AnnotatedSpan> result;
+  {
+    // The request must not depend on the arguments outliving the call.
+    const std::string context = kText;
+    annotator_->AnnotateAsync(
+        context, AnnotationOptions(), &executor,
+        [&num_callbacks, &result](std::vector<AnnotatedSpan> annotations) {
+          ++num_callbacks;
+          result = std::move(annotations);
+        });
+  }
+  EXPECT_EQ(num_callbacks, 0);
+
+  // Every stage is scheduled as a separate task.
+  EXPECT_GT(executor.RunAll(), 1);
+  EXPECT_EQ(num_callbacks, 1);
+  ExpectSameAnnotations(result, expected);
+}
+
+TEST_F(AnnotatorTest, SuggestSelectionIgnoresDistantText) {
+  // The same click in the middle of a long document selects the same span.
+  const CodepointSpan expected = annotator_->SuggestSelection(kText, {12, 15});
+  // Each line holds kText and a newline, which sizeof(kText) accounts for.
+  const int offset = 25 * sizeof(kText);
+  const CodepointSpan result = annotator_->SuggestSelection(
+      Repeat(kText, 50), {offset + 12, offset + 15});
+  EXPECT_EQ(result.first - offset, expected.first);
+  EXPECT_EQ(result.second - offset, expected.second);
+}
+
+TEST_F(AnnotatorTest, SuggestSelectionFindsCandidatesCrossingWindowEdge) {
+  // The chain of 61 'x's spans codepoints [8, 129), much more than the engine
+  // window around the click.
+  std::string chain = "x";
+  for (int i = 0; i < 60; ++i) {
+    chain += "-x";
+  }
+  const std::string context = "Look at " + chain + " now.";
+  LoadModel([](ModelT* model) {
+    AddRegexPattern(model, "chain", "(x(?:-x)+)", ModeFlag_SELECTION);
+    SetEngineContextSize(model, /*engine_context_size=*/4);
+  });
+
+  EXPECT_EQ(annotator_->SuggestSelection(context, {60, 61}),
+            CodepointSpan(8, 129));
+}
+
+TEST_F(AnnotatorTest, SuggestSelectionVerifiesMatchesOnWholeContext) {
+  // The verifier only accepts the match in a context longer than the engine
+  // window around the click.
+  const std::string filler = Repeat("and then some more words", 20);
+  const std::string context = filler + "alpha beta gamma " + filler;
+  const int start = filler.size();
+  LoadModel([](ModelT* model) {
+    RegexModel_::PatternT* pattern = AddRegexPattern(
+        model, "greek", "(alpha beta gamma)", ModeFlag_SELECTION);
+    pattern->verification_options.reset(new VerificationOptionsT);
+    pattern->verification_options->lua_verifier = 0;
+    model->regex_model->lua_verifier.push_back("return #context > 500");
+    SetEngineContextSize(model, /*engine_context_size=*/4);
+  });
+
+  EXPECT_EQ(annotator_->SuggestSelection(context, {start + 6, start + 10}),
+            CodepointSpan(start, start + 16));
+}
+
+TEST_F(AnnotatorTest, EarlyTerminationKeepsClassification) {
+  ClassificationOptions early_termination_options;
+  early_termination_options.enable_early_termination = true;
+
+  const std::vector<CodepointSpan> selections = {
+      {11, 24}, {25, 30}, {35, 38}, {43, 47}, {54, 70}, {74, 84}};
+  for (const CodepointSpan& selection : selections) {
+    const std::vector<ClassificationResult> expected =
+        annotator_->ClassifyText(kText, selection);
+    const std::vector<ClassificationResult> result = annotator_->ClassifyText(
+        kText, selection, early_termination_options);
+    ASSERT_EQ(result.size(), expected.size());
+    for (int i = 0; i < result.size(); ++i) {
+      EXPECT_EQ(result[i].collection, expected[i].collection);
+      EXPECT_FLOAT_EQ(result[i].score, expected[i].score);
+    }
+  }
+
+  const Annotator::ClassifyTextStats stats =
+      annotator_->GetClassifyTextStats();
+  EXPECT_EQ(stats.num_early_termination_calls, selections.size());
+}
+
+TEST_F(AnnotatorTest, EarlyTerminationSkipsModelAfterHighPriorityResult) {
+  LoadModel([](ModelT* model) {
+    AddRegexPattern(model, "urgent", "(today)", ModeFlag_CLASSIFICATION);
+  });
+  ClassificationOptions early_termination_options;
+  early_termination_options.enable_early_termination = true;
+
+  // The regex result outranks anything the ML model can produce.
+  const std::vector<ClassificationResult> expected =
+      annotator_->ClassifyText(kText, {25, 30});
+  const std::vector<ClassificationResult> result =
+      annotator_->ClassifyText(kText, {25, 30}, early_termination_options);
+  ASSERT_FALSE(result.empty());
+  EXPECT_EQ(result[0].collection, "urgent");
+  ASSERT_EQ(result.size(), expected.size());
+  for (int i = 0; i < result.size(); ++i) {
+    EXPECT_EQ(result[i].collection, expected[i].collection);
+    EXPECT_FLOAT_EQ(result[i].score, expected[i].score);
+  }
+
+  const Annotator::ClassifyTextStats stats =
+      annotator_->GetClassifyTextStats();
+  EXPECT_EQ(stats.num_early_termination_calls, 1);
+  EXPECT_EQ(stats.num_skipped_model_inferences, 1);
+}
+
+TEST_F(AnnotatorTest, AnnotatesRequestedRegexCollectionOnFreshModel) {
+  // The collection is only produced by a regex pattern of the model, and no
+  // result of it was returned before the request.
+  LoadModel([](ModelT* model) {
+    AddRegexPattern(model, "fresh-regex-collection", "(zyxwv)",
+                    ModeFlag_ANNOTATION);
+  });
+  AnnotationOptions options;
+  options.entity_types = {"fresh-regex-collection"};
+
+  const std::vector<AnnotatedSpan> result =
+      annotator_->Annotate("Look for zyxwv here.", options);
+  ASSERT_EQ(result.size(), 1);
+  EXPECT_EQ(result[0].span, CodepointSpan(9, 14));
+  ASSERT_FALSE(result[0].classification.empty());
+  EXPECT_EQ(result[0].classification[0].collection, "fresh-regex-collection");
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/contact/contact-engine-gazetteer.h"
+
+#include "annotator/collections.h"
+#include "annotator/contact/contact-engine_generated.h"
+#include "utils/base/logging.h"
+#include "utils/flatbuffers.h"
+
+namespace libtextclassifier3 {
+namespace {
+// Interned once, instead of for each matched contact.
+const InternedString& kInternedContactCollection =
+    *[]() { return new InternedString(Collections::Contact()); }();
+}  // namespace
+
+void ContactEngine::FillContactResult(const ContactResultData& contact,
+                                      ClassificationResult* result) {
+  *result = ClassificationResult(kInternedContactCollection, /*arg_score=*/1.0);
+  *result->mutable_contact() = contact;
+}
+
+bool ContactEngine::ParseContacts(
+    const std::string& serialized_config,
+    std::vector<GazetteerEngine<ContactResultData>::Entry>* entries) const {
+  const ContactEngineConfig* config =
+      LoadAndVerifyFlatbuffer<ContactEngineConfig>(serialized_config);
+  if (config == nullptr) {
+    TC3_LOG(ERROR) << "Could not load the contact engine config.";
+    return false;
+  }
+  if (config->contacts() == nullptr) {
+    return true;
+  }
+
+  for (const ContactEngineConfig_::Contact* config_contact :
+       *config->contacts()) {
+    if (config_contact->id() == nullptr) {
+      TC3_LOG(ERROR) << "Contact without id.";
+      return false;
+    }
+    entries->emplace_back();
+    GazetteerEngine<ContactResultData>::Entry& entry = entries->back();
+    ContactResultData& contact = entry.entity;
+    contact.id = config_contact->id()->str();
+    if (config_contact->name() != nullptr) {
+      contact.name = config_contact->name()->str();
+    }
+    if (config_contact->given_name() != nullptr) {
+      contact.given_name = config_contact->given_name()->str();
+    }
+    if (config_contact->nickname() != nullptr) {
+      contact.nickname = config_contact->nickname()->str();
+    }
+    if (config_contact->email_address() != nullptr) {
+      contact.email_address = config_contact->email_address()->str();
+    }
+    if (config_contact->phone_number() != nullptr) {
+      contact.phone_number = config_contact->phone_number()->str();
+    }
+    entry.key = contact.id;
+    entry.names = {contact.name, contact.given_name, contact.nickname};
+    if (config_contact->aliases() != nullptr) {
+      for (const flatbuffers::String* alias : *config_contact->aliases()) {
+        entry.names.push_back(alias->str());
+      }
+    }
+  }
+  return true;
+}
+
+bool ContactEngine::Initialize(const std::string& serialized_config) {
+  if (feature_processor_ == nullptr) {
+    TC3_LOG(ERROR) << "No feature processor for the contact engine.";
+    return false;
+  }
+  std::vector<GazetteerEngine<ContactResultData>::Entry> entries;
+  if (!ParseContacts(serialized_config, &entries)) {
+    return false;
+  }
+  engine_.Add(entries, /*replace_all=*/true);
+  return true;
+}
+
+bool ContactEngine::AddContacts(const std::string& serialized_config) {
+  if (feature_processor_ == nullptr) {
+    return false;
+  }
+  std::vector<GazetteerEngine<ContactResultData>::Entry> entries;
+  if (!ParseContacts(serialized_config, &entries)) {
+    return false;
+  }
+  engine_.Add(entries, /*replace_all=*/false);
+  return true;
+}
+
+bool ContactEngine::RemoveContact(const std::string& id) {
+  return engine_.Remove(id);
+}
+
+bool ContactEngine::ClassifyText(
+    const std::string& context, CodepointSpan selection_indices,
+    ClassificationResult* classification_result) const {
+  if (feature_processor_ == nullptr) {
+    return false;
+  }
+  return engine_.ClassifyText(context, selection_indices,
+                              classification_result);
+}
+
+bool ContactEngine::Chunk(const UnicodeText& context_unicode,
+                          const std::vector<Token>& tokens,
+                          std::vector<AnnotatedSpan>* result) const {
+  if (feature_processor_ == nullptr) {
+    return true;
+  }
+  engine_.Chunk(context_unicode, result);
+  return true;
+}
+
+}  // namespace libtextclassifier3
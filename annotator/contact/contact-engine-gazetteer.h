@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBTEXTCLASSIFIER_ANNOTATOR_CONTACT_CONTACT_ENGINE_GAZETTEER_H_
+#define LIBTEXTCLASSIFIER_ANNOTATOR_CONTACT_CONTACT_ENGINE_GAZETTEER_H_
+
+#include <string>
+#include <vector>
+
+#include "annotator/feature-processor.h"
+#include "annotator/gazetteer.h"
+#include "annotator/types.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+
+namespace libtextclassifier3 {
+
+// Finds the user's contacts in text by matching their names, nicknames and
+// aliases against a gazetteer of normalized token sequences. Contacts can be
+// added and removed after initialization without rebuilding the gazetteer.
+// The engine is thread-safe: lookups can run concurrently with updates.
+class ContactEngine {
+ public:
+  explicit ContactEngine(const FeatureProcessor* feature_processor,
+                         const UniLib* unilib)
+      : feature_processor_(feature_processor),
+        engine_(feature_processor, unilib, &FillContactResult) {}
+
+  // Initializes the engine with the contacts from a serialized
+  // ContactEngineConfig flatbuffer, replacing any previous contacts.
+  bool Initialize(const std::string& serialized_config);
+
+  // Adds the contacts from a serialized ContactEngineConfig flatbuffer. A
+  // contact with the id of an existing one replaces it.
+  bool AddContacts(const std::string& serialized_config);
+
+  // Removes the contact with the given id. Returns false if there was none.
+  bool RemoveContact(const std::string& id);
+
+  // Classifies the selection as a contact if it is exactly one of the names
+  // of a contact.
+  bool ClassifyText(const std::string& context, CodepointSpan selection_indices,
+                    ClassificationResult* classification_result) const;
+
+  // Finds all the contact names in the context. The cost is linear in the
+  // length of the context, independently of the number of contacts.
+  // NOTE: The context is tokenized by the engine itself, the passed tokens
+  // are not used, as they need not cover the whole context.
+  bool Chunk(const UnicodeText& context_unicode,
+             const std::vector<Token>& tokens,
+             std::vector<AnnotatedSpan>* result) const;
+
+ private:
+  static void FillContactResult(const ContactResultData& contact,
+                                ClassificationResult* result);
+
+  // Parses the contacts of a serialized ContactEngineConfig flatbuffer.
+  bool ParseContacts(
+      const std::string& serialized_config,
+      std::vector<GazetteerEngine<ContactResultData>::Entry>* entries) const;
+
+  const FeatureProcessor* feature_processor_;
+  GazetteerEngine<ContactResultData> engine_;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_ANNOTATOR_CONTACT_CONTACT_ENGINE_GAZETTEER_H_
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/contact/contact-engine-gazetteer.h"
+
+#include "annotator/collections.h"
+#include "annotator/contact/contact-engine_generated.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+std::string PackContacts(
+    const std::vector<std::vector<std::string>>& contacts) {
+  ContactEngineConfigT config;
+  for (const std::vector<std::string>& fields : contacts) {
+    config.contacts.emplace_back(new ContactEngineConfig_::ContactT());
+    ContactEngineConfig_::ContactT* contact = config.contacts.back().get();
+    contact->id = fields[0];
+    contact->name = fields[1];
+    contact->given_name = fields[2];
+    contact->phone_number = "+41 79 123 45 67";
+    for (int i = 3; i < fields.size(); ++i) {
+      contact->aliases.push_back(fields[i]);
+    }
+  }
+  flatbuffers::FlatBufferBuilder builder;
+  FinishContactEngineConfigBuffer(
+      builder, ContactEngineConfig::Pack(builder, &config));
+  return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+                     builder.GetSize());
+}
+
+class ContactEngineTest : public ::testing::Test {
+ protected:
+  ContactEngineTest() : INIT_UNILIB_FOR_TESTING(unilib_) {
+    FeatureProcessorOptionsT options;
+    options.tokenization_codepoint_config.emplace_back(
+        new TokenizationCodepointRangeT());
+    auto& config = options.tokenization_codepoint_config.back();
+    config->start = 32;
+    config->end = 33;
+    config->role = TokenizationCodepointRange_::Role_WHITESPACE_SEPARATOR;
+    options.ignored_span_boundary_codepoints.push_back('.');
+    options.ignored_span_boundary_codepoints.push_back(',');
+    options.ignored_span_boundary_codepoints.push_back('!');
+
+    flatbuffers::FlatBufferBuilder builder;
+    builder.Finish(CreateFeatureProcessorOptions(builder, &options));
+    options_buffer_ = builder.Release();
+    feature_processor_.reset(new FeatureProcessor(
+        flatbuffers::GetRoot<FeatureProcessorOptions>(options_buffer_.data()),
+        &unilib_));
+  }
+
+  std::vector<std::pair<CodepointSpan, std::string>> Chunk(
+      const ContactEngine& engine, const std::string& text) {
+    std::vector<AnnotatedSpan> spans;
+    EXPECT_TRUE(engine.Chunk(UTF8ToUnicodeText(text, /*do_copy=*/false),
+                             /*tokens=*/{}, &spans));
+    std::vector<std::pair<CodepointSpan, std::string>> result;
+    for (const AnnotatedSpan& span : spans) {
+      EXPECT_EQ(span.classification[0].collection, Collections::Contact());
+      result.push_back({span.span, span.classification[0].contact()->id});
+    }
+    return result;
+  }
+
+  UniLib unilib_;
+  flatbuffers::DetachedBuffer options_buffer_;
+  std::unique_ptr<FeatureProcessor> feature_processor_;
+};
+
+TEST_F(ContactEngineTest, FindsContactsInText) {
+  ContactEngine engine(feature_processor_.get(), &unilib_);
+  ASSERT_TRUE(engine.Initialize(PackContacts(
+      {{"1", "John Doe", "John", "Johnny"}, {"2", "Jane Roe", "Jane"}})));
+
+  EXPECT_THAT(
+      Chunk(engine, "Tell JOHN DOE and johnny, jane is here!"),
+      ElementsAre(std::make_pair(CodepointSpan{5, 13}, std::string("1")),
+                  std::make_pair(CodepointSpan{18, 24}, std::string("1")),
+                  std::make_pair(CodepointSpan{26, 30}, std::string("2"))));
+  EXPECT_THAT(Chunk(engine, "Johnathan Does"), IsEmpty());
+}
+
+TEST_F(ContactEngineTest, ClassifiesContact) {
+  ContactEngine engine(feature_processor_.get(), &unilib_);
+  ASSERT_TRUE(engine.Initialize(PackContacts({{"1", "John Doe", "John"}})));
+
+  ClassificationResult result;
+  EXPECT_TRUE(engine.ClassifyText("Hi John Doe!", {3, 11}, &result));
+  EXPECT_EQ(result.collection, Collections::Contact());
+  EXPECT_EQ(result.contact()->id, "1");
+  EXPECT_EQ(result.contact()->name, "John Doe");
+  EXPECT_EQ(result.contact()->given_name, "John");
+  EXPECT_EQ(result.contact()->phone_number, "+41 79 123 45 67");
+  EXPECT_FALSE(engine.ClassifyText("Hi John Doe!", {0, 7}, &result));
+}
+
+TEST_F(ContactEngineTest, UpdatesContactsIncrementally) {
+  ContactEngine engine(feature_processor_.get(), &unilib_);
+  ASSERT_TRUE(engine.Initialize(PackContacts({{"1", "John Doe", "John"}})));
+
+  ASSERT_TRUE(engine.AddContacts(PackContacts({{"2", "Jane Roe", "Jane"}})));
+  EXPECT_THAT(
+      Chunk(engine, "John and Jane"),
+      ElementsAre(std::make_pair(CodepointSpan{0, 4}, std::string("1")),
+                  std::make_pair(CodepointSpan{9, 13}, std::string("2"))));
+
+  EXPECT_TRUE(engine.RemoveContact("1"));
+  EXPECT_FALSE(engine.RemoveContact("1"));
+  EXPECT_THAT(Chunk(engine, "John and Jane"),
+              ElementsAre(std::make_pair(CodepointSpan{9, 13},
+                                         std::string("2"))));
+
+  // Adding a contact with an existing id replaces it.
+  ASSERT_TRUE(engine.AddContacts(PackContacts({{"2", "Janet Roe", "Janet"}})));
+  EXPECT_THAT(Chunk(engine, "John and Jane"), IsEmpty());
+  EXPECT_THAT(Chunk(engine, "Janet Roe"),
+              ElementsAre(std::make_pair(CodepointSpan{0, 9},
+                                         std::string("2"))));
+}
+
+TEST_F(ContactEngineTest, FailsOnInvalidConfig) {
+  ContactEngine engine(feature_processor_.get(), &unilib_);
+  EXPECT_FALSE(engine.Initialize("not a flatbuffer"));
+  EXPECT_FALSE(engine.AddContacts("not a flatbuffer"));
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
@@ -17,6 +17,6 @@
 #ifndef LIBTEXTCLASSIFIER_ANNOTATOR_CONTACT_CONTACT_ENGINE_H_
 #define LIBTEXTCLASSIFIER_ANNOTATOR_CONTACT_CONTACT_ENGINE_H_
 
-#include "annotator/contact/contact-engine-dummy.h"
+#include "annotator/contact/contact-engine-gazetteer.h"
 
 #endif  // LIBTEXTCLASSIFIER_ANNOTATOR_CONTACT_CONTACT_ENGINE_H_
@@ -20,18 +20,30 @@
 
 namespace libtextclassifier3 {
 
-bool DatetimeExtractor::Extract(DateParseData* result,
-                                CodepointSpan* result_span) const {
+bool DatetimeExtractor::Extract(const CompiledRule& rule,
+                                const UniLib::RegexMatcher& matcher,
+                                int locale_id, DateParseData* result,
+                                CodepointSpan* result_span) {
+  rule_ = &rule;
+  matcher_ = &matcher;
+  const int num_locales =
+      static_cast<int>(rule_ids_.size()) / kNumDatetimeExtractorTypes;
+  locale_rule_ids_ =
+      locale_id >= 0 && locale_id < num_locales
+          ? rule_ids_.data() + locale_id * kNumDatetimeExtractorTypes
+          : nullptr;
+
   result->field_set_mask = 0;
   *result_span = {kInvalidIndex, kInvalidIndex};
 
-  if (rule_.regex->groups() == nullptr) {
+  if (rule_->regex->groups() == nullptr) {
     return false;
   }
 
-  for (int group_id = 0; group_id < rule_.regex->groups()->size(); group_id++) {
+  const int num_groups = rule_->regex->groups()->size();
+  for (int group_id = 0; group_id < num_groups; group_id++) {
     UnicodeText group_text;
-    const int group_type = rule_.regex->groups()->Get(group_id);
+    const int group_type = rule_->regex->groups()->Get(group_id);
     if (group_type == DatetimeGroupType_GROUP_UNUSED) {
       continue;
     }
@@ -148,17 +160,12 @@ bool DatetimeExtractor::Extract(DateParseData* result,
 
 bool DatetimeExtractor::RuleIdForType(DatetimeExtractorType type,
                                       int* rule_id) const {
-  auto type_it = type_and_locale_to_rule_.find(type);
-  if (type_it == type_and_locale_to_rule_.end()) {
+  if (locale_rule_ids_ == nullptr || type < 0 ||
+      type >= kNumDatetimeExtractorTypes) {
     return false;
   }
-
-  auto locale_it = type_it->second.find(locale_id_);
-  if (locale_it == type_it->second.end()) {
-    return false;
-  }
-  *rule_id = locale_it->second;
-  return true;
+  *rule_id = locale_rule_ids_[type];
+  return *rule_id >= 0;
 }
 
 bool DatetimeExtractor::ExtractType(const UnicodeText& input,
@@ -192,7 +199,7 @@ bool DatetimeExtractor::ExtractType(const UnicodeText& input,
 bool DatetimeExtractor::GroupTextFromMatch(int group_id,
                                            UnicodeText* result) const {
   int status;
-  *result = matcher_.Group(group_id, &status);
+  *result = matcher_->Group(group_id, &status);
   if (status != UniLib::RegexMatcher::kNoError) {
     return false;
   }
@@ -202,11 +209,11 @@ bool DatetimeExtractor::GroupTextFromMatch(int group_id,
 bool DatetimeExtractor::UpdateMatchSpan(int group_id,
                                         CodepointSpan* span) const {
   int status;
-  const int match_start = matcher_.Start(group_id, &status);
+  const int match_start = matcher_->Start(group_id, &status);
   if (status != UniLib::RegexMatcher::kNoError) {
     return false;
   }
-  const int match_end = matcher_.End(group_id, &status);
+  const int match_end = matcher_->End(group_id, &status);
   if (status != UniLib::RegexMatcher::kNoError) {
     return false;
   }
@@ -220,10 +227,10 @@ bool DatetimeExtractor::UpdateMatchSpan(int group_id,
   return true;
 }
 
-template <typename T>
+template <typename T, int N>
 bool DatetimeExtractor::MapInput(
     const UnicodeText& input,
-    const std::vector<std::pair<DatetimeExtractorType, T>>& mapping,
+    const std::pair<DatetimeExtractorType, T> (&mapping)[N],
     T* result) const {
   for (const auto& type_value_pair : mapping) {
     if (ExtractType(input, type_value_pair.first)) {
@@ -237,39 +244,39 @@ bool DatetimeExtractor::MapInput(
 bool DatetimeExtractor::ParseWrittenNumber(const UnicodeText& input,
                                            int* parsed_number) const {
   std::vector<std::pair<int, int>> found_numbers;
-  for (const auto& type_value_pair :
-       std::vector<std::pair<DatetimeExtractorType, int>>{
-           {DatetimeExtractorType_ZERO, 0},
-           {DatetimeExtractorType_ONE, 1},
-           {DatetimeExtractorType_TWO, 2},
-           {DatetimeExtractorType_THREE, 3},
-           {DatetimeExtractorType_FOUR, 4},
-           {DatetimeExtractorType_FIVE, 5},
-           {DatetimeExtractorType_SIX, 6},
-           {DatetimeExtractorType_SEVEN, 7},
-           {DatetimeExtractorType_EIGHT, 8},
-           {DatetimeExtractorType_NINE, 9},
-           {DatetimeExtractorType_TEN, 10},
-           {DatetimeExtractorType_ELEVEN, 11},
-           {DatetimeExtractorType_TWELVE, 12},
-           {DatetimeExtractorType_THIRTEEN, 13},
-           {DatetimeExtractorType_FOURTEEN, 14},
-           {DatetimeExtractorType_FIFTEEN, 15},
-           {DatetimeExtractorType_SIXTEEN, 16},
-           {DatetimeExtractorType_SEVENTEEN, 17},
-           {DatetimeExtractorType_EIGHTEEN, 18},
-           {DatetimeExtractorType_NINETEEN, 19},
-           {DatetimeExtractorType_TWENTY, 20},
-           {DatetimeExtractorType_THIRTY, 30},
-           {DatetimeExtractorType_FORTY, 40},
-           {DatetimeExtractorType_FIFTY, 50},
-           {DatetimeExtractorType_SIXTY, 60},
-           {DatetimeExtractorType_SEVENTY, 70},
-           {DatetimeExtractorType_EIGHTY, 80},
-           {DatetimeExtractorType_NINETY, 90},
-           {DatetimeExtractorType_HUNDRED, 100},
-           {DatetimeExtractorType_THOUSAND, 1000},
-       }) {
+  static const std::pair<DatetimeExtractorType, int> kWrittenNumbers[] = {
+      {DatetimeExtractorType_ZERO, 0},
+      {DatetimeExtractorType_ONE, 1},
+      {DatetimeExtractorType_TWO, 2},
+      {DatetimeExtractorType_THREE, 3},
+      {DatetimeExtractorType_FOUR, 4},
+      {DatetimeExtractorType_FIVE, 5},
+      {DatetimeExtractorType_SIX, 6},
+      {DatetimeExtractorType_SEVEN, 7},
+      {DatetimeExtractorType_EIGHT, 8},
+      {DatetimeExtractorType_NINE, 9},
+      {DatetimeExtractorType_TEN, 10},
+      {DatetimeExtractorType_ELEVEN, 11},
+      {DatetimeExtractorType_TWELVE, 12},
+      {DatetimeExtractorType_THIRTEEN, 13},
+      {DatetimeExtractorType_FOURTEEN, 14},
+      {DatetimeExtractorType_FIFTEEN, 15},
+      {DatetimeExtractorType_SIXTEEN, 16},
+      {DatetimeExtractorType_SEVENTEEN, 17},
+      {DatetimeExtractorType_EIGHTEEN, 18},
+      {DatetimeExtractorType_NINETEEN, 19},
+      {DatetimeExtractorType_TWENTY, 20},
+      {DatetimeExtractorType_THIRTY, 30},
+      {DatetimeExtractorType_FORTY, 40},
+      {DatetimeExtractorType_FIFTY, 50},
+      {DatetimeExtractorType_SIXTY, 60},
+      {DatetimeExtractorType_SEVENTY, 70},
+      {DatetimeExtractorType_EIGHTY, 80},
+      {DatetimeExtractorType_NINETY, 90},
+      {DatetimeExtractorType_HUNDRED, 100},
+      {DatetimeExtractorType_THOUSAND, 1000},
+  };
+  for (const auto& type_value_pair : kWrittenNumbers) {
     int rule_id;
     if (!RuleIdForType(type_value_pair.first, &rule_id)) {
       return false;
@@ -353,22 +360,21 @@ bool DatetimeExtractor::ParseMonth(const UnicodeText& input,
     return true;
   }
 
-  if (MapInput(input,
-               {
-                   {DatetimeExtractorType_JANUARY, 1},
-                   {DatetimeExtractorType_FEBRUARY, 2},
-                   {DatetimeExtractorType_MARCH, 3},
-                   {DatetimeExtractorType_APRIL, 4},
-                   {DatetimeExtractorType_MAY, 5},
-                   {DatetimeExtractorType_JUNE, 6},
-                   {DatetimeExtractorType_JULY, 7},
-                   {DatetimeExtractorType_AUGUST, 8},
-                   {DatetimeExtractorType_SEPTEMBER, 9},
-                   {DatetimeExtractorType_OCTOBER, 10},
-                   {DatetimeExtractorType_NOVEMBER, 11},
-                   {DatetimeExtractorType_DECEMBER, 12},
-               },
-               parsed_month)) {
+  static const std::pair<DatetimeExtractorType, int> kMonths[] = {
+      {DatetimeExtractorType_JANUARY, 1},
+      {DatetimeExtractorType_FEBRUARY, 2},
+      {DatetimeExtractorType_MARCH, 3},
+      {DatetimeExtractorType_APRIL, 4},
+      {DatetimeExtractorType_MAY, 5},
+      {DatetimeExtractorType_JUNE, 6},
+      {DatetimeExtractorType_JULY, 7},
+      {DatetimeExtractorType_AUGUST, 8},
+      {DatetimeExtractorType_SEPTEMBER, 9},
+      {DatetimeExtractorType_OCTOBER, 10},
+      {DatetimeExtractorType_NOVEMBER, 11},
+      {DatetimeExtractorType_DECEMBER, 12},
+  };
+  if (MapInput(input, kMonths, parsed_month)) {
     return true;
   }
 
@@ -377,12 +383,12 @@ bool DatetimeExtractor::ParseMonth(const UnicodeText& input,
 
 bool DatetimeExtractor::ParseAMPM(const UnicodeText& input,
                                   DateParseData::AMPM* parsed_ampm) const {
-  return MapInput(input,
-                  {
-                      {DatetimeExtractorType_AM, DateParseData::AMPM::AM},
-                      {DatetimeExtractorType_PM, DateParseData::AMPM::PM},
-                  },
-                  parsed_ampm);
+  static const std::pair<DatetimeExtractorType, DateParseData::AMPM>
+      kAmPm[] = {
+          {DatetimeExtractorType_AM, DateParseData::AMPM::AM},
+          {DatetimeExtractorType_PM, DateParseData::AMPM::PM},
+      };
+  return MapInput(input, kAmPm, parsed_ampm);
 }
 
 bool DatetimeExtractor::ParseRelationDistance(const UnicodeText& input,
@@ -398,11 +404,11 @@ bool DatetimeExtractor::ParseRelationDistance(const UnicodeText& input,
 
 bool DatetimeExtractor::ParseRelation(
     const UnicodeText& input, DateParseData::Relation* parsed_relation) const {
-  return MapInput(
-      input,
-      {
+  static const std::pair<DatetimeExtractorType, DateParseData::Relation>
+      kRelations[] = {
           {DatetimeExtractorType_NOW, DateParseData::Relation::NOW},
-          {DatetimeExtractorType_YESTERDAY, DateParseData::Relation::YESTERDAY},
+          {DatetimeExtractorType_YESTERDAY,
+           DateParseData::Relation::YESTERDAY},
           {DatetimeExtractorType_TOMORROW, DateParseData::Relation::TOMORROW},
           {DatetimeExtractorType_NEXT, DateParseData::Relation::NEXT},
           {DatetimeExtractorType_NEXT_OR_SAME,
@@ -410,18 +416,18 @@ bool DatetimeExtractor::ParseRelation(
           {DatetimeExtractorType_LAST, DateParseData::Relation::LAST},
           {DatetimeExtractorType_PAST, DateParseData::Relation::PAST},
           {DatetimeExtractorType_FUTURE, DateParseData::Relation::FUTURE},
-      },
-      parsed_relation);
+      };
+  return MapInput(input, kRelations, parsed_relation);
 }
 
 bool DatetimeExtractor::ParseRelationType(
     const UnicodeText& input,
     DateParseData::RelationType* parsed_relation_type) const {
-  return MapInput(
-      input,
-      {
+  static const std::pair<DatetimeExtractorType, DateParseData::RelationType>
+      kRelationTypes[] = {
           {DatetimeExtractorType_MONDAY, DateParseData::RelationType::MONDAY},
-          {DatetimeExtractorType_TUESDAY, DateParseData::RelationType::TUESDAY},
+          {DatetimeExtractorType_TUESDAY,
+           DateParseData::RelationType::TUESDAY},
           {DatetimeExtractorType_WEDNESDAY,
            DateParseData::RelationType::WEDNESDAY},
           {DatetimeExtractorType_THURSDAY,
@@ -430,15 +436,17 @@ bool DatetimeExtractor::ParseRelationType(
           {DatetimeExtractorType_SATURDAY,
            DateParseData::RelationType::SATURDAY},
           {DatetimeExtractorType_SUNDAY, DateParseData::RelationType::SUNDAY},
-          {DatetimeExtractorType_SECONDS, DateParseData::RelationType::SECOND},
-          {DatetimeExtractorType_MINUTES, DateParseData::RelationType::MINUTE},
+          {DatetimeExtractorType_SECONDS,
+           DateParseData::RelationType::SECOND},
+          {DatetimeExtractorType_MINUTES,
+           DateParseData::RelationType::MINUTE},
           {DatetimeExtractorType_HOURS, DateParseData::RelationType::HOUR},
           {DatetimeExtractorType_DAY, DateParseData::RelationType::DAY},
           {DatetimeExtractorType_WEEK, DateParseData::RelationType::WEEK},
           {DatetimeExtractorType_MONTH, DateParseData::RelationType::MONTH},
           {DatetimeExtractorType_YEAR, DateParseData::RelationType::YEAR},
-      },
-      parsed_relation_type);
+      };
+  return MapInput(input, kRelationTypes, parsed_relation_type);
 }
 
 }  // namespace libtextclassifier3
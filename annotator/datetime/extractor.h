@@ -17,8 +17,9 @@
 #ifndef LIBTEXTCLASSIFIER_ANNOTATOR_DATETIME_EXTRACTOR_H_
 #define LIBTEXTCLASSIFIER_ANNOTATOR_DATETIME_EXTRACTOR_H_
 
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "annotator/model_generated.h"
@@ -40,25 +41,34 @@ struct CompiledRule {
   const DatetimeModelPattern* pattern;
 };
 
+// Number of entries per locale of an extractor rule table, see
+// DatetimeExtractor.
+constexpr int kNumDatetimeExtractorTypes = DatetimeExtractorType_MAX + 1;
+
 // A helper class for DatetimeParser that extracts structured data
-// (DateParseDate) from the current match of the passed RegexMatcher.
+// (DateParseDate) from the current match of a RegexMatcher.
+//
+// The extractor only refers to the tables of the parser, so one instance is
+// created per request and reused for all its matches.
 class DatetimeExtractor {
  public:
+  // 'extractor_rule_ids' has kNumDatetimeExtractorTypes entries for each
+  // locale id. The entry of an extractor type is the index of its rule in
+  // 'extractor_rules', or -1 if the locale has no rule for the type.
   DatetimeExtractor(
-      const CompiledRule& rule, const UniLib::RegexMatcher& matcher,
-      int locale_id, const UniLib& unilib,
+      const UniLib& unilib,
       const std::vector<std::unique_ptr<const UniLib::RegexPattern>>&
           extractor_rules,
-      const std::unordered_map<DatetimeExtractorType,
-                               std::unordered_map<int, int>>&
-          type_and_locale_to_extractor_rule)
-      : rule_(rule),
-        matcher_(matcher),
-        locale_id_(locale_id),
-        unilib_(unilib),
+      const std::vector<int>& extractor_rule_ids)
+      : unilib_(unilib),
         rules_(extractor_rules),
-        type_and_locale_to_rule_(type_and_locale_to_extractor_rule) {}
-  bool Extract(DateParseData* result, CodepointSpan* result_span) const;
+        rule_ids_(extractor_rule_ids) {}
+
+  // Extracts the data from the current match of 'matcher' of the given rule,
+  // using the extractor rules of the locale.
+  bool Extract(const CompiledRule& rule, const UniLib::RegexMatcher& matcher,
+               int locale_id, DateParseData* result,
+               CodepointSpan* result_span);
 
  private:
   bool RuleIdForType(DatetimeExtractorType type, int* rule_id) const;
@@ -77,9 +87,9 @@ class DatetimeExtractor {
 
   // Returns true if any of the extractors from 'mapping' matched. If it did,
   // will fill 'result' with the associated value from 'mapping'.
-  template <typename T>
+  template <typename T, int N>
   bool MapInput(const UnicodeText& input,
-                const std::vector<std::pair<DatetimeExtractorType, T>>& mapping,
+                const std::pair<DatetimeExtractorType, T> (&mapping)[N],
                 T* result) const;
 
   bool ParseDigits(const UnicodeText& input, int* parsed_digits) const;
@@ -100,13 +110,17 @@ class DatetimeExtractor {
   bool ParseWeekday(const UnicodeText& input,
                     DateParseData::RelationType* parsed_weekday) const;
 
-  const CompiledRule& rule_;
-  const UniLib::RegexMatcher& matcher_;
-  int locale_id_;
   const UniLib& unilib_;
   const std::vector<std::unique_ptr<const UniLib::RegexPattern>>& rules_;
-  const std::unordered_map<DatetimeExtractorType, std::unordered_map<int, int>>&
-      type_and_locale_to_rule_;
+  const std::vector<int>& rule_ids_;
+
+  // The match that is being extracted.
+  const CompiledRule* rule_ = nullptr;
+  const UniLib::RegexMatcher* matcher_ = nullptr;
+
+  // The entries of 'rule_ids_' for the locale of the match, or nullptr if the
+  // locale has no extractor rules.
+  const int* locale_rule_ids_ = nullptr;
 };
 
 }  // namespace libtextclassifier3
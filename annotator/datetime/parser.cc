@@ -16,7 +16,8 @@
 
 #include "annotator/datetime/parser.h"
 
-#include <set>
+#include <algorithm>
+#include <numeric>
 #include <unordered_set>
 
 #include "annotator/datetime/extractor.h"
@@ -71,7 +72,24 @@ DatetimeParser::DatetimeParser(const DatetimeModel* model, const UniLib& unilib,
   }
 
   if (model->extractors() != nullptr) {
+    int num_locales =
+        model->locales() != nullptr ? model->locales()->Length() : 0;
     for (const DatetimeModelExtractor* extractor : *model->extractors()) {
+      if (extractor->locales()) {
+        for (int locale : *extractor->locales()) {
+          num_locales = std::max(num_locales, locale + 1);
+        }
+      }
+    }
+    extractor_rule_ids_.assign(num_locales * kNumDatetimeExtractorTypes, -1);
+
+    for (const DatetimeModelExtractor* extractor : *model->extractors()) {
+      if (extractor->extractor() < 0 ||
+          extractor->extractor() >= kNumDatetimeExtractorTypes) {
+        TC3_LOG(ERROR) << "Invalid datetime extractor type: "
+                       << extractor->extractor();
+        continue;
+      }
       std::unique_ptr<UniLib::RegexPattern> regex_pattern =
           UncompressMakeRegexPattern(
               unilib, extractor->pattern(), extractor->compressed_pattern(),
@@ -84,7 +102,11 @@ DatetimeParser::DatetimeParser(const DatetimeModel* model, const UniLib& unilib,
 
       if (extractor->locales()) {
         for (int locale : *extractor->locales()) {
-          type_and_locale_to_extractor_rule_[extractor->extractor()][locale] =
+          if (locale < 0) {
+            continue;
+          }
+          extractor_rule_ids_[locale * kNumDatetimeExtractorTypes +
+                              extractor->extractor()] =
               extractor_rules_.size() - 1;
         }
       }
@@ -110,6 +132,26 @@ DatetimeParser::DatetimeParser(const DatetimeModel* model, const UniLib& unilib,
   initialized_ = true;
 }
 
+DatetimeParser::ExecutedRules::ExecutedRules(int num_rules) {
+  const int num_words = (num_rules + 63) / 64;
+  if (num_words > kNumInlineWords) {
+    heap_words_.resize(num_words, 0);
+    words_ = heap_words_.data();
+  } else {
+    words_ = inline_words_;
+  }
+}
+
+bool DatetimeParser::ExecutedRules::Insert(int rule_id) {
+  uint64& word = words_[rule_id / 64];
+  const uint64 bit = static_cast<uint64>(1) << (rule_id % 64);
+  if (word & bit) {
+    return false;
+  }
+  word |= bit;
+  return true;
+}
+
 bool DatetimeParser::Parse(
     const std::string& input, const int64 reference_time_ms_utc,
     const std::string& reference_timezone, const std::string& locales,
@@ -124,8 +166,9 @@ bool DatetimeParser::FindSpansUsingLocales(
     const std::vector<int>& locale_ids, const UnicodeText& input,
     const int64 reference_time_ms_utc, const std::string& reference_timezone,
     ModeFlag mode, AnnotationUsecase annotation_usecase, bool anchor_start_end,
-    const std::string& reference_locale,
-    std::unordered_set<int>* executed_rules,
+    const std::string& reference_locale, TriggerFeatures trigger_features,
+    const AnchoredTextFeatures& anchored_features,
+    ExecutedRules* executed_rules, DatetimeExtractor* extractor,
     std::vector<DatetimeParseResultSpan>* found_spans) const {
   for (const int locale_id : locale_ids) {
     auto rules_it = locale_to_rules_.find(locale_id);
@@ -134,11 +177,6 @@ bool DatetimeParser::FindSpansUsingLocales(
     }
 
     for (const int rule_id : rules_it->second) {
-      // Skip rules that were already executed in previous locales.
-      if (executed_rules->find(rule_id) != executed_rules->end()) {
-        continue;
-      }
-
       if ((rules_[rule_id].pattern->enabled_annotation_usecases() &
            (1 << annotation_usecase)) == 0) {
         continue;
@@ -148,11 +186,26 @@ bool DatetimeParser::FindSpansUsingLocales(
         continue;
       }
 
-      executed_rules->insert(rule_id);
+      if (!ShouldTrigger(rules_[rule_id].pattern->trigger_features(),
+                         trigger_features)) {
+        continue;
+      }
+
+      if (anchor_start_end &&
+          !SatisfiesAnchoredMatchConstraints(
+              rules_[rule_id].pattern->anchored_match_constraints(),
+              anchored_features)) {
+        continue;
+      }
+
+      // Skip rules that were already executed in previous locales.
+      if (!executed_rules->Insert(rule_id)) {
+        continue;
+      }
 
       if (!ParseWithRule(rules_[rule_id], input, reference_time_ms_utc,
                          reference_timezone, reference_locale, locale_id,
-                         anchor_start_end, found_spans)) {
+                         anchor_start_end, extractor, found_spans)) {
         return false;
       }
     }
@@ -165,52 +218,72 @@ bool DatetimeParser::Parse(
     const std::string& reference_timezone, const std::string& locales,
     ModeFlag mode, AnnotationUsecase annotation_usecase, bool anchor_start_end,
     std::vector<DatetimeParseResultSpan>* results) const {
+  return Parse(input, reference_time_ms_utc, reference_timezone,
+               PrepareLocales(locales), mode, annotation_usecase,
+               anchor_start_end, results);
+}
+
+bool DatetimeParser::Parse(
+    const UnicodeText& input, const int64 reference_time_ms_utc,
+    const std::string& reference_timezone, const PreparedLocales& locales,
+    ModeFlag mode, AnnotationUsecase annotation_usecase, bool anchor_start_end,
+    std::vector<DatetimeParseResultSpan>* results) const {
   std::vector<DatetimeParseResultSpan> found_spans;
-  std::unordered_set<int> executed_rules;
-  std::string reference_locale;
-  const std::vector<int> requested_locales =
-      ParseAndExpandLocales(locales, &reference_locale);
-  if (!FindSpansUsingLocales(requested_locales, input, reference_time_ms_utc,
+  ExecutedRules executed_rules(rules_.size());
+  DatetimeExtractor extractor(unilib_, extractor_rules_, extractor_rule_ids_);
+  // The anchored features include the trigger features of the input.
+  AnchoredTextFeatures anchored_features;
+  TriggerFeatures trigger_features;
+  if (anchor_start_end) {
+    anchored_features = ComputeAnchoredTextFeatures(input);
+    trigger_features = anchored_features.features;
+  } else {
+    trigger_features = ComputeTriggerFeatures(input);
+  }
+  if (!FindSpansUsingLocales(locales.locale_ids, input, reference_time_ms_utc,
                              reference_timezone, mode, annotation_usecase,
-                             anchor_start_end, reference_locale,
-                             &executed_rules, &found_spans)) {
+                             anchor_start_end, locales.reference_locale,
+                             trigger_features, anchored_features,
+                             &executed_rules, &extractor, &found_spans)) {
     return false;
   }
 
-  std::vector<std::pair<DatetimeParseResultSpan, int>> indexed_found_spans;
-  indexed_found_spans.reserve(found_spans.size());
-  for (int i = 0; i < found_spans.size(); i++) {
-    indexed_found_spans.push_back({found_spans[i], i});
-  }
-
   // Resolve conflicts by always picking the longer span and breaking ties by
   // selecting the earlier entry in the list for a given locale.
-  std::sort(indexed_found_spans.begin(), indexed_found_spans.end(),
-            [](const std::pair<DatetimeParseResultSpan, int>& a,
-               const std::pair<DatetimeParseResultSpan, int>& b) {
-              if ((a.first.span.second - a.first.span.first) !=
-                  (b.first.span.second - b.first.span.first)) {
-                return (a.first.span.second - a.first.span.first) >
-                       (b.first.span.second - b.first.span.first);
-              } else {
-                return a.second < b.second;
-              }
-            });
-
-  found_spans.clear();
-  for (auto& span_index_pair : indexed_found_spans) {
-    found_spans.push_back(span_index_pair.first);
-  }
-
-  std::set<int, std::function<bool(int, int)>> chosen_indices_set(
-      [&found_spans](int a, int b) {
-        return found_spans[a].span.first < found_spans[b].span.first;
-      });
-  for (int i = 0; i < found_spans.size(); ++i) {
-    if (!DoesCandidateConflict(i, found_spans, chosen_indices_set)) {
-      chosen_indices_set.insert(i);
-      results->push_back(found_spans[i]);
+  std::vector<int> order(found_spans.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&found_spans](int a, int b) {
+    const int a_length =
+        found_spans[a].span.second - found_spans[a].span.first;
+    const int b_length =
+        found_spans[b].span.second - found_spans[b].span.first;
+    if (a_length != b_length) {
+      return a_length > b_length;
     }
+    return a < b;
+  });
+
+  // The chosen spans do not overlap, so sorted by their start they are sorted
+  // intervals in which a new span can only overlap its neighbors.
+  std::vector<CodepointSpan> chosen_spans;
+  chosen_spans.reserve(found_spans.size());
+  for (const int i : order) {
+    const CodepointSpan& span = found_spans[i].span;
+    const auto next = std::lower_bound(
+        chosen_spans.begin(), chosen_spans.end(), span,
+        [](const CodepointSpan& chosen, const CodepointSpan& span) {
+          return chosen.first < span.first;
+        });
+    if ((next != chosen_spans.end() && SpansOverlap(span, *next)) ||
+        (next != chosen_spans.begin() && SpansOverlap(span, *(next - 1)))) {
+      continue;
+    }
+    // Spans that start where a chosen span starts are returned but not
+    // tracked, like the previous set keyed by the span start did.
+    if (next == chosen_spans.end() || next->first != span.first) {
+      chosen_spans.insert(next, span);
+    }
+    results->push_back(std::move(found_spans[i]));
   }
 
   return true;
@@ -220,6 +293,7 @@ bool DatetimeParser::HandleParseMatch(
     const CompiledRule& rule, const UniLib::RegexMatcher& matcher,
     int64 reference_time_ms_utc, const std::string& reference_timezone,
     const std::string& reference_locale, int locale_id,
+    DatetimeExtractor* extractor,
     std::vector<DatetimeParseResultSpan>* result) const {
   int status = UniLib::RegexMatcher::kNoError;
   const int start = matcher.Start(&status);
@@ -235,7 +309,7 @@ bool DatetimeParser::HandleParseMatch(
   DatetimeParseResultSpan parse_result;
   std::vector<DatetimeParseResult> alternatives;
   if (!ExtractDatetime(rule, matcher, reference_time_ms_utc, reference_timezone,
-                       reference_locale, locale_id, &alternatives,
+                       reference_locale, locale_id, extractor, &alternatives,
                        &parse_result.span)) {
     return false;
   }
@@ -262,7 +336,8 @@ bool DatetimeParser::ParseWithRule(
     const CompiledRule& rule, const UnicodeText& input,
     const int64 reference_time_ms_utc, const std::string& reference_timezone,
     const std::string& reference_locale, const int locale_id,
-    bool anchor_start_end, std::vector<DatetimeParseResultSpan>* result) const {
+    bool anchor_start_end, DatetimeExtractor* extractor,
+    std::vector<DatetimeParseResultSpan>* result) const {
   std::unique_ptr<UniLib::RegexMatcher> matcher =
       rule.compiled_regex->Matcher(input);
   int status = UniLib::RegexMatcher::kNoError;
@@ -270,7 +345,7 @@ bool DatetimeParser::ParseWithRule(
     if (matcher->Matches(&status) && status == UniLib::RegexMatcher::kNoError) {
       if (!HandleParseMatch(rule, *matcher, reference_time_ms_utc,
                             reference_timezone, reference_locale, locale_id,
-                            result)) {
+                            extractor, result)) {
         return false;
       }
     }
@@ -278,7 +353,7 @@ bool DatetimeParser::ParseWithRule(
     while (matcher->Find(&status) && status == UniLib::RegexMatcher::kNoError) {
       if (!HandleParseMatch(rule, *matcher, reference_time_ms_utc,
                             reference_timezone, reference_locale, locale_id,
-                            result)) {
+                            extractor, result)) {
         return false;
       }
     }
@@ -286,16 +361,15 @@ bool DatetimeParser::ParseWithRule(
   return true;
 }
 
-std::vector<int> DatetimeParser::ParseAndExpandLocales(
-    const std::string& locales, std::string* reference_locale) const {
+DatetimeParser::PreparedLocales DatetimeParser::PrepareLocales(
+    const std::string& locales) const {
+  PreparedLocales prepared;
   std::vector<StringPiece> split_locales = strings::Split(locales, ',');
   if (!split_locales.empty()) {
-    *reference_locale = split_locales[0].ToString();
-  } else {
-    *reference_locale = "";
+    prepared.reference_locale = split_locales[0].ToString();
   }
 
-  std::vector<int> result;
+  std::vector<int>& result = prepared.locale_ids;
   for (const StringPiece& locale_str : split_locales) {
     auto locale_it = locale_string_to_id_.find(locale_str.ToString());
     if (locale_it != locale_string_to_id_.end()) {
@@ -342,7 +416,7 @@ std::vector<int> DatetimeParser::ParseAndExpandLocales(
     }
   }
 
-  return result;
+  return prepared;
 }
 
 void DatetimeParser::FillInterpretations(
@@ -392,13 +466,11 @@ bool DatetimeParser::ExtractDatetime(const CompiledRule& rule,
                                      const std::string& reference_timezone,
                                      const std::string& reference_locale,
                                      int locale_id,
+                                     DatetimeExtractor* extractor,
                                      std::vector<DatetimeParseResult>* results,
                                      CodepointSpan* result_span) const {
   DateParseData parse;
-  DatetimeExtractor extractor(rule, matcher, locale_id, unilib_,
-                              extractor_rules_,
-                              type_and_locale_to_extractor_rule_);
-  if (!extractor.Extract(&parse, result_span)) {
+  if (!extractor->Extract(rule, matcher, locale_id, &parse, result_span)) {
     return false;
   }
 
@@ -25,6 +25,7 @@
 
 #include "annotator/datetime/extractor.h"
 #include "annotator/model_generated.h"
+#include "annotator/trigger-features.h"
 #include "annotator/types.h"
 #include "utils/base/integral_types.h"
 #include "utils/calendar/calendar.h"
@@ -58,6 +59,27 @@ class DatetimeParser {
              bool anchor_start_end,
              std::vector<DatetimeParseResultSpan>* results) const;
 
+  // Locale spec string resolved to the locales of the model.
+  struct PreparedLocales {
+    // Ids of the requested locales, their fallbacks and the default locales,
+    // in the order in which their rules are run.
+    std::vector<int> locale_ids;
+
+    // The first requested locale.
+    std::string reference_locale;
+  };
+
+  // Resolves a locale spec string (comma-separated locale names), so that it
+  // can be reused across calls.
+  PreparedLocales PrepareLocales(const std::string& locales) const;
+
+  // Same as above but takes locales prepared with PrepareLocales().
+  bool Parse(const UnicodeText& input, int64 reference_time_ms_utc,
+             const std::string& reference_timezone,
+             const PreparedLocales& locales, ModeFlag mode,
+             AnnotationUsecase annotation_usecase, bool anchor_start_end,
+             std::vector<DatetimeParseResultSpan>* results) const;
+
 #ifdef TC3_TEST_ONLY
   void TestOnlySetGenerateAlternativeInterpretationsWhenAmbiguous(bool value) {
     generate_alternative_interpretations_when_ambiguous_ = value;
@@ -69,26 +91,44 @@ class DatetimeParser {
                  const CalendarLib& calendarlib,
                  ZlibDecompressor* decompressor);
 
-  // Returns a list of locale ids for given locale spec string (comma-separated
-  // locale names). Assigns the first parsed locale to reference_locale.
-  std::vector<int> ParseAndExpandLocales(const std::string& locales,
-                                         std::string* reference_locale) const;
+  // Set of the ids of the rules that were already run during a call. The bits
+  // are stored inline for the number of rules of typical models, so that it
+  // does not allocate.
+  class ExecutedRules {
+   public:
+    explicit ExecutedRules(int num_rules);
+
+    // Adds the rule, returns false if it was already present.
+    bool Insert(int rule_id);
+
+   private:
+    static constexpr int kNumInlineWords = 16;
+
+    uint64 inline_words_[kNumInlineWords] = {};
+    std::vector<uint64> heap_words_;
+    uint64* words_;
+  };
 
   // Helper function that finds datetime spans, only using the rules associated
-  // with the given locales.
+  // with the given locales and triggered by the features of the input. With
+  // 'anchor_start_end', rules whose anchored match constraints are not
+  // satisfied by 'anchored_features' are skipped too.
   bool FindSpansUsingLocales(
       const std::vector<int>& locale_ids, const UnicodeText& input,
       const int64 reference_time_ms_utc, const std::string& reference_timezone,
       ModeFlag mode, AnnotationUsecase annotation_usecase,
       bool anchor_start_end, const std::string& reference_locale,
-      std::unordered_set<int>* executed_rules,
+      TriggerFeatures trigger_features,
+      const AnchoredTextFeatures& anchored_features,
+      ExecutedRules* executed_rules,
+      DatetimeExtractor* extractor,
       std::vector<DatetimeParseResultSpan>* found_spans) const;
 
   bool ParseWithRule(const CompiledRule& rule, const UnicodeText& input,
                      int64 reference_time_ms_utc,
                      const std::string& reference_timezone,
                      const std::string& reference_locale, const int locale_id,
-                     bool anchor_start_end,
+                     bool anchor_start_end, DatetimeExtractor* extractor,
                      std::vector<DatetimeParseResultSpan>* result) const;
 
   void FillInterpretations(const DateParseData& parse,
@@ -100,6 +140,7 @@ class DatetimeParser {
                        int64 reference_time_ms_utc,
                        const std::string& reference_timezone,
                        const std::string& reference_locale, int locale_id,
+                       DatetimeExtractor* extractor,
                        std::vector<DatetimeParseResult>* results,
                        CodepointSpan* result_span) const;
 
@@ -109,6 +150,7 @@ class DatetimeParser {
                         int64 reference_time_ms_utc,
                         const std::string& reference_timezone,
                         const std::string& reference_locale, int locale_id,
+                        DatetimeExtractor* extractor,
                         std::vector<DatetimeParseResultSpan>* result) const;
 
  private:
@@ -118,8 +160,9 @@ class DatetimeParser {
   std::vector<CompiledRule> rules_;
   std::unordered_map<int, std::vector<int>> locale_to_rules_;
   std::vector<std::unique_ptr<const UniLib::RegexPattern>> extractor_rules_;
-  std::unordered_map<DatetimeExtractorType, std::unordered_map<int, int>>
-      type_and_locale_to_extractor_rule_;
+  // Extractor rule ids indexed by
+  // locale * kNumDatetimeExtractorTypes + type, -1 if there is no rule.
+  std::vector<int> extractor_rule_ids_;
   std::unordered_map<std::string, int> locale_string_to_id_;
   std::vector<int> default_locale_ids_;
   bool use_extractors_for_locating_;
@@ -27,6 +27,7 @@
 #include "annotator/datetime/parser.h"
 #include "annotator/model_generated.h"
 #include "annotator/types-test-util.h"
+#include "utils/testing/allocation-counter.h"
 #include "utils/testing/annotator.h"
 
 using testing::ElementsAreArray;
@@ -444,6 +445,109 @@ TEST_F(ParserTest, WhenAlternativesDisabledDoesNotGenerateAlternatives) {
                               GRANULARITY_MINUTE));
 }
 
+TEST_F(ParserTest, SkipsExtractorsOfInvalidType) {
+  LoadModel([](ModelT* model) {
+    for (const int extractor_type : {-1, kNumDatetimeExtractorTypes, 1000}) {
+      model->datetime_model->extractors.emplace_back(
+          new DatetimeModelExtractorT);
+      DatetimeModelExtractorT* extractor =
+          model->datetime_model->extractors.back().get();
+      extractor->extractor =
+          static_cast<DatetimeExtractorType>(extractor_type);
+      extractor->pattern = "invalid";
+      extractor->locales.push_back(0);
+      extractor->locales.push_back(1);
+    }
+  });
+
+  EXPECT_TRUE(ParsesCorrectly("{january 1 2018 at 4:30}", 1514777400000,
+                              GRANULARITY_MINUTE));
+}
+
+// Loose upper bound of the allocations of parsing kAllocationsText with the
+// test model. It is not a measurement: it catches per-codepoint allocations,
+// not a few more per call. Measure the test model to tighten it.
+constexpr int64 kParseAllocationBudget = 2000;
+constexpr char kAllocationsText[] =
+    "Let's meet on January 1, 1988 at 5pm, or on 09/Mar/2004 22:02:40.";
+// Words of kAllocationsText.
+constexpr int kAllocationsTextWords = 12;
+// Loose, unmeasured budget of the additional allocations per word of added
+// text, which covers the matches and the results found in it.
+constexpr int64 kParseAllocationsPerAddedWord = 16;
+
+TEST_F(ParserTest, ParseIsWithinAllocationBudget) {
+  const UnicodeText text = UTF8ToUnicodeText(kAllocationsText,
+                                             /*do_copy=*/false);
+  const DatetimeParser::PreparedLocales locales =
+      parser_->PrepareLocales("en-US");
+  std::vector<DatetimeParseResultSpan> results;
+  // Warm up, so that lazily initialized state is not counted.
+  ASSERT_TRUE(parser_->Parse(text, 0, "Europe/Zurich", locales,
+                             ModeFlag_ANNOTATION,
+                             AnnotationUsecase_ANNOTATION_USECASE_SMART,
+                             /*anchor_start_end=*/false, &results));
+  ASSERT_FALSE(results.empty());
+
+  results.clear();
+  ScopedAllocationCounter counter;
+  ASSERT_TRUE(parser_->Parse(text, 0, "Europe/Zurich", locales,
+                             ModeFlag_ANNOTATION,
+                             AnnotationUsecase_ANNOTATION_USECASE_SMART,
+                             /*anchor_start_end=*/false, &results));
+  EXPECT_LE(counter.num_allocations(), kParseAllocationBudget);
+}
+
+TEST_F(ParserTest, ParseAllocationsPerAddedWord) {
+  const DatetimeParser::PreparedLocales locales =
+      parser_->PrepareLocales("en-US");
+  auto parse_allocations = [this, &locales](const std::string& text_utf8) {
+    const UnicodeText text = UTF8ToUnicodeText(text_utf8, /*do_copy=*/false);
+    std::vector<DatetimeParseResultSpan> results;
+    // Warm up, so that lazily initialized state is not counted.
+    parser_->Parse(text, 0, "Europe/Zurich", locales, ModeFlag_ANNOTATION,
+                   AnnotationUsecase_ANNOTATION_USECASE_SMART,
+                   /*anchor_start_end=*/false, &results);
+    results.clear();
+    ScopedAllocationCounter counter;
+    parser_->Parse(text, 0, "Europe/Zurich", locales, ModeFlag_ANNOTATION,
+                   AnnotationUsecase_ANNOTATION_USECASE_SMART,
+                   /*anchor_start_end=*/false, &results);
+    return counter.num_allocations();
+  };
+
+  constexpr int kRepetitions = 4;
+  std::string repeated_text = kAllocationsText;
+  for (int i = 1; i < kRepetitions; ++i) {
+    repeated_text += " ";
+    repeated_text += kAllocationsText;
+  }
+  const int64 single = parse_allocations(kAllocationsText);
+  const int64 repeated = parse_allocations(repeated_text);
+  EXPECT_LE(repeated - single, kParseAllocationsPerAddedWord *
+                                   kAllocationsTextWords * (kRepetitions - 1));
+}
+
+TEST_F(ParserTest, RuleBookkeepingDoesNotAllocate) {
+  const UnicodeText text = UTF8ToUnicodeText(kAllocationsText,
+                                             /*do_copy=*/false);
+  const DatetimeParser::PreparedLocales locales =
+      parser_->PrepareLocales("en-US");
+  std::vector<DatetimeParseResultSpan> results;
+  ASSERT_TRUE(parser_->Parse(text, 0, "Europe/Zurich", locales, ModeFlag_NONE,
+                             AnnotationUsecase_ANNOTATION_USECASE_SMART,
+                             /*anchor_start_end=*/false, &results));
+
+  // No rule is enabled for the mode, so everything that is left is the
+  // bookkeeping of the executed rules and of the found spans.
+  ScopedAllocationCounter counter;
+  ASSERT_TRUE(parser_->Parse(text, 0, "Europe/Zurich", locales, ModeFlag_NONE,
+                             AnnotationUsecase_ANNOTATION_USECASE_SMART,
+                             /*anchor_start_end=*/false, &results));
+  EXPECT_EQ(counter.num_allocations(), 0);
+  EXPECT_TRUE(results.empty());
+}
+
 class ParserLocaleTest : public testing::Test {
  public:
   void SetUp() override;
@@ -534,5 +638,29 @@ TEST_F(ParserLocaleTest, SwissEnglish) {
   EXPECT_TRUE(HasResult("default", /*locales=*/"en-CH"));
 }
 
+TEST_F(ParserLocaleTest, PreparesLocalesWithFallbacks) {
+  const DatetimeParser::PreparedLocales locales =
+      parser_->PrepareLocales("en-CH,zh-Hant-TW");
+  EXPECT_EQ(locales.reference_locale, "en-CH");
+  EXPECT_THAT(locales.locale_ids, testing::ElementsAre(1, 5, 3, 4, 6));
+
+  EXPECT_TRUE(parser_->PrepareLocales("").reference_locale.empty());
+  EXPECT_THAT(parser_->PrepareLocales("").locale_ids, testing::ElementsAre(6));
+}
+
+TEST_F(ParserLocaleTest, ParsesWithPreparedLocales) {
+  const DatetimeParser::PreparedLocales locales =
+      parser_->PrepareLocales("en-CH");
+  for (const std::string input : {"en-CH", "all-CH", "en-all", "default"}) {
+    std::vector<DatetimeParseResultSpan> results;
+    EXPECT_TRUE(parser_->Parse(
+        UTF8ToUnicodeText(input, /*do_copy=*/false),
+        /*reference_time_ms_utc=*/0,
+        /*reference_timezone=*/"", locales, ModeFlag_ANNOTATION,
+        AnnotationUsecase_ANNOTATION_USECASE_SMART, false, &results));
+    EXPECT_EQ(results.size(), 1) << input;
+  }
+}
+
 }  // namespace
 }  // namespace libtextclassifier3
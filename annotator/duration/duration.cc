@@ -18,6 +18,7 @@
 
 #include <climits>
 #include <cstdlib>
+#include <cstring>
 
 #include "annotator/collections.h"
 #include "annotator/types.h"
@@ -25,55 +26,107 @@
 #include "utils/strings/numbers.h"
 
 namespace libtextclassifier3 {
+namespace {
+// Interned once, instead of for each duration found.
+const InternedString& kInternedDurationCollection =
+    *[]() { return new InternedString(Collections::Duration()); }();
+}  // namespace
 
 using DurationUnit = internal::DurationUnit;
+using internal::ParseQuantity;
 
 namespace internal {
 
 namespace {
-void FillDurationUnitMap(
+void AddDurationTokens(
     const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>*
         expressions,
-    DurationUnit duration_unit,
-    std::unordered_map<std::string, DurationUnit>* target_map) {
+    const DurationToken& duration_token, DurationTokenDictionary* dictionary) {
   if (expressions == nullptr) {
     return;
   }
 
   for (const flatbuffers::String* expression_string : *expressions) {
-    (*target_map)[expression_string->c_str()] = duration_unit;
+    const StringPiece expression(expression_string->c_str(),
+                                 expression_string->size());
+    DurationToken token = duration_token;
+    if (token.type != DurationToken::Type::HALF &&
+        ParseQuantity(expression, &token.value)) {
+      token.type = DurationToken::Type::QUANTITY;
+    }
+    (*dictionary)[expression] = token;
   }
 }
+
+DurationToken MakeDurationToken(DurationToken::Type type,
+                                DurationUnit unit = DurationUnit::UNKNOWN) {
+  DurationToken token;
+  token.type = type;
+  token.unit = unit;
+  return token;
+}
 }  // namespace
 
-std::unordered_map<std::string, DurationUnit> BuildTokenToDurationUnitMapping(
+DurationTokenDictionary BuildDurationTokenDictionary(
     const DurationAnnotatorOptions* options) {
-  std::unordered_map<std::string, DurationUnit> mapping;
-  FillDurationUnitMap(options->week_expressions(), DurationUnit::WEEK,
-                      &mapping);
-  FillDurationUnitMap(options->day_expressions(), DurationUnit::DAY, &mapping);
-  FillDurationUnitMap(options->hour_expressions(), DurationUnit::HOUR,
-                      &mapping);
-  FillDurationUnitMap(options->minute_expressions(), DurationUnit::MINUTE,
-                      &mapping);
-  FillDurationUnitMap(options->second_expressions(), DurationUnit::SECOND,
-                      &mapping);
-  return mapping;
+  // Added from the lowest to the highest precedence, later additions override
+  // the earlier ones.
+  DurationTokenDictionary dictionary;
+  AddDurationTokens(options->filler_expressions(),
+                    MakeDurationToken(DurationToken::Type::FILLER),
+                    &dictionary);
+  AddDurationTokens(
+      options->week_expressions(),
+      MakeDurationToken(DurationToken::Type::UNIT, DurationUnit::WEEK),
+      &dictionary);
+  AddDurationTokens(
+      options->day_expressions(),
+      MakeDurationToken(DurationToken::Type::UNIT, DurationUnit::DAY),
+      &dictionary);
+  AddDurationTokens(
+      options->hour_expressions(),
+      MakeDurationToken(DurationToken::Type::UNIT, DurationUnit::HOUR),
+      &dictionary);
+  AddDurationTokens(
+      options->minute_expressions(),
+      MakeDurationToken(DurationToken::Type::UNIT, DurationUnit::MINUTE),
+      &dictionary);
+  AddDurationTokens(
+      options->second_expressions(),
+      MakeDurationToken(DurationToken::Type::UNIT, DurationUnit::SECOND),
+      &dictionary);
+  AddDurationTokens(options->half_expressions(),
+                    MakeDurationToken(DurationToken::Type::HALF), &dictionary);
+  return dictionary;
 }
 
-std::unordered_set<std::string> BuildStringSet(
-    const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>*
-        strings) {
-  std::unordered_set<std::string> result;
-  if (strings == nullptr) {
-    return result;
+bool ParseQuantity(StringPiece value, int32* result) {
+  if (value.empty()) {
+    return false;
   }
 
-  for (const flatbuffers::String* string_value : *strings) {
-    result.insert(string_value->c_str());
+  // Numbers that fit into an int32 are short, so they are copied to the stack
+  // to be zero-terminated.
+  char buffer[32];
+  if (value.size() >= sizeof(buffer)) {
+    return ParseInt32(value.ToString().c_str(), result);
   }
+  memcpy(buffer, value.data(), value.size());
+  buffer[value.size()] = '\0';
+  return ParseInt32(buffer, result);
+}
 
-  return result;
+TriggerFeatures DurationTriggerFeatures(
+    const DurationTokenDictionary& dictionary) {
+  // A duration has a unit, so the text has all the features of one of the
+  // units. It thus has the features common to all of them.
+  TriggerFeatures features = kAllTriggerFeatures;
+  for (const auto& entry : dictionary) {
+    if (entry.second.type == DurationToken::Type::UNIT) {
+      features &= ComputeTriggerFeatures(entry.first);
+    }
+  }
+  return features;
 }
 
 }  // namespace internal
@@ -146,24 +199,34 @@ int DurationAnnotator::FindDurationStartingAt(const UnicodeText& context,
        token_index++) {
     const Token& token = tokens[token_index];
 
-    if (ParseQuantityToken(token, &parsed_duration)) {
-      has_quantity = true;
-      if (start_index == kInvalidIndex) {
-        start_index = token.start;
-      }
-      end_index = token.end;
-    } else if (ParseDurationUnitToken(token, &parsed_duration.unit)) {
-      if (start_index == kInvalidIndex) {
-        start_index = token.start;
-      }
-      end_index = token.end;
-      parsed_duration_atoms.push_back(parsed_duration);
-      has_quantity = false;
-      parsed_duration = ParsedDurationAtom();
-    } else if (ParseFillerToken(token)) {
-    } else {
+    internal::DurationToken duration_token;
+    if (!ParseToken(token, &duration_token)) {
       break;
     }
+
+    switch (duration_token.type) {
+      case internal::DurationToken::Type::QUANTITY:
+        parsed_duration.value = duration_token.value;
+        has_quantity = true;
+        break;
+      case internal::DurationToken::Type::HALF:
+        parsed_duration.plus_half = true;
+        has_quantity = true;
+        break;
+      case internal::DurationToken::Type::UNIT:
+        parsed_duration.unit = duration_token.unit;
+        parsed_duration_atoms.push_back(parsed_duration);
+        has_quantity = false;
+        parsed_duration = ParsedDurationAtom();
+        break;
+      case internal::DurationToken::Type::FILLER:
+        continue;
+    }
+
+    if (start_index == kInvalidIndex) {
+      start_index = token.start;
+    }
+    end_index = token.end;
   }
 
   if (parsed_duration_atoms.empty()) {
@@ -173,7 +236,7 @@ int DurationAnnotator::FindDurationStartingAt(const UnicodeText& context,
   const bool parse_ended_without_unit_for_last_mentioned_quantity =
       has_quantity;
 
-  ClassificationResult classification{Collections::Duration(),
+  ClassificationResult classification{kInternedDurationCollection,
                                       options_->score()};
   classification.priority_score = options_->priority_score();
   classification.duration_ms =
@@ -236,55 +299,23 @@ int64 DurationAnnotator::ParsedDurationAtomsToMillis(
   return result;
 }
 
-bool DurationAnnotator::ParseQuantityToken(const Token& token,
-                                           ParsedDurationAtom* value) const {
-  if (token.value.empty()) {
-    return false;
-  }
+bool DurationAnnotator::ParseToken(
+    const Token& token, internal::DurationToken* duration_token) const {
+  const StringPiece token_value =
+      feature_processor_->StripBoundaryCodepoints(StringPiece(token.value));
 
-  std::string token_value_buffer;
-  const std::string& token_value = feature_processor_->StripBoundaryCodepoints(
-      token.value, &token_value_buffer);
-
-  if (half_expressions_.find(token_value) != half_expressions_.end()) {
-    value->plus_half = true;
+  const auto it = token_dictionary_.find(token_value);
+  if (it != token_dictionary_.end()) {
+    *duration_token = it->second;
     return true;
   }
 
-  int32 parsed_value;
-  if (ParseInt32(token_value.c_str(), &parsed_value)) {
-    value->value = parsed_value;
+  if (ParseQuantity(token_value, &duration_token->value)) {
+    duration_token->type = internal::DurationToken::Type::QUANTITY;
     return true;
   }
 
   return false;
 }
 
-bool DurationAnnotator::ParseDurationUnitToken(
-    const Token& token, DurationUnit* duration_unit) const {
-  std::string token_value_buffer;
-  const std::string& token_value = feature_processor_->StripBoundaryCodepoints(
-      token.value, &token_value_buffer);
-
-  const auto it = token_value_to_duration_unit_.find(token_value);
-  if (it == token_value_to_duration_unit_.end()) {
-    return false;
-  }
-
-  *duration_unit = it->second;
-  return true;
-}
-
-bool DurationAnnotator::ParseFillerToken(const Token& token) const {
-  std::string token_value_buffer;
-  const std::string& token_value = feature_processor_->StripBoundaryCodepoints(
-      token.value, &token_value_buffer);
-
-  if (filler_expressions_.find(token_value) == filler_expressions_.end()) {
-    return false;
-  }
-
-  return true;
-}
-
 }  // namespace libtextclassifier3
@@ -19,12 +19,13 @@
 
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 #include "annotator/feature-processor.h"
 #include "annotator/model_generated.h"
+#include "annotator/trigger-features.h"
 #include "annotator/types.h"
+#include "utils/strings/stringpiece.h"
 #include "utils/utf8/unicodetext.h"
 
 namespace libtextclassifier3 {
@@ -44,13 +45,51 @@ enum class DurationUnit {
   // savings time and assume the day is always 24 hours.
 };
 
-// Prepares the mapping between token values and duration unit types.
-std::unordered_map<std::string, internal::DurationUnit>
-BuildTokenToDurationUnitMapping(const DurationAnnotatorOptions* options);
+// Role of a (stripped) token value in a duration expression.
+struct DurationToken {
+  enum class Type {
+    // A number, e.g. "3".
+    QUANTITY = 0,
 
-// Creates a set of strings from a flatbuffer string vector.
-std::unordered_set<std::string> BuildStringSet(
-    const flatbuffers::Vector<flatbuffers::Offset<flatbuffers::String>>*);
+    // A half expression, e.g. "half".
+    HALF = 1,
+
+    // A duration unit, e.g. "hours".
+    UNIT = 2,
+
+    // A filler word that can appear inside an expression, e.g. "and".
+    FILLER = 3
+  };
+
+  Type type = Type::FILLER;
+
+  // The unit, for UNIT tokens.
+  DurationUnit unit = DurationUnit::UNKNOWN;
+
+  // The parsed number, for QUANTITY tokens.
+  int32 value = 0;
+};
+
+// Mapping from token values to their roles in duration expressions. The keys
+// point into the model.
+typedef std::unordered_map<StringPiece, DurationToken, StringPieceHash,
+                           StringPieceEqual>
+    DurationTokenDictionary;
+
+// Prepares the mapping between the token values from the model and their
+// roles. If a value is listed more than once, half expressions take
+// precedence over numbers, numbers over units and units over fillers.
+DurationTokenDictionary BuildDurationTokenDictionary(
+    const DurationAnnotatorOptions* options);
+
+// Parses the value as a number, like ParseInt32 does for zero-terminated
+// strings.
+bool ParseQuantity(StringPiece value, int32* result);
+
+// Computes the trigger features that every text with a duration unit from the
+// dictionary has.
+TriggerFeatures DurationTriggerFeatures(
+    const DurationTokenDictionary& dictionary);
 
 }  // namespace internal
 
@@ -61,12 +100,9 @@ class DurationAnnotator {
                              const FeatureProcessor* feature_processor)
       : options_(options),
         feature_processor_(feature_processor),
-        token_value_to_duration_unit_(
-            internal::BuildTokenToDurationUnitMapping(options)),
-        filler_expressions_(
-            internal::BuildStringSet(options->filler_expressions())),
-        half_expressions_(
-            internal::BuildStringSet(options->half_expressions())) {}
+        token_dictionary_(internal::BuildDurationTokenDictionary(options)),
+        trigger_features_(
+            internal::DurationTriggerFeatures(token_dictionary_)) {}
 
   // Classifies given text, and if it is a duration, it passes the result in
   // 'classification_result' and returns true, otherwise returns false.
@@ -79,6 +115,10 @@ class DurationAnnotator {
                AnnotationUsecase annotation_usecase,
                std::vector<AnnotatedSpan>* results) const;
 
+  // Returns the trigger features of which every text with a duration has at
+  // least one.
+  TriggerFeatures trigger_features() const { return trigger_features_; }
+
  private:
   // Represents a component of duration parsed from text (e.g. "3 hours" from
   // the expression "3 hours and 20 minutes").
@@ -107,20 +147,18 @@ class DurationAnnotator {
                              int start_token_index,
                              AnnotatedSpan* result) const;
 
-  bool ParseQuantityToken(const Token& token, ParsedDurationAtom* value) const;
-  bool ParseDurationUnitToken(const Token& token,
-                              internal::DurationUnit* duration_unit) const;
-  bool ParseFillerToken(const Token& token) const;
+  // Normalizes the token once and looks up its role in a duration
+  // expression. Returns false if the token can't be part of one.
+  bool ParseToken(const Token& token,
+                  internal::DurationToken* duration_token) const;
 
   int64 ParsedDurationAtomsToMillis(
       const std::vector<ParsedDurationAtom>& atoms) const;
 
   const DurationAnnotatorOptions* options_;
   const FeatureProcessor* feature_processor_;
-  const std::unordered_map<std::string, internal::DurationUnit>
-      token_value_to_duration_unit_;
-  const std::unordered_set<std::string> filler_expressions_;
-  const std::unordered_set<std::string> half_expressions_;
+  const internal::DurationTokenDictionary token_dictionary_;
+  const TriggerFeatures trigger_features_;
 };
 
 }  // namespace libtextclassifier3
@@ -24,6 +24,7 @@
 #include "annotator/types-test-util.h"
 #include "annotator/types.h"
 #include "utils/test-utils.h"
+#include "utils/testing/allocation-counter.h"
 #include "utils/utf8/unicodetext.h"
 #include "utils/utf8/unilib.h"
 #include "gmock/gmock.h"
@@ -316,5 +317,56 @@ TEST_F(DurationAnnotatorTest, StripsPunctuationFromTokens) {
                                 10 * 60 * 1000 + 2 * 1000)))))));
 }
 
+TEST_F(DurationAnnotatorTest, DoesNotAllocatePerToken) {
+  const UnicodeText text = UTF8ToUnicodeText(
+      "See you ,tomorrow, at the usual place, and bring 2 ,friends, along");
+  std::vector<Token> tokens = Tokenize(text);
+  std::vector<AnnotatedSpan> result;
+
+  ScopedAllocationCounter allocation_counter;
+  EXPECT_TRUE(duration_annotator_.FindAll(
+      text, tokens, AnnotationUsecase_ANNOTATION_USECASE_RAW, &result));
+  EXPECT_EQ(allocation_counter.num_allocations(), 0);
+  EXPECT_TRUE(result.empty());
+}
+
+TEST(DurationTokenDictionaryTest, KeepsPrecedenceOfRoles) {
+  DurationAnnotatorOptionsT options;
+  options.filler_expressions.push_back("and");
+  options.filler_expressions.push_back("hour");
+  options.filler_expressions.push_back("7");
+  options.hour_expressions.push_back("hour");
+  options.hour_expressions.push_back("half");
+  options.half_expressions.push_back("half");
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(DurationAnnotatorOptions::Pack(builder, &options));
+  const internal::DurationTokenDictionary dictionary =
+      internal::BuildDurationTokenDictionary(
+          flatbuffers::GetRoot<DurationAnnotatorOptions>(
+              builder.GetBufferPointer()));
+
+  ASSERT_EQ(dictionary.size(), 4);
+  EXPECT_EQ(dictionary.at("and").type, internal::DurationToken::Type::FILLER);
+  EXPECT_EQ(dictionary.at("hour").type, internal::DurationToken::Type::UNIT);
+  EXPECT_EQ(dictionary.at("hour").unit, internal::DurationUnit::HOUR);
+  EXPECT_EQ(dictionary.at("half").type, internal::DurationToken::Type::HALF);
+  EXPECT_EQ(dictionary.at("7").type, internal::DurationToken::Type::QUANTITY);
+  EXPECT_EQ(dictionary.at("7").value, 7);
+}
+
+TEST_F(DurationAnnotatorTest, RequiresFeaturesOfUnits) {
+  EXPECT_EQ(duration_annotator_.trigger_features(),
+            1 << TriggerFeature_ASCII_LETTER);
+}
+
+TEST(DurationTokenDictionaryTest, ParsesQuantityFromView) {
+  const std::string text = "12 minutes";
+  int32 value;
+  EXPECT_TRUE(internal::ParseQuantity(StringPiece(text.data(), 2), &value));
+  EXPECT_EQ(value, 12);
+  EXPECT_FALSE(internal::ParseQuantity(StringPiece(text), &value));
+  EXPECT_FALSE(internal::ParseQuantity(StringPiece(), &value));
+}
+
 }  // namespace
 }  // namespace libtextclassifier3
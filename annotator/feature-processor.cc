@@ -16,8 +16,8 @@
 
 #include "annotator/feature-processor.h"
 
+#include <algorithm>
 #include <iterator>
-#include <set>
 #include <vector>
 
 #include "utils/base/logging.h"
@@ -147,32 +147,20 @@ void FeatureProcessor::StripTokensFromOtherLines(
 void FeatureProcessor::StripTokensFromOtherLines(
     const UnicodeText& context_unicode, CodepointSpan span,
     std::vector<Token>* tokens) const {
-  std::vector<UnicodeTextRange> lines = SplitContext(context_unicode);
+  std::vector<ContextLine> lines;
+  SplitContext(context_unicode, &lines);
 
-  auto span_start = context_unicode.begin();
-  if (span.first > 0) {
-    std::advance(span_start, span.first);
-  }
-  auto span_end = context_unicode.begin();
-  if (span.second > 0) {
-    std::advance(span_end, span.second);
-  }
-  for (const UnicodeTextRange& line : lines) {
+  const CodepointIndex span_start = std::max(span.first, 0);
+  const CodepointIndex span_end = std::max(span.second, 0);
+  for (const ContextLine& line : lines) {
     // Find the line that completely contains the span.
-    if (line.first <= span_start && line.second >= span_end) {
-      const CodepointIndex last_line_begin_index =
-          std::distance(context_unicode.begin(), line.first);
-      const CodepointIndex last_line_end_index =
-          last_line_begin_index + std::distance(line.first, line.second);
-
-      for (auto token = tokens->begin(); token != tokens->end();) {
-        if (token->start >= last_line_begin_index &&
-            token->end <= last_line_end_index) {
-          ++token;
-        } else {
-          token = tokens->erase(token);
-        }
-      }
+    if (line.span.first <= span_start && line.span.second >= span_end) {
+      tokens->erase(std::remove_if(tokens->begin(), tokens->end(),
+                                   [&line](const Token& token) {
+                                     return token.start < line.span.first ||
+                                            token.end > line.span.second;
+                                   }),
+                    tokens->end());
     }
   }
 }
@@ -197,6 +185,11 @@ std::vector<Token> FeatureProcessor::Tokenize(
   return tokenizer_.Tokenize(text_unicode);
 }
 
+void FeatureProcessor::Tokenize(const UnicodeText& text_unicode,
+                                std::vector<Token>* tokens) const {
+  tokenizer_.Tokenize(text_unicode, tokens);
+}
+
 bool FeatureProcessor::LabelToSpan(
     const int label, const VectorSpan<Token>& tokens,
     std::pair<CodepointIndex, CodepointIndex>* span) const {
@@ -476,11 +469,24 @@ bool FeatureProcessor::SelectionLabelSpans(
 void FeatureProcessor::PrepareIgnoredSpanBoundaryCodepoints() {
   if (options_->ignored_span_boundary_codepoints() != nullptr) {
     for (const int codepoint : *options_->ignored_span_boundary_codepoints()) {
-      ignored_span_boundary_codepoints_.insert(codepoint);
+      ignored_span_boundary_codepoints_.Add(codepoint);
     }
   }
 }
 
+bool FeatureProcessor::IsIgnoredSpanBoundaryToken(const Token& token) const {
+  if (token.value.empty()) {
+    return false;
+  }
+  const UnicodeText value = UTF8ToUnicodeText(token.value, /*do_copy=*/false);
+  for (const char32 codepoint : value) {
+    if (!ignored_span_boundary_codepoints_.Contains(codepoint)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 int FeatureProcessor::CountIgnoredSpanBoundaryCodepoints(
     const UnicodeText::const_iterator& span_start,
     const UnicodeText::const_iterator& span_end,
@@ -507,8 +513,7 @@ int FeatureProcessor::CountIgnoredSpanBoundaryCodepoints(
 
   // Move until we encounter a non-ignored character.
   int num_ignored = 0;
-  while (ignored_span_boundary_codepoints_.find(*it) !=
-         ignored_span_boundary_codepoints_.end()) {
+  while (ignored_span_boundary_codepoints_.Contains(*it)) {
     ++num_ignored;
 
     if (it == it_last) {
@@ -527,22 +532,31 @@ int FeatureProcessor::CountIgnoredSpanBoundaryCodepoints(
 
 namespace {
 
-void FindSubstrings(const UnicodeText& t, const std::set<char32>& codepoints,
-                    std::vector<UnicodeTextRange>* ranges) {
+// Codepoints that separate lines of the context.
+const CodepointSet& LineSeparatorCodepoints() {
+  static const CodepointSet* const codepoints = new CodepointSet{'\n', '|'};
+  return *codepoints;
+}
+
+void FindSubstrings(const UnicodeText& t, const CodepointSet& codepoints,
+                    std::vector<ContextLine>* lines) {
   UnicodeText::const_iterator start = t.begin();
   UnicodeText::const_iterator curr = start;
   UnicodeText::const_iterator end = t.end();
-  for (; curr != end; ++curr) {
-    if (codepoints.find(*curr) != codepoints.end()) {
+  CodepointIndex start_index = 0;
+  CodepointIndex curr_index = 0;
+  for (; curr != end; ++curr, ++curr_index) {
+    if (codepoints.Contains(*curr)) {
       if (start != curr) {
-        ranges->push_back(std::make_pair(start, curr));
+        lines->push_back({{start, curr}, {start_index, curr_index}});
       }
       start = curr;
       ++start;
+      start_index = curr_index + 1;
     }
   }
   if (start != end) {
-    ranges->push_back(std::make_pair(start, end));
+    lines->push_back({{start, end}, {start_index, curr_index}});
   }
 }
 
@@ -550,10 +564,20 @@ void FindSubstrings(const UnicodeText& t, const std::set<char32>& codepoints,
 
 std::vector<UnicodeTextRange> FeatureProcessor::SplitContext(
     const UnicodeText& context_unicode) const {
-  std::vector<UnicodeTextRange> lines;
-  const std::set<char32> codepoints{{'\n', '|'}};
-  FindSubstrings(context_unicode, codepoints, &lines);
-  return lines;
+  std::vector<ContextLine> lines;
+  SplitContext(context_unicode, &lines);
+  std::vector<UnicodeTextRange> ranges;
+  ranges.reserve(lines.size());
+  for (const ContextLine& line : lines) {
+    ranges.push_back(line.range);
+  }
+  return ranges;
+}
+
+void FeatureProcessor::SplitContext(const UnicodeText& context_unicode,
+                                    std::vector<ContextLine>* lines) const {
+  lines->clear();
+  FindSubstrings(context_unicode, LineSeparatorCodepoints(), lines);
 }
 
 CodepointSpan FeatureProcessor::StripBoundaryCodepoints(
@@ -604,7 +628,7 @@ float FeatureProcessor::SupportedCodepointsRatio(
     const UnicodeText value =
         UTF8ToUnicodeText(tokens[i].value, /*do_copy=*/false);
     for (auto codepoint : value) {
-      if (IsCodepointInRanges(codepoint, supported_codepoint_ranges_)) {
+      if (supported_codepoints_.Contains(codepoint)) {
         ++num_supported;
       }
       ++num_total;
@@ -615,21 +639,38 @@ float FeatureProcessor::SupportedCodepointsRatio(
 
 const std::string& FeatureProcessor::StripBoundaryCodepoints(
     const std::string& value, std::string* buffer) const {
-  const UnicodeText value_unicode = UTF8ToUnicodeText(value, /*do_copy=*/false);
-  const CodepointSpan initial_span{0, value_unicode.size_codepoints()};
-  const CodepointSpan stripped_span =
-      StripBoundaryCodepoints(value_unicode, initial_span);
-
-  if (initial_span != stripped_span) {
-    const UnicodeText stripped_token_value =
-        UnicodeText::Substring(value_unicode, stripped_span.first,
-                               stripped_span.second, /*do_copy=*/false);
-    *buffer = stripped_token_value.ToUTF8String();
+  const StringPiece stripped_value =
+      StripBoundaryCodepoints(StringPiece(value));
+  if (stripped_value.size() != value.size()) {
+    *buffer = stripped_value.ToString();
     return *buffer;
   }
   return value;
 }
 
+StringPiece FeatureProcessor::StripBoundaryCodepoints(StringPiece value) const {
+  if (value.empty() || ignored_span_boundary_codepoints_.empty()) {
+    return value;
+  }
+
+  const UnicodeText value_unicode =
+      UTF8ToUnicodeText(value.data(), value.size(), /*do_copy=*/false);
+  UnicodeText::const_iterator begin = value_unicode.begin();
+  UnicodeText::const_iterator end = value_unicode.end();
+  while (begin != end && ignored_span_boundary_codepoints_.Contains(*begin)) {
+    ++begin;
+  }
+  while (begin != end) {
+    UnicodeText::const_iterator last = end;
+    --last;
+    if (!ignored_span_boundary_codepoints_.Contains(*last)) {
+      break;
+    }
+    end = last;
+  }
+  return StringPiece(begin.utf8_data(), end.utf8_data() - begin.utf8_data());
+}
+
 int FeatureProcessor::CollectionToLabel(const std::string& collection) const {
   const auto it = collection_to_label_.find(collection);
   if (it == collection_to_label_.end()) {
@@ -639,9 +680,9 @@ int FeatureProcessor::CollectionToLabel(const std::string& collection) const {
   }
 }
 
-std::string FeatureProcessor::LabelToCollection(int label) const {
-  if (label >= 0 && label < collection_to_label_.size()) {
-    return (*options_->collections())[label]->str();
+InternedString FeatureProcessor::LabelToCollection(int label) const {
+  if (label >= 0 && label < label_to_collection_.size()) {
+    return label_to_collection_[label];
   } else {
     return GetDefaultCollection();
   }
@@ -651,6 +692,8 @@ void FeatureProcessor::MakeLabelMaps() {
   if (options_->collections() != nullptr) {
     for (int i = 0; i < options_->collections()->size(); ++i) {
       collection_to_label_[(*options_->collections())[i]->str()] = i;
+      label_to_collection_.emplace_back(
+          (*options_->collections())[i]->str());
     }
   }
 
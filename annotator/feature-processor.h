@@ -30,6 +30,9 @@
 #include "annotator/types.h"
 #include "utils/base/integral_types.h"
 #include "utils/base/logging.h"
+#include "utils/codepoint-set.h"
+#include "utils/strings/stringpiece.h"
+#include "utils/strings/interned-string.h"
 #include "utils/token-feature-extractor.h"
 #include "utils/tokenizer.h"
 #include "utils/utf8/unicodetext.h"
@@ -81,6 +84,13 @@ TokenSpan CodepointSpanToTokenSpan(
 CodepointSpan TokenSpanToCodepointSpan(
     const std::vector<Token>& selectable_tokens, TokenSpan token_span);
 
+// A line of a context, as a view into its buffer together with the codepoint
+// span of the line in the context.
+struct ContextLine {
+  UnicodeTextRange range;
+  CodepointSpan span;
+};
+
 // Takes care of preparing features for the span prediction model.
 class FeatureProcessor {
  public:
@@ -98,9 +108,10 @@ class FeatureProcessor {
         tokenizer_(internal::BuildTokenizer(options, unilib)) {
     MakeLabelMaps();
     if (options->supported_codepoint_ranges() != nullptr) {
-      SortCodepointRanges({options->supported_codepoint_ranges()->begin(),
-                           options->supported_codepoint_ranges()->end()},
-                          &supported_codepoint_ranges_);
+      for (const CodepointRange* range :
+           *options->supported_codepoint_ranges()) {
+        supported_codepoints_.AddRange(range->start(), range->end());
+      }
     }
     PrepareIgnoredSpanBoundaryCodepoints();
   }
@@ -111,14 +122,19 @@ class FeatureProcessor {
   // Same as above but takes UnicodeText.
   std::vector<Token> Tokenize(const UnicodeText& text_unicode) const;
 
+  // Same as above but writes the tokens to 'tokens', reusing its storage
+  // across calls.
+  void Tokenize(const UnicodeText& text_unicode,
+                std::vector<Token>* tokens) const;
+
   // Converts a label into a token span.
   bool LabelToTokenSpan(int label, TokenSpan* token_span) const;
 
   // Gets the total number of selection labels.
   int GetSelectionLabelCount() const { return label_to_selection_.size(); }
 
-  // Gets the string value for given collection label.
-  std::string LabelToCollection(int label) const;
+  // Gets the collection for given collection label.
+  InternedString LabelToCollection(int label) const;
 
   // Gets the total number of collections of the model.
   int NumCollections() const { return collection_to_label_.size(); }
@@ -167,10 +183,19 @@ class FeatureProcessor {
 
   int EmbeddingSize() const { return options_->embedding_size(); }
 
+  // Returns whether the token is non-empty and made only of codepoints that
+  // are stripped from span boundaries, e.g. punctuation.
+  bool IsIgnoredSpanBoundaryToken(const Token& token) const;
+
   // Splits context to several segments.
   std::vector<UnicodeTextRange> SplitContext(
       const UnicodeText& context_unicode) const;
 
+  // Same as above but writes the lines to 'lines', reusing its storage, and
+  // also returns their codepoint spans.
+  void SplitContext(const UnicodeText& context_unicode,
+                    std::vector<ContextLine>* lines) const;
+
   // Strips boundary codepoints from the span in context and returns the new
   // start and end indices. If the span comprises entirely of boundary
   // codepoints, the first index of span is returned for both indices.
@@ -192,6 +217,10 @@ class FeatureProcessor {
   const std::string& StripBoundaryCodepoints(const std::string& value,
                                              std::string* buffer) const;
 
+  // Same as above, but returns a view of the stripped part of 'value' and
+  // does not allocate.
+  StringPiece StripBoundaryCodepoints(StringPiece value) const;
+
  protected:
   // Returns the class id corresponding to the given string collection
   // identifier. There is a catch-all class id that the function returns for
@@ -264,14 +293,13 @@ class FeatureProcessor {
  protected:
   const TokenFeatureExtractor feature_extractor_;
 
-  // Codepoint ranges that define what codepoints are supported by the model.
-  // NOTE: Must be sorted.
-  std::vector<CodepointRangeStruct> supported_codepoint_ranges_;
+  // Codepoints that are supported by the model.
+  CodepointSet supported_codepoints_;
 
  private:
   // Set of codepoints that will be stripped from beginning and end of
   // predicted spans.
-  std::set<int32> ignored_span_boundary_codepoints_;
+  CodepointSet ignored_span_boundary_codepoints_;
 
   const FeatureProcessorOptions* const options_;
 
@@ -281,6 +309,7 @@ class FeatureProcessor {
 
   // Mapping between collections and labels.
   std::map<std::string, int> collection_to_label_;
+  std::vector<InternedString> label_to_collection_;
 
   Tokenizer tokenizer_;
 };
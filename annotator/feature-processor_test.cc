@@ -55,7 +55,7 @@ class TestingFeatureProcessor : public FeatureProcessor {
   using FeatureProcessor::FeatureProcessor;
   using FeatureProcessor::SpanToLabel;
   using FeatureProcessor::StripTokensFromOtherLines;
-  using FeatureProcessor::supported_codepoint_ranges_;
+  using FeatureProcessor::supported_codepoints_;
   using FeatureProcessor::SupportedCodepointsRatio;
 };
 
@@ -291,6 +291,40 @@ TEST_F(FeatureProcessorTest, KeepLineWithCrosslineClick) {
                            Token("Thiřd", 23, 28), Token("Lině", 29, 33)}));
 }
 
+TEST_F(FeatureProcessorTest, SplitContextReturnsLineSpans) {
+  FeatureProcessorOptionsT options;
+  flatbuffers::DetachedBuffer options_fb = PackFeatureProcessorOptions(options);
+  TestingFeatureProcessor feature_processor(
+      flatbuffers::GetRoot<FeatureProcessorOptions>(options_fb.data()),
+      &unilib_);
+
+  const std::string context_utf8 = "Fiřst Lině\n\nSěcond|Thiřd Lině\n";
+  const UnicodeText context =
+      UTF8ToUnicodeText(context_utf8, /*do_copy=*/false);
+  std::vector<ContextLine> lines;
+  feature_processor.SplitContext(context, &lines);
+
+  ASSERT_EQ(lines.size(), 3);
+  EXPECT_EQ(lines[0].span, CodepointSpan(0, 10));
+  EXPECT_EQ(UnicodeText::UTF8Substring(lines[0].range.first,
+                                       lines[0].range.second),
+            "Fiřst Lině");
+  EXPECT_EQ(lines[1].span, CodepointSpan(12, 18));
+  EXPECT_EQ(UnicodeText::UTF8Substring(lines[1].range.first,
+                                       lines[1].range.second),
+            "Sěcond");
+  EXPECT_EQ(lines[2].span, CodepointSpan(19, 29));
+  EXPECT_EQ(UnicodeText::UTF8Substring(lines[2].range.first,
+                                       lines[2].range.second),
+            "Thiřd Lině");
+
+  // The lines of a previous context are replaced.
+  feature_processor.SplitContext(
+      UTF8ToUnicodeText("One", /*do_copy=*/false), &lines);
+  ASSERT_EQ(lines.size(), 1);
+  EXPECT_EQ(lines[0].span, CodepointSpan(0, 3));
+}
+
 TEST_F(FeatureProcessorTest, SpanToLabel) {
   FeatureProcessorOptionsT options;
   options.context_size = 1;
@@ -562,24 +596,15 @@ TEST_F(FeatureProcessorTest, SupportedCodepointsRatio) {
   EXPECT_THAT(feature_processor.SupportedCodepointsRatio(
                   {0, 3}, feature_processor.Tokenize("ěěě řřř ěěě")),
               FloatEq(0.0));
-  EXPECT_FALSE(
-      IsCodepointInRanges(-1, feature_processor.supported_codepoint_ranges_));
-  EXPECT_TRUE(
-      IsCodepointInRanges(0, feature_processor.supported_codepoint_ranges_));
-  EXPECT_TRUE(
-      IsCodepointInRanges(10, feature_processor.supported_codepoint_ranges_));
-  EXPECT_TRUE(
-      IsCodepointInRanges(127, feature_processor.supported_codepoint_ranges_));
-  EXPECT_FALSE(
-      IsCodepointInRanges(128, feature_processor.supported_codepoint_ranges_));
-  EXPECT_FALSE(
-      IsCodepointInRanges(9999, feature_processor.supported_codepoint_ranges_));
-  EXPECT_TRUE(IsCodepointInRanges(
-      10000, feature_processor.supported_codepoint_ranges_));
-  EXPECT_FALSE(IsCodepointInRanges(
-      10001, feature_processor.supported_codepoint_ranges_));
-  EXPECT_TRUE(IsCodepointInRanges(
-      25000, feature_processor.supported_codepoint_ranges_));
+  EXPECT_FALSE(feature_processor.supported_codepoints_.Contains(-1));
+  EXPECT_TRUE(feature_processor.supported_codepoints_.Contains(0));
+  EXPECT_TRUE(feature_processor.supported_codepoints_.Contains(10));
+  EXPECT_TRUE(feature_processor.supported_codepoints_.Contains(127));
+  EXPECT_FALSE(feature_processor.supported_codepoints_.Contains(128));
+  EXPECT_FALSE(feature_processor.supported_codepoints_.Contains(9999));
+  EXPECT_TRUE(feature_processor.supported_codepoints_.Contains(10000));
+  EXPECT_FALSE(feature_processor.supported_codepoints_.Contains(10001));
+  EXPECT_TRUE(feature_processor.supported_codepoints_.Contains(25000));
 
   const std::vector<Token> tokens = {Token("ěěě", 0, 3), Token("řřř", 4, 7),
                                      Token("eee", 8, 11)};
@@ -939,6 +964,38 @@ TEST_F(FeatureProcessorTest, IgnoredSpanBoundaryCodepoints) {
   // Test stripping empty string.
   EXPECT_EQ(feature_processor.StripBoundaryCodepoints("", {0, 0}),
             std::make_pair(0, 0));
+
+  // Test stripping views of values.
+  EXPECT_EQ(feature_processor.StripBoundaryCodepoints(StringPiece("[Wořld].,"))
+                .ToString(),
+            "Wořld");
+  EXPECT_EQ(feature_processor.StripBoundaryCodepoints(StringPiece("ěščř"))
+                .ToString(),
+            "ěščř");
+  EXPECT_TRUE(
+      feature_processor.StripBoundaryCodepoints(StringPiece("[[]]")).empty());
+  EXPECT_TRUE(
+      feature_processor.StripBoundaryCodepoints(StringPiece("")).empty());
+}
+
+TEST_F(FeatureProcessorTest, IsIgnoredSpanBoundaryToken) {
+  FeatureProcessorOptionsT options;
+  options.ignored_span_boundary_codepoints.push_back('.');
+  options.ignored_span_boundary_codepoints.push_back(',');
+  options.ignored_span_boundary_codepoints.push_back('[');
+  options.ignored_span_boundary_codepoints.push_back(']');
+
+  flatbuffers::DetachedBuffer options_fb = PackFeatureProcessorOptions(options);
+  TestingFeatureProcessor feature_processor(
+      flatbuffers::GetRoot<FeatureProcessorOptions>(options_fb.data()),
+      &unilib_);
+
+  EXPECT_TRUE(feature_processor.IsIgnoredSpanBoundaryToken(Token(".", 0, 1)));
+  EXPECT_TRUE(feature_processor.IsIgnoredSpanBoundaryToken(Token("].,", 0, 3)));
+  EXPECT_FALSE(
+      feature_processor.IsIgnoredSpanBoundaryToken(Token("[ěšč]", 0, 5)));
+  EXPECT_FALSE(feature_processor.IsIgnoredSpanBoundaryToken(Token("!", 0, 1)));
+  EXPECT_FALSE(feature_processor.IsIgnoredSpanBoundaryToken(Token("", 0, 0)));
 }
 
 TEST_F(FeatureProcessorTest, CodepointSpanToTokenSpan) {
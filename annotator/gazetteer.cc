@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/gazetteer.h"
+
+#include <algorithm>
+
+namespace libtextclassifier3 {
+
+std::vector<Token> TokenizeForGazetteer(
+    const FeatureProcessor& feature_processor, const UniLib& unilib,
+    const UnicodeText& text) {
+  std::vector<Token> tokens = feature_processor.Tokenize(text);
+  std::string buffer;
+  int num_kept = 0;
+  for (int i = 0; i < tokens.size(); ++i) {
+    Token& token = tokens[i];
+    const std::string& stripped =
+        feature_processor.StripBoundaryCodepoints(token.value, &buffer);
+    if (stripped.empty()) {
+      continue;
+    }
+    UnicodeText normalized;
+    for (const char32 codepoint :
+         UTF8ToUnicodeText(stripped, /*do_copy=*/false)) {
+      normalized.push_back(unilib.ToLower(codepoint));
+    }
+    token.value = normalized.ToUTF8String();
+    // Moving a token onto itself would leave its value unspecified.
+    if (num_kept != i) {
+      tokens[num_kept] = std::move(token);
+    }
+    ++num_kept;
+  }
+  tokens.resize(num_kept);
+  return tokens;
+}
+
+std::vector<std::string> GazetteerPattern(
+    const FeatureProcessor& feature_processor, const UniLib& unilib,
+    const std::string& name) {
+  std::vector<std::string> pattern;
+  for (Token& token : TokenizeForGazetteer(
+           feature_processor, unilib,
+           UTF8ToUnicodeText(name, /*do_copy=*/false))) {
+    pattern.push_back(std::move(token.value));
+  }
+  return pattern;
+}
+
+Gazetteer::Gazetteer() { Clear(); }
+
+void Gazetteer::Clear() {
+  nodes_.clear();
+  nodes_.emplace_back();  // Root.
+  free_nodes_.clear();
+  edges_.clear();
+  token_ids_.clear();
+  tokens_.clear();
+  token_references_.clear();
+  free_token_ids_.clear();
+  num_patterns_by_length_.clear();
+  num_patterns_ = 0;
+}
+
+int Gazetteer::TokenId(const std::string& token) const {
+  const auto it = token_ids_.find(token);
+  return it != token_ids_.end() ? it->second : -1;
+}
+
+int Gazetteer::Child(int node, int token_id) const {
+  const auto it = edges_.find(EdgeKey(node, token_id));
+  return it != edges_.end() ? it->second : -1;
+}
+
+int Gazetteer::AllocateNode() {
+  if (!free_nodes_.empty()) {
+    const int node = free_nodes_.back();
+    free_nodes_.pop_back();
+    nodes_[node] = Node();
+    return node;
+  }
+  nodes_.emplace_back();
+  return nodes_.size() - 1;
+}
+
+int Gazetteer::AddTokenReference(const std::string& token) {
+  int token_id = TokenId(token);
+  if (token_id < 0) {
+    if (!free_token_ids_.empty()) {
+      token_id = free_token_ids_.back();
+      free_token_ids_.pop_back();
+      tokens_[token_id] = token;
+      token_references_[token_id] = 0;
+    } else {
+      token_id = tokens_.size();
+      tokens_.push_back(token);
+      token_references_.push_back(0);
+    }
+    token_ids_[token] = token_id;
+  }
+  ++token_references_[token_id];
+  return token_id;
+}
+
+void Gazetteer::RemoveTokenReference(int token_id) {
+  if (--token_references_[token_id] > 0) {
+    return;
+  }
+  token_ids_.erase(tokens_[token_id]);
+  tokens_[token_id].clear();
+  free_token_ids_.push_back(token_id);
+}
+
+bool Gazetteer::Add(const std::vector<std::string>& pattern, int value) {
+  if (pattern.empty()) {
+    return false;
+  }
+  int node = 0;
+  for (const std::string& token : pattern) {
+    const int token_id = TokenId(token);
+    const int child = token_id >= 0 ? Child(node, token_id) : -1;
+    if (child >= 0) {
+      node = child;
+      continue;
+    }
+    const int new_child = AllocateNode();
+    nodes_[new_child].parent = node;
+    nodes_[new_child].token_id = AddTokenReference(token);
+    edges_[EdgeKey(node, nodes_[new_child].token_id)] = new_child;
+    ++nodes_[node].num_children;
+    node = new_child;
+  }
+  if (nodes_[node].values.empty()) {
+    ++num_patterns_;
+    if (num_patterns_by_length_.size() <= pattern.size()) {
+      num_patterns_by_length_.resize(pattern.size() + 1, 0);
+    }
+    ++num_patterns_by_length_[pattern.size()];
+  }
+  nodes_[node].values.push_back(value);
+  return true;
+}
+
+bool Gazetteer::Remove(const std::vector<std::string>& pattern, int value) {
+  int node = 0;
+  for (const std::string& token : pattern) {
+    const int token_id = TokenId(token);
+    node = token_id >= 0 ? Child(node, token_id) : -1;
+    if (node < 0) {
+      return false;
+    }
+  }
+  std::vector<int>& values = nodes_[node].values;
+  const auto it = std::find(values.begin(), values.end(), value);
+  if (node == 0 || it == values.end()) {
+    return false;
+  }
+  values.erase(it);
+  if (!values.empty()) {
+    return true;
+  }
+  --num_patterns_;
+  --num_patterns_by_length_[pattern.size()];
+  while (num_patterns_by_length_.size() > 1 &&
+         num_patterns_by_length_.back() == 0) {
+    num_patterns_by_length_.pop_back();
+  }
+
+  // Prune the nodes that no longer lead to any pattern.
+  while (node != 0 && nodes_[node].values.empty() &&
+         nodes_[node].num_children == 0) {
+    const int parent = nodes_[node].parent;
+    edges_.erase(EdgeKey(parent, nodes_[node].token_id));
+    RemoveTokenReference(nodes_[node].token_id);
+    --nodes_[parent].num_children;
+    nodes_[node].values.shrink_to_fit();
+    free_nodes_.push_back(node);
+    node = parent;
+  }
+  return true;
+}
+
+void Gazetteer::FindAll(const std::vector<Token>& tokens,
+                        std::vector<Match>* matches) const {
+  if (num_patterns_ == 0) {
+    return;
+  }
+  const int max_length = num_patterns_by_length_.size() - 1;
+  std::vector<int> token_ids(tokens.size());
+  for (int i = 0; i < tokens.size(); ++i) {
+    token_ids[i] = TokenId(tokens[i].value);
+  }
+  for (int begin = 0; begin < token_ids.size(); ++begin) {
+    int node = 0;
+    const int end_limit = std::min<int>(token_ids.size(), begin + max_length);
+    for (int end = begin; end < end_limit && token_ids[end] >= 0; ++end) {
+      node = Child(node, token_ids[end]);
+      if (node < 0) {
+        break;
+      }
+      if (!nodes_[node].values.empty()) {
+        matches->push_back({{begin, end + 1}, &nodes_[node].values});
+      }
+    }
+  }
+}
+
+void Gazetteer::FindLongest(const std::vector<Token>& tokens,
+                            std::vector<Match>* matches) const {
+  std::vector<Match> all_matches;
+  FindAll(tokens, &all_matches);
+
+  // The matches are ordered by start and then end token, so the longest
+  // match of a start token is the last one.
+  int covered_until_token = 0;
+  for (int i = 0; i < all_matches.size(); ++i) {
+    const Match& match = all_matches[i];
+    if (match.token_span.first < covered_until_token ||
+        (i + 1 < all_matches.size() &&
+         all_matches[i + 1].token_span.first == match.token_span.first)) {
+      continue;
+    }
+    covered_until_token = match.token_span.second;
+    matches->push_back(match);
+  }
+}
+
+const std::vector<int>* Gazetteer::Find(
+    const std::vector<Token>& tokens) const {
+  if (tokens.empty()) {
+    return nullptr;
+  }
+  int node = 0;
+  for (const Token& token : tokens) {
+    const int token_id = TokenId(token.value);
+    node = token_id >= 0 ? Child(node, token_id) : -1;
+    if (node < 0) {
+      return nullptr;
+    }
+  }
+  return nodes_[node].values.empty() ? nullptr : &nodes_[node].values;
+}
+
+}  // namespace libtextclassifier3
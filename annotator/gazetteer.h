@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Multi-pattern matcher over token sequences, and the shared implementation of
+// the engines that find names in text with it (contacts, installed apps).
+
+#ifndef LIBTEXTCLASSIFIER_ANNOTATOR_GAZETTEER_H_
+#define LIBTEXTCLASSIFIER_ANNOTATOR_GAZETTEER_H_
+
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "annotator/feature-processor.h"
+#include "annotator/types.h"
+#include "utils/base/integral_types.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+
+namespace libtextclassifier3 {
+
+// Tokenizes the text with the feature processor's tokenizer and normalizes
+// the token values for matching: boundary codepoints (e.g. punctuation) are
+// stripped and the values are lower-cased. Tokens that consist only of
+// boundary codepoints are dropped. The token start and end indices refer to
+// the original, unstripped tokens.
+std::vector<Token> TokenizeForGazetteer(
+    const FeatureProcessor& feature_processor, const UniLib& unilib,
+    const UnicodeText& text);
+
+// Returns the normalized token values of a name, for adding to a Gazetteer.
+std::vector<std::string> GazetteerPattern(
+    const FeatureProcessor& feature_processor, const UniLib& unilib,
+    const std::string& name);
+
+// A trie over sequences of normalized tokens, mapping each sequence (pattern)
+// to a list of integer values. Patterns can be added and removed
+// incrementally, the memory used by a pattern is proportional to its length.
+// Finding all the matches in a text costs O(number of tokens * length of the
+// longest pattern) hash lookups, independently of the number of patterns.
+// NOTE: This class is not thread-safe.
+class Gazetteer {
+ public:
+  struct Match {
+    // Span of the matched tokens.
+    TokenSpan token_span;
+
+    // Values of the matched pattern. Valid until the gazetteer is modified.
+    const std::vector<int>* values;
+  };
+
+  Gazetteer();
+
+  // Adds 'value' for the pattern. Returns false if the pattern is empty.
+  bool Add(const std::vector<std::string>& pattern, int value);
+
+  // Removes 'value' from the pattern. Returns false if it was not present.
+  bool Remove(const std::vector<std::string>& pattern, int value);
+
+  // Removes all the patterns.
+  void Clear();
+
+  // Finds all occurrences of patterns in the normalized 'tokens', including
+  // overlapping ones, ordered by their start and then end token.
+  void FindAll(const std::vector<Token>& tokens,
+               std::vector<Match>* matches) const;
+
+  // Like FindAll, but of the overlapping matches only keeps the leftmost
+  // longest ones.
+  void FindLongest(const std::vector<Token>& tokens,
+                   std::vector<Match>* matches) const;
+
+  // Returns the values of the pattern equal to the whole of 'tokens', or
+  // nullptr if there is no such pattern.
+  const std::vector<int>* Find(const std::vector<Token>& tokens) const;
+
+  // Number of distinct patterns.
+  int size() const { return num_patterns_; }
+
+ private:
+  struct Node {
+    std::vector<int> values;
+    int parent = -1;
+    int token_id = -1;
+    int num_children = 0;
+  };
+
+  // Returns the id of the token, or -1 if it's not part of any pattern.
+  int TokenId(const std::string& token) const;
+
+  // Returns the child of 'node' for the token, or -1.
+  int Child(int node, int token_id) const;
+
+  static int64 EdgeKey(int node, int token_id) {
+    return (static_cast<int64>(node) << 32) | static_cast<uint32>(token_id);
+  }
+
+  int AllocateNode();
+  int AddTokenReference(const std::string& token);
+  void RemoveTokenReference(int token_id);
+
+  std::vector<Node> nodes_;
+  std::vector<int> free_nodes_;
+  std::unordered_map<int64, int> edges_;
+
+  // Interned tokens, with the number of pattern positions referencing them.
+  std::unordered_map<std::string, int> token_ids_;
+  std::vector<std::string> tokens_;
+  std::vector<int> token_references_;
+  std::vector<int> free_token_ids_;
+
+  // Number of patterns per length, to bound the matching.
+  std::vector<int> num_patterns_by_length_;
+  int num_patterns_ = 0;
+};
+
+// Finds entities, e.g. contacts or apps, in text by their names. Each entity
+// has a unique key and is found under the normalized token sequences of its
+// names. Entities can be added and removed without rebuilding the gazetteer.
+// 'Entity' is the payload that 'fill_result' turns into the classification
+// result of a match.
+// The engine is thread-safe: lookups can run concurrently with updates.
+template <typename Entity>
+class GazetteerEngine {
+ public:
+  typedef void (*FillResultFn)(const Entity& entity,
+                               ClassificationResult* result);
+
+  struct Entry {
+    std::string key;
+    Entity entity;
+    std::vector<std::string> names;
+  };
+
+  GazetteerEngine(const FeatureProcessor* feature_processor,
+                  const UniLib* unilib, FillResultFn fill_result)
+      : feature_processor_(feature_processor),
+        unilib_(*unilib),
+        fill_result_(fill_result) {}
+
+  // Adds the entries; an entry with the key of an existing entity replaces it.
+  // If 'replace_all' is true, all the existing entities are removed first.
+  // Lookups see either none or all of the changes.
+  void Add(const std::vector<Entry>& entries, bool replace_all);
+
+  // Removes the entity with the given key. Returns false if there was none.
+  bool Remove(const std::string& key);
+
+  // Classifies the selection if it is exactly one of the names of an entity.
+  bool ClassifyText(const std::string& context, CodepointSpan selection_indices,
+                    ClassificationResult* classification_result) const;
+
+  // Finds all the entity names in the context. The cost is linear in the
+  // length of the context, independently of the number of entities.
+  void Chunk(const UnicodeText& context_unicode,
+             std::vector<AnnotatedSpan>* result) const;
+
+ private:
+  struct IndexedEntity {
+    Entity entity;
+
+    // Normalized token sequences the entity is found under.
+    std::vector<std::vector<std::string>> patterns;
+  };
+
+  // Removes the entity with the given key, with the mutex held for writing.
+  bool RemoveLocked(const std::string& key);
+
+  const FeatureProcessor* feature_processor_;
+  const UniLib& unilib_;
+  const FillResultFn fill_result_;
+
+  mutable std::shared_timed_mutex mutex_;
+
+  // Entities by their index in the gazetteer values. Removed entities leave a
+  // hole that is reused by the next added entity.
+  std::vector<IndexedEntity> entities_;
+  std::vector<int> free_entity_indices_;
+  std::unordered_map<std::string, int> entity_index_by_key_;
+
+  Gazetteer gazetteer_;
+};
+
+template <typename Entity>
+void GazetteerEngine<Entity>::Add(const std::vector<Entry>& entries,
+                                  bool replace_all) {
+  // Normalize the names before taking the lock, so that lookups are only
+  // blocked for the updates of the gazetteer.
+  std::vector<std::vector<std::vector<std::string>>> entry_patterns(
+      entries.size());
+  for (int i = 0; i < entries.size(); ++i) {
+    for (const std::string& name : entries[i].names) {
+      std::vector<std::string> pattern =
+          GazetteerPattern(*feature_processor_, unilib_, name);
+      if (pattern.empty() ||
+          std::find(entry_patterns[i].begin(), entry_patterns[i].end(),
+                    pattern) != entry_patterns[i].end()) {
+        continue;
+      }
+      entry_patterns[i].push_back(std::move(pattern));
+    }
+  }
+
+  std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+  if (replace_all) {
+    entities_.clear();
+    free_entity_indices_.clear();
+    entity_index_by_key_.clear();
+    gazetteer_.Clear();
+  }
+  for (int i = 0; i < entries.size(); ++i) {
+    RemoveLocked(entries[i].key);
+
+    int index;
+    if (!free_entity_indices_.empty()) {
+      index = free_entity_indices_.back();
+      free_entity_indices_.pop_back();
+    } else {
+      index = entities_.size();
+      entities_.emplace_back();
+    }
+    for (const std::vector<std::string>& pattern : entry_patterns[i]) {
+      gazetteer_.Add(pattern, index);
+    }
+    entities_[index].entity = entries[i].entity;
+    entities_[index].patterns = std::move(entry_patterns[i]);
+    entity_index_by_key_[entries[i].key] = index;
+  }
+}
+
+template <typename Entity>
+bool GazetteerEngine<Entity>::Remove(const std::string& key) {
+  std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+  return RemoveLocked(key);
+}
+
+template <typename Entity>
+bool GazetteerEngine<Entity>::RemoveLocked(const std::string& key) {
+  const auto it = entity_index_by_key_.find(key);
+  if (it == entity_index_by_key_.end()) {
+    return false;
+  }
+  const int index = it->second;
+  for (const std::vector<std::string>& pattern : entities_[index].patterns) {
+    gazetteer_.Remove(pattern, index);
+  }
+  entities_[index] = IndexedEntity();
+  free_entity_indices_.push_back(index);
+  entity_index_by_key_.erase(it);
+  return true;
+}
+
+template <typename Entity>
+bool GazetteerEngine<Entity>::ClassifyText(
+    const std::string& context, CodepointSpan selection_indices,
+    ClassificationResult* classification_result) const {
+  const UnicodeText context_unicode =
+      UTF8ToUnicodeText(context, /*do_copy=*/false);
+  const UnicodeText selection = UnicodeText::Substring(
+      context_unicode, selection_indices.first, selection_indices.second,
+      /*do_copy=*/false);
+  const std::vector<Token> tokens =
+      TokenizeForGazetteer(*feature_processor_, unilib_, selection);
+
+  std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+  const std::vector<int>* entity_indices = gazetteer_.Find(tokens);
+  if (entity_indices == nullptr) {
+    return false;
+  }
+  fill_result_(entities_[entity_indices->front()].entity,
+               classification_result);
+  return true;
+}
+
+template <typename Entity>
+void GazetteerEngine<Entity>::Chunk(const UnicodeText& context_unicode,
+                                    std::vector<AnnotatedSpan>* result) const {
+  const std::vector<Token> context_tokens =
+      TokenizeForGazetteer(*feature_processor_, unilib_, context_unicode);
+
+  std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+  std::vector<Gazetteer::Match> matches;
+  gazetteer_.FindLongest(context_tokens, &matches);
+  for (const Gazetteer::Match& match : matches) {
+    AnnotatedSpan annotated_span;
+    annotated_span.span = feature_processor_->StripBoundaryCodepoints(
+        context_unicode, {context_tokens[match.token_span.first].start,
+                          context_tokens[match.token_span.second - 1].end});
+    for (const int entity_index : *match.values) {
+      ClassificationResult classification;
+      fill_result_(entities_[entity_index].entity, &classification);
+      annotated_span.classification.push_back(std::move(classification));
+    }
+    result->push_back(std::move(annotated_span));
+  }
+}
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_ANNOTATOR_GAZETTEER_H_
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/gazetteer.h"
+
+#include "annotator/model_generated.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+std::vector<Token> Tokens(const std::vector<std::string>& values) {
+  std::vector<Token> tokens;
+  int start = 0;
+  for (const std::string& value : values) {
+    tokens.push_back(Token(value, start, start + 1));
+    ++start;
+  }
+  return tokens;
+}
+
+std::vector<std::pair<TokenSpan, std::vector<int>>> FindAll(
+    const Gazetteer& gazetteer, const std::vector<std::string>& text) {
+  std::vector<Gazetteer::Match> matches;
+  gazetteer.FindAll(Tokens(text), &matches);
+  std::vector<std::pair<TokenSpan, std::vector<int>>> result;
+  for (const Gazetteer::Match& match : matches) {
+    result.push_back({match.token_span, *match.values});
+  }
+  return result;
+}
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+using testing::Pair;
+
+TEST(GazetteerTest, FindsAllPatterns) {
+  Gazetteer gazetteer;
+  EXPECT_TRUE(gazetteer.Add({"john"}, 0));
+  EXPECT_TRUE(gazetteer.Add({"john", "doe"}, 1));
+  EXPECT_TRUE(gazetteer.Add({"doe"}, 2));
+  EXPECT_FALSE(gazetteer.Add({}, 3));
+  EXPECT_EQ(gazetteer.size(), 3);
+
+  EXPECT_THAT(FindAll(gazetteer, {"call", "john", "doe", "now"}),
+              ElementsAre(Pair(TokenSpan{1, 2}, ElementsAre(0)),
+                          Pair(TokenSpan{1, 3}, ElementsAre(1)),
+                          Pair(TokenSpan{2, 3}, ElementsAre(2))));
+  EXPECT_THAT(FindAll(gazetteer, {"johnny", "doe"}),
+              ElementsAre(Pair(TokenSpan{1, 2}, ElementsAre(2))));
+  EXPECT_THAT(FindAll(gazetteer, {}), IsEmpty());
+}
+
+TEST(GazetteerTest, FindsLongestPatterns) {
+  Gazetteer gazetteer;
+  gazetteer.Add({"google"}, 0);
+  gazetteer.Add({"google", "maps"}, 1);
+  gazetteer.Add({"maps", "go"}, 2);
+  gazetteer.Add({"go"}, 3);
+
+  std::vector<Gazetteer::Match> matches;
+  gazetteer.FindLongest(Tokens({"open", "google", "maps", "go", "go"}),
+                        &matches);
+  ASSERT_EQ(matches.size(), 3);
+  EXPECT_EQ(matches[0].token_span, TokenSpan(1, 3));
+  EXPECT_EQ(matches[1].token_span, TokenSpan(3, 4));
+  EXPECT_EQ(matches[2].token_span, TokenSpan(4, 5));
+}
+
+TEST(GazetteerTest, KeepsAllValuesOfPattern) {
+  Gazetteer gazetteer;
+  gazetteer.Add({"john"}, 0);
+  gazetteer.Add({"john"}, 1);
+  EXPECT_EQ(gazetteer.size(), 1);
+  EXPECT_THAT(*gazetteer.Find(Tokens({"john"})), ElementsAre(0, 1));
+
+  EXPECT_TRUE(gazetteer.Remove({"john"}, 0));
+  EXPECT_THAT(*gazetteer.Find(Tokens({"john"})), ElementsAre(1));
+}
+
+TEST(GazetteerTest, RemovesPatterns) {
+  Gazetteer gazetteer;
+  gazetteer.Add({"john", "doe"}, 0);
+  gazetteer.Add({"john"}, 1);
+
+  EXPECT_FALSE(gazetteer.Remove({"john", "doe"}, 1));
+  EXPECT_FALSE(gazetteer.Remove({"jane"}, 0));
+  EXPECT_TRUE(gazetteer.Remove({"john", "doe"}, 0));
+  EXPECT_FALSE(gazetteer.Remove({"john", "doe"}, 0));
+  EXPECT_EQ(gazetteer.size(), 1);
+  EXPECT_EQ(gazetteer.Find(Tokens({"john", "doe"})), nullptr);
+  EXPECT_THAT(FindAll(gazetteer, {"john", "doe"}),
+              ElementsAre(Pair(TokenSpan{0, 1}, ElementsAre(1))));
+
+  // Removed nodes and tokens are reused.
+  gazetteer.Add({"jane", "roe"}, 2);
+  EXPECT_THAT(FindAll(gazetteer, {"jane", "roe"}),
+              ElementsAre(Pair(TokenSpan{0, 2}, ElementsAre(2))));
+
+  gazetteer.Clear();
+  EXPECT_EQ(gazetteer.size(), 0);
+  EXPECT_THAT(FindAll(gazetteer, {"john"}), IsEmpty());
+}
+
+TEST(GazetteerTest, FindsExactPattern) {
+  Gazetteer gazetteer;
+  gazetteer.Add({"john", "doe"}, 0);
+  EXPECT_THAT(*gazetteer.Find(Tokens({"john", "doe"})), ElementsAre(0));
+  EXPECT_EQ(gazetteer.Find(Tokens({"john"})), nullptr);
+  EXPECT_EQ(gazetteer.Find(Tokens({"john", "doe", "jr"})), nullptr);
+  EXPECT_EQ(gazetteer.Find(Tokens({})), nullptr);
+}
+
+TEST(GazetteerTest, TokenizesAndNormalizesText) {
+  FeatureProcessorOptionsT options;
+  options.tokenization_codepoint_config.emplace_back(
+      new TokenizationCodepointRangeT());
+  auto& config = options.tokenization_codepoint_config.back();
+  config->start = 32;
+  config->end = 33;
+  config->role = TokenizationCodepointRange_::Role_WHITESPACE_SEPARATOR;
+  options.ignored_span_boundary_codepoints.push_back('!');
+
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(CreateFeatureProcessorOptions(builder, &options));
+  flatbuffers::DetachedBuffer options_buffer = builder.Release();
+  UniLib INIT_UNILIB_FOR_TESTING(unilib);
+  const FeatureProcessor feature_processor(
+      flatbuffers::GetRoot<FeatureProcessorOptions>(options_buffer.data()),
+      &unilib);
+
+  // The leading tokens are kept in place, their values must survive.
+  const UnicodeText text =
+      UTF8ToUnicodeText("Hi John ! Doe!", /*do_copy=*/false);
+  EXPECT_THAT(TokenizeForGazetteer(feature_processor, unilib, text),
+              ElementsAre(Token("hi", 0, 2), Token("john", 3, 7),
+                          Token("doe", 10, 14)));
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/installed_app/installed-app-engine-gazetteer.h"
+
+#include "annotator/collections.h"
+#include "annotator/installed_app/installed-app-engine_generated.h"
+#include "utils/base/logging.h"
+#include "utils/flatbuffers.h"
+
+namespace libtextclassifier3 {
+namespace {
+// Interned once, instead of for each matched app.
+const InternedString& kInternedAppCollection =
+    *[]() { return new InternedString(Collections::App()); }();
+}  // namespace
+
+void InstalledAppEngine::FillAppResult(const AppResultData& app,
+                                       ClassificationResult* result) {
+  *result = ClassificationResult(kInternedAppCollection, /*arg_score=*/1.0);
+  *result->mutable_app() = app;
+}
+
+bool InstalledAppEngine::ParseApps(
+    const std::string& serialized_config,
+    std::vector<GazetteerEngine<AppResultData>::Entry>* entries) const {
+  const InstalledAppEngineConfig* config =
+      LoadAndVerifyFlatbuffer<InstalledAppEngineConfig>(serialized_config);
+  if (config == nullptr) {
+    TC3_LOG(ERROR) << "Could not load the installed app engine config.";
+    return false;
+  }
+  if (config->apps() == nullptr) {
+    return true;
+  }
+
+  for (const InstalledAppEngineConfig_::App* config_app : *config->apps()) {
+    if (config_app->package_name() == nullptr) {
+      TC3_LOG(ERROR) << "App without package name.";
+      return false;
+    }
+    entries->emplace_back();
+    GazetteerEngine<AppResultData>::Entry& entry = entries->back();
+    AppResultData& app = entry.entity;
+    app.package_name = config_app->package_name()->str();
+    if (config_app->name() != nullptr) {
+      app.name = config_app->name()->str();
+    }
+    entry.key = app.package_name;
+    entry.names = {app.name};
+    if (config_app->aliases() != nullptr) {
+      for (const flatbuffers::String* alias : *config_app->aliases()) {
+        entry.names.push_back(alias->str());
+      }
+    }
+  }
+  return true;
+}
+
+bool InstalledAppEngine::Initialize(const std::string& serialized_config) {
+  if (feature_processor_ == nullptr) {
+    TC3_LOG(ERROR) << "No feature processor for the installed app engine.";
+    return false;
+  }
+  std::vector<GazetteerEngine<AppResultData>::Entry> entries;
+  if (!ParseApps(serialized_config, &entries)) {
+    return false;
+  }
+  engine_.Add(entries, /*replace_all=*/true);
+  return true;
+}
+
+bool InstalledAppEngine::AddApps(const std::string& serialized_config) {
+  if (feature_processor_ == nullptr) {
+    return false;
+  }
+  std::vector<GazetteerEngine<AppResultData>::Entry> entries;
+  if (!ParseApps(serialized_config, &entries)) {
+    return false;
+  }
+  engine_.Add(entries, /*replace_all=*/false);
+  return true;
+}
+
+bool InstalledAppEngine::RemoveApp(const std::string& package_name) {
+  return engine_.Remove(package_name);
+}
+
+bool InstalledAppEngine::ClassifyText(
+    const std::string& context, CodepointSpan selection_indices,
+    ClassificationResult* classification_result) const {
+  if (feature_processor_ == nullptr) {
+    return false;
+  }
+  return engine_.ClassifyText(context, selection_indices,
+                              classification_result);
+}
+
+bool InstalledAppEngine::Chunk(const UnicodeText& context_unicode,
+                               const std::vector<Token>& tokens,
+                               std::vector<AnnotatedSpan>* result) const {
+  if (feature_processor_ == nullptr) {
+    return true;
+  }
+  engine_.Chunk(context_unicode, result);
+  return true;
+}
+
+}  // namespace libtextclassifier3
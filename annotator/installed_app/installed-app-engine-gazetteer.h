@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBTEXTCLASSIFIER_ANNOTATOR_INSTALLED_APP_INSTALLED_APP_ENGINE_GAZETTEER_H_
+#define LIBTEXTCLASSIFIER_ANNOTATOR_INSTALLED_APP_INSTALLED_APP_ENGINE_GAZETTEER_H_
+
+#include <string>
+#include <vector>
+
+#include "annotator/feature-processor.h"
+#include "annotator/gazetteer.h"
+#include "annotator/types.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+
+namespace libtextclassifier3 {
+
+// Finds mentions of the installed apps in text by matching their case-folded
+// labels against a gazetteer. Apps can be added and removed as they are
+// installed and uninstalled, without rebuilding the gazetteer.
+// The engine is thread-safe: lookups can run concurrently with updates.
+class InstalledAppEngine {
+ public:
+  explicit InstalledAppEngine(const FeatureProcessor* feature_processor,
+                              const UniLib* unilib)
+      : feature_processor_(feature_processor),
+        engine_(feature_processor, unilib, &FillAppResult) {}
+
+  // Initializes the engine with the apps from a serialized
+  // InstalledAppEngineConfig flatbuffer, replacing any previous apps.
+  bool Initialize(const std::string& serialized_config);
+
+  // Adds the apps from a serialized InstalledAppEngineConfig flatbuffer. An
+  // app with the package name of an existing one replaces it.
+  bool AddApps(const std::string& serialized_config);
+
+  // Removes the app with the given package name. Returns false if there was
+  // none.
+  bool RemoveApp(const std::string& package_name);
+
+  // Classifies the selection as an app if it is exactly one of its names.
+  bool ClassifyText(const std::string& context, CodepointSpan selection_indices,
+                    ClassificationResult* classification_result) const;
+
+  // Finds all the app mentions in the context in a single pass.
+  // NOTE: The context is tokenized by the engine itself, the passed tokens
+  // are not used, as they need not cover the whole context.
+  bool Chunk(const UnicodeText& context_unicode,
+             const std::vector<Token>& tokens,
+             std::vector<AnnotatedSpan>* result) const;
+
+ private:
+  static void FillAppResult(const AppResultData& app,
+                            ClassificationResult* result);
+
+  // Parses the apps of a serialized InstalledAppEngineConfig flatbuffer.
+  bool ParseApps(
+      const std::string& serialized_config,
+      std::vector<GazetteerEngine<AppResultData>::Entry>* entries) const;
+
+  const FeatureProcessor* feature_processor_;
+  GazetteerEngine<AppResultData> engine_;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_ANNOTATOR_INSTALLED_APP_INSTALLED_APP_ENGINE_GAZETTEER_H_
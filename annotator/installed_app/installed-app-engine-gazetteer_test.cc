@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/installed_app/installed-app-engine-gazetteer.h"
+
+#include "annotator/collections.h"
+#include "annotator/installed_app/installed-app-engine_generated.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+std::string PackApps(const std::vector<std::vector<std::string>>& apps) {
+  InstalledAppEngineConfigT config;
+  for (const std::vector<std::string>& fields : apps) {
+    config.apps.emplace_back(new InstalledAppEngineConfig_::AppT());
+    InstalledAppEngineConfig_::AppT* app = config.apps.back().get();
+    app->package_name = fields[0];
+    app->name = fields[1];
+    for (int i = 2; i < fields.size(); ++i) {
+      app->aliases.push_back(fields[i]);
+    }
+  }
+  flatbuffers::FlatBufferBuilder builder;
+  FinishInstalledAppEngineConfigBuffer(
+      builder, InstalledAppEngineConfig::Pack(builder, &config));
+  return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+                     builder.GetSize());
+}
+
+class InstalledAppEngineTest : public ::testing::Test {
+ protected:
+  InstalledAppEngineTest() : INIT_UNILIB_FOR_TESTING(unilib_) {
+    FeatureProcessorOptionsT options;
+    options.tokenization_codepoint_config.emplace_back(
+        new TokenizationCodepointRangeT());
+    auto& config = options.tokenization_codepoint_config.back();
+    config->start = 32;
+    config->end = 33;
+    config->role = TokenizationCodepointRange_::Role_WHITESPACE_SEPARATOR;
+    options.ignored_span_boundary_codepoints.push_back('.');
+    options.ignored_span_boundary_codepoints.push_back(',');
+
+    flatbuffers::FlatBufferBuilder builder;
+    builder.Finish(CreateFeatureProcessorOptions(builder, &options));
+    options_buffer_ = builder.Release();
+    feature_processor_.reset(new FeatureProcessor(
+        flatbuffers::GetRoot<FeatureProcessorOptions>(options_buffer_.data()),
+        &unilib_));
+  }
+
+  std::vector<std::pair<CodepointSpan, std::string>> Chunk(
+      const InstalledAppEngine& engine, const std::string& text) {
+    std::vector<AnnotatedSpan> spans;
+    EXPECT_TRUE(engine.Chunk(UTF8ToUnicodeText(text, /*do_copy=*/false),
+                             /*tokens=*/{}, &spans));
+    std::vector<std::pair<CodepointSpan, std::string>> result;
+    for (const AnnotatedSpan& span : spans) {
+      EXPECT_EQ(span.classification[0].collection, Collections::App());
+      result.push_back(
+          {span.span, span.classification[0].app()->package_name});
+    }
+    return result;
+  }
+
+  UniLib unilib_;
+  flatbuffers::DetachedBuffer options_buffer_;
+  std::unique_ptr<FeatureProcessor> feature_processor_;
+};
+
+TEST_F(InstalledAppEngineTest, FindsAppsInText) {
+  InstalledAppEngine engine(feature_processor_.get(), &unilib_);
+  ASSERT_TRUE(engine.Initialize(
+      PackApps({{"com.google.android.apps.maps", "Google Maps", "Maps"},
+                {"com.android.chrome", "Chrome"}})));
+
+  EXPECT_THAT(
+      Chunk(engine, "Open google maps, then CHROME."),
+      ElementsAre(std::make_pair(CodepointSpan{5, 16},
+                                 std::string("com.google.android.apps.maps")),
+                  std::make_pair(CodepointSpan{23, 29},
+                                 std::string("com.android.chrome"))));
+  EXPECT_THAT(Chunk(engine, "Chromecast"), IsEmpty());
+}
+
+TEST_F(InstalledAppEngineTest, ClassifiesApp) {
+  InstalledAppEngine engine(feature_processor_.get(), &unilib_);
+  ASSERT_TRUE(engine.Initialize(PackApps({{"com.android.chrome", "Chrome"}})));
+
+  ClassificationResult result;
+  EXPECT_TRUE(engine.ClassifyText("Open Chrome", {5, 11}, &result));
+  EXPECT_EQ(result.collection, Collections::App());
+  EXPECT_EQ(result.app()->name, "Chrome");
+  EXPECT_EQ(result.app()->package_name, "com.android.chrome");
+  EXPECT_FALSE(engine.ClassifyText("Open Chrome", {0, 11}, &result));
+}
+
+TEST_F(InstalledAppEngineTest, UpdatesAppsIncrementally) {
+  InstalledAppEngine engine(feature_processor_.get(), &unilib_);
+  ASSERT_TRUE(engine.Initialize(PackApps({{"com.android.chrome", "Chrome"}})));
+
+  ASSERT_TRUE(engine.AddApps(PackApps({{"com.example.notes", "Notes"}})));
+  EXPECT_THAT(Chunk(engine, "Chrome or Notes"),
+              ElementsAre(std::make_pair(CodepointSpan{0, 6},
+                                         std::string("com.android.chrome")),
+                          std::make_pair(CodepointSpan{10, 15},
+                                         std::string("com.example.notes"))));
+
+  EXPECT_TRUE(engine.RemoveApp("com.android.chrome"));
+  EXPECT_FALSE(engine.RemoveApp("com.android.chrome"));
+  EXPECT_THAT(Chunk(engine, "Chrome or Notes"),
+              ElementsAre(std::make_pair(CodepointSpan{10, 15},
+                                         std::string("com.example.notes"))));
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
@@ -17,6 +17,6 @@
 #ifndef LIBTEXTCLASSIFIER_ANNOTATOR_INSTALLED_APP_INSTALLED_APP_ENGINE_H_
 #define LIBTEXTCLASSIFIER_ANNOTATOR_INSTALLED_APP_INSTALLED_APP_ENGINE_H_
 
-#include "annotator/installed_app/installed-app-engine-dummy.h"
+#include "annotator/installed_app/installed-app-engine-gazetteer.h"
 
 #endif  // LIBTEXTCLASSIFIER_ANNOTATOR_INSTALLED_APP_INSTALLED_APP_ENGINE_H_
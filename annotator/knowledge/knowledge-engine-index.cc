@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/knowledge/knowledge-engine-index.h"
+
+#include <cctype>
+#include <cstring>
+
+#include "annotator/collections.h"
+#include "utils/base/logging.h"
+#include "utils/flatbuffers.h"
+#include "utils/hash/farmhash.h"
+#include "utils/sentencepiece/double_array_trie.h"
+#include "utils/sentencepiece/sorted_strings_table.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+// Whether the byte separates words. Only ASCII whitespace and punctuation are
+// considered, bytes of multi-byte UTF8 sequences never separate words.
+bool IsWordSeparator(char c) {
+  return c == ' ' ||
+         (c > ' ' && c < 0x7f && !std::isalnum(static_cast<unsigned char>(c)));
+}
+
+// Collection of all the entity results.
+const InternedString& kInternedEntityCollection =
+    *[]() { return new InternedString(Collections::Entity()); }();
+
+}  // namespace
+
+std::string NormalizeForKnowledgeIndex(
+    const UniLib& unilib, const UnicodeText& text,
+    std::vector<int>* codepoint_index_by_byte) {
+  UnicodeText normalized;
+  if (codepoint_index_by_byte != nullptr) {
+    codepoint_index_by_byte->clear();
+  }
+  int codepoint_index = 0;
+  bool previous_is_whitespace = false;
+  for (const char32 codepoint : text) {
+    const bool is_whitespace = unilib.IsWhitespace(codepoint);
+    if (!is_whitespace || !previous_is_whitespace) {
+      const int size_before = normalized.size_bytes();
+      normalized.push_back(is_whitespace ? ' ' : unilib.ToLower(codepoint));
+      if (codepoint_index_by_byte != nullptr) {
+        codepoint_index_by_byte->insert(
+            codepoint_index_by_byte->end(),
+            normalized.size_bytes() - size_before, codepoint_index);
+      }
+    }
+    previous_is_whitespace = is_whitespace;
+    ++codepoint_index;
+  }
+  if (codepoint_index_by_byte != nullptr) {
+    codepoint_index_by_byte->push_back(codepoint_index);
+  }
+  return normalized.ToUTF8String();
+}
+
+bool KnowledgeEngine::Initialize(const std::string& serialized_config) {
+  const KnowledgeEngineConfig* config =
+      LoadAndVerifyFlatbuffer<KnowledgeEngineConfig>(serialized_config);
+  if (config == nullptr) {
+    TC3_LOG(ERROR) << "Could not load the knowledge engine config.";
+    return false;
+  }
+  min_score_ = config->min_score();
+
+  // The previous index, if any, becomes invalid with its mapping.
+  index_ = nullptr;
+  matcher_.reset();
+  if (config->index_path() != nullptr) {
+    mmap_.reset(new ScopedMmap(config->index_path()->str()));
+  } else if (config->index_fd() >= 0) {
+    mmap_.reset(new ScopedMmap(config->index_fd(), config->index_offset(),
+                               config->index_size()));
+  } else {
+    TC3_LOG(ERROR) << "No knowledge index given.";
+    return false;
+  }
+  if (!mmap_->handle().ok()) {
+    TC3_LOG(ERROR) << "Could not map the knowledge index.";
+    return false;
+  }
+
+  // As the index only contains scalar vectors, verifying it does not depend
+  // on the number of entities.
+  const KnowledgeIndex* index = LoadAndVerifyFlatbuffer<KnowledgeIndex>(
+      mmap_->handle().start(), mmap_->handle().num_bytes());
+  if (index == nullptr || index->surface_forms() == nullptr ||
+      index->surface_form_entities() == nullptr ||
+      index->entity_ids() == nullptr ||
+      index->entity_ids_offsets() == nullptr ||
+      index->entity_scores() == nullptr ||
+      index->entity_payloads() == nullptr ||
+      index->entity_payloads_offsets() == nullptr ||
+      index->entity_id_hash_table() == nullptr ||
+      index->entity_id_hash_table()->size() == 0) {
+    TC3_LOG(ERROR) << "Invalid knowledge index.";
+    return false;
+  }
+  const int num_entities = index->entity_scores()->size();
+  if (index->entity_ids_offsets()->size() != num_entities + 1 ||
+      index->entity_payloads_offsets()->size() != num_entities + 1) {
+    TC3_LOG(ERROR) << "Inconsistent knowledge index entity tables.";
+    return false;
+  }
+
+  switch (index->matcher_type()) {
+    case KnowledgeIndexMatcherType_MAPPED_TRIE:
+      matcher_.reset(new DoubleArrayTrie(
+          reinterpret_cast<const TrieNode*>(index->surface_forms()->data()),
+          index->surface_forms()->size() / sizeof(TrieNode)));
+      break;
+    case KnowledgeIndexMatcherType_SORTED_STRING_TABLE:
+      if (index->surface_forms_offsets() == nullptr ||
+          index->surface_forms_offsets()->size() !=
+              index->surface_form_entities()->size()) {
+        TC3_LOG(ERROR) << "Invalid knowledge index surface forms.";
+        return false;
+      }
+      matcher_.reset(new SortedStringsTable(
+          index->surface_forms_offsets()->size(),
+          index->surface_forms_offsets()->data(),
+          StringPiece(index->surface_forms()->data(),
+                      index->surface_forms()->size())));
+      break;
+    default:
+      TC3_LOG(ERROR) << "Unknown knowledge index matcher type.";
+      return false;
+  }
+  index_ = index;
+  return true;
+}
+
+StringPiece KnowledgeEngine::EntityId(int entity) const {
+  const uint32 begin = index_->entity_ids_offsets()->Get(entity);
+  const uint32 end = index_->entity_ids_offsets()->Get(entity + 1);
+  if (begin > end || end > index_->entity_ids()->size()) {
+    return StringPiece();
+  }
+  return StringPiece(index_->entity_ids()->data() + begin, end - begin);
+}
+
+StringPiece KnowledgeEngine::EntityPayload(int entity) const {
+  const uint32 begin = index_->entity_payloads_offsets()->Get(entity);
+  const uint32 end = index_->entity_payloads_offsets()->Get(entity + 1);
+  if (begin > end || end > index_->entity_payloads()->size()) {
+    return StringPiece();
+  }
+  return StringPiece(index_->entity_payloads()->data() + begin, end - begin);
+}
+
+void KnowledgeEngine::FillClassificationResult(
+    int entity, ClassificationResult* result) const {
+  *result = ClassificationResult(kInternedEntityCollection,
+                                 index_->entity_scores()->Get(entity));
+  result->set_serialized_knowledge_result(EntityPayload(entity).ToString());
+}
+
+int KnowledgeEngine::MatchSurfaceForm(StringPiece text, bool prefix_only,
+                                      int* match_length) const {
+  std::vector<TrieMatch> matches;
+  if (!matcher_->FindAllPrefixMatches(text, &matches)) {
+    return -1;
+  }
+
+  // The matches are ordered by length, take the longest valid one.
+  const int num_entities = index_->entity_scores()->size();
+  for (auto it = matches.rbegin(); it != matches.rend(); ++it) {
+    if (it->match_length < text.size() &&
+        (!prefix_only || !IsWordSeparator(text[it->match_length]))) {
+      continue;
+    }
+    if (it->id < 0 || it->id >= index_->surface_form_entities()->size()) {
+      continue;
+    }
+    const int entity = index_->surface_form_entities()->Get(it->id);
+    if (entity >= num_entities ||
+        index_->entity_scores()->Get(entity) < min_score_) {
+      continue;
+    }
+    *match_length = it->match_length;
+    return entity;
+  }
+  return -1;
+}
+
+bool KnowledgeEngine::ClassifyText(
+    const std::string& context, CodepointSpan selection_indices,
+    ClassificationResult* classification_result) const {
+  if (index_ == nullptr) {
+    return false;
+  }
+  const UnicodeText context_unicode =
+      UTF8ToUnicodeText(context, /*do_copy=*/false);
+  const std::string selection = NormalizeForKnowledgeIndex(
+      unilib_, UnicodeText::Substring(context_unicode, selection_indices.first,
+                                      selection_indices.second,
+                                      /*do_copy=*/false));
+  int match_length;
+  const int entity =
+      MatchSurfaceForm(selection, /*prefix_only=*/false, &match_length);
+  if (entity < 0) {
+    return false;
+  }
+  FillClassificationResult(entity, classification_result);
+  return true;
+}
+
+bool KnowledgeEngine::Chunk(const std::string& context,
+                            std::vector<AnnotatedSpan>* result) const {
+  if (index_ == nullptr) {
+    return true;
+  }
+  std::vector<int> codepoint_index_by_byte;
+  const std::string normalized = NormalizeForKnowledgeIndex(
+      unilib_, UTF8ToUnicodeText(context, /*do_copy=*/false),
+      &codepoint_index_by_byte);
+
+  int position = 0;
+  while (position < normalized.size()) {
+    // Only try to match at word starts.
+    if (IsWordSeparator(normalized[position]) ||
+        (position > 0 && !IsWordSeparator(normalized[position - 1]))) {
+      ++position;
+      continue;
+    }
+    int match_length;
+    const int entity = MatchSurfaceForm(
+        StringPiece(normalized.data() + position, normalized.size() - position),
+        /*prefix_only=*/true, &match_length);
+    if (entity < 0) {
+      ++position;
+      continue;
+    }
+    AnnotatedSpan annotated_span;
+    annotated_span.span = {codepoint_index_by_byte[position],
+                           codepoint_index_by_byte[position + match_length]};
+    annotated_span.classification.emplace_back();
+    FillClassificationResult(entity, &annotated_span.classification.back());
+    annotated_span.source = AnnotatedSpan::Source::KNOWLEDGE;
+    result->push_back(std::move(annotated_span));
+    position += match_length;
+  }
+  return true;
+}
+
+bool KnowledgeEngine::LookUpEntity(
+    const std::string& id, std::string* serialized_knowledge_result) const {
+  if (index_ == nullptr) {
+    return false;
+  }
+  const flatbuffers::Vector<uint32>* hash_table =
+      index_->entity_id_hash_table();
+  const int num_entities = index_->entity_scores()->size();
+  const uint32 num_buckets = hash_table->size();
+  uint32 bucket = tc3farmhash::Fingerprint32(id.data(), id.size()) %
+                  num_buckets;
+  for (uint32 i = 0; i < num_buckets; ++i) {
+    const uint32 value = hash_table->Get(bucket);
+    if (value == 0) {
+      return false;
+    }
+    const int entity = value - 1;
+    if (entity < num_entities) {
+      const StringPiece entity_id = EntityId(entity);
+      if (entity_id.size() == id.size() &&
+          std::memcmp(entity_id.data(), id.data(), id.size()) == 0) {
+        *serialized_knowledge_result = EntityPayload(entity).ToString();
+        return true;
+      }
+    }
+    bucket = (bucket + 1) % num_buckets;
+  }
+  return false;
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBTEXTCLASSIFIER_ANNOTATOR_KNOWLEDGE_KNOWLEDGE_ENGINE_INDEX_H_
+#define LIBTEXTCLASSIFIER_ANNOTATOR_KNOWLEDGE_KNOWLEDGE_ENGINE_INDEX_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "annotator/knowledge/knowledge-engine_generated.h"
+#include "annotator/types.h"
+#include "utils/memory/mmap.h"
+#include "utils/sentencepiece/matcher.h"
+#include "utils/strings/stringpiece.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+
+namespace libtextclassifier3 {
+
+// Normalizes text for matching against the surface forms of a knowledge
+// index: lower-cases it and collapses whitespace runs into a single space.
+// If 'codepoint_index_by_byte' is not null, it receives for each byte of the
+// result, plus one past the end, the index of the input codepoint it stems
+// from.
+std::string NormalizeForKnowledgeIndex(
+    const UniLib& unilib, const UnicodeText& text,
+    std::vector<int>* codepoint_index_by_byte = nullptr);
+
+// Knowledge engine backed by a memory mapped KnowledgeIndex flatbuffer. The
+// index is not loaded to the heap: opening it takes constant time and the
+// lookups read the mapped pages directly. Mentions are found in a single pass
+// over the text by matching the surface forms at word starts, entities are
+// looked up by id through a hash table in O(1).
+class KnowledgeEngine {
+ public:
+  explicit KnowledgeEngine(const UniLib* unilib) : unilib_(*unilib) {}
+
+  // Initializes the engine from a serialized KnowledgeEngineConfig.
+  bool Initialize(const std::string& serialized_config);
+
+  bool ClassifyText(const std::string& context, CodepointSpan selection_indices,
+                    ClassificationResult* classification_result) const;
+
+  bool Chunk(const std::string& context,
+             std::vector<AnnotatedSpan>* result) const;
+
+  bool LookUpEntity(const std::string& id,
+                    std::string* serialized_knowledge_result) const;
+
+ private:
+  // Returns the entity index of the surface form that equals or, if
+  // 'prefix_only' is set, is the longest prefix of 'text' ending at a word
+  // boundary, or -1 if there is none. Sets 'match_length' to its length.
+  int MatchSurfaceForm(StringPiece text, bool prefix_only,
+                       int* match_length) const;
+
+  void FillClassificationResult(int entity,
+                                ClassificationResult* result) const;
+
+  StringPiece EntityId(int entity) const;
+  StringPiece EntityPayload(int entity) const;
+
+  const UniLib& unilib_;
+  std::unique_ptr<ScopedMmap> mmap_;
+  const KnowledgeIndex* index_ = nullptr;
+  std::unique_ptr<SentencePieceMatcher> matcher_;
+  float min_score_ = 0.0;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_ANNOTATOR_KNOWLEDGE_KNOWLEDGE_ENGINE_INDEX_H_
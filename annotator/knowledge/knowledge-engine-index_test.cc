@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/knowledge/knowledge-engine-index.h"
+
+#include <fstream>
+
+#include "annotator/collections.h"
+#include "annotator/knowledge/knowledge-index-builder.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+class KnowledgeEngineTest : public ::testing::Test {
+ protected:
+  KnowledgeEngineTest() : INIT_UNILIB_FOR_TESTING(unilib_) {}
+
+  // Builds an index over the entities and initializes the engine with it.
+  bool InitializeEngine(const std::vector<KnowledgeIndexEntity>& entities,
+                        float min_score, KnowledgeEngine* engine) {
+    std::string serialized_index;
+    if (!BuildKnowledgeIndex(unilib_, entities, &serialized_index)) {
+      return false;
+    }
+    const std::string index_path =
+        testing::TempDir() + "/knowledge_engine_test_index.fb";
+    std::ofstream(index_path, std::ios::binary) << serialized_index;
+
+    KnowledgeEngineConfigT config;
+    config.index_path = index_path;
+    config.min_score = min_score;
+    flatbuffers::FlatBufferBuilder builder;
+    builder.Finish(KnowledgeEngineConfig::Pack(builder, &config));
+    return engine->Initialize(
+        std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+                    builder.GetSize()));
+  }
+
+  std::vector<KnowledgeIndexEntity> TestEntities() {
+    std::vector<KnowledgeIndexEntity> entities(3);
+    entities[0].id = "/m/02j81";
+    entities[0].score = 0.9;
+    entities[0].serialized_knowledge_result = "eiffel";
+    entities[0].surface_forms = {"Eiffel Tower", "La Tour Eiffel"};
+    entities[1].id = "/m/05qtj";
+    entities[1].score = 0.8;
+    entities[1].serialized_knowledge_result = "paris";
+    entities[1].surface_forms = {"Paris"};
+    entities[2].id = "/m/0f8l9c";
+    entities[2].score = 0.2;
+    entities[2].serialized_knowledge_result = "france";
+    entities[2].surface_forms = {"France"};
+    return entities;
+  }
+
+  UniLib unilib_;
+};
+
+TEST_F(KnowledgeEngineTest, FindsEntitiesInText) {
+  KnowledgeEngine engine(&unilib_);
+  ASSERT_TRUE(InitializeEngine(TestEntities(), /*min_score=*/0.5, &engine));
+
+  std::vector<AnnotatedSpan> result;
+  ASSERT_TRUE(engine.Chunk(
+      "The  EIFFEL tower is in Paris, France. Parisian eiffel towers.",
+      &result));
+  ASSERT_EQ(result.size(), 2);
+  EXPECT_EQ(result[0].span, CodepointSpan(5, 17));
+  EXPECT_EQ(result[0].source, AnnotatedSpan::Source::KNOWLEDGE);
+  EXPECT_EQ(result[0].classification[0].collection, Collections::Entity());
+  EXPECT_FLOAT_EQ(result[0].classification[0].score, 0.9);
+  EXPECT_EQ(result[0].classification[0].serialized_knowledge_result(),
+            "eiffel");
+  EXPECT_EQ(result[1].span, CodepointSpan(24, 29));
+  EXPECT_EQ(result[1].classification[0].serialized_knowledge_result(),
+            "paris");
+}
+
+TEST_F(KnowledgeEngineTest, ClassifiesEntity) {
+  KnowledgeEngine engine(&unilib_);
+  ASSERT_TRUE(InitializeEngine(TestEntities(), /*min_score=*/0.0, &engine));
+
+  ClassificationResult result;
+  EXPECT_TRUE(engine.ClassifyText("Visit la tour eiffel!", {6, 20}, &result));
+  EXPECT_EQ(result.collection, Collections::Entity());
+  EXPECT_EQ(result.serialized_knowledge_result(), "eiffel");
+  EXPECT_TRUE(engine.ClassifyText("France", {0, 6}, &result));
+  EXPECT_EQ(result.serialized_knowledge_result(), "france");
+  EXPECT_FALSE(engine.ClassifyText("Visit la tour eiffel!", {9, 20}, &result));
+}
+
+TEST_F(KnowledgeEngineTest, LooksUpEntities) {
+  KnowledgeEngine engine(&unilib_);
+  ASSERT_TRUE(InitializeEngine(TestEntities(), /*min_score=*/0.0, &engine));
+
+  std::string serialized_knowledge_result;
+  EXPECT_TRUE(engine.LookUpEntity("/m/05qtj", &serialized_knowledge_result));
+  EXPECT_EQ(serialized_knowledge_result, "paris");
+  EXPECT_TRUE(engine.LookUpEntity("/m/0f8l9c", &serialized_knowledge_result));
+  EXPECT_EQ(serialized_knowledge_result, "france");
+  EXPECT_FALSE(engine.LookUpEntity("/m/unknown", &serialized_knowledge_result));
+}
+
+TEST_F(KnowledgeEngineTest, RejectsInvalidIndex) {
+  KnowledgeEngine engine(&unilib_);
+  std::vector<KnowledgeIndexEntity> entities = TestEntities();
+  entities[1].id = entities[0].id;
+  EXPECT_FALSE(InitializeEngine(entities, /*min_score=*/0.0, &engine));
+  EXPECT_FALSE(engine.Initialize("not a flatbuffer"));
+
+  std::vector<AnnotatedSpan> result;
+  EXPECT_TRUE(engine.Chunk("Paris", &result));
+  EXPECT_THAT(result, IsEmpty());
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/knowledge/knowledge-index-builder.h"
+
+#include <map>
+#include <unordered_set>
+
+#include "annotator/knowledge/knowledge-engine-index.h"
+#include "annotator/knowledge/knowledge-engine_generated.h"
+#include "utils/base/logging.h"
+#include "utils/hash/farmhash.h"
+
+namespace libtextclassifier3 {
+
+bool BuildKnowledgeIndex(const UniLib& unilib,
+                         const std::vector<KnowledgeIndexEntity>& entities,
+                         std::string* serialized_index) {
+  KnowledgeIndexT index;
+  index.matcher_type = KnowledgeIndexMatcherType_SORTED_STRING_TABLE;
+
+  // Sorted surface forms, as required by the sorted string table.
+  std::map<std::string, int> entity_by_surface_form;
+  std::unordered_set<std::string> ids;
+  index.entity_ids_offsets.push_back(0);
+  index.entity_payloads_offsets.push_back(0);
+  for (int i = 0; i < entities.size(); ++i) {
+    const KnowledgeIndexEntity& entity = entities[i];
+    if (!ids.insert(entity.id).second) {
+      TC3_LOG(ERROR) << "Duplicate entity id: " << entity.id;
+      return false;
+    }
+    index.entity_ids += entity.id;
+    index.entity_ids_offsets.push_back(index.entity_ids.size());
+    index.entity_payloads += entity.serialized_knowledge_result;
+    index.entity_payloads_offsets.push_back(index.entity_payloads.size());
+    index.entity_scores.push_back(entity.score);
+
+    for (const std::string& surface_form : entity.surface_forms) {
+      std::string normalized = NormalizeForKnowledgeIndex(
+          unilib, UTF8ToUnicodeText(surface_form, /*do_copy=*/false));
+      if (!normalized.empty() && normalized.back() == ' ') {
+        normalized.pop_back();
+      }
+      if (!normalized.empty() && normalized.front() == ' ') {
+        normalized.erase(0, 1);
+      }
+      if (normalized.empty()) {
+        continue;
+      }
+      auto it = entity_by_surface_form.find(normalized);
+      if (it == entity_by_surface_form.end()) {
+        entity_by_surface_form[normalized] = i;
+      } else if (entities[it->second].score < entity.score) {
+        it->second = i;
+      }
+    }
+  }
+
+  for (const auto& surface_form_and_entity : entity_by_surface_form) {
+    index.surface_forms_offsets.push_back(index.surface_forms.size());
+    index.surface_forms += surface_form_and_entity.first;
+    index.surface_forms.push_back('\0');
+    index.surface_form_entities.push_back(surface_form_and_entity.second);
+  }
+
+  // Keep the load factor at most 1/2 for short probe sequences.
+  index.entity_id_hash_table.assign(2 * entities.size() + 1, 0);
+  const uint32 num_buckets = index.entity_id_hash_table.size();
+  for (int i = 0; i < entities.size(); ++i) {
+    uint32 bucket = tc3farmhash::Fingerprint32(entities[i].id.data(),
+                                               entities[i].id.size()) %
+                    num_buckets;
+    while (index.entity_id_hash_table[bucket] != 0) {
+      bucket = (bucket + 1) % num_buckets;
+    }
+    index.entity_id_hash_table[bucket] = i + 1;
+  }
+
+  flatbuffers::FlatBufferBuilder builder;
+  FinishKnowledgeIndexBuffer(builder, KnowledgeIndex::Pack(builder, &index));
+  serialized_index->assign(
+      reinterpret_cast<const char*>(builder.GetBufferPointer()),
+      builder.GetSize());
+  return true;
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Offline construction of the memory mappable index of the knowledge engine.
+
+#ifndef LIBTEXTCLASSIFIER_ANNOTATOR_KNOWLEDGE_KNOWLEDGE_INDEX_BUILDER_H_
+#define LIBTEXTCLASSIFIER_ANNOTATOR_KNOWLEDGE_KNOWLEDGE_INDEX_BUILDER_H_
+
+#include <string>
+#include <vector>
+
+#include "utils/utf8/unilib.h"
+
+namespace libtextclassifier3 {
+
+struct KnowledgeIndexEntity {
+  std::string id;
+  float score = 1.0;
+
+  // Returned in ClassificationResult::serialized_knowledge_result and by
+  // LookUpEntity.
+  std::string serialized_knowledge_result;
+
+  // Names under which the entity is found in text.
+  std::vector<std::string> surface_forms;
+};
+
+// Builds a serialized KnowledgeIndex over the entities. A surface form shared
+// by several entities refers to the highest scoring one. Returns false if
+// entity ids are not unique.
+bool BuildKnowledgeIndex(const UniLib& unilib,
+                         const std::vector<KnowledgeIndexEntity>& entities,
+                         std::string* serialized_index);
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_ANNOTATOR_KNOWLEDGE_KNOWLEDGE_INDEX_BUILDER_H_
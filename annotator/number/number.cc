@@ -23,6 +23,11 @@
 #include "utils/base/logging.h"
 
 namespace libtextclassifier3 {
+namespace {
+// Interned once, instead of for each number found.
+const InternedString& kInternedNumberCollection =
+    *[]() { return new InternedString(Collections::Number()); }();
+}  // namespace
 
 bool NumberAnnotator::ClassifyText(
     const UnicodeText& context, CodepointSpan selection_indices,
@@ -35,9 +40,8 @@ bool NumberAnnotator::ClassifyText(
                                          selection_indices.second),
                   &parsed_value, &num_prefix_codepoints,
                   &num_suffix_codepoints)) {
-    ClassificationResult classification{Collections::Number(), 1.0};
     TC3_CHECK(classification_result != nullptr);
-    classification_result->collection = Collections::Number();
+    classification_result->collection = kInternedNumberCollection;
     classification_result->score = options_->score();
     classification_result->priority_score = options_->priority_score();
     classification_result->numeric_value = parsed_value;
@@ -63,7 +67,7 @@ bool NumberAnnotator::FindAll(const UnicodeText& context,
     int num_suffix_codepoints;
     if (ParseNumber(token_text, &parsed_value, &num_prefix_codepoints,
                     &num_suffix_codepoints)) {
-      ClassificationResult classification{Collections::Number(),
+      ClassificationResult classification{kInternedNumberCollection,
                                           options_->score()};
       classification.numeric_value = parsed_value;
       classification.priority_score = options_->priority_score();
@@ -80,15 +84,15 @@ bool NumberAnnotator::FindAll(const UnicodeText& context,
   return true;
 }
 
-std::unordered_set<int> NumberAnnotator::FlatbuffersVectorToSet(
+CodepointSet NumberAnnotator::FlatbuffersVectorToCodepointSet(
     const flatbuffers::Vector<int32_t>* codepoints) {
+  CodepointSet result;
   if (codepoints == nullptr) {
-    return std::unordered_set<int>{};
+    return result;
   }
 
-  std::unordered_set<int> result;
   for (const int codepoint : *codepoints) {
-    result.insert(codepoint);
+    result.Add(codepoint);
   }
   return result;
 }
@@ -152,8 +156,7 @@ bool NumberAnnotator::ParseNumber(const UnicodeText& text, int64* result,
   // Consume prefix codepoints.
   *num_prefix_codepoints = stripped_span.first;
   while (it != text.end()) {
-    if (allowed_prefix_codepoints_.find(*it) ==
-        allowed_prefix_codepoints_.end()) {
+    if (!allowed_prefix_codepoints_.Contains(*it)) {
       break;
     }
 
@@ -171,8 +174,7 @@ bool NumberAnnotator::ParseNumber(const UnicodeText& text, int64* result,
   bool valid_suffix = true;
   *num_suffix_codepoints = 0;
   while (it != it_end) {
-    if (allowed_suffix_codepoints_.find(*it) ==
-        allowed_suffix_codepoints_.end()) {
+    if (!allowed_suffix_codepoints_.Contains(*it)) {
       valid_suffix = false;
       break;
     }
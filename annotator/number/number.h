@@ -18,12 +18,13 @@
 #define LIBTEXTCLASSIFIER_ANNOTATOR_NUMBER_NUMBER_H_
 
 #include <string>
-#include <unordered_set>
 #include <vector>
 
 #include "annotator/feature-processor.h"
 #include "annotator/model_generated.h"
+#include "annotator/trigger-features.h"
 #include "annotator/types.h"
+#include "utils/codepoint-set.h"
 #include "utils/utf8/unicodetext.h"
 
 namespace libtextclassifier3 {
@@ -40,10 +41,10 @@ class NumberAnnotator {
                            const FeatureProcessor* feature_processor)
       : options_(options),
         feature_processor_(feature_processor),
-        allowed_prefix_codepoints_(
-            FlatbuffersVectorToSet(options->allowed_prefix_codepoints())),
-        allowed_suffix_codepoints_(
-            FlatbuffersVectorToSet(options->allowed_suffix_codepoints())) {}
+        allowed_prefix_codepoints_(FlatbuffersVectorToCodepointSet(
+            options->allowed_prefix_codepoints())),
+        allowed_suffix_codepoints_(FlatbuffersVectorToCodepointSet(
+            options->allowed_suffix_codepoints())) {}
 
   // Classifies given text, and if it is a number, it passes the result in
   // 'classification_result' and returns true, otherwise returns false.
@@ -56,8 +57,14 @@ class NumberAnnotator {
                AnnotationUsecase annotation_usecase,
                std::vector<AnnotatedSpan>* result) const;
 
+  // Returns the trigger features of which every number found by FindAll has
+  // at least one: a digit, or a sign which alone parses as zero.
+  TriggerFeatures trigger_features() const {
+    return (1 << TriggerFeature_DIGIT) | (1 << TriggerFeature_SIGN);
+  }
+
  private:
-  static std::unordered_set<int> FlatbuffersVectorToSet(
+  static CodepointSet FlatbuffersVectorToCodepointSet(
       const flatbuffers::Vector<int32_t>* codepoints);
 
   // Parses the text to an int64 value and returns true if succeeded, otherwise
@@ -69,8 +76,8 @@ class NumberAnnotator {
 
   const NumberAnnotatorOptions* options_;
   const FeatureProcessor* feature_processor_;
-  const std::unordered_set<int> allowed_prefix_codepoints_;
-  const std::unordered_set<int> allowed_suffix_codepoints_;
+  const CodepointSet allowed_prefix_codepoints_;
+  const CodepointSet allowed_suffix_codepoints_;
 };
 
 }  // namespace libtextclassifier3
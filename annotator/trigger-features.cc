@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/trigger-features.h"
+
+#include <algorithm>
+
+namespace libtextclassifier3 {
+namespace {
+
+constexpr TriggerFeatures Flag(TriggerFeature feature) {
+  return static_cast<TriggerFeatures>(1) << feature;
+}
+
+// Trigger features of each byte of UTF-8 text. All bytes of multi-byte
+// sequences are outside of ASCII, so the bytes can be classified without
+// decoding the codepoints.
+struct ByteTriggerFeatures {
+  ByteTriggerFeatures() {
+    for (int byte = 0; byte < 256; ++byte) {
+      TriggerFeatures features = 0;
+      if (byte >= '0' && byte <= '9') {
+        features |= Flag(TriggerFeature_DIGIT);
+      } else if ((byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z')) {
+        features |= Flag(TriggerFeature_ASCII_LETTER);
+      } else if (byte >= 0x80) {
+        features |= Flag(TriggerFeature_NON_ASCII);
+      } else if (byte == '@') {
+        features |= Flag(TriggerFeature_AT_SIGN);
+      } else if (byte == '/') {
+        features |= Flag(TriggerFeature_SLASH);
+      } else if (byte == ':') {
+        features |= Flag(TriggerFeature_COLON);
+      } else if (byte == '.') {
+        features |= Flag(TriggerFeature_PERIOD);
+      } else if (byte == '+' || byte == '-') {
+        features |= Flag(TriggerFeature_SIGN);
+      }
+      table[byte] = features;
+    }
+  }
+
+  TriggerFeatures table[256];
+};
+
+// Number of bytes scanned between the checks whether all features were
+// already seen.
+constexpr int kBlockSize = 64;
+
+const TriggerFeatures* ByteTriggerFeaturesTable() {
+  static const ByteTriggerFeatures* const byte_features =
+      new ByteTriggerFeatures();
+  return byte_features->table;
+}
+
+}  // namespace
+
+TriggerFeatures ComputeTriggerFeatures(StringPiece utf8_text) {
+  const TriggerFeatures* table = ByteTriggerFeaturesTable();
+  const unsigned char* bytes =
+      reinterpret_cast<const unsigned char*>(utf8_text.data());
+  const int size = utf8_text.size();
+
+  TriggerFeatures features = 0;
+  int i = 0;
+  while (i < size) {
+    const int block_end = std::min(size, i + kBlockSize);
+    for (; i < block_end; ++i) {
+      features |= table[bytes[i]];
+    }
+    if (features == kAllTriggerFeatures) {
+      break;
+    }
+  }
+  return features;
+}
+
+AnchoredTextFeatures ComputeAnchoredTextFeatures(StringPiece utf8_text) {
+  const TriggerFeatures* table = ByteTriggerFeaturesTable();
+  const unsigned char* bytes =
+      reinterpret_cast<const unsigned char*>(utf8_text.data());
+  const int size = utf8_text.size();
+
+  AnchoredTextFeatures result;
+  if (size == 0) {
+    return result;
+  }
+  for (int i = 0; i < size; ++i) {
+    result.features |= table[bytes[i]];
+    // Every codepoint has exactly one byte that is not a continuation byte.
+    if ((bytes[i] & 0xC0) != 0x80) {
+      ++result.num_codepoints;
+    }
+  }
+  // The bytes of a multi-byte codepoint are all outside of ASCII, so its
+  // first and last byte both classify it.
+  result.first_codepoint_features = table[bytes[0]];
+  result.last_codepoint_features = table[bytes[size - 1]];
+  return result;
+}
+
+bool SatisfiesAnchoredMatchConstraints(
+    const AnchoredMatchConstraints* constraints,
+    const AnchoredTextFeatures& text_features) {
+  if (constraints == nullptr) {
+    return true;
+  }
+  if (text_features.num_codepoints < constraints->min_length()) {
+    return false;
+  }
+  if (constraints->max_length() > 0 &&
+      text_features.num_codepoints > constraints->max_length()) {
+    return false;
+  }
+  if (!ShouldTrigger(constraints->first_codepoint_features(),
+                     text_features.first_codepoint_features) ||
+      !ShouldTrigger(constraints->last_codepoint_features(),
+                     text_features.last_codepoint_features)) {
+    return false;
+  }
+  return (text_features.features & constraints->required_features()) ==
+         constraints->required_features();
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cheap pre-scan of the input text that lets annotation skip the engines and
+// rules whose triggers are absent from it.
+
+#ifndef LIBTEXTCLASSIFIER_ANNOTATOR_TRIGGER_FEATURES_H_
+#define LIBTEXTCLASSIFIER_ANNOTATOR_TRIGGER_FEATURES_H_
+
+#include "annotator/model_generated.h"
+#include "utils/base/integral_types.h"
+#include "utils/strings/stringpiece.h"
+#include "utils/utf8/unicodetext.h"
+
+namespace libtextclassifier3 {
+
+// Flags of TriggerFeature values: bit i is set for the feature with value i.
+typedef uint32 TriggerFeatures;
+
+constexpr TriggerFeatures kAllTriggerFeatures =
+    (static_cast<TriggerFeatures>(1) << (TriggerFeature_MAX + 1)) - 1;
+
+// Computes the trigger features present in the UTF-8 text, in a single pass
+// over its bytes.
+TriggerFeatures ComputeTriggerFeatures(StringPiece utf8_text);
+
+inline TriggerFeatures ComputeTriggerFeatures(const UnicodeText& text) {
+  return ComputeTriggerFeatures(StringPiece(text.data(), text.size_bytes()));
+}
+
+// Returns whether an engine or rule that needs one of the 'required' features
+// should run on text with the 'present' features. No required features means
+// that it always runs.
+inline bool ShouldTrigger(TriggerFeatures required, TriggerFeatures present) {
+  return required == 0 || (required & present) != 0;
+}
+
+// Features of a text that rules have to match as a whole, e.g. a selection
+// that is classified.
+struct AnchoredTextFeatures {
+  int num_codepoints = 0;
+  TriggerFeatures features = 0;
+  TriggerFeatures first_codepoint_features = 0;
+  TriggerFeatures last_codepoint_features = 0;
+};
+
+// Computes the features of the UTF-8 text, in a single pass over its bytes.
+AnchoredTextFeatures ComputeAnchoredTextFeatures(StringPiece utf8_text);
+
+inline AnchoredTextFeatures ComputeAnchoredTextFeatures(
+    const UnicodeText& text) {
+  return ComputeAnchoredTextFeatures(
+      StringPiece(text.data(), text.size_bytes()));
+}
+
+// Returns whether a rule with the 'constraints' can match the whole text with
+// the given features. No constraints means that it can.
+bool SatisfiesAnchoredMatchConstraints(
+    const AnchoredMatchConstraints* constraints,
+    const AnchoredTextFeatures& text_features);
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_ANNOTATOR_TRIGGER_FEATURES_H_
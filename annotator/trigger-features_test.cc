@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/trigger-features.h"
+
+#include <string>
+
+#include "flatbuffers/flatbuffers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+TriggerFeatures Flag(TriggerFeature feature) { return 1 << feature; }
+
+TEST(TriggerFeaturesTest, ComputesFeaturesOfText) {
+  EXPECT_EQ(ComputeTriggerFeatures(""), 0);
+  EXPECT_EQ(ComputeTriggerFeatures("   "), 0);
+  EXPECT_EQ(ComputeTriggerFeatures("Hello there"),
+            Flag(TriggerFeature_ASCII_LETTER));
+  EXPECT_EQ(ComputeTriggerFeatures("call 555-1234"),
+            Flag(TriggerFeature_ASCII_LETTER) | Flag(TriggerFeature_DIGIT) |
+                Flag(TriggerFeature_SIGN));
+  EXPECT_EQ(ComputeTriggerFeatures("a@b.c"),
+            Flag(TriggerFeature_ASCII_LETTER) | Flag(TriggerFeature_AT_SIGN) |
+                Flag(TriggerFeature_PERIOD));
+  EXPECT_EQ(ComputeTriggerFeatures("12:30 1/2"),
+            Flag(TriggerFeature_DIGIT) | Flag(TriggerFeature_COLON) |
+                Flag(TriggerFeature_SLASH));
+  EXPECT_EQ(ComputeTriggerFeatures("ahoj světe"),
+            Flag(TriggerFeature_ASCII_LETTER) | Flag(TriggerFeature_NON_ASCII));
+  EXPECT_EQ(ComputeTriggerFeatures("ОК"), Flag(TriggerFeature_NON_ASCII));
+}
+
+TEST(TriggerFeaturesTest, ScansLongText) {
+  std::string text(1000, ' ');
+  text[999] = '@';
+  EXPECT_EQ(ComputeTriggerFeatures(text), Flag(TriggerFeature_AT_SIGN));
+  EXPECT_EQ(ComputeTriggerFeatures("a1ř@/:.+" + text), kAllTriggerFeatures);
+}
+
+TEST(TriggerFeaturesTest, ComputesFeaturesOfUnicodeText) {
+  EXPECT_EQ(ComputeTriggerFeatures(UTF8ToUnicodeText("7", /*do_copy=*/false)),
+            Flag(TriggerFeature_DIGIT));
+}
+
+TEST(TriggerFeaturesTest, TriggersWhenAnyRequiredFeatureIsPresent) {
+  EXPECT_TRUE(ShouldTrigger(0, 0));
+  EXPECT_TRUE(ShouldTrigger(0, Flag(TriggerFeature_DIGIT)));
+  EXPECT_FALSE(ShouldTrigger(Flag(TriggerFeature_DIGIT), 0));
+  EXPECT_FALSE(ShouldTrigger(Flag(TriggerFeature_DIGIT),
+                             Flag(TriggerFeature_ASCII_LETTER)));
+  EXPECT_TRUE(ShouldTrigger(
+      Flag(TriggerFeature_DIGIT) | Flag(TriggerFeature_SIGN),
+      Flag(TriggerFeature_ASCII_LETTER) | Flag(TriggerFeature_SIGN)));
+}
+
+TEST(TriggerFeaturesTest, ComputesAnchoredFeaturesOfText) {
+  AnchoredTextFeatures features = ComputeAnchoredTextFeatures("");
+  EXPECT_EQ(features.num_codepoints, 0);
+  EXPECT_EQ(features.features, 0);
+
+  features = ComputeAnchoredTextFeatures("@ahoj 1");
+  EXPECT_EQ(features.num_codepoints, 7);
+  EXPECT_EQ(features.features, Flag(TriggerFeature_AT_SIGN) |
+                                   Flag(TriggerFeature_ASCII_LETTER) |
+                                   Flag(TriggerFeature_DIGIT));
+  EXPECT_EQ(features.first_codepoint_features, Flag(TriggerFeature_AT_SIGN));
+  EXPECT_EQ(features.last_codepoint_features, Flag(TriggerFeature_DIGIT));
+
+  features = ComputeAnchoredTextFeatures("řeka ř");
+  EXPECT_EQ(features.num_codepoints, 6);
+  EXPECT_EQ(features.first_codepoint_features, Flag(TriggerFeature_NON_ASCII));
+  EXPECT_EQ(features.last_codepoint_features, Flag(TriggerFeature_NON_ASCII));
+}
+
+class AnchoredMatchConstraintsTest : public ::testing::Test {
+ protected:
+  const AnchoredMatchConstraints* Constraints(
+      int min_length, int max_length, TriggerFeatures first_codepoint_features,
+      TriggerFeatures last_codepoint_features,
+      TriggerFeatures required_features) {
+    builder_.Clear();
+    builder_.Finish(CreateAnchoredMatchConstraints(
+        builder_, min_length, max_length, first_codepoint_features,
+        last_codepoint_features, required_features));
+    return flatbuffers::GetRoot<AnchoredMatchConstraints>(
+        builder_.GetBufferPointer());
+  }
+
+  flatbuffers::FlatBufferBuilder builder_;
+};
+
+TEST_F(AnchoredMatchConstraintsTest, AcceptsAnyTextWithoutConstraints) {
+  EXPECT_TRUE(SatisfiesAnchoredMatchConstraints(
+      nullptr, ComputeAnchoredTextFeatures("hello")));
+  EXPECT_TRUE(SatisfiesAnchoredMatchConstraints(
+      Constraints(0, 0, 0, 0, 0), ComputeAnchoredTextFeatures("hello")));
+}
+
+TEST_F(AnchoredMatchConstraintsTest, ChecksLength) {
+  const AnchoredMatchConstraints* constraints = Constraints(3, 5, 0, 0, 0);
+  EXPECT_FALSE(SatisfiesAnchoredMatchConstraints(
+      constraints, ComputeAnchoredTextFeatures("ab")));
+  EXPECT_TRUE(SatisfiesAnchoredMatchConstraints(
+      constraints, ComputeAnchoredTextFeatures("abc")));
+  EXPECT_TRUE(SatisfiesAnchoredMatchConstraints(
+      constraints, ComputeAnchoredTextFeatures("ábčďé")));
+  EXPECT_FALSE(SatisfiesAnchoredMatchConstraints(
+      constraints, ComputeAnchoredTextFeatures("abcdef")));
+}
+
+TEST_F(AnchoredMatchConstraintsTest, ChecksFirstAndLastCodepoint) {
+  const AnchoredMatchConstraints* constraints =
+      Constraints(0, 0, Flag(TriggerFeature_DIGIT) | Flag(TriggerFeature_SIGN),
+                  Flag(TriggerFeature_DIGIT), 0);
+  EXPECT_TRUE(SatisfiesAnchoredMatchConstraints(
+      constraints, ComputeAnchoredTextFeatures("+1 555 1234")));
+  EXPECT_FALSE(SatisfiesAnchoredMatchConstraints(
+      constraints, ComputeAnchoredTextFeatures("(555) 1234")));
+  EXPECT_FALSE(SatisfiesAnchoredMatchConstraints(
+      constraints, ComputeAnchoredTextFeatures("555 1234 ")));
+  EXPECT_FALSE(SatisfiesAnchoredMatchConstraints(
+      constraints, ComputeAnchoredTextFeatures("hello")));
+}
+
+TEST_F(AnchoredMatchConstraintsTest, RequiresAllFeatures) {
+  const AnchoredMatchConstraints* constraints = Constraints(
+      0, 0, 0, 0, Flag(TriggerFeature_AT_SIGN) | Flag(TriggerFeature_PERIOD));
+  EXPECT_TRUE(SatisfiesAnchoredMatchConstraints(
+      constraints, ComputeAnchoredTextFeatures("a@b.c")));
+  EXPECT_FALSE(SatisfiesAnchoredMatchConstraints(
+      constraints, ComputeAnchoredTextFeatures("a@b")));
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
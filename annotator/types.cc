@@ -51,6 +51,54 @@ logging::LoggingStringStream& operator<<(logging::LoggingStringStream& stream,
   return stream;
 }
 
+void* ClassificationResult::MutablePayload(PayloadType type) {
+  if (payload_type_ == type && payload_.use_count() == 1) {
+    return payload_.get();
+  }
+  std::shared_ptr<void> payload;
+  const bool copy = payload_type_ == type;
+  switch (type) {
+    case PAYLOAD_CONTACT:
+      payload = copy ? std::make_shared<ContactResultData>(*contact())
+                     : std::make_shared<ContactResultData>();
+      break;
+    case PAYLOAD_APP:
+      payload = copy ? std::make_shared<AppResultData>(*app())
+                     : std::make_shared<AppResultData>();
+      break;
+    case PAYLOAD_KNOWLEDGE:
+      payload = copy ? std::make_shared<std::string>(
+                           serialized_knowledge_result())
+                     : std::make_shared<std::string>();
+      break;
+    default:
+      break;
+  }
+  payload_type_ = type;
+  payload_ = std::move(payload);
+  return payload_.get();
+}
+
+ContactResultData* ClassificationResult::mutable_contact() {
+  return static_cast<ContactResultData*>(MutablePayload(PAYLOAD_CONTACT));
+}
+
+AppResultData* ClassificationResult::mutable_app() {
+  return static_cast<AppResultData*>(MutablePayload(PAYLOAD_APP));
+}
+
+const std::string& ClassificationResult::serialized_knowledge_result() const {
+  static const std::string* empty = new std::string();
+  return payload_type_ == PAYLOAD_KNOWLEDGE
+             ? *static_cast<const std::string*>(payload_.get())
+             : *empty;
+}
+
+void ClassificationResult::set_serialized_knowledge_result(std::string value) {
+  *static_cast<std::string*>(MutablePayload(PAYLOAD_KNOWLEDGE)) =
+      std::move(value);
+}
+
 logging::LoggingStringStream& operator<<(logging::LoggingStringStream& stream,
                                          const ClassificationResult& result) {
   return stream << "ClassificationResult(" << result.collection
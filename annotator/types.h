@@ -22,6 +22,7 @@
 #include <cmath>
 #include <functional>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <utility>
@@ -31,6 +32,7 @@
 #include "utils/base/integral_types.h"
 #include "utils/base/logging.h"
 #include "utils/flatbuffers.h"
+#include "utils/strings/interned-string.h"
 #include "utils/variant.h"
 
 namespace libtextclassifier3 {
@@ -57,10 +59,11 @@ inline bool ValidNonEmptySpan(const CodepointSpan& span) {
   return span.first < span.second && span.first >= 0 && span.second >= 0;
 }
 
-template <typename T>
+template <typename T, typename Allocator>
 bool DoesCandidateConflict(
     const int considered_candidate, const std::vector<T>& candidates,
-    const std::set<int, std::function<bool(int, int)>>& chosen_indices_set) {
+    const std::set<int, std::function<bool(int, int)>, Allocator>&
+        chosen_indices_set) {
   if (chosen_indices_set.empty()) {
     return false;
   }
@@ -206,14 +209,27 @@ struct DatetimeParseResultSpan {
 logging::LoggingStringStream& operator<<(logging::LoggingStringStream& stream,
                                          const DatetimeParseResultSpan& value);
 
+// Information about a contact, for results of the contact collection.
+struct ContactResultData {
+  std::string name;
+  std::string given_name;
+  std::string nickname;
+  std::string email_address;
+  std::string phone_number;
+  std::string id;
+};
+
+// Information about an installed app, for results of the app collection.
+struct AppResultData {
+  std::string name;
+  std::string package_name;
+};
+
 struct ClassificationResult {
-  std::string collection;
+  // Interned: copies and comparisons of the collection are pointer-sized.
+  InternedString collection;
   float score;
   DatetimeParseResult datetime_parse_result;
-  std::string serialized_knowledge_result;
-  std::string contact_name, contact_given_name, contact_nickname,
-      contact_email_address, contact_phone_number, contact_id;
-  std::string app_name, app_package_name;
   int64 numeric_value;
 
   // Length of the parsed duration in milliseconds.
@@ -222,7 +238,6 @@ struct ClassificationResult {
   // Internal score used for conflict resolution.
   float priority_score;
 
-
   // Entity data information.
   std::string serialized_entity_data;
   const EntityData* entity_data() {
@@ -230,18 +245,57 @@ struct ClassificationResult {
                                                serialized_entity_data.size());
   }
 
+  // Collection specific data. At most one kind is set at a time: setting one
+  // replaces any other. It is allocated only for the results that have such
+  // data and shared between copies until modified.
+
+  // Contact information, or nullptr if not set.
+  const ContactResultData* contact() const {
+    return payload_type_ == PAYLOAD_CONTACT
+               ? static_cast<const ContactResultData*>(payload_.get())
+               : nullptr;
+  }
+  ContactResultData* mutable_contact();
+
+  // Installed app information, or nullptr if not set.
+  const AppResultData* app() const {
+    return payload_type_ == PAYLOAD_APP
+               ? static_cast<const AppResultData*>(payload_.get())
+               : nullptr;
+  }
+  AppResultData* mutable_app();
+
+  // Serialized result of the knowledge engine, empty if not set.
+  const std::string& serialized_knowledge_result() const;
+  void set_serialized_knowledge_result(std::string value);
+
   explicit ClassificationResult() : score(-1.0f), priority_score(-1.0) {}
 
-  ClassificationResult(const std::string& arg_collection, float arg_score)
+  ClassificationResult(const InternedString& arg_collection, float arg_score)
       : collection(arg_collection),
         score(arg_score),
         priority_score(arg_score) {}
 
-  ClassificationResult(const std::string& arg_collection, float arg_score,
+  ClassificationResult(const InternedString& arg_collection, float arg_score,
                        float arg_priority_score)
       : collection(arg_collection),
         score(arg_score),
         priority_score(arg_priority_score) {}
+
+ private:
+  enum PayloadType {
+    PAYLOAD_NONE = 0,
+    PAYLOAD_CONTACT = 1,
+    PAYLOAD_APP = 2,
+    PAYLOAD_KNOWLEDGE = 3,
+  };
+
+  // Makes the payload of the given type exclusively owned by this result,
+  // creating or copying it as needed, and returns it.
+  void* MutablePayload(PayloadType type);
+
+  PayloadType payload_type_ = PAYLOAD_NONE;
+  std::shared_ptr<void> payload_;
 };
 
 // Pretty-printing function for ClassificationResult.
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "annotator/types.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+TEST(ClassificationResultTest, IsCompact) {
+  // The collection specific data lives behind a single pointer.
+  EXPECT_LE(sizeof(ClassificationResult), 3 * sizeof(std::string) +
+                                              sizeof(DatetimeParseResult) +
+                                              4 * sizeof(int64));
+}
+
+TEST(ClassificationResultTest, InternsCollection) {
+  const ClassificationResult a("phone", 1.0);
+  const ClassificationResult b(std::string("phone"), 0.5);
+  EXPECT_EQ(a.collection, b.collection);
+  EXPECT_EQ(&a.collection.str(), &b.collection.str());
+  EXPECT_EQ(a.collection, "phone");
+}
+
+TEST(ClassificationResultTest, KeepsOnePayload) {
+  ClassificationResult result("contact", 1.0);
+  EXPECT_EQ(result.contact(), nullptr);
+  EXPECT_EQ(result.app(), nullptr);
+  EXPECT_EQ(result.serialized_knowledge_result(), "");
+
+  result.mutable_contact()->name = "John Doe";
+  ASSERT_NE(result.contact(), nullptr);
+  EXPECT_EQ(result.contact()->name, "John Doe");
+
+  result.mutable_app()->name = "Chrome";
+  EXPECT_EQ(result.contact(), nullptr);
+  EXPECT_EQ(result.app()->name, "Chrome");
+
+  result.set_serialized_knowledge_result("knowledge");
+  EXPECT_EQ(result.app(), nullptr);
+  EXPECT_EQ(result.serialized_knowledge_result(), "knowledge");
+}
+
+TEST(ClassificationResultTest, CopiesAreIndependent) {
+  ClassificationResult original("contact", 1.0);
+  original.mutable_contact()->name = "John Doe";
+
+  ClassificationResult copy = original;
+  EXPECT_EQ(copy.contact()->name, "John Doe");
+  copy.mutable_contact()->name = "Jane Roe";
+  EXPECT_EQ(original.contact()->name, "John Doe");
+  EXPECT_EQ(copy.contact()->name, "Jane Roe");
+
+  ClassificationResult moved = std::move(copy);
+  EXPECT_EQ(moved.contact()->name, "Jane Roe");
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
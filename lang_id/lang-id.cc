@@ -274,6 +274,16 @@ void LangId::FindLanguages(const char *data, size_t num_bytes,
   pimpl_->FindLanguages(text, result);
 }
 
+void LangId::FindLanguagesAsync(
+    const string &text, Executor *executor,
+    std::function<void(LangIdResult)> callback) const {
+  executor->Schedule([this, text, callback]() {
+    LangIdResult result;
+    FindLanguages(text, &result);
+    callback(std::move(result));
+  });
+}
+
 bool LangId::is_valid() const { return pimpl_->is_valid(); }
 
 int LangId::GetModelVersion() const { return pimpl_->GetModelVersion(); }
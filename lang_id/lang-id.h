@@ -20,6 +20,7 @@
 
 #include <stddef.h>
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <utility>
@@ -27,6 +28,7 @@
 
 #include "lang_id/common/lite_base/macros.h"
 #include "lang_id/model-provider.h"
+#include "utils/executor.h"
 
 namespace libtextclassifier3 {
 namespace mobile {
@@ -86,6 +88,13 @@ class LangId {
     FindLanguages(text.data(), text.size(), result);
   }
 
+  // Asynchronous version of FindLanguages(const string &, LangIdResult *).
+  // |text| is copied and the prediction runs as a task on |executor|, which
+  // invokes |callback| exactly once with the result.  This object must stay
+  // alive until the callback has run.
+  void FindLanguagesAsync(const string &text, Executor *executor,
+                          std::function<void(LangIdResult)> callback) const;
+
   // Returns language code for the most likely language for a piece of text.
   //
   // The input text consists of the |num_bytes| bytes that start at |data|.
@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "replay/request-log.h"
+
+#include <chrono>
+
+#include "utils/base/logging.h"
+#include "utils/flatbuffers.h"
+#include "utils/memory/mmap.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+// Size of the little-endian length prefix of each log entry.
+constexpr int kSizePrefixBytes = 4;
+
+int64 MicrosecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+void AppendScore(float score, std::string* out) {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%.4f", score);
+  out->append(buffer);
+}
+
+void AppendClassifications(
+    const std::vector<ClassificationResult>& classifications,
+    std::string* out) {
+  for (int i = 0; i < classifications.size(); ++i) {
+    if (i > 0) {
+      out->append("|");
+    }
+    out->append(classifications[i].collection);
+    out->append("/");
+    AppendScore(classifications[i].score, out);
+  }
+}
+
+}  // namespace
+
+std::string SerializeRecordedRequest(const RecordedRequestT& request) {
+  flatbuffers::FlatBufferBuilder builder;
+  builder.Finish(RecordedRequest::Pack(builder, &request));
+  const uint32 size = builder.GetSize();
+  std::string entry(kSizePrefixBytes, '\0');
+  for (int i = 0; i < kSizePrefixBytes; ++i) {
+    entry[i] = static_cast<char>((size >> (8 * i)) & 0xFF);
+  }
+  entry.append(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+               size);
+  return entry;
+}
+
+bool ParseRequestLog(const std::string& data,
+                     std::vector<std::unique_ptr<RecordedRequestT>>* requests) {
+  int offset = 0;
+  while (offset < data.size()) {
+    if (offset + kSizePrefixBytes > data.size()) {
+      TC3_LOG(ERROR) << "Truncated size prefix at offset " << offset;
+      return false;
+    }
+    uint32 size = 0;
+    for (int i = 0; i < kSizePrefixBytes; ++i) {
+      size |= static_cast<uint32>(static_cast<uint8>(data[offset + i]))
+              << (8 * i);
+    }
+    offset += kSizePrefixBytes;
+    if (size > data.size() - offset) {
+      TC3_LOG(ERROR) << "Truncated log entry at offset " << offset;
+      return false;
+    }
+    std::unique_ptr<RecordedRequestT> request =
+        LoadAndVerifyMutableFlatbuffer<RecordedRequest>(data.data() + offset,
+                                                        size);
+    if (request == nullptr) {
+      TC3_LOG(ERROR) << "Invalid log entry at offset " << offset;
+      return false;
+    }
+    requests->push_back(std::move(request));
+    offset += size;
+  }
+  return true;
+}
+
+bool ReadRequestLog(const std::string& path,
+                    std::vector<std::unique_ptr<RecordedRequestT>>* requests) {
+  ScopedMmap mmap(path);
+  if (!mmap.handle().ok()) {
+    TC3_LOG(ERROR) << "Could not open request log: " << path;
+    return false;
+  }
+  return ParseRequestLog(
+      std::string(reinterpret_cast<const char*>(mmap.handle().start()),
+                  mmap.handle().num_bytes()),
+      requests);
+}
+
+AnnotationOptions AnnotationOptionsFromRecord(const RecordedRequestT& request) {
+  AnnotationOptions options;
+  options.reference_time_ms_utc = request.reference_time_ms_utc;
+  options.reference_timezone = request.reference_timezone;
+  options.locales = request.locales;
+  options.detected_text_language_tags = request.detected_text_language_tags;
+  options.entity_types.insert(request.entity_types.begin(),
+                              request.entity_types.end());
+  options.is_serialized_entity_data_enabled =
+      request.is_serialized_entity_data_enabled;
+  options.annotation_usecase =
+      static_cast<AnnotationUsecase>(request.annotation_usecase);
+  return options;
+}
+
+ClassificationOptions ClassificationOptionsFromRecord(
+    const RecordedRequestT& request) {
+  ClassificationOptions options;
+  options.reference_time_ms_utc = request.reference_time_ms_utc;
+  options.reference_timezone = request.reference_timezone;
+  options.locales = request.locales;
+  options.detected_text_language_tags = request.detected_text_language_tags;
+  options.annotation_usecase =
+      static_cast<AnnotationUsecase>(request.annotation_usecase);
+  return options;
+}
+
+SelectionOptions SelectionOptionsFromRecord(const RecordedRequestT& request) {
+  SelectionOptions options;
+  options.locales = request.locales;
+  options.detected_text_language_tags = request.detected_text_language_tags;
+  options.annotation_usecase =
+      static_cast<AnnotationUsecase>(request.annotation_usecase);
+  return options;
+}
+
+Conversation ConversationFromRecord(const RecordedRequestT& request) {
+  Conversation conversation;
+  for (const auto& message : request.messages) {
+    std::vector<AnnotatedSpan> annotations;
+    annotations.reserve(message->annotations.size());
+    for (const auto& recorded_annotation : message->annotations) {
+      AnnotatedSpan annotation;
+      annotation.span = {recorded_annotation->span_start,
+                         recorded_annotation->span_end};
+      for (const auto& recorded_classification :
+           recorded_annotation->classification) {
+        ClassificationResult classification(
+            recorded_classification->collection,
+            recorded_classification->score,
+            recorded_classification->priority_score);
+        classification.serialized_entity_data =
+            recorded_classification->serialized_entity_data;
+        annotation.classification.push_back(std::move(classification));
+      }
+      annotations.push_back(std::move(annotation));
+    }
+    conversation.messages.push_back(
+        {message->user_id, message->text, message->reference_time_ms_utc,
+         message->reference_timezone, std::move(annotations),
+         message->detected_text_language_tags});
+  }
+  return conversation;
+}
+
+ActionSuggestionOptions ActionSuggestionOptionsFromRecord(
+    const RecordedRequestT& request) {
+  // ActionSuggestionOptions has no fields yet; they are to be recorded and
+  // restored here once it gets some.
+  return ActionSuggestionOptions();
+}
+
+std::string FormatAnnotations(const std::vector<AnnotatedSpan>& annotations) {
+  std::string out;
+  for (const AnnotatedSpan& annotation : annotations) {
+    out.append(FormatSelection(annotation.span));
+    out.append(":");
+    AppendClassifications(annotation.classification, &out);
+    out.append(";");
+  }
+  return out;
+}
+
+std::string FormatClassifications(
+    const std::vector<ClassificationResult>& classifications) {
+  std::string out;
+  AppendClassifications(classifications, &out);
+  return out;
+}
+
+std::string FormatSelection(CodepointSpan selection) {
+  return std::to_string(selection.first) + "-" +
+         std::to_string(selection.second);
+}
+
+std::string FormatActions(const ActionsSuggestionsResponse& response) {
+  std::string out;
+  for (const ActionSuggestion& action : response.actions) {
+    out.append(action.type);
+    out.append("/");
+    AppendScore(action.score, &out);
+    out.append(":");
+    out.append(action.response_text);
+    out.append(";");
+  }
+  return out;
+}
+
+std::unique_ptr<RequestRecorder> RequestRecorder::FromPath(
+    const std::string& path) {
+  FILE* file = fopen(path.c_str(), "ab");
+  if (file == nullptr) {
+    TC3_LOG(ERROR) << "Could not open request log for writing: " << path;
+    return nullptr;
+  }
+  return std::unique_ptr<RequestRecorder>(new RequestRecorder(file));
+}
+
+RequestRecorder::~RequestRecorder() { fclose(file_); }
+
+bool RequestRecorder::Append(const RecordedRequestT& request) {
+  const std::string entry = SerializeRecordedRequest(request);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fwrite(entry.data(), 1, entry.size(), file_) != entry.size()) {
+    TC3_LOG(ERROR) << "Could not write request log entry.";
+    return false;
+  }
+  return fflush(file_) == 0;
+}
+
+std::vector<AnnotatedSpan> RequestRecorder::Annotate(
+    const Annotator& annotator, const std::string& context,
+    const AnnotationOptions& options) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<AnnotatedSpan> result = annotator.Annotate(context, options);
+
+  RecordedRequestT request;
+  request.latency_us = MicrosecondsSince(start);
+  request.type = RecordedRequestType_ANNOTATE;
+  request.context = context;
+  request.locales = options.locales;
+  request.detected_text_language_tags = options.detected_text_language_tags;
+  request.reference_time_ms_utc = options.reference_time_ms_utc;
+  request.reference_timezone = options.reference_timezone;
+  request.annotation_usecase = options.annotation_usecase;
+  request.entity_types.assign(options.entity_types.begin(),
+                              options.entity_types.end());
+  request.is_serialized_entity_data_enabled =
+      options.is_serialized_entity_data_enabled;
+  request.output = FormatAnnotations(result);
+  Append(request);
+  return result;
+}
+
+std::vector<ClassificationResult> RequestRecorder::ClassifyText(
+    const Annotator& annotator, const std::string& context,
+    CodepointSpan selection_indices, const ClassificationOptions& options) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<ClassificationResult> result =
+      annotator.ClassifyText(context, selection_indices, options);
+
+  RecordedRequestT request;
+  request.latency_us = MicrosecondsSince(start);
+  request.type = RecordedRequestType_CLASSIFY_TEXT;
+  request.context = context;
+  request.span_start = selection_indices.first;
+  request.span_end = selection_indices.second;
+  request.locales = options.locales;
+  request.detected_text_language_tags = options.detected_text_language_tags;
+  request.reference_time_ms_utc = options.reference_time_ms_utc;
+  request.reference_timezone = options.reference_timezone;
+  request.annotation_usecase = options.annotation_usecase;
+  request.output = FormatClassifications(result);
+  Append(request);
+  return result;
+}
+
+CodepointSpan RequestRecorder::SuggestSelection(
+    const Annotator& annotator, const std::string& context,
+    CodepointSpan click_indices, const SelectionOptions& options) {
+  const auto start = std::chrono::steady_clock::now();
+  const CodepointSpan result =
+      annotator.SuggestSelection(context, click_indices, options);
+
+  RecordedRequestT request;
+  request.latency_us = MicrosecondsSince(start);
+  request.type = RecordedRequestType_SUGGEST_SELECTION;
+  request.context = context;
+  request.span_start = click_indices.first;
+  request.span_end = click_indices.second;
+  request.locales = options.locales;
+  request.detected_text_language_tags = options.detected_text_language_tags;
+  request.annotation_usecase = options.annotation_usecase;
+  request.output = FormatSelection(result);
+  Append(request);
+  return result;
+}
+
+ActionsSuggestionsResponse RequestRecorder::SuggestActions(
+    const ActionsSuggestions& actions_suggestions,
+    const Conversation& conversation, const Annotator* annotator,
+    const ActionSuggestionOptions& options) {
+  const auto start = std::chrono::steady_clock::now();
+  ActionsSuggestionsResponse result =
+      actions_suggestions.SuggestActions(conversation, annotator, options);
+
+  RecordedRequestT request;
+  request.latency_us = MicrosecondsSince(start);
+  request.type = RecordedRequestType_SUGGEST_ACTIONS;
+  for (const ConversationMessage& message : conversation.messages) {
+    request.messages.emplace_back(new RecordedRequest_::MessageT);
+    RecordedRequest_::MessageT* recorded_message =
+        request.messages.back().get();
+    recorded_message->user_id = message.user_id;
+    recorded_message->text = message.text;
+    recorded_message->reference_time_ms_utc = message.reference_time_ms_utc;
+    recorded_message->reference_timezone = message.reference_timezone;
+    recorded_message->detected_text_language_tags =
+        message.detected_text_language_tags;
+    for (const AnnotatedSpan& annotation : message.annotations) {
+      recorded_message->annotations.emplace_back(
+          new RecordedRequest_::AnnotationT);
+      RecordedRequest_::AnnotationT* recorded_annotation =
+          recorded_message->annotations.back().get();
+      recorded_annotation->span_start = annotation.span.first;
+      recorded_annotation->span_end = annotation.span.second;
+      for (const ClassificationResult& classification :
+           annotation.classification) {
+        recorded_annotation->classification.emplace_back(
+            new RecordedRequest_::ClassificationT);
+        RecordedRequest_::ClassificationT* recorded_classification =
+            recorded_annotation->classification.back().get();
+        recorded_classification->collection = classification.collection;
+        recorded_classification->score = classification.score;
+        recorded_classification->priority_score =
+            classification.priority_score;
+        recorded_classification->serialized_entity_data =
+            classification.serialized_entity_data;
+      }
+    }
+  }
+  request.output = FormatActions(result);
+  Append(request);
+  return result;
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Recording of API requests into a compact log for deterministic offline
+// replay, e.g. to reproduce production slowdowns against another model or
+// library build.
+
+#ifndef LIBTEXTCLASSIFIER_REPLAY_REQUEST_LOG_H_
+#define LIBTEXTCLASSIFIER_REPLAY_REQUEST_LOG_H_
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "actions/actions-suggestions.h"
+#include "actions/types.h"
+#include "annotator/annotator.h"
+#include "annotator/types.h"
+#include "utils/base/integral_types.h"
+#include "replay/request-log_generated.h"
+
+namespace libtextclassifier3 {
+
+// Serializes a request as a size-prefixed log entry.
+std::string SerializeRecordedRequest(const RecordedRequestT& request);
+
+// Parses the concatenated log entries in 'data'. Returns false if the log is
+// corrupted.
+bool ParseRequestLog(const std::string& data,
+                     std::vector<std::unique_ptr<RecordedRequestT>>* requests);
+
+// Reads all the requests from the log file at 'path'.
+bool ReadRequestLog(const std::string& path,
+                    std::vector<std::unique_ptr<RecordedRequestT>>* requests);
+
+// Creates the options and inputs of a recorded request.
+AnnotationOptions AnnotationOptionsFromRecord(const RecordedRequestT& request);
+ClassificationOptions ClassificationOptionsFromRecord(
+    const RecordedRequestT& request);
+SelectionOptions SelectionOptionsFromRecord(const RecordedRequestT& request);
+Conversation ConversationFromRecord(const RecordedRequestT& request);
+ActionSuggestionOptions ActionSuggestionOptionsFromRecord(
+    const RecordedRequestT& request);
+
+// Formats results in the canonical text form stored in the log, so that the
+// outputs of two runs can be compared as strings.
+std::string FormatAnnotations(const std::vector<AnnotatedSpan>& annotations);
+std::string FormatClassifications(
+    const std::vector<ClassificationResult>& classifications);
+std::string FormatSelection(CodepointSpan selection);
+std::string FormatActions(const ActionsSuggestionsResponse& response);
+
+// Runs requests and appends them, together with their output and latency, to
+// a log file.
+// NOTE: This class is thread-safe, the log entries are written atomically.
+class RequestRecorder {
+ public:
+  // Opens the log at 'path' for appending. Returns nullptr on failure.
+  static std::unique_ptr<RequestRecorder> FromPath(const std::string& path);
+
+  ~RequestRecorder();
+
+  // Same as the corresponding methods of Annotator and ActionsSuggestions,
+  // but also record the request.
+  std::vector<AnnotatedSpan> Annotate(const Annotator& annotator,
+                                      const std::string& context,
+                                      const AnnotationOptions& options);
+  std::vector<ClassificationResult> ClassifyText(
+      const Annotator& annotator, const std::string& context,
+      CodepointSpan selection_indices, const ClassificationOptions& options);
+  CodepointSpan SuggestSelection(const Annotator& annotator,
+                                 const std::string& context,
+                                 CodepointSpan click_indices,
+                                 const SelectionOptions& options);
+  ActionsSuggestionsResponse SuggestActions(
+      const ActionsSuggestions& actions_suggestions,
+      const Conversation& conversation, const Annotator* annotator,
+      const ActionSuggestionOptions& options);
+
+  // Appends an already filled-in request to the log.
+  bool Append(const RecordedRequestT& request);
+
+ private:
+  explicit RequestRecorder(FILE* file) : file_(file) {}
+
+  std::mutex mutex_;
+  FILE* file_;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_REPLAY_REQUEST_LOG_H_
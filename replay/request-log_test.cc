@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "replay/request-log.h"
+
+#include "annotator/collections.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+using testing::UnorderedElementsAre;
+
+TEST(RequestLogTest, SerializesAndParsesRequests) {
+  RecordedRequestT annotate;
+  annotate.type = RecordedRequestType_ANNOTATE;
+  annotate.context = "Call me at 9pm";
+  annotate.locales = "en";
+  annotate.reference_time_ms_utc = 1554465190000;
+  annotate.reference_timezone = "Europe/Zurich";
+  annotate.entity_types = {"date", "phone"};
+  annotate.output = "11-14:datetime/1.0000;";
+  annotate.latency_us = 1234;
+
+  RecordedRequestT suggest_actions;
+  suggest_actions.type = RecordedRequestType_SUGGEST_ACTIONS;
+  suggest_actions.messages.emplace_back(new RecordedRequest_::MessageT);
+  suggest_actions.messages.back()->user_id = 1;
+  suggest_actions.messages.back()->text = "Where are you?";
+  suggest_actions.messages.back()->annotations.emplace_back(
+      new RecordedRequest_::AnnotationT);
+  RecordedRequest_::AnnotationT* annotation =
+      suggest_actions.messages.back()->annotations.back().get();
+  annotation->span_start = 10;
+  annotation->span_end = 13;
+  annotation->classification.emplace_back(
+      new RecordedRequest_::ClassificationT);
+  annotation->classification.back()->collection = "address";
+  annotation->classification.back()->score = 0.5;
+  annotation->classification.back()->priority_score = 0.25;
+
+  const std::string log = SerializeRecordedRequest(annotate) +
+                          SerializeRecordedRequest(suggest_actions);
+  std::vector<std::unique_ptr<RecordedRequestT>> requests;
+  ASSERT_TRUE(ParseRequestLog(log, &requests));
+  ASSERT_EQ(requests.size(), 2);
+
+  EXPECT_EQ(requests[0]->type, RecordedRequestType_ANNOTATE);
+  EXPECT_EQ(requests[0]->context, "Call me at 9pm");
+  EXPECT_EQ(requests[0]->span_start, -1);
+  EXPECT_EQ(requests[0]->output, "11-14:datetime/1.0000;");
+  EXPECT_EQ(requests[0]->latency_us, 1234);
+  const AnnotationOptions options = AnnotationOptionsFromRecord(*requests[0]);
+  EXPECT_EQ(options.locales, "en");
+  EXPECT_EQ(options.reference_time_ms_utc, 1554465190000);
+  EXPECT_EQ(options.reference_timezone, "Europe/Zurich");
+  EXPECT_THAT(options.entity_types, UnorderedElementsAre("date", "phone"));
+
+  const Conversation conversation = ConversationFromRecord(*requests[1]);
+  ASSERT_EQ(conversation.messages.size(), 1);
+  EXPECT_EQ(conversation.messages[0].user_id, 1);
+  EXPECT_EQ(conversation.messages[0].text, "Where are you?");
+  ASSERT_EQ(conversation.messages[0].annotations.size(), 1);
+  const AnnotatedSpan& restored_annotation =
+      conversation.messages[0].annotations[0];
+  EXPECT_EQ(restored_annotation.span, CodepointSpan(10, 13));
+  ASSERT_EQ(restored_annotation.classification.size(), 1);
+  EXPECT_EQ(restored_annotation.classification[0].collection, "address");
+  EXPECT_FLOAT_EQ(restored_annotation.classification[0].score, 0.5);
+  EXPECT_FLOAT_EQ(restored_annotation.classification[0].priority_score, 0.25);
+}
+
+TEST(RequestLogTest, RejectsTruncatedLog) {
+  RecordedRequestT request;
+  request.type = RecordedRequestType_CLASSIFY_TEXT;
+  request.context = "Call me at 9pm";
+  const std::string entry = SerializeRecordedRequest(request);
+
+  std::vector<std::unique_ptr<RecordedRequestT>> requests;
+  EXPECT_FALSE(ParseRequestLog(entry.substr(0, entry.size() - 1), &requests));
+  EXPECT_FALSE(ParseRequestLog(entry.substr(0, 2), &requests));
+}
+
+TEST(RequestLogTest, FormatsResults) {
+  std::vector<AnnotatedSpan> annotations(1);
+  annotations[0].span = {0, 4};
+  annotations[0].classification = {{Collections::Phone(), 0.5},
+                                   {Collections::Number(), 0.25}};
+  EXPECT_EQ(FormatAnnotations(annotations), "0-4:phone/0.5000|number/0.2500;");
+  EXPECT_EQ(FormatClassifications({{Collections::Other(), 1.0}}),
+            "other/1.0000");
+  EXPECT_EQ(FormatSelection({3, 7}), "3-7");
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
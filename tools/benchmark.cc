@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Micro-benchmarks of the main entry points. Reports the time, the heap
+// allocations and the allocated bytes per call.
+//
+// Example:
+//   benchmark --annotator_model=en.model --lang_id_model=lang_id.model \
+//       --text="Call me at (800) 123-456 today." --iterations=1000
+//
+// The "rule-heavy" variants run on the text repeated --rule_heavy_repetitions
+// times, so that regex rules and their entity data dominate.
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "actions/actions-suggestions.h"
+#include "annotator/annotator.h"
+#include "lang_id/fb_model/lang-id-from-fb.h"
+#include "lang_id/lang-id.h"
+#include "utils/calendar/calendar.h"
+#include "utils/flatbuffers-writer.h"
+#include "utils/flatbuffers.h"
+#include "utils/strings/numbers.h"
+#include "utils/testing/allocation-counter.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+constexpr char kUsage[] =
+    "Usage: benchmark [--annotator_model=PATH] [--actions_model=PATH]\n"
+    "    [--lang_id_model=PATH] [--text=TEXT] [--iterations=N]\n"
+    "    [--filter=SUBSTRING] [--rule_heavy_repetitions=N]\n";
+
+struct Flags {
+  std::string annotator_model;
+  std::string actions_model;
+  std::string lang_id_model;
+  std::string text =
+      "Call me at (800) 123-456 today, at 5pm, or meet me at 350 Third Street "
+      "in 15 minutes.";
+  int iterations = 100;
+  int rule_heavy_repetitions = 20;
+  // Only benchmarks the name of which contains this string are run.
+  std::string filter;
+};
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+      std::cerr << "Malformed flag: " << arg << std::endl;
+      return false;
+    }
+    const std::string name = arg.substr(2, equals - 2);
+    const std::string value = arg.substr(equals + 1);
+    if (name == "annotator_model") {
+      flags->annotator_model = value;
+    } else if (name == "actions_model") {
+      flags->actions_model = value;
+    } else if (name == "lang_id_model") {
+      flags->lang_id_model = value;
+    } else if (name == "text") {
+      flags->text = value;
+    } else if (name == "filter") {
+      flags->filter = value;
+    } else if (name == "iterations") {
+      int32 iterations;
+      if (!ParseInt32(value.c_str(), &iterations) || iterations <= 0) {
+        std::cerr << "Invalid number of iterations: " << value << std::endl;
+        return false;
+      }
+      flags->iterations = iterations;
+    } else if (name == "rule_heavy_repetitions") {
+      int32 repetitions;
+      if (!ParseInt32(value.c_str(), &repetitions) || repetitions <= 0) {
+        std::cerr << "Invalid number of repetitions: " << value << std::endl;
+        return false;
+      }
+      flags->rule_heavy_repetitions = repetitions;
+    } else {
+      std::cerr << "Unknown flag: " << name << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns a path to the first string field of the root table of the schema,
+// or an empty string if there is none.
+std::string FirstStringFieldPath(const reflection::Schema* schema) {
+  if (schema == nullptr || schema->root_table() == nullptr ||
+      schema->root_table()->fields() == nullptr) {
+    return "";
+  }
+  for (const reflection::Field* field : *schema->root_table()->fields()) {
+    if (field->type()->base_type() == reflection::String) {
+      FlatbufferFieldPathT path;
+      path.field.emplace_back(new FlatbufferFieldT);
+      path.field.back()->field_name = field->name()->str();
+      return PackFlatbuffer<FlatbufferFieldPath>(&path);
+    }
+  }
+  return "";
+}
+
+struct Benchmark {
+  std::string name;
+  std::function<void()> run;
+};
+
+// Runs the benchmark once to warm up, then 'iterations' times, and prints the
+// per-call averages.
+void RunBenchmark(const Benchmark& benchmark, int iterations) {
+  benchmark.run();
+  ScopedAllocationCounter counter;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    benchmark.run();
+  }
+  const double elapsed_ns =
+      std::chrono::duration<double, std::nano>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+  const AllocationStats allocations = counter.Get();
+  printf("%-40s %12.0f ns/op %10.1f allocs/op %12.1f bytes/op\n",
+         benchmark.name.c_str(), elapsed_ns / iterations,
+         static_cast<double>(allocations.num_allocations) / iterations,
+         static_cast<double>(allocations.num_bytes) / iterations);
+}
+
+int Run(int argc, char** argv) {
+  Flags flags;
+  if (!ParseFlags(argc, argv, &flags)) {
+    std::cerr << kUsage;
+    return 1;
+  }
+
+  std::vector<Benchmark> benchmarks;
+  const std::string& text = flags.text;
+  const int text_size =
+      UTF8ToUnicodeText(text, /*do_copy=*/false).size_codepoints();
+  std::string rule_heavy_text;
+  for (int i = 0; i < flags.rule_heavy_repetitions; ++i) {
+    rule_heavy_text += (i == 0 ? "" : " ") + text;
+  }
+  std::unique_ptr<CompiledFlatbufferSchema> entity_data_schema;
+  std::string entity_data_path;
+  FlatbufferWriter::FieldPath resolved_entity_data_path;
+
+  std::unique_ptr<Annotator> annotator;
+  if (!flags.annotator_model.empty()) {
+    annotator = Annotator::FromPath(
+        flags.annotator_model, std::unique_ptr<UniLib>(new UniLib()),
+        std::unique_ptr<CalendarLib>(new CalendarLib()));
+    if (annotator == nullptr) {
+      std::cerr << "Could not load annotator model." << std::endl;
+      return 1;
+    }
+    const Annotator* model = annotator.get();
+    benchmarks.push_back(
+        {"Annotator::Annotate", [model, &text]() { model->Annotate(text); }});
+    benchmarks.push_back({"Annotator::Annotate/rule-heavy",
+                          [model, &rule_heavy_text]() {
+                            model->Annotate(rule_heavy_text);
+                          }});
+    benchmarks.push_back(
+        {"Annotator::ClassifyText", [model, &text, text_size]() {
+           model->ClassifyText(text, {0, text_size});
+         }});
+    benchmarks.push_back(
+        {"Annotator::SuggestSelection", [model, &text, text_size]() {
+           model->SuggestSelection(text, {text_size / 2, text_size / 2 + 1});
+         }});
+    const FeatureProcessor* feature_processor =
+        model->SelectionFeatureProcessorForTests();
+    if (feature_processor != nullptr) {
+      benchmarks.push_back({"FeatureProcessor::Tokenize",
+                            [feature_processor, &text]() {
+                              feature_processor->Tokenize(text);
+                            }});
+      benchmarks.push_back({"FeatureProcessor::SplitContext",
+                            [feature_processor, &text]() {
+                              feature_processor->SplitContext(
+                                  UTF8ToUnicodeText(text, /*do_copy=*/false));
+                            }});
+      benchmarks.push_back(
+          {"FeatureProcessor::StripBoundaryCodepoints",
+           [feature_processor, &text, text_size]() {
+             feature_processor->StripBoundaryCodepoints(text, {0, text_size});
+           }});
+      const std::vector<Token> tokens = feature_processor->Tokenize(text);
+      benchmarks.push_back(
+          {"FeatureProcessor::HasEnoughSupportedCodepoints",
+           [feature_processor, tokens]() {
+             feature_processor->HasEnoughSupportedCodepoints(
+                 tokens, {0, static_cast<int>(tokens.size())});
+           }});
+    }
+    const NumberAnnotator* number_annotator = model->NumberAnnotatorForTests();
+    if (number_annotator != nullptr) {
+      benchmarks.push_back(
+          {"NumberAnnotator::FindAll", [number_annotator, &text]() {
+             std::vector<AnnotatedSpan> result;
+             number_annotator->FindAll(
+                 UTF8ToUnicodeText(text, /*do_copy=*/false),
+                 AnnotationUsecase_ANNOTATION_USECASE_SMART, &result);
+           }});
+    }
+    const DatetimeParser* datetime_parser = model->DatetimeParserForTests();
+    if (datetime_parser != nullptr) {
+      benchmarks.push_back(
+          {"DatetimeParser::Parse/multi-date", [datetime_parser]() {
+             std::vector<DatetimeParseResultSpan> result;
+             datetime_parser->Parse(
+                 "Meet on January 1, 1988 at 5pm, on 09/Mar/2004 22:02:40, "
+                 "tomorrow at noon or next monday at 10:30am.",
+                 /*reference_time_ms_utc=*/0, /*reference_timezone=*/"UTC",
+                 /*locales=*/"en-US", ModeFlag_ANNOTATION,
+                 AnnotationUsecase_ANNOTATION_USECASE_SMART,
+                 /*anchor_start_end=*/false, &result);
+           }});
+    }
+
+    // Entity data writes with a field path from the model, looked up on every
+    // write or resolved once up front.
+    entity_data_path = FirstStringFieldPath(model->entity_data_schema());
+    if (!entity_data_path.empty()) {
+      entity_data_schema =
+          CompiledFlatbufferSchema::Create(model->entity_data_schema());
+    }
+    if (entity_data_schema != nullptr &&
+        entity_data_schema->ResolveFieldPath(
+            flatbuffers::GetRoot<FlatbufferFieldPath>(entity_data_path.data()),
+            &resolved_entity_data_path)) {
+      const CompiledFlatbufferSchema* schema = entity_data_schema.get();
+      const FlatbufferFieldPath* path =
+          flatbuffers::GetRoot<FlatbufferFieldPath>(entity_data_path.data());
+      benchmarks.push_back({"FlatbufferWriter::ParseAndSet/lookup",
+                            [schema, path, &text]() {
+                              FlatbufferWriter writer(schema);
+                              writer.ParseAndSet(path, text);
+                              writer.Serialize();
+                            }});
+      benchmarks.push_back({"FlatbufferWriter::ParseAndSet/resolved",
+                            [schema, &resolved_entity_data_path, &text]() {
+                              FlatbufferWriter writer(schema);
+                              writer.ParseAndSet(resolved_entity_data_path,
+                                                 text);
+                              writer.Serialize();
+                            }});
+    }
+  }
+
+  UniLib actions_unilib;
+  std::unique_ptr<ActionsSuggestions> actions_suggestions;
+  Conversation conversation;
+  conversation.messages.push_back({/*user_id=*/1, text,
+                                   /*reference_time_ms_utc=*/0,
+                                   /*reference_timezone=*/"UTC",
+                                   /*annotations=*/{},
+                                   /*detected_text_language_tags=*/"en"});
+  Conversation rule_heavy_conversation = conversation;
+  rule_heavy_conversation.messages.back().text = rule_heavy_text;
+  if (!flags.actions_model.empty()) {
+    actions_suggestions =
+        ActionsSuggestions::FromPath(flags.actions_model, &actions_unilib);
+    if (actions_suggestions == nullptr) {
+      std::cerr << "Could not load actions model." << std::endl;
+      return 1;
+    }
+    const ActionsSuggestions* model = actions_suggestions.get();
+    const Annotator* annotator_model = annotator.get();
+    benchmarks.push_back(
+        {"ActionsSuggestions::SuggestActions",
+         [model, annotator_model, &conversation]() {
+           model->SuggestActions(conversation, annotator_model);
+         }});
+    benchmarks.push_back(
+        {"ActionsSuggestions::SuggestActions/rule-heavy",
+         [model, annotator_model, &rule_heavy_conversation]() {
+           model->SuggestActions(rule_heavy_conversation, annotator_model);
+         }});
+  }
+
+  std::unique_ptr<mobile::lang_id::LangId> lang_id;
+  if (!flags.lang_id_model.empty()) {
+    lang_id = mobile::lang_id::GetLangIdFromFlatbufferFile(flags.lang_id_model);
+    if (lang_id == nullptr || !lang_id->is_valid()) {
+      std::cerr << "Could not load lang id model." << std::endl;
+      return 1;
+    }
+    const mobile::lang_id::LangId* model = lang_id.get();
+    benchmarks.push_back({"LangId::FindLanguages", [model, &text]() {
+                            mobile::lang_id::LangIdResult result;
+                            model->FindLanguages(text, &result);
+                          }});
+  }
+
+  if (benchmarks.empty()) {
+    std::cerr << "No models given." << std::endl << kUsage;
+    return 1;
+  }
+  for (const Benchmark& benchmark : benchmarks) {
+    if (benchmark.name.find(flags.filter) != std::string::npos) {
+      RunBenchmark(benchmark, flags.iterations);
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
+
+int main(int argc, char** argv) {
+  return libtextclassifier3::Run(argc, argv);
+}
@@ -0,0 +1,479 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Command line tool for offline bulk processing of text with a single model
+// instance shared between worker threads.
+//
+// Reads one request per input line, either as plain text or as a JSON record
+// {"text": ..., "start": ..., "end": ..., "locales": ...}, runs the selected
+// API on it and writes one JSON result per line. Latency percentiles and
+// throughput are reported on stderr at the end.
+//
+// NOTE: The library is built with the Java ICU UniLib, which needs a JVM to
+// compile regular expressions. The tool runs without one, so the regex and
+// datetime annotators find nothing and the ICU tokenizer is unavailable; the
+// results differ from those on a device. A warning is printed in that case.
+//
+// Example:
+//   bulk-annotate --mode=annotate --annotator_model=en.model --threads=8 \
+//       --input=messages.txt --output=annotations.jsonl
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "actions/actions-suggestions.h"
+#include "annotator/annotator.h"
+#include "lang_id/fb_model/lang-id-from-fb.h"
+#include "lang_id/lang-id.h"
+#include "tools/json-records.h"
+#include "tools/latency-stats.h"
+#include "utils/base/logging.h"
+#include "utils/calendar/calendar.h"
+#include "utils/strings/numbers.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+constexpr char kUsage[] =
+    "Usage: bulk-annotate --mode=annotate|classify|suggest_actions|lang_id\n"
+    "    [--annotator_model=PATH] [--actions_model=PATH]\n"
+    "    [--lang_id_model=PATH] [--input=PATH|-] [--output=PATH|-]\n"
+    "    [--format=text|json] [--threads=N] [--locales=en]\n"
+    "    [--reference_time_ms_utc=MS] [--reference_timezone=TZ]\n";
+
+struct Flags {
+  std::string mode = "annotate";
+  std::string annotator_model;
+  std::string actions_model;
+  std::string lang_id_model;
+  std::string input = "-";
+  std::string output = "-";
+  std::string format = "text";
+  int threads = 1;
+  std::string locales = "en";
+  int64 reference_time_ms_utc = 0;
+  std::string reference_timezone = "UTC";
+};
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  flags->threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+      std::cerr << "Malformed flag: " << arg << std::endl;
+      return false;
+    }
+    const std::string name = arg.substr(2, equals - 2);
+    const std::string value = arg.substr(equals + 1);
+    if (name == "mode") {
+      flags->mode = value;
+    } else if (name == "annotator_model") {
+      flags->annotator_model = value;
+    } else if (name == "actions_model") {
+      flags->actions_model = value;
+    } else if (name == "lang_id_model") {
+      flags->lang_id_model = value;
+    } else if (name == "input") {
+      flags->input = value;
+    } else if (name == "output") {
+      flags->output = value;
+    } else if (name == "format") {
+      flags->format = value;
+    } else if (name == "locales") {
+      flags->locales = value;
+    } else if (name == "reference_timezone") {
+      flags->reference_timezone = value;
+    } else if (name == "threads") {
+      int32 threads;
+      if (!ParseInt32(value.c_str(), &threads) || threads <= 0) {
+        std::cerr << "Invalid number of threads: " << value << std::endl;
+        return false;
+      }
+      flags->threads = threads;
+    } else if (name == "reference_time_ms_utc") {
+      if (!ParseInt64(value.c_str(), &flags->reference_time_ms_utc)) {
+        std::cerr << "Invalid reference time: " << value << std::endl;
+        return false;
+      }
+    } else {
+      std::cerr << "Unknown flag: " << name << std::endl;
+      return false;
+    }
+  }
+  if (flags->mode != "annotate" && flags->mode != "classify" &&
+      flags->mode != "suggest_actions" && flags->mode != "lang_id") {
+    std::cerr << "Unknown mode: " << flags->mode << std::endl;
+    return false;
+  }
+  if (flags->format != "text" && flags->format != "json") {
+    std::cerr << "Unknown format: " << flags->format << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// A single line of input.
+struct Record {
+  int64 index;
+  std::string line;
+};
+
+// Bounded multi-producer multi-consumer queue of records.
+class RecordQueue {
+ public:
+  explicit RecordQueue(int capacity) : capacity_(capacity) {}
+
+  void Push(Record record) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this]() { return records_.size() < capacity_; });
+    records_.push(std::move(record));
+    not_empty_.notify_one();
+  }
+
+  // Returns false once the queue is closed and drained.
+  bool Pop(Record* record) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() { return closed_ || !records_.empty(); });
+    if (records_.empty()) {
+      return false;
+    }
+    *record = std::move(records_.front());
+    records_.pop();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void Close() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+  }
+
+ private:
+  const int capacity_;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::queue<Record> records_;
+  bool closed_ = false;
+};
+
+// Models shared by all the workers.
+struct Models {
+  std::unique_ptr<Annotator> annotator;
+  std::unique_ptr<ActionsSuggestions> actions_suggestions;
+  std::unique_ptr<mobile::lang_id::LangId> lang_id;
+  std::unique_ptr<UniLib> actions_unilib;
+};
+
+// Returns whether 'unilib' can compile and run regular expressions.
+bool CompilesRegexes(const UniLib& unilib) {
+  const UnicodeText text = UTF8ToUnicodeText("a", /*do_copy=*/false);
+  const std::unique_ptr<UniLib::RegexPattern> pattern =
+      unilib.CreateRegexPattern(text);
+  if (pattern == nullptr) {
+    return false;
+  }
+  const std::unique_ptr<UniLib::RegexMatcher> matcher = pattern->Matcher(text);
+  int status = UniLib::RegexMatcher::kNoError;
+  return matcher != nullptr && matcher->Matches(&status) &&
+         status == UniLib::RegexMatcher::kNoError;
+}
+
+// Creates a UniLib without a JVM, which the Java ICU UniLib needs for regular
+// expressions.
+std::unique_ptr<UniLib> NewUniLib() {
+  return std::unique_ptr<UniLib>(new UniLib(/*jni_cache=*/nullptr));
+}
+
+bool LoadModels(const Flags& flags, Models* models) {
+  if (!flags.annotator_model.empty() || !flags.actions_model.empty()) {
+    if (!CompilesRegexes(*NewUniLib())) {
+      std::cerr << "WARNING: Regular expressions are not supported without a "
+                   "JVM; regex and datetime results are missing."
+                << std::endl;
+    }
+  }
+  if (!flags.annotator_model.empty()) {
+    models->annotator = Annotator::FromPath(
+        flags.annotator_model, NewUniLib(),
+        std::unique_ptr<CalendarLib>(new CalendarLib()));
+    if (models->annotator == nullptr) {
+      std::cerr << "Could not load annotator model: "
+                << flags.annotator_model << std::endl;
+      return false;
+    }
+  }
+  if (!flags.actions_model.empty()) {
+    models->actions_unilib = NewUniLib();
+    models->actions_suggestions = ActionsSuggestions::FromPath(
+        flags.actions_model, models->actions_unilib.get());
+    if (models->actions_suggestions == nullptr) {
+      std::cerr << "Could not load actions model: " << flags.actions_model
+                << std::endl;
+      return false;
+    }
+  }
+  if (!flags.lang_id_model.empty()) {
+    models->lang_id =
+        mobile::lang_id::GetLangIdFromFlatbufferFile(flags.lang_id_model);
+    if (models->lang_id == nullptr || !models->lang_id->is_valid()) {
+      std::cerr << "Could not load lang id model: " << flags.lang_id_model
+                << std::endl;
+      return false;
+    }
+  }
+
+  if ((flags.mode == "annotate" || flags.mode == "classify") &&
+      models->annotator == nullptr) {
+    std::cerr << "--annotator_model is required for mode " << flags.mode
+              << std::endl;
+    return false;
+  }
+  if (flags.mode == "suggest_actions" &&
+      models->actions_suggestions == nullptr) {
+    std::cerr << "--actions_model is required for mode " << flags.mode
+              << std::endl;
+    return false;
+  }
+  if (flags.mode == "lang_id" && models->lang_id == nullptr) {
+    std::cerr << "--lang_id_model is required for mode " << flags.mode
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void AppendClassifications(
+    const std::vector<ClassificationResult>& classifications,
+    std::string* out) {
+  out->append("[");
+  for (int i = 0; i < classifications.size(); ++i) {
+    if (i > 0) {
+      out->append(",");
+    }
+    out->append("{\"collection\":");
+    AppendJsonString(classifications[i].collection, out);
+    out->append(",\"score\":");
+    out->append(std::to_string(classifications[i].score));
+    out->append("}");
+  }
+  out->append("]");
+}
+
+// Processes a single input line and appends the JSON result to 'out'.
+void ProcessRecord(const Flags& flags, const Models& models,
+                   const Record& record, std::string* out) {
+  out->append("{\"index\":");
+  out->append(std::to_string(record.index));
+
+  std::string text = record.line;
+  std::string locales = flags.locales;
+  CodepointSpan span = {kInvalidIndex, kInvalidIndex};
+  if (flags.format == "json") {
+    std::unordered_map<std::string, std::string> fields;
+    int32 value;
+    if (!ParseJsonRecord(record.line, &fields) || !fields.count("text")) {
+      out->append(",\"error\":\"malformed record\"}\n");
+      return;
+    }
+    text = fields["text"];
+    if (fields.count("locales")) {
+      locales = fields["locales"];
+    }
+    if (fields.count("start") && ParseInt32(fields["start"].c_str(), &value)) {
+      span.first = value;
+    }
+    if (fields.count("end") && ParseInt32(fields["end"].c_str(), &value)) {
+      span.second = value;
+    }
+  }
+
+  if (flags.mode == "annotate") {
+    AnnotationOptions options;
+    options.locales = locales;
+    options.reference_time_ms_utc = flags.reference_time_ms_utc;
+    options.reference_timezone = flags.reference_timezone;
+    out->append(",\"annotations\":[");
+    const std::vector<AnnotatedSpan> annotations =
+        models.annotator->Annotate(text, options);
+    for (int i = 0; i < annotations.size(); ++i) {
+      if (i > 0) {
+        out->append(",");
+      }
+      out->append("{\"start\":");
+      out->append(std::to_string(annotations[i].span.first));
+      out->append(",\"end\":");
+      out->append(std::to_string(annotations[i].span.second));
+      out->append(",\"classification\":");
+      AppendClassifications(annotations[i].classification, out);
+      out->append("}");
+    }
+    out->append("]");
+  } else if (flags.mode == "classify") {
+    if (span.first == kInvalidIndex || span.second == kInvalidIndex) {
+      span = {0, UTF8ToUnicodeText(text, /*do_copy=*/false).size_codepoints()};
+    }
+    ClassificationOptions options;
+    options.locales = locales;
+    options.reference_time_ms_utc = flags.reference_time_ms_utc;
+    options.reference_timezone = flags.reference_timezone;
+    out->append(",\"classification\":");
+    AppendClassifications(models.annotator->ClassifyText(text, span, options),
+                          out);
+  } else if (flags.mode == "suggest_actions") {
+    Conversation conversation;
+    conversation.messages.push_back(
+        {/*user_id=*/1, text, flags.reference_time_ms_utc,
+         flags.reference_timezone, /*annotations=*/{}, locales});
+    const ActionsSuggestionsResponse response =
+        models.actions_suggestions->SuggestActions(conversation,
+                                                   models.annotator.get());
+    out->append(",\"actions\":[");
+    for (int i = 0; i < response.actions.size(); ++i) {
+      if (i > 0) {
+        out->append(",");
+      }
+      out->append("{\"type\":");
+      AppendJsonString(response.actions[i].type, out);
+      out->append(",\"response_text\":");
+      AppendJsonString(response.actions[i].response_text, out);
+      out->append(",\"score\":");
+      out->append(std::to_string(response.actions[i].score));
+      out->append("}");
+    }
+    out->append("]");
+  } else if (flags.mode == "lang_id") {
+    mobile::lang_id::LangIdResult result;
+    models.lang_id->FindLanguages(text, &result);
+    out->append(",\"languages\":[");
+    for (int i = 0; i < result.predictions.size(); ++i) {
+      if (i > 0) {
+        out->append(",");
+      }
+      out->append("{\"language\":");
+      AppendJsonString(result.predictions[i].first, out);
+      out->append(",\"probability\":");
+      out->append(std::to_string(result.predictions[i].second));
+      out->append("}");
+    }
+    out->append("]");
+  } else {
+    out->append(",\"error\":\"unknown mode\"");
+  }
+  out->append("}\n");
+}
+
+void RunWorker(const Flags& flags, const Models& models, RecordQueue* queue,
+               std::mutex* output_mutex, std::ostream* output,
+               LatencyStats* stats) {
+  Record record;
+  std::string result;
+  while (queue->Pop(&record)) {
+    result.clear();
+    const auto start = std::chrono::steady_clock::now();
+    ProcessRecord(flags, models, record, &result);
+    stats->Add(std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count());
+    std::lock_guard<std::mutex> lock(*output_mutex);
+    output->write(result.data(), result.size());
+  }
+}
+
+int Run(int argc, char** argv) {
+  Flags flags;
+  if (!ParseFlags(argc, argv, &flags)) {
+    std::cerr << kUsage;
+    return 1;
+  }
+  Models models;
+  if (!LoadModels(flags, &models)) {
+    return 1;
+  }
+
+  std::ifstream input_file;
+  std::istream* input = &std::cin;
+  if (flags.input != "-") {
+    input_file.open(flags.input);
+    if (!input_file) {
+      std::cerr << "Could not open input: " << flags.input << std::endl;
+      return 1;
+    }
+    input = &input_file;
+  }
+  std::ofstream output_file;
+  std::ostream* output = &std::cout;
+  if (flags.output != "-") {
+    output_file.open(flags.output);
+    if (!output_file) {
+      std::cerr << "Could not open output: " << flags.output << std::endl;
+      return 1;
+    }
+    output = &output_file;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  RecordQueue queue(/*capacity=*/64 * flags.threads);
+  std::mutex output_mutex;
+  std::vector<LatencyStats> stats(flags.threads);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < flags.threads; ++i) {
+    workers.emplace_back(RunWorker, std::cref(flags), std::cref(models),
+                         &queue, &output_mutex, output, &stats[i]);
+  }
+
+  Record record;
+  for (record.index = 0; std::getline(*input, record.line); ++record.index) {
+    queue.Push(record);
+  }
+  queue.Close();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  output->flush();
+
+  const double wall_time_s =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  LatencyStats total;
+  for (const LatencyStats& worker_stats : stats) {
+    total.Merge(worker_stats);
+  }
+  std::cerr << total.Summary(wall_time_s) << std::endl;
+  return 0;
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
+
+int main(int argc, char** argv) {
+  return libtextclassifier3::Run(argc, argv);
+}
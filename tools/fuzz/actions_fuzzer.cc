@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// libFuzzer target for ActionsSuggestions::SuggestActions on a single message
+// conversation. The model is read from $TC3_FUZZ_ACTIONS_MODEL, or the
+// installed universal model by default.
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "actions/actions-suggestions.h"
+#include "tools/fuzz/latency-guard.h"
+#include "utils/utf8/unilib.h"
+
+namespace {
+
+libtextclassifier3::UniLib* unilib = nullptr;
+libtextclassifier3::ActionsSuggestions* actions_suggestions = nullptr;
+
+}  // namespace
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv) {
+  const char* path = getenv("TC3_FUZZ_ACTIONS_MODEL");
+  unilib = new libtextclassifier3::UniLib();
+  actions_suggestions =
+      libtextclassifier3::ActionsSuggestions::FromPath(
+          path != nullptr ? path
+                          : "/system/etc/textclassifier/"
+                            "actions_suggestions.universal.model",
+          unilib)
+          .release();
+  if (actions_suggestions == nullptr) {
+    fprintf(stderr, "Could not load actions model.\n");
+    abort();
+  }
+  return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  libtextclassifier3::CheckLatencyScaling(
+      "SuggestActions", std::string(reinterpret_cast<const char*>(data), size),
+      [](const std::string& input) {
+        libtextclassifier3::Conversation conversation;
+        conversation.messages.push_back(
+            {/*user_id=*/1, input, /*reference_time_ms_utc=*/0,
+             /*reference_timezone=*/"UTC", /*annotations=*/{},
+             /*detected_text_language_tags=*/"en"});
+        actions_suggestions->SuggestActions(conversation);
+      });
+  return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// libFuzzer target for Annotator::Annotate, ClassifyText and SuggestSelection.
+// The model is read from $TC3_FUZZ_ANNOTATOR_MODEL, or the installed universal
+// model by default.
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "annotator/annotator.h"
+#include "tools/fuzz/latency-guard.h"
+#include "utils/calendar/calendar.h"
+#include "utils/utf8/unicodetext.h"
+#include "utils/utf8/unilib.h"
+
+namespace {
+
+libtextclassifier3::Annotator* annotator = nullptr;
+
+}  // namespace
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv) {
+  const char* path = getenv("TC3_FUZZ_ANNOTATOR_MODEL");
+  annotator =
+      libtextclassifier3::Annotator::FromPath(
+          path != nullptr
+              ? path
+              : "/system/etc/textclassifier/textclassifier.universal.model",
+          std::unique_ptr<libtextclassifier3::UniLib>(
+              new libtextclassifier3::UniLib()),
+          std::unique_ptr<libtextclassifier3::CalendarLib>(
+              new libtextclassifier3::CalendarLib()))
+          .release();
+  if (annotator == nullptr) {
+    fprintf(stderr, "Could not load annotator model.\n");
+    abort();
+  }
+  return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  const std::string text(reinterpret_cast<const char*>(data), size);
+  libtextclassifier3::CheckLatencyScaling(
+      "Annotate", text,
+      [](const std::string& input) { annotator->Annotate(input); });
+
+  const libtextclassifier3::UnicodeText text_unicode =
+      libtextclassifier3::UTF8ToUnicodeText(text, /*do_copy=*/false);
+  if (!text_unicode.is_valid() || text_unicode.size_codepoints() == 0) {
+    return 0;
+  }
+  libtextclassifier3::CheckLatencyScaling(
+      "ClassifyText", text, [](const std::string& input) {
+        const int num_codepoints =
+            libtextclassifier3::UTF8ToUnicodeText(input, /*do_copy=*/false)
+                .size_codepoints();
+        annotator->ClassifyText(input, {0, num_codepoints});
+      });
+  libtextclassifier3::CheckLatencyScaling(
+      "SuggestSelection", text, [](const std::string& input) {
+        const int num_codepoints =
+            libtextclassifier3::UTF8ToUnicodeText(input, /*do_copy=*/false)
+                .size_codepoints();
+        annotator->SuggestSelection(
+            input, {num_codepoints / 2, num_codepoints / 2 + 1});
+      });
+  return 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// libFuzzer target for LangId::FindLanguages. The model is read from
+// $TC3_FUZZ_LANG_ID_MODEL, or the installed model by default.
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "lang_id/fb_model/lang-id-from-fb.h"
+#include "lang_id/lang-id.h"
+#include "tools/fuzz/latency-guard.h"
+
+namespace {
+
+libtextclassifier3::mobile::lang_id::LangId* lang_id = nullptr;
+
+}  // namespace
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv) {
+  const char* path = getenv("TC3_FUZZ_LANG_ID_MODEL");
+  lang_id = libtextclassifier3::mobile::lang_id::GetLangIdFromFlatbufferFile(
+                path != nullptr ? path
+                                : "/system/etc/textclassifier/lang_id.model")
+                .release();
+  if (lang_id == nullptr || !lang_id->is_valid()) {
+    fprintf(stderr, "Could not load lang id model.\n");
+    abort();
+  }
+  return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  libtextclassifier3::CheckLatencyScaling(
+      "FindLanguages", std::string(reinterpret_cast<const char*>(data), size),
+      [](const std::string& input) {
+        libtextclassifier3::mobile::lang_id::LangIdResult result;
+        lang_id->FindLanguages(input.data(), input.size(), &result);
+      });
+  return 0;
+}
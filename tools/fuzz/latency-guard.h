@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Latency assertions for the fuzzers: each input is processed once as is and
+// once concatenated with itself, and it is flagged if doubling its size more
+// than multiplies the processing time by a fixed ratio. Linear processing
+// doubles the time, so the check catches inputs on which the processing time
+// grows super-linearly, independently of how fast the device is.
+//
+// The check is configured with the environment variables
+//   TC3_FUZZ_MAX_DOUBLING_RATIO (default 3): maximum ratio of the processing
+//       times of the doubled and of the original input.
+//   TC3_FUZZ_MIN_CHECKED_US (default 1000): doubled inputs processed faster
+//       than this are not checked, as their timings are dominated by noise.
+// Offending inputs abort the process, so that libFuzzer saves them; they
+// should then be added to tools/fuzz/corpus as regressions.
+
+#ifndef LIBTEXTCLASSIFIER_TOOLS_FUZZ_LATENCY_GUARD_H_
+#define LIBTEXTCLASSIFIER_TOOLS_FUZZ_LATENCY_GUARD_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace libtextclassifier3 {
+namespace internal {
+
+inline double LatencyGuardEnvOrDefault(const char* name,
+                                       double default_value) {
+  const char* value = getenv(name);
+  return value != nullptr ? atof(value) : default_value;
+}
+
+// Returns the processing time of 'input' in microseconds.
+template <typename Fn>
+double MeasureLatencyUs(const Fn& fn, const std::string& input) {
+  const auto start = std::chrono::steady_clock::now();
+  fn(input);
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+}  // namespace internal
+
+// Runs 'fn' on 'input' and on 'input' concatenated with itself, and aborts if
+// the second run is more than TC3_FUZZ_MAX_DOUBLING_RATIO times slower.
+template <typename Fn>
+void CheckLatencyScaling(const char* name, const std::string& input,
+                         const Fn& fn) {
+  const std::string doubled_input = input + input;
+  double latency_us = internal::MeasureLatencyUs(fn, input);
+  double doubled_latency_us = internal::MeasureLatencyUs(fn, doubled_input);
+  const double max_ratio =
+      internal::LatencyGuardEnvOrDefault("TC3_FUZZ_MAX_DOUBLING_RATIO", 3.0);
+  const double min_checked_us =
+      internal::LatencyGuardEnvOrDefault("TC3_FUZZ_MIN_CHECKED_US", 1000.0);
+  if (doubled_latency_us < min_checked_us ||
+      doubled_latency_us <= max_ratio * latency_us) {
+    return;
+  }
+
+  // Confirm with the fastest of a few more runs before flagging the input, so
+  // that a single scheduling hiccup is not reported.
+  constexpr int kNumConfirmationRuns = 3;
+  for (int i = 0; i < kNumConfirmationRuns; ++i) {
+    latency_us = std::min(latency_us, internal::MeasureLatencyUs(fn, input));
+    doubled_latency_us = std::min(
+        doubled_latency_us, internal::MeasureLatencyUs(fn, doubled_input));
+  }
+  if (doubled_latency_us >= min_checked_us &&
+      doubled_latency_us > max_ratio * latency_us) {
+    fprintf(stderr,
+            "%s took %.0f us for %zu bytes and %.0f us for %zu bytes (ratio "
+            "%.1f), maximum ratio is %.1f.\n",
+            name, latency_us, input.size(), doubled_latency_us,
+            doubled_input.size(), doubled_latency_us / latency_us, max_ratio);
+    abort();
+  }
+}
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_TOOLS_FUZZ_LATENCY_GUARD_H_
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/json-records.h"
+
+#include <cctype>
+
+#include "utils/utf8/unicodetext.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+void SkipWhitespace(const std::string& line, int* pos) {
+  while (*pos < line.size() &&
+         std::isspace(static_cast<unsigned char>(line[*pos]))) {
+    ++(*pos);
+  }
+}
+
+bool ParseHex4(const std::string& line, int pos, int* value) {
+  if (pos + 4 > line.size()) {
+    return false;
+  }
+  *value = 0;
+  for (int i = pos; i < pos + 4; ++i) {
+    const char c = line[i];
+    *value <<= 4;
+    if (c >= '0' && c <= '9') {
+      *value |= c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      *value |= c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      *value |= c - 'A' + 10;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parses a JSON string starting at the opening quote at 'pos'. On success,
+// 'pos' points past the closing quote.
+bool ParseString(const std::string& line, int* pos, std::string* value) {
+  if (*pos >= line.size() || line[*pos] != '"') {
+    return false;
+  }
+  value->clear();
+  for (++(*pos); *pos < line.size(); ++(*pos)) {
+    const char c = line[*pos];
+    if (c == '"') {
+      ++(*pos);
+      return true;
+    }
+    if (c != '\\') {
+      value->push_back(c);
+      continue;
+    }
+    if (++(*pos) >= line.size()) {
+      return false;
+    }
+    switch (line[*pos]) {
+      case '"':
+      case '\\':
+      case '/':
+        value->push_back(line[*pos]);
+        break;
+      case 'b':
+        value->push_back('\b');
+        break;
+      case 'f':
+        value->push_back('\f');
+        break;
+      case 'n':
+        value->push_back('\n');
+        break;
+      case 'r':
+        value->push_back('\r');
+        break;
+      case 't':
+        value->push_back('\t');
+        break;
+      case 'u': {
+        int codepoint;
+        if (!ParseHex4(line, *pos + 1, &codepoint)) {
+          return false;
+        }
+        *pos += 4;
+        // Combine surrogate pairs.
+        int low_surrogate;
+        if (codepoint >= 0xD800 && codepoint <= 0xDBFF &&
+            *pos + 2 < line.size() && line[*pos + 1] == '\\' &&
+            line[*pos + 2] == 'u' &&
+            ParseHex4(line, *pos + 3, &low_surrogate) &&
+            low_surrogate >= 0xDC00 && low_surrogate <= 0xDFFF) {
+          codepoint =
+              0x10000 + ((codepoint - 0xD800) << 10) + (low_surrogate - 0xDC00);
+          *pos += 6;
+        }
+        UnicodeText encoded;
+        encoded.push_back(codepoint);
+        value->append(encoded.data(), encoded.size_bytes());
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+bool ParseJsonRecord(const std::string& line,
+                     std::unordered_map<std::string, std::string>* fields) {
+  fields->clear();
+  int pos = 0;
+  SkipWhitespace(line, &pos);
+  if (pos >= line.size() || line[pos] != '{') {
+    return false;
+  }
+  ++pos;
+  SkipWhitespace(line, &pos);
+  if (pos < line.size() && line[pos] == '}') {
+    return true;
+  }
+  while (pos < line.size()) {
+    std::string key;
+    SkipWhitespace(line, &pos);
+    if (!ParseString(line, &pos, &key)) {
+      return false;
+    }
+    SkipWhitespace(line, &pos);
+    if (pos >= line.size() || line[pos] != ':') {
+      return false;
+    }
+    ++pos;
+    SkipWhitespace(line, &pos);
+    if (pos >= line.size()) {
+      return false;
+    }
+    std::string value;
+    if (line[pos] == '"') {
+      if (!ParseString(line, &pos, &value)) {
+        return false;
+      }
+    } else if (line[pos] == '{' || line[pos] == '[') {
+      return false;
+    } else {
+      const int begin = pos;
+      while (pos < line.size() && line[pos] != ',' && line[pos] != '}' &&
+             !std::isspace(static_cast<unsigned char>(line[pos]))) {
+        ++pos;
+      }
+      value = line.substr(begin, pos - begin);
+    }
+    (*fields)[key] = value;
+    SkipWhitespace(line, &pos);
+    if (pos >= line.size()) {
+      return false;
+    }
+    if (line[pos] == '}') {
+      return true;
+    }
+    if (line[pos] != ',') {
+      return false;
+    }
+    ++pos;
+  }
+  return false;
+}
+
+void AppendJsonString(const std::string& value, std::string* out) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  out->push_back('"');
+  for (const char c : value) {
+    switch (c) {
+      case '"':
+        out->append("\\\"");
+        break;
+      case '\\':
+        out->append("\\\\");
+        break;
+      case '\n':
+        out->append("\\n");
+        break;
+      case '\r':
+        out->append("\\r");
+        break;
+      case '\t':
+        out->append("\\t");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out->append("\\u00");
+          out->push_back(kHexDigits[(c >> 4) & 0xF]);
+          out->push_back(kHexDigits[c & 0xF]);
+        } else {
+          out->push_back(c);
+        }
+    }
+  }
+  out->push_back('"');
+}
+
+}  // namespace libtextclassifier3
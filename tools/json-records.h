@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Minimal support for the one-record-per-line JSON format read and written by
+// the command line tools.
+
+#ifndef LIBTEXTCLASSIFIER_TOOLS_JSON_RECORDS_H_
+#define LIBTEXTCLASSIFIER_TOOLS_JSON_RECORDS_H_
+
+#include <string>
+#include <unordered_map>
+
+namespace libtextclassifier3 {
+
+// Parses a flat JSON object, e.g. {"text": "Call me at 9", "start": 11}.
+// String values are unescaped, other scalar values (numbers, true, false,
+// null) are stored as their literal text. Nested objects and arrays are not
+// supported. Returns false if the line is not such an object.
+bool ParseJsonRecord(const std::string& line,
+                     std::unordered_map<std::string, std::string>* fields);
+
+// Appends 'value' to 'out' as a quoted and escaped JSON string.
+void AppendJsonString(const std::string& value, std::string* out);
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_TOOLS_JSON_RECORDS_H_
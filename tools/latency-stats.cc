@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/latency-stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace libtextclassifier3 {
+
+void LatencyStats::Merge(const LatencyStats& other) {
+  latencies_us_.insert(latencies_us_.end(), other.latencies_us_.begin(),
+                       other.latencies_us_.end());
+  sorted_ = false;
+}
+
+int64 LatencyStats::Percentile(double percentile) {
+  if (latencies_us_.empty()) {
+    return 0;
+  }
+  if (!sorted_) {
+    std::sort(latencies_us_.begin(), latencies_us_.end());
+    sorted_ = true;
+  }
+  const int rank = static_cast<int>(
+      std::ceil(percentile / 100.0 * latencies_us_.size()));
+  return latencies_us_[std::min(std::max(rank - 1, 0),
+                                static_cast<int>(latencies_us_.size()) - 1)];
+}
+
+std::string LatencyStats::Summary(double wall_time_s) {
+  char buffer[256];
+  int length = snprintf(buffer, sizeof(buffer), "requests: %lld",
+                        static_cast<long long>(Count()));
+  if (wall_time_s > 0) {
+    length += snprintf(buffer + length, sizeof(buffer) - length,
+                       ", throughput: %.1f/s", Count() / wall_time_s);
+  }
+  snprintf(buffer + length, sizeof(buffer) - length,
+           ", latency us: p50 %lld, p90 %lld, p99 %lld, p99.9 %lld, max %lld",
+           static_cast<long long>(Percentile(50)),
+           static_cast<long long>(Percentile(90)),
+           static_cast<long long>(Percentile(99)),
+           static_cast<long long>(Percentile(99.9)),
+           static_cast<long long>(Percentile(100)));
+  return buffer;
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Latency bookkeeping shared by the command line tools.
+
+#ifndef LIBTEXTCLASSIFIER_TOOLS_LATENCY_STATS_H_
+#define LIBTEXTCLASSIFIER_TOOLS_LATENCY_STATS_H_
+
+#include <string>
+#include <vector>
+
+#include "utils/base/integral_types.h"
+
+namespace libtextclassifier3 {
+
+// Collects per-request latencies and summarizes them as percentiles.
+// NOTE: This class is not thread-safe; use one instance per worker and merge
+// them at the end.
+class LatencyStats {
+ public:
+  void Add(int64 latency_us) {
+    latencies_us_.push_back(latency_us);
+    sorted_ = false;
+  }
+
+  void Merge(const LatencyStats& other);
+
+  int64 Count() const { return latencies_us_.size(); }
+
+  // Returns the nearest-rank latency for 'percentile' in [0, 100], or 0 if no
+  // latencies were recorded.
+  int64 Percentile(double percentile);
+
+  // Returns a human readable summary with the p50, p90, p99, p99.9 and max
+  // latencies, and the throughput if the wall time of the run is positive.
+  std::string Summary(double wall_time_s);
+
+ private:
+  std::vector<int64> latencies_us_;
+  bool sorted_ = true;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_TOOLS_LATENCY_STATS_H_
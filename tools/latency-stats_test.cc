@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tools/latency-stats.h"
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+TEST(LatencyStatsTest, PercentilesOfUnsortedLatencies) {
+  LatencyStats stats;
+  for (const int64 latency_us : {70, 10, 100, 40, 20, 90, 30, 60, 80, 50}) {
+    stats.Add(latency_us);
+  }
+  EXPECT_EQ(stats.Count(), 10);
+  EXPECT_EQ(stats.Percentile(0), 10);
+  EXPECT_EQ(stats.Percentile(50), 50);
+  EXPECT_EQ(stats.Percentile(90), 90);
+  EXPECT_EQ(stats.Percentile(100), 100);
+
+  // Latencies added after a percentile was computed are sorted in as well.
+  stats.Add(5);
+  stats.Add(1000);
+  EXPECT_EQ(stats.Percentile(0), 5);
+  EXPECT_EQ(stats.Percentile(50), 50);
+  EXPECT_EQ(stats.Percentile(100), 1000);
+}
+
+TEST(LatencyStatsTest, PercentilesOfMergedLatencies) {
+  LatencyStats stats;
+  stats.Add(30);
+  stats.Add(10);
+  LatencyStats other;
+  other.Add(40);
+  other.Add(20);
+  stats.Merge(other);
+  EXPECT_EQ(stats.Count(), 4);
+  EXPECT_EQ(stats.Percentile(25), 10);
+  EXPECT_EQ(stats.Percentile(50), 20);
+  EXPECT_EQ(stats.Percentile(75), 30);
+  EXPECT_EQ(stats.Percentile(100), 40);
+}
+
+TEST(LatencyStatsTest, PercentileOfNoLatencies) {
+  LatencyStats stats;
+  EXPECT_EQ(stats.Percentile(50), 0);
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
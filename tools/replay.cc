@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Command line tool that deterministically replays a request log recorded
+// with RequestRecorder against the given models, and reports per-request
+// latency deltas and output differences.
+//
+// Requests are replayed sequentially with their recorded reference times, so
+// relative dates resolve the same way as during recording. Use
+// --reference_time_ms_utc to pin the clock of all the requests instead.
+//
+// Example:
+//   replay --log=requests.log --annotator_model=en.model \
+//       --actions_model=actions.model
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "actions/actions-suggestions.h"
+#include "annotator/annotator.h"
+#include "replay/request-log.h"
+#include "tools/latency-stats.h"
+#include "utils/calendar/calendar.h"
+#include "utils/strings/numbers.h"
+#include "utils/utf8/unilib.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+constexpr char kUsage[] =
+    "Usage: replay --log=PATH [--annotator_model=PATH]\n"
+    "    [--actions_model=PATH] [--reference_time_ms_utc=MS]\n"
+    "    [--repetitions=N] [--quiet=true]\n";
+
+struct Flags {
+  std::string log;
+  std::string annotator_model;
+  std::string actions_model;
+  // If non-zero, overrides the recorded reference times.
+  int64 reference_time_ms_utc = 0;
+  // Each request is run this many times and the fastest run is reported, to
+  // reduce noise.
+  int repetitions = 1;
+  // If true, only the summary and the output differences are printed.
+  bool quiet = false;
+};
+
+bool ParseFlags(int argc, char** argv, Flags* flags) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || equals == std::string::npos) {
+      std::cerr << "Malformed flag: " << arg << std::endl;
+      return false;
+    }
+    const std::string name = arg.substr(2, equals - 2);
+    const std::string value = arg.substr(equals + 1);
+    if (name == "log") {
+      flags->log = value;
+    } else if (name == "annotator_model") {
+      flags->annotator_model = value;
+    } else if (name == "actions_model") {
+      flags->actions_model = value;
+    } else if (name == "quiet") {
+      flags->quiet = (value == "true");
+    } else if (name == "reference_time_ms_utc") {
+      if (!ParseInt64(value.c_str(), &flags->reference_time_ms_utc)) {
+        std::cerr << "Invalid reference time: " << value << std::endl;
+        return false;
+      }
+    } else if (name == "repetitions") {
+      int32 repetitions;
+      if (!ParseInt32(value.c_str(), &repetitions) || repetitions <= 0) {
+        std::cerr << "Invalid number of repetitions: " << value << std::endl;
+        return false;
+      }
+      flags->repetitions = repetitions;
+    } else {
+      std::cerr << "Unknown flag: " << name << std::endl;
+      return false;
+    }
+  }
+  if (flags->log.empty()) {
+    std::cerr << "--log is required." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+const char* RequestTypeName(RecordedRequestType type) {
+  switch (type) {
+    case RecordedRequestType_ANNOTATE:
+      return "annotate";
+    case RecordedRequestType_CLASSIFY_TEXT:
+      return "classify_text";
+    case RecordedRequestType_SUGGEST_SELECTION:
+      return "suggest_selection";
+    case RecordedRequestType_SUGGEST_ACTIONS:
+      return "suggest_actions";
+    default:
+      return "unknown";
+  }
+}
+
+// Runs the request once and sets its output in the canonical format. Returns
+// false if the request can't be replayed with the loaded models.
+bool RunRequest(const Annotator* annotator,
+                const ActionsSuggestions* actions_suggestions,
+                const RecordedRequestT& request, std::string* output) {
+  const CodepointSpan span = {request.span_start, request.span_end};
+  switch (request.type) {
+    case RecordedRequestType_ANNOTATE:
+      if (annotator == nullptr) {
+        return false;
+      }
+      *output = FormatAnnotations(annotator->Annotate(
+          request.context, AnnotationOptionsFromRecord(request)));
+      return true;
+    case RecordedRequestType_CLASSIFY_TEXT:
+      if (annotator == nullptr) {
+        return false;
+      }
+      *output = FormatClassifications(annotator->ClassifyText(
+          request.context, span, ClassificationOptionsFromRecord(request)));
+      return true;
+    case RecordedRequestType_SUGGEST_SELECTION:
+      if (annotator == nullptr) {
+        return false;
+      }
+      *output = FormatSelection(annotator->SuggestSelection(
+          request.context, span, SelectionOptionsFromRecord(request)));
+      return true;
+    case RecordedRequestType_SUGGEST_ACTIONS:
+      if (actions_suggestions == nullptr) {
+        return false;
+      }
+      *output = FormatActions(actions_suggestions->SuggestActions(
+          ConversationFromRecord(request), annotator,
+          ActionSuggestionOptionsFromRecord(request)));
+      return true;
+    default:
+      return false;
+  }
+}
+
+int Run(int argc, char** argv) {
+  Flags flags;
+  if (!ParseFlags(argc, argv, &flags)) {
+    std::cerr << kUsage;
+    return 1;
+  }
+
+  std::unique_ptr<Annotator> annotator;
+  if (!flags.annotator_model.empty()) {
+    annotator = Annotator::FromPath(
+        flags.annotator_model, std::unique_ptr<UniLib>(new UniLib()),
+        std::unique_ptr<CalendarLib>(new CalendarLib()));
+    if (annotator == nullptr) {
+      std::cerr << "Could not load annotator model: "
+                << flags.annotator_model << std::endl;
+      return 1;
+    }
+  }
+  UniLib actions_unilib;
+  std::unique_ptr<ActionsSuggestions> actions_suggestions;
+  if (!flags.actions_model.empty()) {
+    actions_suggestions =
+        ActionsSuggestions::FromPath(flags.actions_model, &actions_unilib);
+    if (actions_suggestions == nullptr) {
+      std::cerr << "Could not load actions model: " << flags.actions_model
+                << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<std::unique_ptr<RecordedRequestT>> requests;
+  if (!ReadRequestLog(flags.log, &requests)) {
+    std::cerr << "Could not read request log: " << flags.log << std::endl;
+    return 1;
+  }
+
+  LatencyStats recorded_stats;
+  LatencyStats replayed_stats;
+  int num_skipped = 0;
+  int num_differences = 0;
+  int64 total_delta_us = 0;
+  for (int i = 0; i < requests.size(); ++i) {
+    RecordedRequestT* request = requests[i].get();
+    if (flags.reference_time_ms_utc != 0) {
+      request->reference_time_ms_utc = flags.reference_time_ms_utc;
+      for (auto& message : request->messages) {
+        message->reference_time_ms_utc = flags.reference_time_ms_utc;
+      }
+    }
+
+    std::string output;
+    int64 latency_us = -1;
+    bool supported = true;
+    for (int repetition = 0; repetition < flags.repetitions && supported;
+         ++repetition) {
+      const auto start = std::chrono::steady_clock::now();
+      supported = RunRequest(annotator.get(), actions_suggestions.get(),
+                             *request, &output);
+      const int64 run_latency_us =
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count();
+      if (latency_us < 0 || run_latency_us < latency_us) {
+        latency_us = run_latency_us;
+      }
+    }
+    if (!supported) {
+      ++num_skipped;
+      std::cerr << "#" << i << " " << RequestTypeName(request->type)
+                << ": skipped, no model loaded for the request type."
+                << std::endl;
+      continue;
+    }
+
+    recorded_stats.Add(request->latency_us);
+    replayed_stats.Add(latency_us);
+    total_delta_us += latency_us - request->latency_us;
+    const bool differs = (output != request->output);
+    if (differs) {
+      ++num_differences;
+    }
+    if (!flags.quiet || differs) {
+      std::cout << "#" << i << " " << RequestTypeName(request->type)
+                << " recorded: " << request->latency_us
+                << "us replayed: " << latency_us
+                << "us delta: " << (latency_us - request->latency_us) << "us"
+                << (differs ? " OUTPUT DIFFERS" : "") << std::endl;
+    }
+    if (differs) {
+      std::cout << "  recorded: " << request->output << std::endl
+                << "  replayed: " << output << std::endl;
+    }
+  }
+
+  const int num_replayed = requests.size() - num_skipped;
+  std::cout << "Replayed " << num_replayed << " of " << requests.size()
+            << " requests, " << num_differences << " with different output."
+            << std::endl;
+  if (num_replayed > 0) {
+    std::cout << "Mean latency delta: " << (total_delta_us / num_replayed)
+              << "us" << std::endl
+              << "Recorded " << recorded_stats.Summary(/*wall_time_s=*/0)
+              << std::endl
+              << "Replayed " << replayed_stats.Summary(/*wall_time_s=*/0)
+              << std::endl;
+  }
+  return num_differences > 0 ? 2 : 0;
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
+
+int main(int argc, char** argv) {
+  return libtextclassifier3::Run(argc, argv);
+}
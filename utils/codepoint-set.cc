@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/codepoint-set.h"
+
+#include <algorithm>
+
+namespace libtextclassifier3 {
+
+constexpr char32 CodepointSet::kNumBmpCodepoints;
+
+CodepointSet::CodepointSet(std::initializer_list<char32> codepoints) {
+  for (const char32 codepoint : codepoints) {
+    Add(codepoint);
+  }
+}
+
+void CodepointSet::AddRange(char32 start, char32 end) {
+  start = std::max(start, 0);
+  if (start >= end) {
+    return;
+  }
+
+  // Part in the Basic Multilingual Plane.
+  const char32 bmp_end = std::min(end, kNumBmpCodepoints);
+  if (start < bmp_end) {
+    const int num_words = ((bmp_end - 1) >> 6) + 1;
+    if (num_words > static_cast<int>(bmp_words_.size())) {
+      bmp_words_.resize(num_words, 0);
+    }
+    for (char32 codepoint = start; codepoint < bmp_end; ++codepoint) {
+      bmp_words_[codepoint >> 6] |= static_cast<uint64>(1) << (codepoint & 63);
+    }
+  }
+
+  // Supplementary part.
+  start = std::max(start, kNumBmpCodepoints);
+  if (start >= end) {
+    return;
+  }
+  supplementary_ranges_.push_back({start, end});
+  std::sort(supplementary_ranges_.begin(), supplementary_ranges_.end(),
+            [](const Range& a, const Range& b) { return a.start < b.start; });
+  std::vector<Range> merged;
+  for (const Range& range : supplementary_ranges_) {
+    if (!merged.empty() && range.start <= merged.back().end) {
+      merged.back().end = std::max(merged.back().end, range.end);
+    } else {
+      merged.push_back(range);
+    }
+  }
+  supplementary_ranges_.swap(merged);
+}
+
+bool CodepointSet::ContainsSupplementary(char32 codepoint) const {
+  // First range that ends after the codepoint.
+  const auto it = std::upper_bound(
+      supplementary_ranges_.begin(), supplementary_ranges_.end(), codepoint,
+      [](char32 codepoint, const Range& range) {
+        return codepoint < range.end;
+      });
+  return it != supplementary_ranges_.end() && it->start <= codepoint;
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBTEXTCLASSIFIER_UTILS_CODEPOINT_SET_H_
+#define LIBTEXTCLASSIFIER_UTILS_CODEPOINT_SET_H_
+
+#include <initializer_list>
+#include <vector>
+
+#include "utils/base/integral_types.h"
+
+namespace libtextclassifier3 {
+
+// Compact set of codepoints for membership tests in hot loops.
+//
+// Codepoints from the Basic Multilingual Plane are kept in a bitmap that is
+// only as large as the largest such codepoint added, so a lookup is a single
+// bit test. Supplementary codepoints are kept as sorted, merged ranges and
+// looked up with a binary search.
+//
+// The set is meant to be built once, e.g. at model load, and then only read;
+// concurrent calls to Contains are safe.
+class CodepointSet {
+ public:
+  CodepointSet() = default;
+  CodepointSet(std::initializer_list<char32> codepoints);
+
+  // Adds a single codepoint.
+  void Add(char32 codepoint) { AddRange(codepoint, codepoint + 1); }
+
+  // Adds the codepoint range [start, end).
+  void AddRange(char32 start, char32 end);
+
+  bool Contains(char32 codepoint) const {
+    if (codepoint < 0) {
+      return false;
+    }
+    if (codepoint < kNumBmpCodepoints) {
+      const int word = codepoint >> 6;
+      return word < static_cast<int>(bmp_words_.size()) &&
+             ((bmp_words_[word] >> (codepoint & 63)) & 1);
+    }
+    return !supplementary_ranges_.empty() &&
+           ContainsSupplementary(codepoint);
+  }
+
+  bool empty() const {
+    return bmp_words_.empty() && supplementary_ranges_.empty();
+  }
+
+ private:
+  static constexpr char32 kNumBmpCodepoints = 0x10000;
+
+  struct Range {
+    char32 start;
+    char32 end;
+  };
+
+  bool ContainsSupplementary(char32 codepoint) const;
+
+  std::vector<uint64> bmp_words_;
+
+  // Sorted, non-overlapping and non-adjacent ranges [start, end) of
+  // codepoints outside of the Basic Multilingual Plane.
+  std::vector<Range> supplementary_ranges_;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_UTILS_CODEPOINT_SET_H_
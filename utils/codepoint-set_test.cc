@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/codepoint-set.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+TEST(CodepointSetTest, EmptySetContainsNothing) {
+  const CodepointSet set;
+  EXPECT_TRUE(set.empty());
+  EXPECT_FALSE(set.Contains(0));
+  EXPECT_FALSE(set.Contains('a'));
+  EXPECT_FALSE(set.Contains(0x1F600));
+  EXPECT_FALSE(set.Contains(-1));
+}
+
+TEST(CodepointSetTest, ContainsAddedCodepoints) {
+  const CodepointSet set{'\n', '|', 0x2014, 0x1F600};
+  EXPECT_FALSE(set.empty());
+  EXPECT_TRUE(set.Contains('\n'));
+  EXPECT_TRUE(set.Contains('|'));
+  EXPECT_TRUE(set.Contains(0x2014));
+  EXPECT_TRUE(set.Contains(0x1F600));
+  EXPECT_FALSE(set.Contains(' '));
+  EXPECT_FALSE(set.Contains(0x2015));
+  EXPECT_FALSE(set.Contains(0xFFFF));
+  EXPECT_FALSE(set.Contains(0x1F601));
+}
+
+TEST(CodepointSetTest, ContainsAddedRanges) {
+  CodepointSet set;
+  set.AddRange(0, 128);
+  set.AddRange(10000, 10001);
+  set.AddRange(0xFFF0, 0x10010);
+  set.AddRange(0x20000, 0x20010);
+  set.AddRange(0x20008, 0x20020);
+  EXPECT_TRUE(set.Contains(0));
+  EXPECT_TRUE(set.Contains(127));
+  EXPECT_FALSE(set.Contains(128));
+  EXPECT_FALSE(set.Contains(9999));
+  EXPECT_TRUE(set.Contains(10000));
+  EXPECT_FALSE(set.Contains(10001));
+  EXPECT_TRUE(set.Contains(0xFFFF));
+  EXPECT_TRUE(set.Contains(0x10000));
+  EXPECT_TRUE(set.Contains(0x1000F));
+  EXPECT_FALSE(set.Contains(0x10010));
+  EXPECT_TRUE(set.Contains(0x20000));
+  EXPECT_TRUE(set.Contains(0x2001F));
+  EXPECT_FALSE(set.Contains(0x20020));
+}
+
+TEST(CodepointSetTest, IgnoresEmptyAndNegativeRanges) {
+  CodepointSet set;
+  set.AddRange(20, 10);
+  set.AddRange(-5, 0);
+  EXPECT_TRUE(set.empty());
+  set.AddRange(-5, 1);
+  EXPECT_TRUE(set.Contains(0));
+  EXPECT_FALSE(set.Contains(-1));
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Interface for running the asynchronous variants of the public APIs on a
+// caller-supplied thread pool or event loop.
+
+#ifndef LIBTEXTCLASSIFIER_UTILS_EXECUTOR_H_
+#define LIBTEXTCLASSIFIER_UTILS_EXECUTOR_H_
+
+#include <functional>
+
+namespace libtextclassifier3 {
+
+// Runs tasks on behalf of the asynchronous APIs. A single request may be split
+// into several tasks that are scheduled one after another, so that long
+// requests yield between their stages and do not monopolize a worker.
+// Implementations must be thread-safe.
+class Executor {
+ public:
+  virtual ~Executor() {}
+
+  // Schedules 'task' to be run exactly once. The task may be run on any
+  // thread, including the calling one.
+  virtual void Schedule(std::function<void()> task) = 0;
+};
+
+// Executor that runs every task immediately on the calling thread. Makes the
+// asynchronous APIs behave like the blocking ones.
+class InlineExecutor : public Executor {
+ public:
+  void Schedule(std::function<void()> task) override { task(); }
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_UTILS_EXECUTOR_H_
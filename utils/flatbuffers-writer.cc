@@ -0,0 +1,547 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/flatbuffers-writer.h"
+
+#include <algorithm>
+
+#include "utils/base/logging.h"
+#include "utils/flatbuffers.h"
+#include "utils/strings/numbers.h"
+
+namespace libtextclassifier3 {
+
+std::unique_ptr<CompiledFlatbufferSchema> CompiledFlatbufferSchema::Create(
+    const reflection::Schema* schema) {
+  if (schema == nullptr || schema->root_table() == nullptr ||
+      schema->objects() == nullptr) {
+    TC3_LOG(ERROR) << "No root table specified.";
+    return nullptr;
+  }
+  std::unique_ptr<CompiledFlatbufferSchema> compiled(
+      new CompiledFlatbufferSchema(schema));
+  compiled->tables_.resize(schema->objects()->size());
+  for (int i = 0; i < schema->objects()->size(); i++) {
+    const reflection::Object* object = schema->objects()->Get(i);
+    Table* table = &compiled->tables_[i];
+    table->object = object;
+    if (object == schema->root_table()) {
+      compiled->root_table_ = i;
+    }
+    if (object->fields() == nullptr) {
+      continue;
+    }
+    for (const reflection::Field* field : *object->fields()) {
+      if (field->id() >= table->fields.size()) {
+        table->fields.resize(field->id() + 1);
+      }
+      Field* compiled_field = &table->fields[field->id()];
+      compiled_field->field = field;
+      compiled_field->base_type = field->type()->base_type();
+      compiled_field->offset = field->offset();
+      if (compiled_field->base_type == reflection::Obj) {
+        compiled_field->table = field->type()->index();
+      }
+    }
+  }
+  if (compiled->root_table_ < 0) {
+    TC3_LOG(ERROR) << "Root table is not part of the schema objects.";
+    return nullptr;
+  }
+  return compiled;
+}
+
+const CompiledFlatbufferSchema::Field*
+CompiledFlatbufferSchema::FieldByIdOrNull(const int table, const int id) const {
+  const std::vector<Field>& fields = tables_[table].fields;
+  if (id < 0 || id >= fields.size() || fields[id].field == nullptr) {
+    return nullptr;
+  }
+  return &fields[id];
+}
+
+const CompiledFlatbufferSchema::Field* CompiledFlatbufferSchema::FieldOrNull(
+    const int table, const StringPiece field_name) const {
+  const reflection::Object* object = tables_[table].object;
+  if (object->fields() == nullptr) {
+    return nullptr;
+  }
+  const reflection::Field* field =
+      object->fields()->LookupByKey(field_name.ToString().c_str());
+  if (field == nullptr) {
+    return nullptr;
+  }
+  return FieldByIdOrNull(table, field->id());
+}
+
+const CompiledFlatbufferSchema::Field* CompiledFlatbufferSchema::FieldOrNull(
+    const int table, const FlatbufferField* field) const {
+  if (field->field_name() != nullptr) {
+    const reflection::Object* object = tables_[table].object;
+    if (object->fields() == nullptr) {
+      return nullptr;
+    }
+    const reflection::Field* named_field =
+        object->fields()->LookupByKey(field->field_name()->c_str());
+    if (named_field == nullptr) {
+      return nullptr;
+    }
+    return FieldByIdOrNull(table, named_field->id());
+  }
+  return FieldByOffsetOrNull(table, field->field_offset());
+}
+
+const CompiledFlatbufferSchema::Field*
+CompiledFlatbufferSchema::FieldByOffsetOrNull(const int table,
+                                              const int field_offset) const {
+  // Vtable offsets are assigned from the field ids.
+  const int id = (field_offset - flatbuffers::FieldIndexToOffset(0)) /
+                 static_cast<int>(sizeof(flatbuffers::voffset_t));
+  const Field* field = FieldByIdOrNull(table, id);
+  if (field == nullptr || field->offset != field_offset) {
+    return nullptr;
+  }
+  return field;
+}
+
+bool CompiledFlatbufferSchema::ResolveFieldPath(
+    const FlatbufferFieldPath* field_path, FieldPath* resolved) const {
+  resolved->clear();
+  const auto* path = field_path->field();
+  if (path == nullptr || path->size() == 0) {
+    return false;
+  }
+  int table = root_table_;
+  for (int i = 0; i < path->size(); i++) {
+    if (table < 0) {
+      TC3_LOG(ERROR) << "Field is not of type Object.";
+      resolved->clear();
+      return false;
+    }
+    const Field* field = FieldOrNull(table, path->Get(i));
+    if (field == nullptr) {
+      resolved->clear();
+      return false;
+    }
+    resolved->push_back(field);
+    table = field->table;
+  }
+  return true;
+}
+
+constexpr FlatbufferWriter::Message FlatbufferWriter::kRoot;
+
+FlatbufferWriter::FlatbufferWriter(const CompiledFlatbufferSchema* schema)
+    : schema_(schema) {
+  Reset();
+}
+
+void FlatbufferWriter::Reset() {
+  messages_.clear();
+  values_.clear();
+  strings_.clear();
+  messages_.push_back({schema_->root_table(), /*parent=*/-1,
+                       /*field=*/nullptr});
+}
+
+FlatbufferWriter::Message FlatbufferWriter::Mutable(const Message message,
+                                                    const Field* field) {
+  if (field->base_type != reflection::Obj) {
+    TC3_LOG(ERROR) << "Field is not of type Object.";
+    return -1;
+  }
+  for (int i = 1; i < messages_.size(); i++) {
+    if (messages_[i].parent == message && messages_[i].field == field) {
+      return i;
+    }
+  }
+  messages_.push_back({field->table, message, field});
+  return messages_.size() - 1;
+}
+
+FlatbufferWriter::Value* FlatbufferWriter::MutableValue(const Message message,
+                                                        const Field* field) {
+  for (Value& value : values_) {
+    if (value.message == message && value.field == field) {
+      return &value;
+    }
+  }
+  values_.emplace_back();
+  Value* value = &values_.back();
+  value->message = message;
+  value->field = field;
+  value->int_value = 0;
+  value->string_begin = 0;
+  value->string_size = 0;
+  return value;
+}
+
+bool FlatbufferWriter::CheckType(const Field* field,
+                                 const reflection::BaseType base_type) const {
+  if (field == nullptr) {
+    TC3_LOG(ERROR) << "Expected non-null field.";
+    return false;
+  }
+  if (field->base_type != base_type) {
+    TC3_LOG(ERROR) << "Type mismatch for field `" << field->field->name()->str()
+                   << "`, expected: " << field->base_type
+                   << ", got: " << base_type;
+    return false;
+  }
+  return true;
+}
+
+bool FlatbufferWriter::Set(const Message message, const Field* field,
+                           const bool value) {
+  if (!CheckType(field, reflection::Bool)) {
+    return false;
+  }
+  MutableValue(message, field)->int_value = value;
+  return true;
+}
+
+bool FlatbufferWriter::Set(const Message message, const Field* field,
+                           const int32 value) {
+  if (!CheckType(field, reflection::Int)) {
+    return false;
+  }
+  MutableValue(message, field)->int_value = value;
+  return true;
+}
+
+bool FlatbufferWriter::Set(const Message message, const Field* field,
+                           const int64 value) {
+  if (!CheckType(field, reflection::Long)) {
+    return false;
+  }
+  MutableValue(message, field)->int_value = value;
+  return true;
+}
+
+bool FlatbufferWriter::Set(const Message message, const Field* field,
+                           const float value) {
+  if (!CheckType(field, reflection::Float)) {
+    return false;
+  }
+  MutableValue(message, field)->real_value = value;
+  return true;
+}
+
+bool FlatbufferWriter::Set(const Message message, const Field* field,
+                           const double value) {
+  if (!CheckType(field, reflection::Double)) {
+    return false;
+  }
+  MutableValue(message, field)->real_value = value;
+  return true;
+}
+
+bool FlatbufferWriter::Set(const Message message, const Field* field,
+                           const StringPiece value) {
+  if (!CheckType(field, reflection::String)) {
+    return false;
+  }
+  Value* string_value = MutableValue(message, field);
+  string_value->string_begin = strings_.size();
+  string_value->string_size = value.size();
+  strings_.append(value.data(), value.size());
+  return true;
+}
+
+bool FlatbufferWriter::ParseAndSet(const Message message, const Field* field,
+                                   const std::string& value) {
+  switch (field->base_type) {
+    case reflection::String:
+      return Set(message, field, StringPiece(value));
+    case reflection::Int: {
+      int32 int_value;
+      if (!ParseInt32(value.data(), &int_value)) {
+        TC3_LOG(ERROR) << "Could not parse '" << value << "' as int32.";
+        return false;
+      }
+      return Set(message, field, int_value);
+    }
+    case reflection::Long: {
+      int64 int_value;
+      if (!ParseInt64(value.data(), &int_value)) {
+        TC3_LOG(ERROR) << "Could not parse '" << value << "' as int64.";
+        return false;
+      }
+      return Set(message, field, int_value);
+    }
+    case reflection::Float: {
+      double double_value;
+      if (!ParseDouble(value.data(), &double_value)) {
+        TC3_LOG(ERROR) << "Could not parse '" << value << "' as float.";
+        return false;
+      }
+      return Set(message, field, static_cast<float>(double_value));
+    }
+    case reflection::Double: {
+      double double_value;
+      if (!ParseDouble(value.data(), &double_value)) {
+        TC3_LOG(ERROR) << "Could not parse '" << value << "' as double.";
+        return false;
+      }
+      return Set(message, field, double_value);
+    }
+    default:
+      TC3_LOG(ERROR) << "Unhandled field type: " << field->base_type;
+      return false;
+  }
+}
+
+bool FlatbufferWriter::ParseAndSet(const FlatbufferFieldPath* path,
+                                   const std::string& value) {
+  Message parent;
+  const Field* field;
+  if (!GetFieldWithParent(path, &parent, &field)) {
+    return false;
+  }
+  return ParseAndSet(parent, field, value);
+}
+
+bool FlatbufferWriter::ParseAndSet(const FieldPath& path,
+                                   const std::string& value) {
+  if (path.empty()) {
+    return false;
+  }
+  Message parent = kRoot;
+  for (int i = 0; i + 1 < path.size(); i++) {
+    parent = Mutable(parent, path[i]);
+    if (parent < 0) {
+      return false;
+    }
+  }
+  return ParseAndSet(parent, path.back(), value);
+}
+
+bool FlatbufferWriter::GetFieldWithParent(
+    const FlatbufferFieldPath* field_path, Message* parent,
+    const Field** field) {
+  const auto* path = field_path->field();
+  if (path == nullptr || path->size() == 0) {
+    return false;
+  }
+
+  for (int i = 0; i < path->size(); i++) {
+    *parent = (i == 0 ? kRoot : Mutable(*parent, *field));
+    if (*parent < 0) {
+      return false;
+    }
+    *field = schema_->FieldOrNull(messages_[*parent].table, path->Get(i));
+    if (*field == nullptr) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool FlatbufferWriter::MergeFrom(const Message message,
+                                 const flatbuffers::Table* from) {
+  const reflection::Object* object =
+      schema_->table(messages_[message].table).object;
+
+  // No fields to set.
+  if (object->fields() == nullptr) {
+    return true;
+  }
+
+  for (const reflection::Field* reflection_field : *object->fields()) {
+    // Skip fields that are not explicitly set.
+    if (!from->CheckField(reflection_field->offset())) {
+      continue;
+    }
+    const Field* field = &schema_->table(messages_[message].table)
+                              .fields[reflection_field->id()];
+    switch (field->base_type) {
+      case reflection::Bool:
+        Set(message, field,
+            static_cast<bool>(from->GetField<uint8_t>(
+                field->offset, reflection_field->default_integer())));
+        break;
+      case reflection::Int:
+        Set(message, field,
+            from->GetField<int32>(field->offset,
+                                  reflection_field->default_integer()));
+        break;
+      case reflection::Long:
+        Set(message, field,
+            from->GetField<int64>(field->offset,
+                                  reflection_field->default_integer()));
+        break;
+      case reflection::Float:
+        Set(message, field,
+            from->GetField<float>(field->offset,
+                                  reflection_field->default_real()));
+        break;
+      case reflection::Double:
+        Set(message, field,
+            from->GetField<double>(field->offset,
+                                   reflection_field->default_real()));
+        break;
+      case reflection::String: {
+        const flatbuffers::String* value =
+            from->GetPointer<const flatbuffers::String*>(field->offset);
+        Set(message, field, StringPiece(value->c_str(), value->size()));
+        break;
+      }
+      case reflection::Obj: {
+        const Message child = Mutable(message, field);
+        if (!MergeFrom(child,
+                       from->GetPointer<const flatbuffers::Table* const>(
+                           field->offset))) {
+          return false;
+        }
+        break;
+      }
+      default:
+        TC3_LOG(ERROR) << "Unsupported type: " << field->base_type;
+        return false;
+    }
+  }
+  return true;
+}
+
+bool FlatbufferWriter::MergeFromSerializedFlatbuffer(StringPiece from) {
+  return MergeFrom(kRoot, flatbuffers::GetAnyRoot(
+                              reinterpret_cast<const unsigned char*>(
+                                  from.data())));
+}
+
+flatbuffers::uoffset_t FlatbufferWriter::SerializeMessage(
+    const Message message, flatbuffers::FlatBufferBuilder* builder) {
+  // Children and values are sorted by message and then by the address of the
+  // reflection field data, which is the order in which `ReflectiveFlatbuffer`
+  // keeps them, so that both produce the same bytes.
+  const size_t offsets_start = offsets_.size();
+
+  // Build all children before we can start with this table.
+  const auto children_begin = std::lower_bound(
+      children_.begin(), children_.end(), message,
+      [](const std::pair<Message, Message>& child, const Message parent) {
+        return child.first < parent;
+      });
+  for (auto it = children_begin;
+       it != children_.end() && it->first == message; ++it) {
+    const uint16 offset = messages_[it->second].field->offset;
+    const flatbuffers::uoffset_t child_offset =
+        SerializeMessage(it->second, builder);
+    offsets_.push_back({offset, child_offset});
+  }
+
+  // Create strings.
+  const auto values_begin = std::lower_bound(
+      values_.begin(), values_.end(), message,
+      [](const Value& value, const Message key) {
+        return value.message < key;
+      });
+  const auto values_end = std::upper_bound(
+      values_begin, values_.end(), message,
+      [](const Message key, const Value& value) {
+        return key < value.message;
+      });
+  for (auto it = values_begin; it != values_end; ++it) {
+    if (it->field->base_type == reflection::String) {
+      offsets_.push_back(
+          {it->field->offset,
+           builder->CreateString(strings_.data() + it->string_begin,
+                                 it->string_size)
+               .o});
+    }
+  }
+
+  // Build the table now.
+  const flatbuffers::uoffset_t table_start = builder->StartTable();
+
+  // Add scalar fields.
+  for (auto it = values_begin; it != values_end; ++it) {
+    const reflection::Field* field = it->field->field;
+    switch (it->field->base_type) {
+      case reflection::Bool:
+        builder->AddElement<uint8_t>(
+            it->field->offset, static_cast<uint8_t>(it->int_value),
+            static_cast<uint8_t>(field->default_integer()));
+        continue;
+      case reflection::Int:
+        builder->AddElement<int32>(
+            it->field->offset, static_cast<int32>(it->int_value),
+            static_cast<int32>(field->default_integer()));
+        continue;
+      case reflection::Long:
+        builder->AddElement<int64>(it->field->offset, it->int_value,
+                                   field->default_integer());
+        continue;
+      case reflection::Float:
+        builder->AddElement<float>(
+            it->field->offset, static_cast<float>(it->real_value),
+            static_cast<float>(field->default_real()));
+        continue;
+      case reflection::Double:
+        builder->AddElement<double>(it->field->offset, it->real_value,
+                                    field->default_real());
+        continue;
+      default:
+        continue;
+    }
+  }
+
+  // Add strings and subtables.
+  for (size_t i = offsets_start; i < offsets_.size(); i++) {
+    builder->AddOffset(offsets_[i].first,
+                       flatbuffers::Offset<void>(offsets_[i].second));
+  }
+  offsets_.resize(offsets_start);
+
+  return builder->EndTable(table_start);
+}
+
+void FlatbufferWriter::Serialize(std::string* serialized) {
+  std::sort(values_.begin(), values_.end(),
+            [](const Value& a, const Value& b) {
+              if (a.message != b.message) {
+                return a.message < b.message;
+              }
+              return a.field->field < b.field->field;
+            });
+  children_.clear();
+  for (int i = 1; i < messages_.size(); i++) {
+    children_.push_back({messages_[i].parent, i});
+  }
+  std::sort(children_.begin(), children_.end(),
+            [this](const std::pair<Message, Message>& a,
+                   const std::pair<Message, Message>& b) {
+              if (a.first != b.first) {
+                return a.first < b.first;
+              }
+              return messages_[a.second].field->field <
+                     messages_[b.second].field->field;
+            });
+
+  PooledFlatBufferBuilder builder;
+  builder->Finish(
+      flatbuffers::Offset<void>(SerializeMessage(kRoot, builder.get())));
+  CopyFinishedFlatbuffer(*builder, serialized);
+}
+
+std::string FlatbufferWriter::Serialize() {
+  std::string serialized;
+  Serialize(&serialized);
+  return serialized;
+}
+
+}  // namespace libtextclassifier3
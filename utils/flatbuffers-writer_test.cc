@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/flatbuffers-writer.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "utils/flatbuffers.h"
+#include "utils/flatbuffers_generated.h"
+#include "utils/flatbuffers_test_generated.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "flatbuffers/flatbuffers.h"
+#include "flatbuffers/reflection.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+std::string LoadTestMetadata() {
+  std::ifstream test_config_stream(std::string(TC3_TEST_DATA_DIR) +
+                                   "flatbuffers_test.bfbs");
+  return std::string((std::istreambuf_iterator<char>(test_config_stream)),
+                     (std::istreambuf_iterator<char>()));
+}
+
+std::string FieldPath(const std::vector<std::string>& names) {
+  FlatbufferFieldPathT path;
+  for (const std::string& name : names) {
+    path.field.emplace_back(new FlatbufferFieldT);
+    path.field.back()->field_name = name;
+  }
+  return PackFlatbuffer<FlatbufferFieldPath>(&path);
+}
+
+class FlatbufferWriterTest : public testing::Test {
+ protected:
+  FlatbufferWriterTest()
+      : metadata_buffer_(LoadTestMetadata()),
+        schema_(flatbuffers::GetRoot<reflection::Schema>(
+            metadata_buffer_.data())),
+        compiled_schema_(CompiledFlatbufferSchema::Create(schema_)),
+        reflective_builder_(schema_) {}
+
+  const CompiledFlatbufferSchema::Field* Field(
+      const std::string& table, const std::string& field_name) const {
+    for (int i = 0; i < schema_->objects()->size(); i++) {
+      if (schema_->objects()->Get(i)->name()->str() == table) {
+        return compiled_schema_->FieldOrNull(i, field_name);
+      }
+    }
+    return nullptr;
+  }
+
+  const std::string metadata_buffer_;
+  const reflection::Schema* schema_;
+  const std::unique_ptr<CompiledFlatbufferSchema> compiled_schema_;
+  const ReflectiveFlatbufferBuilder reflective_builder_;
+};
+
+TEST_F(FlatbufferWriterTest, ResolvesFieldsByNameAndOffset) {
+  ASSERT_TRUE(compiled_schema_ != nullptr);
+  const int root = compiled_schema_->root_table();
+  const CompiledFlatbufferSchema::Field* flight_number =
+      compiled_schema_->FieldOrNull(root, "flight_number");
+  ASSERT_TRUE(flight_number != nullptr);
+  EXPECT_EQ(flight_number->base_type, reflection::Obj);
+  EXPECT_EQ(compiled_schema_->FieldByOffsetOrNull(root, flight_number->offset),
+            flight_number);
+  EXPECT_EQ(compiled_schema_->FieldOrNull(root, "unknown_field"), nullptr);
+  EXPECT_EQ(compiled_schema_->FieldByOffsetOrNull(root, 1000), nullptr);
+}
+
+TEST_F(FlatbufferWriterTest, PrimitiveFieldsAreCorrectlySet) {
+  FlatbufferWriter writer(compiled_schema_.get());
+  EXPECT_TRUE(writer.Set("an_int_field", 42));
+  EXPECT_TRUE(writer.Set("a_long_field", 84ll));
+  EXPECT_TRUE(writer.Set("a_bool_field", true));
+  EXPECT_TRUE(writer.Set("a_float_field", 1.f));
+  EXPECT_TRUE(writer.Set("a_double_field", 1.0));
+  EXPECT_FALSE(writer.Set("an_int_field", 1.0));
+  EXPECT_FALSE(writer.Set("unknown_field", 42));
+
+  const std::string serialized_entity_data = writer.Serialize();
+  std::unique_ptr<test::EntityDataT> entity_data =
+      LoadAndVerifyMutableFlatbuffer<test::EntityData>(
+          serialized_entity_data.data(), serialized_entity_data.size());
+  ASSERT_TRUE(entity_data != nullptr);
+  EXPECT_EQ(entity_data->an_int_field, 42);
+  EXPECT_EQ(entity_data->a_long_field, 84);
+  EXPECT_EQ(entity_data->a_bool_field, true);
+  EXPECT_NEAR(entity_data->a_float_field, 1.f, 1e-4);
+  EXPECT_NEAR(entity_data->a_double_field, 1.f, 1e-4);
+}
+
+TEST_F(FlatbufferWriterTest, ProducesSameBytesAsReflectiveFlatbuffer) {
+  const std::string carrier_code_path =
+      FieldPath({"flight_number", "carrier_code"});
+  const std::string first_name_path = FieldPath({"contact_info", "first_name"});
+  const std::string score_path = FieldPath({"contact_info", "score"});
+
+  std::unique_ptr<ReflectiveFlatbuffer> buffer = reflective_builder_.NewRoot();
+  buffer->Set("a_double_field", 2.0);
+  buffer->Set("an_int_field", 42);
+  buffer->ParseAndSet(
+      flatbuffers::GetRoot<FlatbufferFieldPath>(first_name_path.data()),
+      "Barack");
+  buffer->ParseAndSet(
+      flatbuffers::GetRoot<FlatbufferFieldPath>(carrier_code_path.data()),
+      "LX");
+  buffer->ParseAndSet(
+      flatbuffers::GetRoot<FlatbufferFieldPath>(score_path.data()), "0.5");
+  buffer->Set("an_int_field", 43);
+
+  FlatbufferWriter writer(compiled_schema_.get());
+  writer.Set("a_double_field", 2.0);
+  writer.Set("an_int_field", 42);
+  writer.ParseAndSet(
+      flatbuffers::GetRoot<FlatbufferFieldPath>(first_name_path.data()),
+      "Barack");
+  writer.ParseAndSet(
+      flatbuffers::GetRoot<FlatbufferFieldPath>(carrier_code_path.data()),
+      "LX");
+  writer.ParseAndSet(
+      flatbuffers::GetRoot<FlatbufferFieldPath>(score_path.data()), "0.5");
+  writer.Set("an_int_field", 43);
+
+  EXPECT_EQ(writer.Serialize(), buffer->Serialize());
+}
+
+TEST_F(FlatbufferWriterTest, PartialBuffersAreMergedLikeReflectiveFlatbuffer) {
+  test::EntityDataT additional_entity_data;
+  additional_entity_data.an_int_field = 43;
+  additional_entity_data.flight_number.reset(new test::FlightNumberInfoT);
+  additional_entity_data.flight_number->flight_code = 39;
+  additional_entity_data.contact_info.reset(new test::ContactInfoT);
+  additional_entity_data.contact_info->first_name = "Barack";
+  const std::string to_merge =
+      PackFlatbuffer<test::EntityData>(&additional_entity_data);
+
+  std::unique_ptr<ReflectiveFlatbuffer> buffer = reflective_builder_.NewRoot();
+  buffer->Set("a_long_field", 84ll);
+  buffer->Mutable("flight_number")->Set("carrier_code", "LX");
+  EXPECT_TRUE(buffer->MergeFromSerializedFlatbuffer(to_merge));
+
+  FlatbufferWriter writer(compiled_schema_.get());
+  writer.Set("a_long_field", 84ll);
+  writer.Set(writer.Mutable(FlatbufferWriter::kRoot,
+                            Field("libtextclassifier3.test.EntityData",
+                                  "flight_number")),
+             Field("libtextclassifier3.test.FlightNumberInfo", "carrier_code"),
+             "LX");
+  EXPECT_TRUE(writer.MergeFromSerializedFlatbuffer(to_merge));
+
+  const std::string serialized_entity_data = writer.Serialize();
+  EXPECT_EQ(serialized_entity_data, buffer->Serialize());
+
+  std::unique_ptr<test::EntityDataT> entity_data =
+      LoadAndVerifyMutableFlatbuffer<test::EntityData>(
+          serialized_entity_data.data(), serialized_entity_data.size());
+  ASSERT_TRUE(entity_data != nullptr);
+  EXPECT_EQ(entity_data->an_int_field, 43);
+  EXPECT_EQ(entity_data->a_long_field, 84);
+  EXPECT_EQ(entity_data->flight_number->carrier_code, "LX");
+  EXPECT_EQ(entity_data->flight_number->flight_code, 39);
+  EXPECT_EQ(entity_data->contact_info->first_name, "Barack");
+}
+
+TEST_F(FlatbufferWriterTest, ResolvedFieldPathsSetTheSameFields) {
+  const std::string carrier_code_path =
+      FieldPath({"flight_number", "carrier_code"});
+  FlatbufferWriter::FieldPath resolved;
+  ASSERT_TRUE(compiled_schema_->ResolveFieldPath(
+      flatbuffers::GetRoot<FlatbufferFieldPath>(carrier_code_path.data()),
+      &resolved));
+  EXPECT_EQ(resolved.size(), 2);
+
+  FlatbufferWriter writer(compiled_schema_.get());
+  EXPECT_TRUE(writer.ParseAndSet(
+      flatbuffers::GetRoot<FlatbufferFieldPath>(carrier_code_path.data()),
+      "LX"));
+  const std::string expected = writer.Serialize();
+
+  writer.Reset();
+  EXPECT_TRUE(writer.ParseAndSet(resolved, "LX"));
+  EXPECT_EQ(writer.Serialize(), expected);
+}
+
+TEST_F(FlatbufferWriterTest, DoesNotResolveUnknownFieldPaths) {
+  FlatbufferWriter::FieldPath resolved;
+  const std::string unknown_path = FieldPath({"flight_number", "unknown"});
+  EXPECT_FALSE(compiled_schema_->ResolveFieldPath(
+      flatbuffers::GetRoot<FlatbufferFieldPath>(unknown_path.data()),
+      &resolved));
+  EXPECT_TRUE(resolved.empty());
+
+  // Only table fields can have nested fields.
+  const std::string scalar_path = FieldPath({"an_int_field", "carrier_code"});
+  EXPECT_FALSE(compiled_schema_->ResolveFieldPath(
+      flatbuffers::GetRoot<FlatbufferFieldPath>(scalar_path.data()),
+      &resolved));
+
+  FlatbufferWriter writer(compiled_schema_.get());
+  EXPECT_FALSE(writer.ParseAndSet(resolved, "LX"));
+}
+
+TEST_F(FlatbufferWriterTest, ResetStartsNewMessage) {
+  FlatbufferWriter writer(compiled_schema_.get());
+  writer.Set("an_int_field", 42);
+  writer.Set("a_bool_field", true);
+  const std::string first = writer.Serialize();
+
+  writer.Reset();
+  writer.Set("a_long_field", 84ll);
+  std::string second;
+  writer.Serialize(&second);
+
+  std::unique_ptr<ReflectiveFlatbuffer> buffer = reflective_builder_.NewRoot();
+  buffer->Set("a_long_field", 84ll);
+  EXPECT_EQ(second, buffer->Serialize());
+  EXPECT_NE(first, second);
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
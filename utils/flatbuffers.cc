@@ -58,6 +58,17 @@ bool CreateRepeatedField(
       return false;
   }
 }
+
+// Number of idle builders kept per thread. Covers the nesting depth of the
+// serialization paths; deeper nesting falls back to fresh builders.
+constexpr int kMaxPooledBuildersPerThread = 4;
+
+std::vector<std::unique_ptr<flatbuffers::FlatBufferBuilder>>*
+ThreadFlatBufferBuilderPool() {
+  thread_local std::vector<std::unique_ptr<flatbuffers::FlatBufferBuilder>>
+      pool;
+  return &pool;
+}
 }  // namespace
 
 template <>
@@ -65,6 +76,29 @@ const char* FlatbufferFileIdentifier<Model>() {
   return ModelIdentifier();
 }
 
+constexpr size_t PooledFlatBufferBuilder::kMaxPooledSize;
+
+PooledFlatBufferBuilder::PooledFlatBufferBuilder() {
+  std::vector<std::unique_ptr<flatbuffers::FlatBufferBuilder>>* pool =
+      ThreadFlatBufferBuilderPool();
+  if (pool->empty()) {
+    builder_.reset(new flatbuffers::FlatBufferBuilder());
+  } else {
+    builder_ = std::move(pool->back());
+    pool->pop_back();
+  }
+}
+
+PooledFlatBufferBuilder::~PooledFlatBufferBuilder() {
+  std::vector<std::unique_ptr<flatbuffers::FlatBufferBuilder>>* pool =
+      ThreadFlatBufferBuilderPool();
+  if (pool->size() < kMaxPooledBuildersPerThread &&
+      builder_->GetSize() <= kMaxPooledSize) {
+    builder_->Clear();
+    pool->push_back(std::move(builder_));
+  }
+}
+
 std::unique_ptr<ReflectiveFlatbuffer> ReflectiveFlatbufferBuilder::NewRoot()
     const {
   if (!schema_->root_table()) {
@@ -338,10 +372,15 @@ flatbuffers::uoffset_t ReflectiveFlatbuffer::Serialize(
 }
 
 std::string ReflectiveFlatbuffer::Serialize() const {
-  flatbuffers::FlatBufferBuilder builder;
-  builder.Finish(flatbuffers::Offset<void>(Serialize(&builder)));
-  return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
-                     builder.GetSize());
+  std::string serialized;
+  Serialize(&serialized);
+  return serialized;
+}
+
+void ReflectiveFlatbuffer::Serialize(std::string* serialized) const {
+  PooledFlatBufferBuilder builder;
+  builder->Finish(flatbuffers::Offset<void>(Serialize(builder.get())));
+  CopyFinishedFlatbuffer(*builder, serialized);
 }
 
 bool ReflectiveFlatbuffer::MergeFrom(const flatbuffers::Table* from) {
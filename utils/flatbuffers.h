@@ -22,6 +22,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "annotator/model_generated.h"
 #include "utils/strings/stringpiece.h"
@@ -86,15 +87,58 @@ const char* FlatbufferFileIdentifier() {
 template <>
 const char* FlatbufferFileIdentifier<Model>();
 
+// A builder borrowed from a pool of the current thread for the lifetime of the
+// object. When returned, the builder is cleared but keeps its buffer, so that
+// serializing many messages on a thread does not grow a new buffer from the
+// default size every time. Pooled builders can be nested.
+// A builder that was used for a message larger than kMaxPooledSize is freed
+// instead, so that a single large message doesn't pin its buffer in the pool
+// of every thread that served one.
+class PooledFlatBufferBuilder {
+ public:
+  static constexpr size_t kMaxPooledSize = 64 * 1024;
+
+  PooledFlatBufferBuilder();
+  ~PooledFlatBufferBuilder();
+
+  PooledFlatBufferBuilder(const PooledFlatBufferBuilder&) = delete;
+  PooledFlatBufferBuilder& operator=(const PooledFlatBufferBuilder&) = delete;
+
+  flatbuffers::FlatBufferBuilder* get() const { return builder_.get(); }
+  flatbuffers::FlatBufferBuilder* operator->() const { return builder_.get(); }
+  flatbuffers::FlatBufferBuilder& operator*() const { return *builder_; }
+
+ private:
+  std::unique_ptr<flatbuffers::FlatBufferBuilder> builder_;
+};
+
+// Copies the finished buffer of the builder to `serialized`, reusing its
+// storage.
+inline void CopyFinishedFlatbuffer(
+    const flatbuffers::FlatBufferBuilder& builder, std::string* serialized) {
+  serialized->assign(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+                     builder.GetSize());
+}
+
+// Packs the mutable flatbuffer message into `serialized`, reusing its
+// storage.
+template <typename FlatbufferMessage>
+void PackFlatbuffer(
+    const typename FlatbufferMessage::NativeTableType* mutable_message,
+    std::string* serialized) {
+  PooledFlatBufferBuilder builder;
+  builder->Finish(FlatbufferMessage::Pack(*builder, mutable_message),
+                  FlatbufferFileIdentifier<FlatbufferMessage>());
+  CopyFinishedFlatbuffer(*builder, serialized);
+}
+
 // Packs the mutable flatbuffer message to string.
 template <typename FlatbufferMessage>
 std::string PackFlatbuffer(
     const typename FlatbufferMessage::NativeTableType* mutable_message) {
-  flatbuffers::FlatBufferBuilder builder;
-  builder.Finish(FlatbufferMessage::Pack(builder, mutable_message),
-                 FlatbufferFileIdentifier<FlatbufferMessage>());
-  return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
-                     builder.GetSize());
+  std::string serialized;
+  PackFlatbuffer<FlatbufferMessage>(mutable_message, &serialized);
+  return serialized;
 }
 
 // A flatbuffer that can be built using flatbuffer reflection data of the
@@ -274,6 +318,9 @@ class ReflectiveFlatbuffer {
       flatbuffers::FlatBufferBuilder* builder) const;
   std::string Serialize() const;
 
+  // Serializes the flatbuffer into `serialized`, reusing its storage.
+  void Serialize(std::string* serialized) const;
+
   // Merges the fields from the given flatbuffer table into this flatbuffer.
   // Scalar fields will be overwritten, if present in `from`.
   // Embedded messages will be merged.
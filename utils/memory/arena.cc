@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/memory/arena.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+
+namespace libtextclassifier3 {
+
+constexpr size_t Arena::kDefaultBlockSize;
+
+Arena::Arena(size_t initial_block_size)
+    : next_block_size_(std::max<size_t>(initial_block_size, 64)) {}
+
+Arena::~Arena() {}
+
+void* Arena::Allocate(size_t num_bytes, size_t alignment) {
+  uintptr_t aligned =
+      (reinterpret_cast<uintptr_t>(current_) + alignment - 1) &
+      ~(static_cast<uintptr_t>(alignment) - 1);
+  if (current_ == nullptr ||
+      aligned + num_bytes > reinterpret_cast<uintptr_t>(end_)) {
+    AddBlock(num_bytes + alignment);
+    aligned = (reinterpret_cast<uintptr_t>(current_) + alignment - 1) &
+              ~(static_cast<uintptr_t>(alignment) - 1);
+  }
+  current_ = reinterpret_cast<char*>(aligned + num_bytes);
+  bytes_allocated_ += num_bytes;
+  return reinterpret_cast<void*>(aligned);
+}
+
+void Arena::AddBlock(size_t min_bytes) {
+  const size_t size = std::max(next_block_size_, min_bytes);
+  blocks_.push_back(Block{std::unique_ptr<char[]>(new char[size]), size});
+  current_ = blocks_.back().data.get();
+  end_ = current_ + size;
+  next_block_size_ = 2 * size;
+}
+
+void Arena::Reset() {
+  bytes_allocated_ = 0;
+  if (blocks_.empty()) {
+    return;
+  }
+
+  // Coalesce into a single block that fits everything the last request used,
+  // so that the next request of the same size is served without growing.
+  if (blocks_.size() > 1) {
+    const size_t total = bytes_reserved();
+    blocks_.clear();
+    AddBlock(total);
+    return;
+  }
+  current_ = blocks_.front().data.get();
+  end_ = current_ + blocks_.front().size;
+}
+
+size_t Arena::bytes_reserved() const {
+  size_t result = 0;
+  for (const Block& block : blocks_) {
+    result += block.size;
+  }
+  return result;
+}
+
+}  // namespace libtextclassifier3
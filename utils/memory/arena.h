@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Monotonic allocator for short-lived, per-request temporaries.
+
+#ifndef LIBTEXTCLASSIFIER_UTILS_MEMORY_ARENA_H_
+#define LIBTEXTCLASSIFIER_UTILS_MEMORY_ARENA_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace libtextclassifier3 {
+
+// Bump-pointer allocator: memory is handed out from large blocks and is only
+// given back all at once, by Reset() or on destruction. Objects allocated from
+// the arena are not destroyed by it, so it should only back containers (see
+// ArenaAllocator) whose destructors run before the arena is reset.
+//
+// Reset() keeps the memory around, coalesced into a single block, so an arena
+// reused across requests stops calling malloc once it has grown to the size of
+// a typical request.
+//
+// NOTE: Not thread-safe; use one arena per request or per thread.
+class Arena {
+ public:
+  explicit Arena(size_t initial_block_size = kDefaultBlockSize);
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // Returns 'num_bytes' of uninitialized memory aligned to 'alignment', which
+  // must be a power of two.
+  void* Allocate(size_t num_bytes, size_t alignment = alignof(max_align_t));
+
+  // Releases everything allocated so far. Keeps the memory for reuse.
+  void Reset();
+
+  // Number of bytes handed out since construction or the last Reset().
+  size_t bytes_allocated() const { return bytes_allocated_; }
+
+  // Number of bytes currently held in blocks.
+  size_t bytes_reserved() const;
+
+  static constexpr size_t kDefaultBlockSize = 4096;
+
+ private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  // Adds a block that can fit at least 'min_bytes' and makes it current.
+  void AddBlock(size_t min_bytes);
+
+  std::vector<Block> blocks_;
+  char* current_ = nullptr;
+  char* end_ = nullptr;
+  size_t next_block_size_;
+  size_t bytes_allocated_ = 0;
+};
+
+// Standard allocator backed by an Arena. A null arena makes it behave like
+// std::allocator, so containers can opt into an arena without changing type.
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  ArenaAllocator() : arena_(nullptr) {}
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    if (arena_ == nullptr) {
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* p, size_t n) {
+    if (arena_ == nullptr) {
+      ::operator delete(p);
+    }
+  }
+
+  Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_UTILS_MEMORY_ARENA_H_
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/memory/arena.h"
+
+#include <stdint.h>
+
+#include <map>
+
+#include "utils/testing/allocation-counter.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+TEST(ArenaTest, AlignsAllocations) {
+  Arena arena(/*initial_block_size=*/128);
+  arena.Allocate(1, 1);
+  void* aligned = arena.Allocate(8, 8);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned) % 8, 0);
+  aligned = arena.Allocate(3, 1);
+  aligned = arena.Allocate(16, 16);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned) % 16, 0);
+  EXPECT_EQ(arena.bytes_allocated(), 1 + 8 + 3 + 16);
+}
+
+TEST(ArenaTest, GrowsForLargeAllocations) {
+  Arena arena(/*initial_block_size=*/128);
+  char* data = static_cast<char*>(arena.Allocate(1000));
+  for (int i = 0; i < 1000; ++i) {
+    data[i] = 'a';
+  }
+  EXPECT_GE(arena.bytes_reserved(), 1000);
+}
+
+TEST(ArenaTest, ResetReusesMemory) {
+  Arena arena(/*initial_block_size=*/128);
+  for (int i = 0; i < 10; ++i) {
+    arena.Allocate(100);
+  }
+  arena.Reset();
+  EXPECT_EQ(arena.bytes_allocated(), 0);
+  const size_t reserved = arena.bytes_reserved();
+  EXPECT_GE(reserved, 1000);
+
+  ScopedAllocationCounter counter;
+  for (int i = 0; i < 10; ++i) {
+    arena.Allocate(100);
+  }
+  EXPECT_EQ(counter.num_allocations(), 0);
+  EXPECT_EQ(arena.bytes_reserved(), reserved);
+}
+
+TEST(ArenaTest, BacksContainers) {
+  Arena arena;
+  ArenaVector<int> values{ArenaAllocator<int>(&arena)};
+  for (int i = 0; i < 100; ++i) {
+    values.push_back(i);
+  }
+  EXPECT_EQ(values.size(), 100);
+  EXPECT_EQ(values[99], 99);
+  EXPECT_GE(arena.bytes_allocated(), 100 * sizeof(int));
+
+  std::map<int, int, std::less<int>,
+           ArenaAllocator<std::pair<const int, int>>>
+      map{std::less<int>(), ArenaAllocator<std::pair<const int, int>>(&arena)};
+  map[1] = 2;
+  EXPECT_EQ(map[1], 2);
+}
+
+TEST(ArenaTest, ContainersDoNotAllocateAfterWarmUp) {
+  Arena arena;
+  for (int round = 0; round < 3; ++round) {
+    arena.Reset();
+    ScopedAllocationCounter counter;
+    {
+      ArenaVector<int> values{ArenaAllocator<int>(&arena)};
+      for (int i = 0; i < 200; ++i) {
+        values.push_back(i);
+      }
+    }
+    if (round > 0) {
+      EXPECT_EQ(counter.num_allocations(), 0);
+    }
+  }
+}
+
+TEST(ArenaTest, NullArenaUsesHeap) {
+  ScopedAllocationCounter counter;
+  ArenaVector<int> values;
+  values.push_back(1);
+  EXPECT_EQ(counter.num_allocations(), 1);
+  EXPECT_EQ(values.get_allocator().arena(), nullptr);
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
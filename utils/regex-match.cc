@@ -161,6 +161,18 @@ bool SetFieldFromCapturingGroup(const int group_id,
   return flatbuffer->ParseAndSet(field_path, group_text);
 }
 
+bool SetFieldFromCapturingGroup(const int group_id,
+                                const FlatbufferWriter::FieldPath& field_path,
+                                const UniLib::RegexMatcher* matcher,
+                                FlatbufferWriter* flatbuffer) {
+  int status = UniLib::RegexMatcher::kNoError;
+  std::string group_text = matcher->Group(group_id, &status).ToUTF8String();
+  if (status != UniLib::RegexMatcher::kNoError || group_text.empty()) {
+    return false;
+  }
+  return flatbuffer->ParseAndSet(field_path, group_text);
+}
+
 bool VerifyMatch(const std::string& context,
                  const UniLib::RegexMatcher* matcher,
                  const std::string& lua_verifier_code) {
@@ -17,6 +17,7 @@
 #ifndef LIBTEXTCLASSIFIER_UTILS_REGEX_MATCH_H_
 #define LIBTEXTCLASSIFIER_UTILS_REGEX_MATCH_H_
 
+#include "utils/flatbuffers-writer.h"
 #include "utils/flatbuffers.h"
 #include "utils/flatbuffers_generated.h"
 #include "utils/utf8/unilib.h"
@@ -28,6 +29,10 @@ bool SetFieldFromCapturingGroup(const int group_id,
                                 const FlatbufferFieldPath* field_path,
                                 const UniLib::RegexMatcher* matcher,
                                 ReflectiveFlatbuffer* flatbuffer);
+bool SetFieldFromCapturingGroup(const int group_id,
+                                const FlatbufferWriter::FieldPath& field_path,
+                                const UniLib::RegexMatcher* matcher,
+                                FlatbufferWriter* flatbuffer);
 
 // Post-checks a regular expression match with a lua verifier script.
 // The verifier can access:
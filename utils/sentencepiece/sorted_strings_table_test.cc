@@ -110,5 +110,25 @@ TEST(SortedStringsTest, Lookup) {
   }
 }
 
+TEST(SortedStringsTest, LinearScanStopsAtEndOfInput) {
+  const char pieces[] = "hell\0hello\0o\0there\0";
+  const uint32 offsets[] = {0, 5, 11, 13};
+
+  SortedStringsTable table(/*num_pieces=*/4, offsets, StringPiece(pieces, 18),
+                           /*use_linear_scan_threshold=*/10);
+
+  // The input is a prefix of a longer string, the pieces must only be matched
+  // against the input itself.
+  std::vector<TrieMatch> matches;
+  EXPECT_TRUE(
+      table.FindAllPrefixMatches(StringPiece("hello", 3), &matches));
+  EXPECT_THAT(matches, testing::IsEmpty());
+
+  EXPECT_TRUE(
+      table.FindAllPrefixMatches(StringPiece("hello", 4), &matches));
+  ASSERT_EQ(matches.size(), 1);
+  EXPECT_EQ(matches[0].id, 0 /*hell*/);
+}
+
 }  // namespace
 }  // namespace libtextclassifier3
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/strings/interned-string.h"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace libtextclassifier3 {
+namespace {
+
+using internal::InternedStringEntry;
+
+class StringPool {
+ public:
+  // Returns the pooled entry of the value, or nullptr if it was never
+  // interned.
+  const InternedStringEntry* Find(StringPiece value) {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    const auto it = index_.find(value);
+    return it != index_.end() ? it->second : nullptr;
+  }
+
+  // Returns the pooled entry of the value. The returned pointer stays valid
+  // for the lifetime of the process.
+  const InternedStringEntry* Intern(StringPiece value) {
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+      const auto it = index_.find(value);
+      if (it != index_.end()) {
+        return it->second;
+      }
+    }
+    std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+    const auto it = index_.find(value);
+    if (it != index_.end()) {
+      return it->second;
+    }
+    entries_.push_back(
+        {value.ToString(), static_cast<int>(entries_.size())});
+    const InternedStringEntry* entry = &entries_.back();
+    index_[StringPiece(entry->value)] = entry;
+    return entry;
+  }
+
+ private:
+  std::shared_timed_mutex mutex_;
+
+  // Elements of a deque are never moved in memory by push_back, so the keys
+  // of the index can point into them.
+  std::deque<InternedStringEntry> entries_;
+  std::unordered_map<StringPiece, const InternedStringEntry*, StringPieceHash,
+                     StringPieceEqual>
+      index_;
+};
+
+StringPool* GetStringPool() {
+  // Intentionally leaked, so that interned strings outlive static destructors.
+  static StringPool* pool = new StringPool();
+  return pool;
+}
+
+const InternedStringEntry* EmptyString() {
+  static const InternedStringEntry* empty = GetStringPool()->Intern("");
+  return empty;
+}
+
+}  // namespace
+
+InternedString::InternedString() : entry_(EmptyString()) {}
+
+InternedString::InternedString(const std::string& value)
+    : entry_(value.empty() ? EmptyString() : GetStringPool()->Intern(value)) {}
+
+InternedString::InternedString(const char* value)
+    : InternedString(StringPiece(value)) {}
+
+InternedString::InternedString(StringPiece value)
+    : entry_(value.empty() ? EmptyString() : GetStringPool()->Intern(value)) {}
+
+bool FindInterned(StringPiece value, InternedString* interned) {
+  const InternedStringEntry* entry =
+      value.empty() ? EmptyString() : GetStringPool()->Find(value);
+  if (entry == nullptr) {
+    return false;
+  }
+  interned->entry_ = entry;
+  return true;
+}
+
+void InternedStringSet::Insert(const InternedString& value) {
+  const int word = value.id() / 64;
+  if (word >= static_cast<int>(words_.size())) {
+    words_.resize(word + 1, 0);
+  }
+  const uint64 bit = static_cast<uint64>(1) << (value.id() % 64);
+  if (!(words_[word] & bit)) {
+    words_[word] |= bit;
+    ++size_;
+  }
+}
+
+}  // namespace libtextclassifier3
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LIBTEXTCLASSIFIER_UTILS_STRINGS_INTERNED_STRING_H_
+#define LIBTEXTCLASSIFIER_UTILS_STRINGS_INTERNED_STRING_H_
+
+#include <string>
+#include <vector>
+
+#include "utils/base/integral_types.h"
+#include "utils/base/logging.h"
+#include "utils/strings/stringpiece.h"
+
+namespace libtextclassifier3 {
+
+namespace internal {
+struct InternedStringEntry {
+  std::string value;
+  int id;
+};
+}  // namespace internal
+
+// Immutable string whose value is stored once in a process-wide pool. Copies
+// are pointer copies and equality is pointer equality. Every value also gets a
+// small, dense id, which can index arrays and bitmasks (see InternedStringSet).
+// Meant for small, bounded vocabularies, such as collection names: the pool
+// never shrinks. Construction is thread-safe.
+class InternedString {
+ public:
+  InternedString();
+
+  // Intentionally implicit, so that plain strings can be assigned.
+  InternedString(const std::string& value);  // NOLINT(runtime/explicit)
+  InternedString(const char* value);         // NOLINT(runtime/explicit)
+  explicit InternedString(StringPiece value);
+
+  const std::string& str() const { return entry_->value; }
+  operator const std::string&() const { return entry_->value; }  // NOLINT
+
+  const char* c_str() const { return entry_->value.c_str(); }
+  const char* data() const { return entry_->value.data(); }
+  size_t size() const { return entry_->value.size(); }
+  bool empty() const { return entry_->value.empty(); }
+
+  // Dense id of the value, assigned in the order in which values are first
+  // interned. Stable for the lifetime of the process, but not across runs.
+  int id() const { return entry_->id; }
+
+  friend bool operator==(const InternedString& a, const InternedString& b) {
+    return a.entry_ == b.entry_;
+  }
+  friend bool operator!=(const InternedString& a, const InternedString& b) {
+    return a.entry_ != b.entry_;
+  }
+  friend bool operator==(const InternedString& a, const std::string& b) {
+    return a.entry_->value == b;
+  }
+  friend bool operator==(const std::string& a, const InternedString& b) {
+    return a == b.entry_->value;
+  }
+  friend bool operator!=(const InternedString& a, const std::string& b) {
+    return a.entry_->value != b;
+  }
+  friend bool operator!=(const std::string& a, const InternedString& b) {
+    return a != b.entry_->value;
+  }
+  friend bool operator==(const InternedString& a, const char* b) {
+    return a.entry_->value == b;
+  }
+  friend bool operator!=(const InternedString& a, const char* b) {
+    return a.entry_->value != b;
+  }
+  friend bool operator==(const char* a, const InternedString& b) {
+    return a == b.entry_->value;
+  }
+  friend bool operator!=(const char* a, const InternedString& b) {
+    return a != b.entry_->value;
+  }
+
+  // Lexicographic order of the values.
+  friend bool operator<(const InternedString& a, const InternedString& b) {
+    return a.entry_ != b.entry_ && a.entry_->value < b.entry_->value;
+  }
+  friend bool operator>(const InternedString& a, const InternedString& b) {
+    return b < a;
+  }
+
+ private:
+  friend bool FindInterned(StringPiece value, InternedString* interned);
+
+  const internal::InternedStringEntry* entry_;
+};
+
+// Looks up the interned string equal to 'value' without interning it, so that
+// the pool does not grow with untrusted values, e.g. from requests. Returns
+// false if the value was never interned; it is then not equal to any
+// interned string.
+bool FindInterned(StringPiece value, InternedString* interned);
+
+inline logging::LoggingStringStream& operator<<(
+    logging::LoggingStringStream& stream, const InternedString& value) {
+  return stream << value.str();
+}
+
+// Set of interned strings, stored as a bitmask indexed by their ids, so that
+// lookups neither hash nor compare the values.
+class InternedStringSet {
+ public:
+  InternedStringSet() {}
+
+  // Interns all the values, so only use it with trusted values, e.g. from the
+  // model; see FindInterned for untrusted ones.
+  template <typename Iterable>
+  explicit InternedStringSet(const Iterable& values) {
+    for (const auto& value : values) {
+      Insert(InternedString(value));
+    }
+  }
+
+  void Insert(const InternedString& value);
+
+  bool Contains(const InternedString& value) const {
+    const int word = value.id() / 64;
+    return word < static_cast<int>(words_.size()) &&
+           (words_[word] >> (value.id() % 64)) & 1;
+  }
+
+  bool empty() const { return size_ == 0; }
+  int size() const { return size_; }
+
+ private:
+  std::vector<uint64> words_;
+  int size_ = 0;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_UTILS_STRINGS_INTERNED_STRING_H_
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/strings/interned-string.h"
+
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+TEST(InternedStringTest, EqualValuesShareStorage) {
+  const std::string phone = "phone";
+  const InternedString a(phone);
+  const InternedString b("phone");
+  const InternedString c(StringPiece("phone number", 5));
+  EXPECT_EQ(&a.str(), &b.str());
+  EXPECT_EQ(&a.str(), &c.str());
+  EXPECT_TRUE(a == b);
+  EXPECT_TRUE(a == phone);
+  EXPECT_TRUE(phone == a);
+  EXPECT_TRUE(a == "phone");
+  EXPECT_TRUE("phone" == a);
+  EXPECT_TRUE(a != "email");
+  EXPECT_EQ(a.size(), 5);
+  EXPECT_STREQ(a.c_str(), "phone");
+}
+
+TEST(InternedStringTest, DefaultIsEmpty) {
+  const InternedString empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty, InternedString(""));
+  EXPECT_EQ(empty, std::string());
+}
+
+TEST(InternedStringTest, ConvertsToString) {
+  InternedString value = std::string("address");
+  const std::string& reference = value;
+  EXPECT_EQ(reference, "address");
+  std::string copy = value;
+  EXPECT_EQ(copy, "address");
+  value = "email";
+  EXPECT_EQ(value.str(), "email");
+}
+
+TEST(InternedStringTest, OrdersLexicographically) {
+  EXPECT_LT(InternedString("address"), InternedString("phone"));
+  EXPECT_GT(InternedString("phone"), InternedString("address"));
+  EXPECT_FALSE(InternedString("phone") < InternedString("phone"));
+}
+
+TEST(InternedStringTest, AssignsDenseIds) {
+  const InternedString a("id-test-a");
+  const InternedString b("id-test-b");
+  EXPECT_NE(a.id(), b.id());
+  EXPECT_EQ(InternedString("id-test-a").id(), a.id());
+  EXPECT_EQ(InternedString(std::string("id-test-b")).id(), b.id());
+}
+
+TEST(InternedStringSetTest, ContainsInsertedValues) {
+  InternedStringSet set;
+  EXPECT_TRUE(set.empty());
+  set.Insert("phone");
+  set.Insert("email");
+  set.Insert("phone");
+  EXPECT_EQ(set.size(), 2);
+  EXPECT_TRUE(set.Contains("phone"));
+  EXPECT_TRUE(set.Contains(InternedString("email")));
+  EXPECT_FALSE(set.Contains("address"));
+
+  // Ids beyond the first bitmask word.
+  for (int i = 0; i < 200; ++i) {
+    InternedString(std::to_string(i) + "-set-test");
+  }
+  const InternedString late("late-set-test");
+  EXPECT_FALSE(set.Contains(late));
+  set.Insert(late);
+  EXPECT_TRUE(set.Contains(late));
+}
+
+TEST(InternedStringSetTest, CreatesFromStrings) {
+  const std::vector<std::string> values = {"url", "flight"};
+  const InternedStringSet set(values);
+  EXPECT_EQ(set.size(), 2);
+  EXPECT_TRUE(set.Contains("url"));
+  EXPECT_TRUE(set.Contains("flight"));
+  EXPECT_FALSE(set.Contains("iban"));
+}
+
+TEST(InternedStringTest, FindsOnlyInternedValues) {
+  const InternedString phone("phone");
+  InternedString found;
+  ASSERT_TRUE(FindInterned("phone", &found));
+  EXPECT_EQ(found, phone);
+
+  const int next_id = InternedString("find-interned-marker").id() + 1;
+  EXPECT_FALSE(FindInterned("never-interned", &found));
+  EXPECT_EQ(found, phone);
+  EXPECT_EQ(InternedString("next-interned-marker").id(), next_id);
+}
+
+TEST(InternedStringTest, InternsConcurrently) {
+  std::vector<std::thread> threads;
+  std::vector<const std::string*> values(8);
+  for (int i = 0; i < values.size(); ++i) {
+    threads.emplace_back([i, &values]() {
+      for (int j = 0; j < 1000; ++j) {
+        InternedString(std::to_string(j));
+      }
+      values[i] = &InternedString("concurrent").str();
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  for (const std::string* value : values) {
+    EXPECT_EQ(value, values[0]);
+  }
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
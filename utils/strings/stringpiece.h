@@ -87,6 +87,23 @@ class StringPiece {
   size_t size_;
 };
 
+// Hash and equality functors for using StringPiece as a key of unordered
+// containers.
+struct StringPieceHash {
+  size_t operator()(StringPiece value) const {
+    // FNV-1a.
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < value.size(); ++i) {
+      hash = (hash ^ static_cast<unsigned char>(value.data()[i])) * 16777619u;
+    }
+    return hash;
+  }
+};
+
+struct StringPieceEqual {
+  bool operator()(StringPiece a, StringPiece b) const { return a.Equals(b); }
+};
+
 inline bool EndsWith(StringPiece text, StringPiece suffix) {
   return text.EndsWith(suffix);
 }
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/testing/allocation-counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace libtextclassifier3 {
+namespace {
+
+// Plain old data, so that no thread-local initialization (and thus no
+// allocation) happens on first use.
+thread_local int64 thread_num_allocations = 0;
+thread_local int64 thread_num_bytes = 0;
+
+void* CountedAllocate(std::size_t size) {
+  ++thread_num_allocations;
+  thread_num_bytes += size;
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    std::abort();
+  }
+  return ptr;
+}
+
+}  // namespace
+
+AllocationStats CurrentThreadAllocationStats() {
+  AllocationStats stats;
+  stats.num_allocations = thread_num_allocations;
+  stats.num_bytes = thread_num_bytes;
+  return stats;
+}
+
+}  // namespace libtextclassifier3
+
+void* operator new(std::size_t size) {
+  return libtextclassifier3::CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size) {
+  return libtextclassifier3::CountedAllocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return libtextclassifier3::CountedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return libtextclassifier3::CountedAllocate(size);
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  std::free(ptr);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Test-only instrumentation for counting heap allocations, used to assert
+// per-call allocation budgets of the request paths.
+//
+// NOTE: allocation-counter.cc replaces the global operator new and delete, so
+// it must only be linked into test and benchmark binaries.
+
+#ifndef LIBTEXTCLASSIFIER_UTILS_TESTING_ALLOCATION_COUNTER_H_
+#define LIBTEXTCLASSIFIER_UTILS_TESTING_ALLOCATION_COUNTER_H_
+
+#include "utils/base/integral_types.h"
+
+namespace libtextclassifier3 {
+
+struct AllocationStats {
+  // Number of calls to operator new.
+  int64 num_allocations = 0;
+
+  // Total number of requested bytes.
+  int64 num_bytes = 0;
+};
+
+// Returns the allocations made by the current thread since it started.
+AllocationStats CurrentThreadAllocationStats();
+
+// Counts the allocations made by the current thread during the lifetime of the
+// object. Counters can be nested.
+class ScopedAllocationCounter {
+ public:
+  ScopedAllocationCounter() : start_(CurrentThreadAllocationStats()) {}
+
+  // Returns the allocations made since the counter was created.
+  AllocationStats Get() const {
+    const AllocationStats now = CurrentThreadAllocationStats();
+    AllocationStats stats;
+    stats.num_allocations = now.num_allocations - start_.num_allocations;
+    stats.num_bytes = now.num_bytes - start_.num_bytes;
+    return stats;
+  }
+
+  int64 num_allocations() const { return Get().num_allocations; }
+  int64 num_bytes() const { return Get().num_bytes; }
+
+ private:
+  const AllocationStats start_;
+};
+
+}  // namespace libtextclassifier3
+
+#endif  // LIBTEXTCLASSIFIER_UTILS_TESTING_ALLOCATION_COUNTER_H_
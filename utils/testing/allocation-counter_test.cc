@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/testing/allocation-counter.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace libtextclassifier3 {
+namespace {
+
+TEST(AllocationCounterTest, CountsAllocations) {
+  ScopedAllocationCounter counter;
+  EXPECT_EQ(counter.num_allocations(), 0);
+
+  std::unique_ptr<int> value(new int(42));
+  EXPECT_EQ(counter.num_allocations(), 1);
+  EXPECT_EQ(counter.num_bytes(), sizeof(int));
+
+  std::vector<char> buffer(100);
+  EXPECT_EQ(counter.num_allocations(), 2);
+  EXPECT_EQ(counter.num_bytes(), sizeof(int) + 100);
+}
+
+TEST(AllocationCounterTest, CountersNest) {
+  ScopedAllocationCounter outer;
+  std::unique_ptr<int> first(new int(1));
+  {
+    ScopedAllocationCounter inner;
+    std::unique_ptr<int> second(new int(2));
+    EXPECT_EQ(inner.num_allocations(), 1);
+  }
+  EXPECT_EQ(outer.num_allocations(), 2);
+}
+
+}  // namespace
+}  // namespace libtextclassifier3
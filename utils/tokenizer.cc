@@ -93,30 +93,40 @@ std::vector<Token> Tokenizer::Tokenize(const std::string& text) const {
 }
 
 std::vector<Token> Tokenizer::Tokenize(const UnicodeText& text_unicode) const {
+  std::vector<Token> tokens;
+  Tokenize(text_unicode, &tokens);
+  return tokens;
+}
+
+void Tokenizer::Tokenize(const UnicodeText& text_unicode,
+                         std::vector<Token>* tokens) const {
   switch (type_) {
     case TokenizationType_INTERNAL_TOKENIZER:
-      return InternalTokenize(text_unicode);
+      InternalTokenize(text_unicode, tokens);
+      return;
     case TokenizationType_ICU:
       TC3_FALLTHROUGH_INTENDED;
     case TokenizationType_MIXED: {
-      std::vector<Token> result;
-      if (!ICUTokenize(text_unicode, &result)) {
-        return {};
+      tokens->clear();
+      if (!ICUTokenize(text_unicode, tokens)) {
+        tokens->clear();
+        return;
       }
       if (type_ == TokenizationType_MIXED) {
-        InternalRetokenize(text_unicode, &result);
+        InternalRetokenize(text_unicode, tokens);
       }
-      return result;
+      return;
     }
     default:
       TC3_LOG(ERROR) << "Unknown tokenization type specified. Using internal.";
-      return InternalTokenize(text_unicode);
+      InternalTokenize(text_unicode, tokens);
+      return;
   }
 }
 
-std::vector<Token> Tokenizer::InternalTokenize(
-    const UnicodeText& text_unicode) const {
-  std::vector<Token> result;
+void Tokenizer::InternalTokenize(const UnicodeText& text_unicode,
+                                 std::vector<Token>* result) const {
+  result->clear();
   Token new_token("", 0, 0);
   int codepoint_index = 0;
 
@@ -131,7 +141,7 @@ std::vector<Token> Tokenizer::InternalTokenize(
         (split_on_script_change_ && last_script != kInvalidScript &&
          last_script != script)) {
       if (!new_token.value.empty()) {
-        result.push_back(new_token);
+        result->push_back(new_token);
       }
       new_token = Token("", codepoint_index, codepoint_index);
     }
@@ -143,7 +153,7 @@ std::vector<Token> Tokenizer::InternalTokenize(
     }
     if (role & TokenizationCodepointRange_::Role_SPLIT_AFTER) {
       if (!new_token.value.empty()) {
-        result.push_back(new_token);
+        result->push_back(new_token);
       }
       new_token = Token("", codepoint_index + 1, codepoint_index + 1);
     }
@@ -151,10 +161,8 @@ std::vector<Token> Tokenizer::InternalTokenize(
     last_script = script;
   }
   if (!new_token.value.empty()) {
-    result.push_back(new_token);
+    result->push_back(new_token);
   }
-
-  return result;
 }
 
 void Tokenizer::TokenizeSubstring(const UnicodeText& unicode_text,
@@ -171,7 +179,8 @@ void Tokenizer::TokenizeSubstring(const UnicodeText& unicode_text,
 
   // Run the tokenizer and update the token bounds to reflect the offset of the
   // substring.
-  std::vector<Token> tokens = InternalTokenize(text);
+  std::vector<Token> tokens;
+  InternalTokenize(text, &tokens);
 
   // Avoids progressive capacity increases in the for loop.
   result->reserve(result->size() + tokens.size());
@@ -68,6 +68,11 @@ class Tokenizer {
   // Same as above but takes UnicodeText.
   std::vector<Token> Tokenize(const UnicodeText& text_unicode) const;
 
+  // Same as above but writes the tokens to 'tokens', reusing its storage
+  // across calls.
+  void Tokenize(const UnicodeText& text_unicode,
+                std::vector<Token>* tokens) const;
+
  protected:
   // Finds the tokenization codepoint range config for given codepoint.
   // Internally uses binary search so should be O(log(# of codepoint_ranges)).
@@ -85,7 +90,9 @@ class Tokenizer {
   void TokenizeSubstring(const UnicodeText& unicode_text, CodepointSpan span,
                          std::vector<Token>* result) const;
 
-  std::vector<Token> InternalTokenize(const UnicodeText& text_unicode) const;
+  // Replaces the contents of 'result' with the tokens of the text.
+  void InternalTokenize(const UnicodeText& text_unicode,
+                        std::vector<Token>* result) const;
 
   // Takes the result of ICU tokenization and retokenizes stretches of tokens
   // made of a specific subset of characters using the internal tokenizer.
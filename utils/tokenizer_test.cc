@@ -93,6 +93,12 @@ class TestingTokenizerProxy {
     return tokenizer_->Tokenize(utf8_text);
   }
 
+  void Tokenize(const std::string& utf8_text,
+                std::vector<Token>* tokens) const {
+    tokenizer_->Tokenize(UTF8ToUnicodeText(utf8_text, /*do_copy=*/false),
+                         tokens);
+  }
+
  private:
   UniLib unilib_;
   std::vector<flatbuffers::DetachedBuffer> buffers_;
@@ -177,6 +183,28 @@ TEST(TokenizerTest, TokenizeOnSpace) {
               ElementsAreArray({Token("Hello", 0, 5), Token("world!", 6, 12)}));
 }
 
+TEST(TokenizerTest, TokenizeReplacesTokensOfPreviousText) {
+  std::vector<TokenizationCodepointRangeT> configs;
+  configs.emplace_back();
+  configs.back().start = 32;
+  configs.back().end = 33;
+  configs.back().role = TokenizationCodepointRange_::Role_WHITESPACE_SEPARATOR;
+
+  TestingTokenizerProxy tokenizer(TokenizationType_INTERNAL_TOKENIZER, configs,
+                                  {},
+                                  /*split_on_script_change=*/false,
+                                  /*icu_preserve_whitespace_tokens=*/false);
+  std::vector<Token> tokens;
+  tokenizer.Tokenize("Hello big world!", &tokens);
+  EXPECT_THAT(tokens, ElementsAreArray({Token("Hello", 0, 5),
+                                        Token("big", 6, 9),
+                                        Token("world!", 10, 16)}));
+
+  tokenizer.Tokenize("Bye now", &tokens);
+  EXPECT_THAT(tokens,
+              ElementsAreArray({Token("Bye", 0, 3), Token("now", 4, 7)}));
+}
+
 TEST(TokenizerTest, TokenizeOnSpaceAndScriptChange) {
   std::vector<TokenizationCodepointRangeT> configs;
   TokenizationCodepointRangeT* config;